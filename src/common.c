@@ -39,8 +39,14 @@
 #include <inttypes.h>
 #include <time.h>
 #include <assert.h>
+#include <limits.h>
 #include <pthread.h>
 
+#ifdef SR_HAVE_FUTEX
+# include <linux/futex.h>
+# include <sys/syscall.h>
+#endif
+
 #ifndef SR_HAVE_PTHREAD_MUTEX_TIMEDLOCK
 
 int
@@ -1282,6 +1288,13 @@ sr_remove_data_files(const char *mod_name)
     }
     free(path);
 
+    if ((err_info = sr_module_file_journal_remove(mod_name))) {
+        return err_info;
+    }
+    if ((err_info = sr_module_file_index_remove(mod_name))) {
+        return err_info;
+    }
+
     if ((err_info = sr_path_ds_shm(mod_name, SR_DS_OPERATIONAL, 0, &path))) {
         return err_info;
     }
@@ -1452,6 +1465,34 @@ sr_path_ds_shm(const char *mod_name, sr_datastore_t ds, int abs_path, char **pat
     return err_info;
 }
 
+sr_error_info_t *
+sr_path_ds_journal(const char *mod_name, int abs_path, char **path)
+{
+    sr_error_info_t *err_info = NULL;
+    int ret;
+
+    ret = asprintf(path, "%s/sr_%s.%s.journal", abs_path ? SR_SHM_DIR : "", mod_name, sr_ds2str(SR_DS_RUNNING));
+    if (ret == -1) {
+        *path = NULL;
+        SR_ERRINFO_MEM(&err_info);
+    }
+    return err_info;
+}
+
+sr_error_info_t *
+sr_path_ds_index(const char *mod_name, int abs_path, char **path)
+{
+    sr_error_info_t *err_info = NULL;
+    int ret;
+
+    ret = asprintf(path, "%s/sr_%s.%s.index", abs_path ? SR_SHM_DIR : "", mod_name, sr_ds2str(SR_DS_RUNNING));
+    if (ret == -1) {
+        *path = NULL;
+        SR_ERRINFO_MEM(&err_info);
+    }
+    return err_info;
+}
+
 sr_error_info_t *
 sr_path_evpipe(uint32_t evpipe_num, char **path)
 {
@@ -2058,13 +2099,91 @@ sr_strshmlen(const char *str)
     return SR_SHM_SIZE(strlen(str) + 1);
 }
 
+sr_error_info_t *
+sr_shmalloc(sr_shm_t *shm_ext, size_t size, off_t *off)
+{
+    sr_ext_shm_t *ext_shm;
+    sr_ext_shm_free_t *chunk;
+    off_t *prev_next;
+    size_t chunk_size;
+    uint32_t idx;
+
+    assert(size && (size == SR_SHM_SIZE(size)));
+
+    ext_shm = (sr_ext_shm_t *)shm_ext->addr;
+    ++ext_shm->alloc_count;
+
+    idx = size / SR_SHM_MEM_ALIGN - 1;
+    if ((idx < SR_EXT_SHM_FREE_LISTS - 1) && ext_shm->free_lists[idx]) {
+        /* reuse a chunk of exactly this size */
+        *off = ext_shm->free_lists[idx];
+        ext_shm->free_lists[idx] = ((sr_ext_shm_free_t *)(shm_ext->addr + *off))->next;
+        ext_shm->wasted -= size;
+        ++ext_shm->reuse_count;
+        return NULL;
+    }
+
+    /* first fit from the large chunks */
+    for (prev_next = &ext_shm->free_lists[SR_EXT_SHM_FREE_LISTS - 1]; *prev_next; prev_next = &chunk->next) {
+        chunk = (sr_ext_shm_free_t *)(shm_ext->addr + *prev_next);
+        if (chunk->size >= size) {
+            /* unlink the chunk */
+            *off = *prev_next;
+            chunk_size = chunk->size;
+            *prev_next = chunk->next;
+            ext_shm->wasted -= chunk_size;
+            ++ext_shm->reuse_count;
+
+            /* return the rest of it */
+            sr_shmfree(shm_ext->addr, *off + size, chunk_size - size);
+            return NULL;
+        }
+    }
+
+    /* no suitable free chunk, enlarge ext SHM */
+    *off = shm_ext->size;
+    return sr_shm_remap(shm_ext, shm_ext->size + size);
+}
+
+void
+sr_shmfree(char *ext_shm_addr, off_t off, size_t size)
+{
+    sr_ext_shm_t *ext_shm;
+    sr_ext_shm_free_t *chunk;
+    uint32_t idx;
+
+    if (!size) {
+        return;
+    }
+    assert(off && (size == SR_SHM_SIZE(size)));
+
+    ext_shm = (sr_ext_shm_t *)ext_shm_addr;
+    chunk = (sr_ext_shm_free_t *)(ext_shm_addr + off);
+    ext_shm->wasted += size;
+
+    idx = size / SR_SHM_MEM_ALIGN - 1;
+    if (idx < SR_EXT_SHM_FREE_LISTS - 1) {
+        if (size < sizeof chunk->next) {
+            /* too small to be reused, only wasted */
+            return;
+        }
+    } else {
+        idx = SR_EXT_SHM_FREE_LISTS - 1;
+        chunk->size = size;
+    }
+
+    /* prepend into the free list */
+    chunk->next = ext_shm->free_lists[idx];
+    ext_shm->free_lists[idx] = off;
+}
+
 sr_error_info_t *
 sr_shmrealloc_add(sr_shm_t *shm_ext, off_t *shm_array, uint16_t *shm_count, int in_ext_shm, size_t item_size,
         int32_t add_idx, void **new_item, size_t dyn_attr_size, off_t *dyn_attr_off)
 {
     sr_error_info_t *err_info = NULL;
-    off_t old_array_off, new_array_off, old_count_off, attr_off;
-    size_t new_ext_size;
+    off_t old_array_off, new_array_off, old_count_off;
+    size_t old_size, new_size;
 
     assert((add_idx > -2) && (add_idx <= *shm_count));
     assert(!dyn_attr_size || dyn_attr_off);
@@ -2083,15 +2202,9 @@ sr_shmrealloc_add(sr_shm_t *shm_ext, off_t *shm_array, uint16_t *shm_count, int
         old_count_off = ((char *)shm_count) - shm_ext->addr;
     }
 
-    /* we may not even need to resize ext SHM because of the alignment */
-    if (SR_SHM_SIZE((*shm_count + 1) * item_size) + dyn_attr_size > SR_SHM_SIZE(*shm_count * item_size)) {
-        /* get new offsets and size */
-        new_array_off = shm_ext->size;
-        attr_off = new_array_off + SR_SHM_SIZE((*shm_count + 1) * item_size);
-        new_ext_size = attr_off + dyn_attr_size;
-
-        /* remap ext SHM */
-        if ((err_info = sr_shm_remap(shm_ext, new_ext_size))) {
+    if (dyn_attr_size) {
+        /* allocate the attribute, may remap ext SHM */
+        if ((err_info = sr_shmalloc(shm_ext, dyn_attr_size, dyn_attr_off))) {
             return err_info;
         }
 
@@ -2100,9 +2213,26 @@ sr_shmrealloc_add(sr_shm_t *shm_ext, off_t *shm_array, uint16_t *shm_count, int
             shm_array = (off_t *)(shm_ext->addr + old_array_off);
             shm_count = (uint16_t *)(shm_ext->addr + old_count_off);
         }
+    }
+
+    /* we may not even need to resize the array because of the alignment */
+    old_size = SR_SHM_SIZE(*shm_count * item_size);
+    new_size = SR_SHM_SIZE((*shm_count + 1) * item_size);
+    if (new_size > old_size) {
+        /* allocate the new array, may remap ext SHM */
+        if ((err_info = sr_shmalloc(shm_ext, new_size, &new_array_off))) {
+            if (dyn_attr_size) {
+                sr_shmfree(shm_ext->addr, *dyn_attr_off, dyn_attr_size);
+                *dyn_attr_off = 0;
+            }
+            return err_info;
+        }
 
-        /* add wasted memory */
-        *((size_t *)shm_ext->addr) += SR_SHM_SIZE(*shm_count * item_size);
+        if (in_ext_shm) {
+            /* update our pointers */
+            shm_array = (off_t *)(shm_ext->addr + old_array_off);
+            shm_count = (uint16_t *)(shm_ext->addr + old_count_off);
+        }
 
         /* copy preceding items */
         if (add_idx) {
@@ -2115,15 +2245,10 @@ sr_shmrealloc_add(sr_shm_t *shm_ext, off_t *shm_array, uint16_t *shm_count, int
                     shm_ext->addr + *shm_array + add_idx * item_size, (*shm_count - add_idx) * item_size);
         }
 
-        /* update array and attribute offset */
+        /* free the previous array and update its offset */
+        sr_shmfree(shm_ext->addr, *shm_array, old_size);
         *shm_array = new_array_off;
-        if (dyn_attr_off && dyn_attr_size) {
-            *dyn_attr_off = attr_off;
-        }
-
     } else if (add_idx < *shm_count) {
-        assert(!dyn_attr_size);
-
         /* we only need to move succeeding items */
         memmove(shm_ext->addr + *shm_array + (add_idx + 1) * item_size,
                 shm_ext->addr + *shm_array + add_idx * item_size, (*shm_count - add_idx) * item_size);
@@ -2137,23 +2262,28 @@ sr_shmrealloc_add(sr_shm_t *shm_ext, off_t *shm_array, uint16_t *shm_count, int
 }
 
 void
-sr_shmrealloc_del(char *ext_shm_addr, off_t *shm_array, uint16_t *shm_count, size_t item_size, uint16_t del_idx,
-        size_t dyn_shm_size)
+sr_shmrealloc_del(char *ext_shm_addr, off_t *shm_array, uint16_t *shm_count, size_t item_size, uint16_t del_idx)
 {
-    /* add wasted memory keeping alignment in mind */
-    *((size_t *)ext_shm_addr) += SR_SHM_SIZE(*shm_count * item_size) - SR_SHM_SIZE((*shm_count - 1) * item_size);
-    *((size_t *)ext_shm_addr) += dyn_shm_size;
+    size_t old_size, new_size;
+
+    old_size = SR_SHM_SIZE(*shm_count * item_size);
+    new_size = SR_SHM_SIZE((*shm_count - 1) * item_size);
 
     --(*shm_count);
-    if (!*shm_count) {
-        /* the only item removed */
-        *shm_array = 0;
-    } else if (del_idx < *shm_count) {
+    if (del_idx < *shm_count) {
         /* move all following items, we may need to keep the order intact */
         memmove((ext_shm_addr + *shm_array) + (del_idx * item_size),
                 (ext_shm_addr + *shm_array) + ((del_idx + 1) * item_size),
                 (*shm_count - del_idx) * item_size);
     }
+
+    /* free the unused tail of the array keeping alignment in mind */
+    sr_shmfree(ext_shm_addr, *shm_array + new_size, old_size - new_size);
+
+    if (!*shm_count) {
+        /* the only item removed */
+        *shm_array = 0;
+    }
 }
 
 sr_error_info_t *
@@ -2231,14 +2361,7 @@ sr_munlock(pthread_mutex_t *lock)
     }
 }
 
-/**
- * @brief Wrapper for pthread_cond_init().
- *
- * @param[out] cond Condition variable to initialize.
- * @param[in] shared Whether the condition will be shared among processes.
- * @return err_info, NULL on error.
- */
-static sr_error_info_t *
+sr_error_info_t *
 sr_cond_init(pthread_cond_t *cond, int shared)
 {
     sr_error_info_t *err_info = NULL;
@@ -2288,6 +2411,9 @@ sr_rwlock_init(sr_rwlock_t *rwlock, int shared)
         return err_info;
     }
     rwlock->readers = 0;
+#ifdef SR_HAVE_FUTEX
+    rwlock->cond_seq = 0;
+#endif
     if ((err_info = sr_cond_init(&rwlock->cond, shared))) {
         pthread_mutex_destroy(&rwlock->mutex);
         return err_info;
@@ -2303,6 +2429,265 @@ sr_rwlock_destroy(sr_rwlock_t *rwlock)
     pthread_cond_destroy(&rwlock->cond);
 }
 
+#ifdef SR_HAVE_FUTEX
+
+/** readers futex word flag of a writer holding the mutex */
+#define SR_RWLOCK_WRITER 0x80000000
+
+/** readers futex word unit of the count of writers waiting on the condition (with the mutex released) */
+#define SR_RWLOCK_COND_WAITER 0x01000000
+
+/** readers futex word mask of the count of writers waiting on the condition */
+#define SR_RWLOCK_COND_WAITER_MASK 0x7F000000
+
+/** readers futex word mask of the reader count */
+#define SR_RWLOCK_READER_MASK 0x00FFFFFF
+
+/**
+ * @brief Wait on a futex until woken up or timeout elapses.
+ *
+ * @param[in] uaddr Futex word.
+ * @param[in] expected Expected futex word value, do not wait if it differs.
+ * @param[in] abs_ts Absolute realtime timeout.
+ * @return 0 if woken up, errno on error (EAGAIN and EINTR are returned as 0).
+ */
+static int
+sr_futex_wait(uint32_t *uaddr, uint32_t expected, const struct timespec *abs_ts)
+{
+    if (syscall(SYS_futex, uaddr, FUTEX_WAIT_BITSET | FUTEX_CLOCK_REALTIME, expected, abs_ts, NULL,
+            FUTEX_BITSET_MATCH_ANY) == -1) {
+        if ((errno == EAGAIN) || (errno == EINTR)) {
+            /* value changed or a signal was caught, the caller will check the value */
+            return 0;
+        }
+        return errno;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Wake up waiters on a futex.
+ *
+ * @param[in] uaddr Futex word.
+ */
+static void
+sr_futex_wake(uint32_t *uaddr)
+{
+    if (syscall(SYS_futex, uaddr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0) == -1) {
+        SR_LOG_WRN("Waking up futex waiters failed (%s).", strerror(errno));
+    }
+}
+
+/**
+ * @brief Wake up all the writers waiting on the lock condition.
+ *
+ * @param[in] rwlock RW lock.
+ */
+static void
+sr_rwlock_cond_wake(sr_rwlock_t *rwlock)
+{
+    /* change the condition futex word so that no waiter about to sleep can miss this wake up */
+    __atomic_add_fetch(&rwlock->cond_seq, 1, __ATOMIC_RELEASE);
+
+    /* FUTEX WAKE */
+    sr_futex_wake(&rwlock->cond_seq);
+}
+
+/**
+ * @brief Wake up whoever may be waiting for the readers to leave a RW lock.
+ *
+ * @param[in] rwlock RW lock.
+ * @param[in] readers Readers futex word value after the last reader left.
+ */
+static void
+sr_rwlock_readers_left(sr_rwlock_t *rwlock, uint32_t readers)
+{
+    if (readers & SR_RWLOCK_WRITER) {
+        /* FUTEX WAKE */
+        sr_futex_wake(&rwlock->readers);
+    }
+
+    if (readers & (SR_RWLOCK_WRITER | SR_RWLOCK_COND_WAITER_MASK)) {
+        /* the mutex holder may be just about to wait on the condition so wake it even if it is not yet waiting */
+        sr_rwlock_cond_wake(rwlock);
+    }
+}
+
+sr_error_info_t *
+sr_rwlock(sr_rwlock_t *rwlock, int timeout_ms, sr_lock_mode_t mode, const char *func)
+{
+    sr_error_info_t *err_info = NULL;
+    struct timespec timeout_ts;
+    uint32_t readers;
+    int ret;
+
+    assert(mode != SR_LOCK_NONE);
+    assert(timeout_ms > 0);
+
+    if (mode == SR_LOCK_READ) {
+        /* fast path, there is no writer so just add a reader */
+        readers = __atomic_load_n(&rwlock->readers, __ATOMIC_RELAXED);
+        while (!(readers & (SR_RWLOCK_WRITER | SR_RWLOCK_COND_WAITER_MASK))) {
+            assert((readers & SR_RWLOCK_READER_MASK) < SR_RWLOCK_READER_MASK);
+            if (__atomic_compare_exchange_n(&rwlock->readers, &readers, readers + 1, 1, __ATOMIC_ACQUIRE,
+                    __ATOMIC_RELAXED)) {
+                return NULL;
+            }
+        }
+    }
+
+    sr_time_get(&timeout_ts, timeout_ms);
+
+    /* MUTEX LOCK */
+    ret = pthread_mutex_timedlock(&rwlock->mutex, &timeout_ts);
+    if (ret) {
+        SR_ERRINFO_LOCK(&err_info, func, ret);
+        return err_info;
+    }
+
+    if (mode == SR_LOCK_WRITE) {
+        /* write lock, no new readers can enter once the flag is set so the writer cannot be starved */
+        readers = __atomic_or_fetch(&rwlock->readers, SR_RWLOCK_WRITER, __ATOMIC_ACQUIRE);
+        ret = 0;
+        while (!ret && (readers & SR_RWLOCK_READER_MASK)) {
+            /* FUTEX WAIT */
+            ret = sr_futex_wait(&rwlock->readers, readers, &timeout_ts);
+            readers = __atomic_load_n(&rwlock->readers, __ATOMIC_ACQUIRE);
+        }
+
+        if (ret && (readers & SR_RWLOCK_READER_MASK)) {
+            __atomic_and_fetch(&rwlock->readers, ~SR_RWLOCK_WRITER, __ATOMIC_RELEASE);
+
+            /* MUTEX UNLOCK */
+            pthread_mutex_unlock(&rwlock->mutex);
+
+            SR_ERRINFO_COND(&err_info, func, ret);
+            return err_info;
+        }
+    } else {
+        /* read lock, a writer cannot be holding the mutex */
+        __atomic_add_fetch(&rwlock->readers, 1, __ATOMIC_ACQUIRE);
+
+        /* MUTEX UNLOCK */
+        pthread_mutex_unlock(&rwlock->mutex);
+    }
+
+    return NULL;
+}
+
+void
+sr_rwunlock(sr_rwlock_t *rwlock, sr_lock_mode_t mode, const char *func)
+{
+    sr_error_info_t *err_info = NULL;
+    uint32_t readers;
+
+    (void)func;
+    assert(mode != SR_LOCK_NONE);
+
+    if (mode == SR_LOCK_READ) {
+        /* remove a reader */
+        readers = __atomic_load_n(&rwlock->readers, __ATOMIC_RELAXED);
+        do {
+            if (!(readers & SR_RWLOCK_READER_MASK)) {
+                SR_ERRINFO_INT(&err_info);
+                sr_errinfo_free(&err_info);
+                return;
+            }
+        } while (!__atomic_compare_exchange_n(&rwlock->readers, &readers, readers - 1, 1, __ATOMIC_RELEASE,
+                __ATOMIC_RELAXED));
+        --readers;
+
+        if (!(readers & SR_RWLOCK_READER_MASK)) {
+            /* the last reader, wake any writers, never touching the mutex */
+            sr_rwlock_readers_left(rwlock, readers);
+        }
+        return;
+    }
+
+    /* we are unlocking a write lock, there can be no readers */
+    assert(!(__atomic_load_n(&rwlock->readers, __ATOMIC_RELAXED) & SR_RWLOCK_READER_MASK));
+
+    /* MUTEX UNLOCK */
+    sr_rwlock_cond_unlock(rwlock);
+}
+
+int
+sr_rwlock_has_readers(sr_rwlock_t *rwlock, uint32_t *cond_seq)
+{
+    uint32_t readers;
+
+    /* remember the condition state before checking anything so that no following change can be missed */
+    *cond_seq = __atomic_load_n(&rwlock->cond_seq, __ATOMIC_ACQUIRE);
+
+    /* no new readers can enter without the mutex and the last reader will wake us */
+    readers = __atomic_or_fetch(&rwlock->readers, SR_RWLOCK_WRITER, __ATOMIC_ACQUIRE);
+
+    return readers & SR_RWLOCK_READER_MASK;
+}
+
+int
+sr_rwlock_cond_wait(sr_rwlock_t *rwlock, uint32_t cond_seq, const struct timespec *abs_ts)
+{
+    uint32_t readers;
+    int ret;
+
+    /* we are no longer holding the mutex but the readers entering using it must wake us once they leave */
+    readers = __atomic_load_n(&rwlock->readers, __ATOMIC_RELAXED);
+    do {
+        assert((readers & SR_RWLOCK_COND_WAITER_MASK) < SR_RWLOCK_COND_WAITER_MASK);
+    } while (!__atomic_compare_exchange_n(&rwlock->readers, &readers,
+            (readers & ~SR_RWLOCK_WRITER) + SR_RWLOCK_COND_WAITER, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+    /* MUTEX UNLOCK */
+    pthread_mutex_unlock(&rwlock->mutex);
+
+    /* FUTEX WAIT */
+    ret = sr_futex_wait(&rwlock->cond_seq, cond_seq, abs_ts);
+
+    /* MUTEX LOCK, always relock the same way pthread_cond_timedwait() does */
+    pthread_mutex_lock(&rwlock->mutex);
+
+    /* we are holding the mutex again, let the readers use the fast path if there are no other waiters */
+    __atomic_sub_fetch(&rwlock->readers, SR_RWLOCK_COND_WAITER, __ATOMIC_RELEASE);
+
+    return ret;
+}
+
+void
+sr_rwlock_cond_unlock(sr_rwlock_t *rwlock)
+{
+    uint32_t readers;
+
+    /* clear the writer flag, some readers may still be present after a condition wait timeout */
+    readers = __atomic_and_fetch(&rwlock->readers, ~SR_RWLOCK_WRITER, __ATOMIC_RELEASE);
+
+    if (readers & SR_RWLOCK_COND_WAITER_MASK) {
+        /* the protected state may have changed */
+        sr_rwlock_cond_wake(rwlock);
+    }
+
+    /* broadcast on condition for any users of the lock condition variable */
+    pthread_cond_broadcast(&rwlock->cond);
+
+    /* MUTEX UNLOCK */
+    pthread_mutex_unlock(&rwlock->mutex);
+}
+
+void
+sr_rwlock_recover_readers(sr_rwlock_t *rwlock, uint32_t rcount)
+{
+    uint32_t readers;
+
+    readers = __atomic_sub_fetch(&rwlock->readers, rcount, __ATOMIC_RELEASE);
+    assert(((readers + rcount) & SR_RWLOCK_READER_MASK) >= rcount);
+
+    if (!(readers & SR_RWLOCK_READER_MASK)) {
+        sr_rwlock_readers_left(rwlock, readers);
+    }
+}
+#else
+
 sr_error_info_t *
 sr_rwlock(sr_rwlock_t *rwlock, int timeout_ms, sr_lock_mode_t mode, const char *func)
 {
@@ -2387,6 +2772,39 @@ sr_rwunlock(sr_rwlock_t *rwlock, sr_lock_mode_t mode, const char *func)
     pthread_mutex_unlock(&rwlock->mutex);
 }
 
+int
+sr_rwlock_has_readers(sr_rwlock_t *rwlock, uint32_t *cond_seq)
+{
+    (void)cond_seq;
+
+    return rwlock->readers;
+}
+
+int
+sr_rwlock_cond_wait(sr_rwlock_t *rwlock, uint32_t cond_seq, const struct timespec *abs_ts)
+{
+    (void)cond_seq;
+
+    /* COND WAIT */
+    return pthread_cond_timedwait(&rwlock->cond, &rwlock->mutex, abs_ts);
+}
+
+void
+sr_rwlock_cond_unlock(sr_rwlock_t *rwlock)
+{
+    /* MUTEX UNLOCK */
+    pthread_mutex_unlock(&rwlock->mutex);
+}
+
+void
+sr_rwlock_recover_readers(sr_rwlock_t *rwlock, uint32_t rcount)
+{
+    assert(rwlock->readers >= rcount);
+    rwlock->readers -= rcount;
+}
+
+#endif
+
 void *
 sr_realloc(void *ptr, size_t size)
 {
@@ -2405,8 +2823,9 @@ sr_cp_file2shm(const char *to, const char *from, mode_t perm)
 {
     sr_error_info_t *err_info = NULL;
     int fd_to = -1, fd_from = -1;
-    char *out_ptr, buf[4096];
-    ssize_t nread, nwritten;
+    char *out_ptr, *addr = MAP_FAILED;
+    size_t size = 0, to_write;
+    ssize_t nwritten;
     mode_t um;
 
     /* open "from" file */
@@ -2416,7 +2835,20 @@ sr_cp_file2shm(const char *to, const char *from, mode_t perm)
         goto cleanup;
     }
 
-    /* set umask so that the correct permissions are really set */
+    /* map it so that it can be written at once */
+    if ((err_info = sr_file_get_size(fd_from, &size))) {
+        goto cleanup;
+    }
+    if (size) {
+        addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd_from, 0);
+        if (addr == MAP_FAILED) {
+            sr_errinfo_new(&err_info, SR_ERR_NOMEM, NULL, "Failed to map \"%s\" (%s).", from, strerror(errno));
+            goto cleanup;
+        }
+        madvise(addr, size, MADV_SEQUENTIAL);
+    }
+
+    /* set umask so that the correct permissions are really set */
     um = umask(00000);
 
     /* open "to" SHM */
@@ -2427,27 +2859,25 @@ sr_cp_file2shm(const char *to, const char *from, mode_t perm)
         goto cleanup;
     }
 
-    while ((nread = read(fd_from, buf, sizeof buf)) > 0) {
-        out_ptr = buf;
-        do {
-            nwritten = write(fd_to, out_ptr, nread);
-            if (nwritten >= 0) {
-                nread -= nwritten;
-                out_ptr += nwritten;
-            } else if (errno != EINTR) {
-                SR_ERRINFO_SYSERRNO(&err_info, "write");
-                goto cleanup;
-            }
-        } while (nread > 0);
-    }
-    if (nread == -1) {
-        SR_ERRINFO_SYSERRNO(&err_info, "read");
-        goto cleanup;
+    out_ptr = addr;
+    to_write = size;
+    while (to_write) {
+        nwritten = write(fd_to, out_ptr, to_write);
+        if (nwritten >= 0) {
+            to_write -= nwritten;
+            out_ptr += nwritten;
+        } else if (errno != EINTR) {
+            SR_ERRINFO_SYSERRNO(&err_info, "write");
+            goto cleanup;
+        }
     }
 
     /* success */
 
 cleanup:
+    if (addr != MAP_FAILED) {
+        munmap(addr, size);
+    }
     if (fd_from > -1) {
         close(fd_from);
     }
@@ -2766,18 +3196,250 @@ sr_ev2api(sr_sub_event_t ev)
     return 0;
 }
 
-sr_error_info_t *
-sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
+/**
+ * @brief Arena holding all the strings of an array of values.
+ */
+struct sr_val_arena_s {
+    char *buf;                  /**< Arena memory, NULL if only its size is being learned. */
+    size_t used;                /**< Number of used bytes. */
+};
+
+/**
+ * @brief Duplicate a string into an arena or allocate it.
+ *
+ * @param[in] arena Arena to use, NULL to allocate the string.
+ * @param[in] str String to duplicate.
+ * @return Duplicated string, NULL on memory allocation error.
+ */
+static char *
+sr_val_arena_strdup(struct sr_val_arena_s *arena, const char *str)
 {
-    sr_error_info_t *err_info = NULL;
     char *ptr;
-    const struct lyd_node_leaf_list *leaf;
+    size_t len;
+
+    if (!arena) {
+        return strdup(str);
+    }
+
+    len = strlen(str) + 1;
+    if (!arena->buf) {
+        /* only learning the size */
+        arena->used += len;
+        return (char *)str;
+    }
+
+    ptr = arena->buf + arena->used;
+    memcpy(ptr, str, len);
+    arena->used += len;
+
+    return ptr;
+}
+
+/**
+ * @brief Print a part of a data path, if there is a buffer.
+ *
+ * @param[in] buf Buffer to print into, may be NULL.
+ * @param[in] len Current length of the path.
+ * @param[in] str String to print.
+ * @param[in] str_len Length of the string.
+ * @return New length of the path.
+ */
+static size_t
+sr_lyd_path_append(char *buf, size_t len, const char *str, size_t str_len)
+{
+    if (buf) {
+        memcpy(buf + len, str, str_len);
+    }
+
+    return len + str_len;
+}
+
+/**
+ * @brief Print a predicate of a data path, if there is a buffer.
+ *
+ * @param[in] buf Buffer to print into, may be NULL.
+ * @param[in] len Current length of the path.
+ * @param[in] name Predicate node name.
+ * @param[in] value Predicate value.
+ * @return New length of the path.
+ */
+static size_t
+sr_lyd_path_append_pred(char *buf, size_t len, const char *name, const char *value)
+{
+    const char *quot = strchr(value, '\'') ? "\"" : "'";
+
+    len = sr_lyd_path_append(buf, len, "[", 1);
+    len = sr_lyd_path_append(buf, len, name, strlen(name));
+    len = sr_lyd_path_append(buf, len, "=", 1);
+    len = sr_lyd_path_append(buf, len, quot, 1);
+    len = sr_lyd_path_append(buf, len, value, strlen(value));
+    len = sr_lyd_path_append(buf, len, quot, 1);
+    return sr_lyd_path_append(buf, len, "]", 1);
+}
+
+/**
+ * @brief Print the data path of a node in the same format as lyd_path() without any memory allocation.
+ * Paths with keyless lists are not supported.
+ *
+ * @param[in] node Node to print.
+ * @param[in] buf Buffer to print into, NULL to learn only the length.
+ * @return Length of the path (without the terminating zero).
+ */
+static size_t
+sr_lyd_path_print(const struct lyd_node *node, char *buf)
+{
+    const struct lys_node_list *slist;
+    const struct lyd_node *key;
+    const struct lys_module *mod;
+    size_t len = 0;
+    uint8_t i;
+
+    if (node->parent) {
+        len = sr_lyd_path_print(node->parent, buf);
+    }
+
+    len = sr_lyd_path_append(buf, len, "/", 1);
+    mod = lyd_node_module(node);
+    if (!node->parent || (lyd_node_module(node->parent) != mod)) {
+        len = sr_lyd_path_append(buf, len, mod->name, strlen(mod->name));
+        len = sr_lyd_path_append(buf, len, ":", 1);
+    }
+    len = sr_lyd_path_append(buf, len, node->schema->name, strlen(node->schema->name));
+
+    if (node->schema->nodetype == LYS_LIST) {
+        slist = (const struct lys_node_list *)node->schema;
+        for (i = 0; i < slist->keys_size; ++i) {
+            for (key = node->child; key && (key->schema != (struct lys_node *)slist->keys[i]); key = key->next);
+            if (key) {
+                len = sr_lyd_path_append_pred(buf, len, key->schema->name, sr_ly_leaf_value_str(key));
+            }
+        }
+    } else if (node->schema->nodetype == LYS_LEAFLIST) {
+        len = sr_lyd_path_append_pred(buf, len, ".", sr_ly_leaf_value_str(node));
+    }
+
+    return len;
+}
+
+/**
+ * @brief Get the path of a node, either allocated or in an arena.
+ *
+ * @param[in] arena Arena to use, NULL to allocate the path.
+ * @param[in] node Node to use.
+ * @param[out] path Path of the node.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_val_arena_path(struct sr_val_arena_s *arena, const struct lyd_node *node, char **path)
+{
+    sr_error_info_t *err_info = NULL;
+    const struct lyd_node *parent;
+    char *str;
+    size_t len;
+
+    if (arena) {
+        for (parent = node; parent; parent = parent->parent) {
+            if ((parent->schema->nodetype == LYS_LIST) && !((struct lys_node_list *)parent->schema)->keys_size) {
+                /* position predicates, use libyang */
+                break;
+            }
+        }
+
+        if (!parent) {
+            /* print the path directly into the arena */
+            *path = arena->buf ? arena->buf + arena->used : NULL;
+            len = sr_lyd_path_print(node, *path);
+            if (*path) {
+                (*path)[len] = '\0';
+            }
+            arena->used += len + 1;
+            return NULL;
+        }
+    }
+
+    str = lyd_path(node);
+    SR_CHECK_MEM_RET(!str, err_info);
+    if (arena) {
+        *path = sr_val_arena_strdup(arena, str);
+        free(str);
+    } else {
+        *path = str;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Print anyxml/anydata node value.
+ *
+ * @param[in] node anyxml/anydata node.
+ * @param[out] str Printed value, NULL if none.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_lyd_anydata_str(const struct lyd_node *node, char **str)
+{
+    sr_error_info_t *err_info = NULL;
     struct lyd_node_anydata *any;
     struct lyd_node *tree;
+
+    any = (struct lyd_node_anydata *)node;
+    *str = NULL;
+
+    switch (any->value_type) {
+    case LYD_ANYDATA_CONSTSTRING:
+    case LYD_ANYDATA_JSON:
+    case LYD_ANYDATA_SXML:
+        if (any->value.str) {
+            *str = strdup(any->value.str);
+            SR_CHECK_MEM_RET(!*str, err_info);
+        }
+        break;
+    case LYD_ANYDATA_XML:
+        lyxml_print_mem(str, any->value.xml, LYXML_PRINT_FORMAT);
+        break;
+    case LYD_ANYDATA_LYB:
+        /* try to convert into a data tree */
+        tree = lyd_parse_mem(node->schema->module->ctx, any->value.mem, LYD_LYB, LYD_OPT_DATA | LYD_OPT_STRICT, NULL);
+        if (!tree) {
+            sr_errinfo_new_ly(&err_info, node->schema->module->ctx);
+            sr_errinfo_new(&err_info, SR_ERR_INVAL_ARG, NULL, "Failed to convert LYB anyxml/anydata into XML.");
+            return err_info;
+        }
+        free(any->value.mem);
+        any->value_type = LYD_ANYDATA_DATATREE;
+        any->value.tree = tree;
+        /* fallthrough */
+    case LYD_ANYDATA_DATATREE:
+        lyd_print_mem(str, any->value.tree, LYD_XML, LYP_FORMAT | LYP_WITHSIBLINGS);
+        break;
+    default:
+        SR_ERRINFO_INT(&err_info);
+        return err_info;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Transform a libyang node into sysrepo value with all its strings either allocated or in an arena.
+ *
+ * @param[in] node libyang node to transform.
+ * @param[in] arena Arena to use, NULL to allocate the strings.
+ * @param[out] sr_val sysrepo value.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_val_ly2sr_arena(const struct lyd_node *node, struct sr_val_arena_s *arena, sr_val_t *sr_val)
+{
+    sr_error_info_t *err_info = NULL;
+    char *ptr, *str;
+    const struct lyd_node_leaf_list *leaf;
     const char *origin;
 
-    sr_val->xpath = lyd_path(node);
-    SR_CHECK_MEM_GOTO(!sr_val->xpath, err_info, error);
+    if ((err_info = sr_val_arena_path(arena, node, &sr_val->xpath))) {
+        return err_info;
+    }
 
     sr_val->dflt = node->dflt;
 
@@ -2792,12 +3454,12 @@ sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
         switch (leaf->value_type) {
         case LY_TYPE_BINARY:
             sr_val->type = SR_BINARY_T;
-            sr_val->data.binary_val = strdup(leaf->value_str);
+            sr_val->data.binary_val = sr_val_arena_strdup(arena, leaf->value_str);
             SR_CHECK_MEM_GOTO(!sr_val->data.binary_val, err_info, error);
             break;
         case LY_TYPE_BITS:
             sr_val->type = SR_BITS_T;
-            sr_val->data.bits_val = strdup(leaf->value_str);
+            sr_val->data.bits_val = sr_val_arena_strdup(arena, leaf->value_str);
             SR_CHECK_MEM_GOTO(!sr_val->data.bits_val, err_info, error);
             break;
         case LY_TYPE_BOOL:
@@ -2819,17 +3481,17 @@ sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
             break;
         case LY_TYPE_ENUM:
             sr_val->type = SR_ENUM_T;
-            sr_val->data.enum_val = strdup(leaf->value_str);
+            sr_val->data.enum_val = sr_val_arena_strdup(arena, leaf->value_str);
             SR_CHECK_MEM_GOTO(!sr_val->data.enum_val, err_info, error);
             break;
         case LY_TYPE_IDENT:
             sr_val->type = SR_IDENTITYREF_T;
-            sr_val->data.identityref_val = strdup(leaf->value_str);
+            sr_val->data.identityref_val = sr_val_arena_strdup(arena, leaf->value_str);
             SR_CHECK_MEM_GOTO(!sr_val->data.identityref_val, err_info, error);
             break;
         case LY_TYPE_INST:
             sr_val->type = SR_INSTANCEID_T;
-            sr_val->data.instanceid_val = strdup(leaf->value_str);
+            sr_val->data.instanceid_val = sr_val_arena_strdup(arena, leaf->value_str);
             SR_CHECK_MEM_GOTO(!sr_val->data.instanceid_val, err_info, error);
             break;
         case LY_TYPE_INT8:
@@ -2850,7 +3512,7 @@ sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
             break;
         case LY_TYPE_STRING:
             sr_val->type = SR_STRING_T;
-            sr_val->data.string_val = strdup(leaf->value_str);
+            sr_val->data.string_val = sr_val_arena_strdup(arena, leaf->value_str);
             SR_CHECK_MEM_GOTO(!sr_val->data.string_val, err_info, error);
             break;
         case LY_TYPE_UINT8:
@@ -2871,7 +3533,7 @@ sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
             break;
         default:
             SR_ERRINFO_INT(&err_info);
-            return err_info;
+            goto error;
         }
         break;
     case LYS_CONTAINER:
@@ -2889,39 +3551,14 @@ sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
         break;
     case LYS_ANYXML:
     case LYS_ANYDATA:
-        any = (struct lyd_node_anydata *)node;
-        ptr = NULL;
-
-        switch (any->value_type) {
-        case LYD_ANYDATA_CONSTSTRING:
-        case LYD_ANYDATA_JSON:
-        case LYD_ANYDATA_SXML:
-            if (any->value.str) {
-                ptr = strdup(any->value.str);
-                SR_CHECK_MEM_RET(!ptr, err_info);
-            }
-            break;
-        case LYD_ANYDATA_XML:
-            lyxml_print_mem(&ptr, any->value.xml, LYXML_PRINT_FORMAT);
-            break;
-        case LYD_ANYDATA_LYB:
-            /* try to convert into a data tree */
-            tree = lyd_parse_mem(node->schema->module->ctx, any->value.mem, LYD_LYB, LYD_OPT_DATA | LYD_OPT_STRICT, NULL);
-            if (!tree) {
-                sr_errinfo_new_ly(&err_info, node->schema->module->ctx);
-                sr_errinfo_new(&err_info, SR_ERR_INVAL_ARG, NULL, "Failed to convert LYB anyxml/anydata into XML.");
-                return err_info;
-            }
-            free(any->value.mem);
-            any->value_type = LYD_ANYDATA_DATATREE;
-            any->value.tree = tree;
-            /* fallthrough */
-        case LYD_ANYDATA_DATATREE:
-            lyd_print_mem(&ptr, any->value.tree, LYD_XML, LYP_FORMAT | LYP_WITHSIBLINGS);
-            break;
-        default:
-            SR_ERRINFO_INT(&err_info);
-            return err_info;
+        if ((err_info = sr_lyd_anydata_str(node, &ptr))) {
+            goto error;
+        }
+        if (arena && ptr) {
+            /* move it into the arena */
+            str = ptr;
+            ptr = sr_val_arena_strdup(arena, str);
+            free(str);
         }
 
         if (node->schema->nodetype == LYS_ANYXML) {
@@ -2934,22 +3571,69 @@ sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
         break;
     default:
         SR_ERRINFO_INT(&err_info);
-        return err_info;
+        goto error;
     }
 
     /* origin */
     sr_edit_diff_get_origin(node, &origin, NULL);
     if (origin) {
-        sr_val->origin = strdup(origin);
+        sr_val->origin = sr_val_arena_strdup(arena, origin);
     }
 
     return NULL;
 
 error:
-    free(sr_val->xpath);
+    if (!arena) {
+        free(sr_val->xpath);
+    }
     return err_info;
 }
 
+sr_error_info_t *
+sr_val_ly2sr(const struct lyd_node *node, sr_val_t *sr_val)
+{
+    return sr_val_ly2sr_arena(node, NULL, sr_val);
+}
+
+sr_error_info_t *
+sr_vals_ly2sr_arena(struct lyd_node **nodes, uint32_t count, sr_val_t **values)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_val_arena_s arena = {0};
+    sr_val_t val;
+    uint32_t i;
+
+    *values = NULL;
+    if (!count) {
+        return NULL;
+    }
+
+    /* learn the size of all the strings */
+    for (i = 0; i < count; ++i) {
+        memset(&val, 0, sizeof val);
+        if ((err_info = sr_val_ly2sr_arena(nodes[i], &arena, &val))) {
+            return err_info;
+        }
+    }
+
+    /* allocate the values followed by the arena */
+    *values = calloc(1, count * sizeof **values + arena.used);
+    SR_CHECK_MEM_RET(!*values, err_info);
+    arena.buf = (char *)(*values + count);
+    arena.used = 0;
+
+    /* fill the values */
+    for (i = 0; i < count; ++i) {
+        if ((err_info = sr_val_ly2sr_arena(nodes[i], &arena, (*values) + i))) {
+            free(*values);
+            *values = NULL;
+            return err_info;
+        }
+    }
+
+    return NULL;
+}
+
 char *
 sr_val_sr2ly_str(struct ly_ctx *ctx, const sr_val_t *sr_val, const char *xpath, char *buf, int output)
 {
@@ -3648,6 +4332,133 @@ sr_str_hash(const char *str)
     return hash;
 }
 
+sr_error_info_t *
+sr_xpath_cache_find(pthread_mutex_t *xp_lock, struct sr_xpath_cache_s *xp_cache, const char *xpath, int conventional,
+        const struct lys_module ***ly_mods, uint32_t *ly_mod_count, int *found)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_xpath_cache_entry_s *entry;
+    uint32_t i, hash;
+
+    *ly_mods = NULL;
+    *ly_mod_count = 0;
+    *found = 0;
+    hash = sr_str_hash(xpath);
+
+    /* XPATH CACHE LOCK */
+    if ((err_info = sr_mlock(xp_lock, -1, __func__))) {
+        return err_info;
+    }
+
+    for (i = 0; i < xp_cache->entry_count; ++i) {
+        entry = &xp_cache->entries[i];
+        if ((entry->hash != hash) || (entry->conventional != conventional) || strcmp(entry->xpath, xpath)) {
+            continue;
+        }
+
+        /* copy the modules, the entry can be replaced once unlocked */
+        if (entry->ly_mod_count) {
+            *ly_mods = malloc(entry->ly_mod_count * sizeof **ly_mods);
+            SR_CHECK_MEM_GOTO(!*ly_mods, err_info, cleanup_unlock);
+            memcpy(*ly_mods, entry->ly_mods, entry->ly_mod_count * sizeof **ly_mods);
+        }
+        *ly_mod_count = entry->ly_mod_count;
+        entry->last_use = ++xp_cache->use_counter;
+        *found = 1;
+        break;
+    }
+
+cleanup_unlock:
+    /* XPATH CACHE UNLOCK */
+    sr_munlock(xp_lock);
+
+    return err_info;
+}
+
+sr_error_info_t *
+sr_xpath_cache_add(pthread_mutex_t *xp_lock, struct sr_xpath_cache_s *xp_cache, const char *xpath, int conventional,
+        const struct lys_module **ly_mods, uint32_t ly_mod_count)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_xpath_cache_entry_s *entry;
+    char *xp;
+    void *mem;
+    uint32_t i;
+
+    xp = strdup(xpath);
+    if (!xp) {
+        free(ly_mods);
+        SR_ERRINFO_MEM(&err_info);
+        return err_info;
+    }
+
+    /* XPATH CACHE LOCK */
+    if ((err_info = sr_mlock(xp_lock, -1, __func__))) {
+        free(xp);
+        free(ly_mods);
+        return err_info;
+    }
+
+    for (i = 0; i < xp_cache->entry_count; ++i) {
+        if ((xp_cache->entries[i].conventional == conventional) && !strcmp(xp_cache->entries[i].xpath, xpath)) {
+            /* added by another thread meanwhile */
+            free(xp);
+            free(ly_mods);
+            goto cleanup_unlock;
+        }
+    }
+
+    if (xp_cache->entry_count < SR_XPATH_CACHE_SIZE) {
+        /* new entry */
+        mem = realloc(xp_cache->entries, (xp_cache->entry_count + 1) * sizeof *xp_cache->entries);
+        if (!mem) {
+            free(xp);
+            free(ly_mods);
+            SR_ERRINFO_MEM(&err_info);
+            goto cleanup_unlock;
+        }
+        xp_cache->entries = mem;
+        entry = &xp_cache->entries[xp_cache->entry_count];
+        ++xp_cache->entry_count;
+    } else {
+        /* replace the least recently used entry */
+        entry = &xp_cache->entries[0];
+        for (i = 1; i < xp_cache->entry_count; ++i) {
+            if (xp_cache->entries[i].last_use < entry->last_use) {
+                entry = &xp_cache->entries[i];
+            }
+        }
+        free(entry->xpath);
+        free(entry->ly_mods);
+    }
+
+    entry->xpath = xp;
+    entry->hash = sr_str_hash(xpath);
+    entry->conventional = conventional;
+    entry->ly_mods = ly_mods;
+    entry->ly_mod_count = ly_mod_count;
+    entry->last_use = ++xp_cache->use_counter;
+
+cleanup_unlock:
+    /* XPATH CACHE UNLOCK */
+    sr_munlock(xp_lock);
+
+    return err_info;
+}
+
+void
+sr_xpath_cache_free(struct sr_xpath_cache_s *xp_cache)
+{
+    uint32_t i;
+
+    for (i = 0; i < xp_cache->entry_count; ++i) {
+        free(xp_cache->entries[i].xpath);
+        free(xp_cache->entries[i].ly_mods);
+    }
+    free(xp_cache->entries);
+    memset(xp_cache, 0, sizeof *xp_cache);
+}
+
 sr_error_info_t *
 sr_xpath_trim_last_node(const char *xpath, char **trim_xpath)
 {
@@ -3902,43 +4713,1335 @@ sr_module_data_unlink(struct lyd_node **data, const struct lys_module *ly_mod)
 }
 
 sr_error_info_t *
-sr_module_file_data_append(const struct lys_module *ly_mod, sr_datastore_t ds, struct lyd_node **data)
+sr_module_data_print_lyb(struct lyd_node *diff, const struct lys_module *ly_mod, char **diff_lyb,
+        uint32_t *diff_lyb_len)
 {
     sr_error_info_t *err_info = NULL;
-    struct lyd_node *mod_data = NULL;
-    char *path = NULL;
-    int fd = -1, flags;
+    struct lyd_node *root, *mod_diff, **roots = NULL;
+    uint32_t i, count = 0;
+    int foreign = 0;
 
-retry_open:
-    /* prepare correct file path */
-    if (ds == SR_DS_STARTUP) {
-        err_info = sr_path_startup_file(ly_mod->name, &path);
-    } else {
-        err_info = sr_path_ds_shm(ly_mod->name, ds, 0, &path);
+    free(*diff_lyb);
+    *diff_lyb = NULL;
+
+    LY_TREE_FOR(diff, root) {
+        if (lyd_node_module(root) != ly_mod) {
+            foreign = 1;
+        }
+        ++count;
     }
-    if (err_info) {
-        goto error;
+
+    if (!foreign) {
+        /* the whole diff belongs to this module */
+        if (lyd_print_mem(diff_lyb, diff, LYD_LYB, LYP_WITHSIBLINGS)) {
+            sr_errinfo_new_ly(&err_info, ly_mod->ctx);
+            return err_info;
+        }
+        *diff_lyb_len = lyd_lyb_data_length(*diff_lyb);
+        return NULL;
     }
 
-    /* open fd */
-    if (ds == SR_DS_STARTUP) {
-        fd = open(path, O_RDONLY);
-    } else {
-        fd = shm_open(path, O_RDONLY, 0);
+    /* remember the order of all the top-level nodes */
+    roots = malloc(count * sizeof *roots);
+    SR_CHECK_MEM_RET(!roots, err_info);
+    i = 0;
+    LY_TREE_FOR(diff, root) {
+        roots[i++] = root;
     }
-    if (fd == -1) {
-        if ((errno == ENOENT) && (ds == SR_DS_CANDIDATE)) {
-            /* no candidate exists, just use running */
-            ds = SR_DS_RUNNING;
-            free(path);
-            path = NULL;
-            goto retry_open;
-        }
+
+    /* temporarily unlink the module diff and print it */
+    mod_diff = sr_module_data_unlink(&diff, ly_mod);
+    if (lyd_print_mem(diff_lyb, mod_diff, LYD_LYB, LYP_WITHSIBLINGS)) {
+        sr_errinfo_new_ly(&err_info, ly_mod->ctx);
+    } else {
+        *diff_lyb_len = lyd_lyb_data_length(*diff_lyb);
+    }
+
+    /* relink all the nodes back in their original order */
+    for (i = 0; i < count; ++i) {
+        roots[i]->next = NULL;
+        roots[i]->prev = roots[i];
+        if (i) {
+            sr_ly_link(roots[0], roots[i]);
+        }
+    }
+
+    free(roots);
+    return err_info;
+}
+
+/**
+ * @brief Running data journal header, followed by the records.
+ */
+struct sr_journal_hdr_s {
+    uint32_t base_ver;              /**< Module data version of the data file the records follow. */
+    ino_t data_ino;                 /**< Inode of the data file. */
+    off_t data_size;                /**< Size of the data file. */
+    struct timespec data_mtime;     /**< Modification time of the data file. */
+};
+
+/**
+ * @brief Running data journal record header, followed by the LYB diff.
+ */
+struct sr_journal_rec_s {
+    uint32_t ver;           /**< Module data version the diff results in. */
+    uint32_t diff_lyb_len;  /**< Length of the LYB diff. */
+};
+
+/**
+ * @brief Keep only the changes of a single list instance in a module diff.
+ *
+ * @param[in,out] diff Module diff, set to NULL if the instance was not changed.
+ * @param[in] inst_path Path of a top-level list instance or a list instance in a top-level container.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_diff_inst_restrict(struct lyd_node **diff, const char *inst_path)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *inst, *top, *next, *elem;
+    struct ly_set *set;
+
+    set = lyd_find_path(*diff, inst_path);
+    if (!set) {
+        sr_errinfo_new_ly(&err_info, lyd_node_module(*diff)->ctx);
+        return err_info;
+    }
+    inst = set->number ? set->set.d[0] : NULL;
+    ly_set_free(set);
+
+    if (!inst) {
+        /* instance not changed */
+        lyd_free_withsiblings(*diff);
+        *diff = NULL;
+        return NULL;
+    }
+
+    /* free all the other top-level nodes */
+    top = inst->parent ? inst->parent : inst;
+    next = (*diff == top) ? top->next : *diff;
+    lyd_unlink(top);
+    lyd_free_withsiblings(next);
+    *diff = top;
+
+    /* free all the other instances in the container */
+    if (inst != top) {
+        LY_TREE_FOR_SAFE(top->child, next, elem) {
+            if (elem != inst) {
+                lyd_free(elem);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Read the header of a running data journal and check that it was started for the current data file.
+ * If not, it is left from a compaction that was interrupted after the data file was replaced
+ * and its changes are already in the data file.
+ *
+ * @param[in] mod_name Module name.
+ * @param[in] fd Journal file descriptor.
+ * @param[in] size Journal size.
+ * @param[in] data_st Data file stat, NULL to learn it.
+ * @param[out] hdr Journal header.
+ * @param[out] valid Whether the journal belongs to the current data file or not.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_file_journal_hdr_read(const char *mod_name, int fd, size_t size, const struct stat *data_st,
+        struct sr_journal_hdr_s *hdr, int *valid)
+{
+    sr_error_info_t *err_info = NULL;
+    struct stat st;
+    char *path;
+
+    *valid = 0;
+
+    if (!data_st) {
+        if ((err_info = sr_path_ds_shm(mod_name, SR_DS_RUNNING, 1, &path))) {
+            return err_info;
+        }
+        if (stat(path, &st) == -1) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to stat \"%s\" (%s).", path, strerror(errno));
+            free(path);
+            return err_info;
+        }
+        free(path);
+        data_st = &st;
+    }
+
+    if ((size < sizeof *hdr) || (pread(fd, hdr, sizeof *hdr, 0) != sizeof *hdr)) {
+        /* header not (completely) written */
+        return NULL;
+    }
+
+    *valid = (hdr->data_ino == data_st->st_ino) && (hdr->data_size == data_st->st_size)
+            && (hdr->data_mtime.tv_sec == data_st->st_mtim.tv_sec) && (hdr->data_mtime.tv_nsec == data_st->st_mtim.tv_nsec);
+    return NULL;
+}
+
+sr_error_info_t *
+sr_module_file_journal_apply(const struct lys_module *ly_mod, uint32_t ver, uint32_t cur_ver, uint32_t *journal_base,
+        size_t *journal_off, const char *inst_path, struct lyd_node **mod_data, int *applied)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *diff = NULL;
+    struct sr_journal_hdr_s hdr;
+    struct sr_journal_rec_s rec;
+    char *path = NULL, *addr = MAP_FAILED;
+    size_t size = 0, off, end;
+    uint32_t exp_ver;
+    int fd = -1, valid;
+
+    *applied = 0;
+
+    if ((err_info = sr_path_ds_journal(ly_mod->name, 0, &path))) {
+        goto cleanup;
+    }
+
+    /* open the journal, if any */
+    fd = shm_open(path, O_RDONLY, 0);
+    if (fd > -1) {
+        if ((err_info = sr_file_get_size(fd, &size))) {
+            goto cleanup;
+        }
+        if ((err_info = sr_module_file_journal_hdr_read(ly_mod->name, fd, size, NULL, &hdr, &valid))) {
+            goto cleanup;
+        }
+        if (!valid) {
+            /* its changes are already in the data file */
+            size = 0;
+        }
+    } else if (errno != ENOENT) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+        goto cleanup;
+    }
+    if (!size) {
+        if (!ver || (ver == cur_ver)) {
+            /* no changes to apply */
+            *journal_base = 0;
+            *journal_off = 0;
+            *applied = 1;
+        }
+        goto cleanup;
+    }
+
+    if (!ver || (hdr.base_ver != *journal_base)) {
+        if (ver && (hdr.base_ver != ver)) {
+            /* the journal was compacted since and does not follow the previous data */
+            goto cleanup;
+        }
+
+        /* apply the whole journal */
+        *journal_base = hdr.base_ver;
+        *journal_off = sizeof hdr;
+    } else if ((*journal_off < sizeof hdr) || (*journal_off > size)) {
+        /* the previous part is not in this journal */
+        goto cleanup;
+    }
+    if (*journal_off == size) {
+        /* no new records */
+        *applied = (!ver || (ver == cur_ver));
+        goto cleanup;
+    }
+
+    /* map it */
+    addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        sr_errinfo_new(&err_info, SR_ERR_NOMEM, NULL, "Failed to map \"%s\" (%s).", path, strerror(errno));
+        goto cleanup;
+    }
+
+    /* find the end of complete records and check that they follow the previous version */
+    off = *journal_off;
+    exp_ver = ver;
+    while (off + sizeof rec <= size) {
+        memcpy(&rec, addr + off, sizeof rec);
+        if (rec.diff_lyb_len > size - off - sizeof rec) {
+            SR_LOG_WRN("Journal \"%s\" ends with an incomplete record, ignoring it.", path);
+            break;
+        }
+        if (ver && (rec.ver != exp_ver + 1)) {
+            /* the journal was compacted since or the record was not written */
+            goto cleanup;
+        }
+        exp_ver = rec.ver;
+        off += sizeof rec + rec.diff_lyb_len;
+    }
+    if (ver && (exp_ver != cur_ver)) {
+        /* some changes are missing in the journal */
+        goto cleanup;
+    }
+    end = off;
+
+    /* apply the stored diffs in the order they were written */
+    off = *journal_off;
+    while (off < end) {
+        memcpy(&rec, addr + off, sizeof rec);
+        off += sizeof rec;
+
+        ly_errno = 0;
+        diff = lyd_parse_mem(ly_mod->ctx, addr + off, LYD_LYB, LYD_OPT_EDIT | LYD_OPT_STRICT);
+        if (ly_errno) {
+            sr_errinfo_new_ly(&err_info, ly_mod->ctx);
+            goto cleanup;
+        }
+        if (inst_path && diff && (err_info = sr_module_diff_inst_restrict(&diff, inst_path))) {
+            goto cleanup;
+        }
+        if ((err_info = sr_diff_mod_apply(diff, ly_mod, 0, mod_data))) {
+            goto cleanup;
+        }
+        lyd_free_withsiblings(diff);
+        diff = NULL;
+
+        off += rec.diff_lyb_len;
+    }
+    *journal_off = end;
+    *applied = 1;
+
+cleanup:
+    if (addr != MAP_FAILED) {
+        munmap(addr, size);
+    }
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+    lyd_free_withsiblings(diff);
+    return err_info;
+}
+
+/**
+ * @brief Find the end of the last complete record of a running data journal.
+ *
+ * @param[in] path Journal path.
+ * @param[in] fd Journal file descriptor.
+ * @param[in] size Journal size.
+ * @param[out] end Offset right after the last complete record.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_file_journal_end(const char *path, int fd, size_t size, size_t *end)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_journal_rec_s rec;
+    char *addr;
+    size_t off;
+
+    /* map it */
+    addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        sr_errinfo_new(&err_info, SR_ERR_NOMEM, NULL, "Failed to map \"%s\" (%s).", path, strerror(errno));
+        return err_info;
+    }
+
+    /* skip all the complete records */
+    off = sizeof(struct sr_journal_hdr_s);
+    while (off + sizeof rec <= size) {
+        memcpy(&rec, addr + off, sizeof rec);
+        if (rec.diff_lyb_len > size - off - sizeof rec) {
+            break;
+        }
+        off += sizeof rec + rec.diff_lyb_len;
+    }
+
+    munmap(addr, size);
+    *end = off;
+    return NULL;
+}
+
+sr_error_info_t *
+sr_module_file_journal_append(const struct lys_module *ly_mod, struct lyd_node *diff, uint32_t ver, int *compact)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *root;
+    struct sr_journal_hdr_s hdr;
+    struct sr_journal_rec_s rec_hdr;
+    char *path = NULL, *diff_lyb = NULL, *rec = NULL, *out_ptr;
+    size_t rec_len, journal_size, journal_end;
+    ssize_t nwritten;
+    struct stat st;
+    int fd = -1, ret, valid;
+    mode_t um;
+
+    *compact = 0;
+
+    LY_TREE_FOR(diff, root) {
+        if (lyd_node_module(root) == ly_mod) {
+            break;
+        }
+    }
+    if (!root) {
+        /* no changes of this module */
+        goto cleanup;
+    }
+
+    /* print the module diff into a journal record */
+    if ((err_info = sr_module_data_print_lyb(diff, ly_mod, &diff_lyb, &rec_hdr.diff_lyb_len))) {
+        goto cleanup;
+    }
+    rec_hdr.ver = ver;
+
+    /* learn the data file size and permissions, the journal must share them */
+    if ((err_info = sr_path_ds_shm(ly_mod->name, SR_DS_RUNNING, 1, &path))) {
+        goto cleanup;
+    }
+    ret = stat(path, &st);
+    free(path);
+    path = NULL;
+    if (ret == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "stat");
+        goto cleanup;
+    }
+
+    /* open the journal, it may need to be created */
+    if ((err_info = sr_path_ds_journal(ly_mod->name, 0, &path))) {
+        goto cleanup;
+    }
+    um = umask(00000);
+    fd = shm_open(path, O_RDWR | O_APPEND | O_CREAT, st.st_mode & 00777);
+    umask(um);
+    if (fd == -1) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+        goto cleanup;
+    }
+    if ((err_info = sr_file_get_size(fd, &journal_size))) {
+        goto cleanup;
+    }
+    if (journal_size) {
+        if ((err_info = sr_module_file_journal_hdr_read(ly_mod->name, fd, journal_size, &st, &hdr, &valid))) {
+            goto cleanup;
+        }
+        if (!valid) {
+            /* left from an interrupted compaction, its changes are already in the data file */
+            journal_end = 0;
+        } else if ((err_info = sr_module_file_journal_end(path, fd, journal_size, &journal_end))) {
+            goto cleanup;
+        } else if (journal_end < journal_size) {
+            /* a writer was terminated while appending its record, which must not be followed by a new one */
+            SR_LOG_WRN("Journal \"%s\" ends with an incomplete record, truncating it.", path);
+        }
+        if (journal_end < journal_size) {
+            if (ftruncate(fd, journal_end) == -1) {
+                SR_ERRINFO_SYSERRNO(&err_info, "ftruncate");
+                goto cleanup;
+            }
+            journal_size = journal_end;
+        }
+    }
+    if (!journal_size && ((st.st_uid != geteuid()) || (st.st_gid != getegid()))
+            && (fchown(fd, st.st_uid, st.st_gid) == -1)) {
+        /* the journal would not be accessible the same way as the data file, store the full data instead */
+        SR_LOG_WRN("Failed to change owner of \"%s\" (%s).", path, strerror(errno));
+        if (shm_unlink(path) == -1) {
+            SR_LOG_WRN("Failed to unlink \"%s\" (%s).", path, strerror(errno));
+        }
+        *compact = 1;
+        goto cleanup;
+    }
+
+    /* prepare the record, a new journal starts with the header identifying the data file */
+    rec_len = sizeof rec_hdr + rec_hdr.diff_lyb_len;
+    if (!journal_size) {
+        rec_len += sizeof hdr;
+    }
+    rec = malloc(rec_len);
+    SR_CHECK_MEM_GOTO(!rec, err_info, cleanup);
+    out_ptr = rec;
+    if (!journal_size) {
+        memset(&hdr, 0, sizeof hdr);
+        hdr.base_ver = ver - 1;
+        hdr.data_ino = st.st_ino;
+        hdr.data_size = st.st_size;
+        hdr.data_mtime = st.st_mtim;
+        memcpy(out_ptr, &hdr, sizeof hdr);
+        out_ptr += sizeof hdr;
+    }
+    memcpy(out_ptr, &rec_hdr, sizeof rec_hdr);
+    memcpy(out_ptr + sizeof rec_hdr, diff_lyb, rec_hdr.diff_lyb_len);
+
+    /* append the record */
+    out_ptr = rec;
+    do {
+        nwritten = write(fd, out_ptr, rec_len);
+        if (nwritten >= 0) {
+            rec_len -= nwritten;
+            out_ptr += nwritten;
+            journal_size += nwritten;
+        } else if (errno != EINTR) {
+            SR_ERRINFO_SYSERRNO(&err_info, "write");
+            goto cleanup;
+        }
+    } while (rec_len);
+
+    /* replaying the journal should not take longer than loading the data file */
+    if ((journal_size > SR_JOURNAL_COMPACT_MIN_SIZE) && (journal_size > (size_t)st.st_size)) {
+        *compact = 1;
+    }
+
+cleanup:
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+    free(diff_lyb);
+    free(rec);
+    return err_info;
+}
+
+sr_error_info_t *
+sr_module_file_journal_size(const char *mod_name, uint32_t *base_ver, size_t *size)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_journal_hdr_s hdr;
+    char *path;
+    int fd, valid;
+
+    *base_ver = 0;
+    *size = 0;
+
+    if ((err_info = sr_path_ds_journal(mod_name, 0, &path))) {
+        return err_info;
+    }
+    fd = shm_open(path, O_RDONLY, 0);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+        }
+        free(path);
+        return err_info;
+    }
+    free(path);
+
+    if ((err_info = sr_file_get_size(fd, size))) {
+        goto cleanup;
+    }
+    if ((err_info = sr_module_file_journal_hdr_read(mod_name, fd, *size, NULL, &hdr, &valid))) {
+        goto cleanup;
+    }
+    if (valid) {
+        *base_ver = hdr.base_ver;
+    } else {
+        /* its changes are already in the data file */
+        *size = 0;
+    }
+
+cleanup:
+    close(fd);
+    return err_info;
+}
+
+sr_error_info_t *
+sr_module_file_journal_remove(const char *mod_name)
+{
+    sr_error_info_t *err_info = NULL;
+    char *path;
+
+    if ((err_info = sr_path_ds_journal(mod_name, 0, &path))) {
+        return err_info;
+    }
+    if ((shm_unlink(path) == -1) && (errno != ENOENT)) {
+        SR_LOG_WRN("Failed to unlink \"%s\" (%s).", path, strerror(errno));
+    }
+    free(path);
+
+    return NULL;
+}
+
+/**
+ * @brief Running data index header, followed by the records sorted by their instance paths and the paths.
+ */
+struct sr_index_hdr_s {
+    off_t data_size;                /**< Size of the indexed data file, 0 if the index is not yet complete. */
+    struct timespec data_mtime;     /**< Modification time of the indexed data file. */
+    uint32_t rec_count;             /**< Number of records. */
+};
+
+/**
+ * @brief Running data index record.
+ */
+struct sr_index_rec_s {
+    uint32_t path_off;      /**< Offset of the instance path in the index. */
+    uint32_t path_len;      /**< Length of the instance path without the terminating zero. */
+    off_t data_off;         /**< Offset of the LYB data of the instance with its parent in the data file. */
+    uint32_t data_len;      /**< Length of the LYB data of the instance with its parent. */
+};
+
+/**
+ * @brief Running data list instance stored separately in the data file.
+ */
+struct sr_index_inst_s {
+    struct lyd_node *inst;      /**< List instance. */
+    struct lyd_node *parent;    /**< Parent of the instance, if any. */
+    struct lyd_node *prev;      /**< Previous sibling of the instance, NULL if it is the first one. */
+    char *path;                 /**< Instance path. */
+    off_t data_off;             /**< Offset of the instance LYB data in the data file. */
+    uint32_t data_len;          /**< Length of the instance LYB data. */
+};
+
+/**
+ * @brief Check whether a running data index was created for the current data file.
+ *
+ * @param[in] hdr Index header.
+ * @param[in] st Data file stat.
+ * @return Whether the index is valid or not.
+ */
+static int
+sr_module_file_index_valid(const struct sr_index_hdr_s *hdr, const struct stat *st)
+{
+    return (hdr->data_size == st->st_size) && (hdr->data_mtime.tv_sec == st->st_mtim.tv_sec)
+            && (hdr->data_mtime.tv_nsec == st->st_mtim.tv_nsec);
+}
+
+/**
+ * @brief Check whether a data node is a list instance that is stored separately in the running data file.
+ * These are all top-level list instances and list instances in top-level containers that are not user-ordered
+ * because their changes may depend on other instances.
+ *
+ * @param[in] node Data node.
+ * @return Whether the node is stored separately or not.
+ */
+static int
+sr_module_file_index_inst(const struct lyd_node *node)
+{
+    if (node->schema->nodetype != LYS_LIST) {
+        return 0;
+    }
+    if (node->parent && (node->parent->parent || (node->parent->schema->nodetype != LYS_CONTAINER))) {
+        return 0;
+    }
+    return !sr_ly_is_userord(node);
+}
+
+/**
+ * @brief Collect all the list instances of running data to be stored separately, if there are enough of them.
+ *
+ * @param[in] mod_data Running data of a module.
+ * @param[out] insts Collected instances in the data order, NULL if they should not be stored separately.
+ * @param[out] inst_count Count of @p insts.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_file_index_inst_collect(struct lyd_node *mod_data, struct sr_index_inst_s **insts, uint32_t *inst_count)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *root, *node;
+    uint32_t count = 0, i = 0;
+
+    *insts = NULL;
+    *inst_count = 0;
+
+    /* count them first */
+    LY_TREE_FOR(mod_data, root) {
+        if (sr_module_file_index_inst(root)) {
+            ++count;
+        } else if (root->schema->nodetype == LYS_CONTAINER) {
+            LY_TREE_FOR(root->child, node) {
+                if (sr_module_file_index_inst(node)) {
+                    ++count;
+                }
+            }
+        }
+    }
+    if (count < SR_INDEX_MIN_INST) {
+        /* not worth it, the data will always be loaded whole */
+        return NULL;
+    }
+
+    *insts = calloc(count, sizeof **insts);
+    SR_CHECK_MEM_RET(!*insts, err_info);
+    *inst_count = count;
+
+    LY_TREE_FOR(mod_data, root) {
+        if (sr_module_file_index_inst(root)) {
+            (*insts)[i++].inst = root;
+        } else if (root->schema->nodetype == LYS_CONTAINER) {
+            LY_TREE_FOR(root->child, node) {
+                if (sr_module_file_index_inst(node)) {
+                    (*insts)[i++].inst = node;
+                }
+            }
+        }
+    }
+    assert(i == count);
+
+    return NULL;
+}
+
+/**
+ * @brief Compare index instances by their paths.
+ */
+static int
+sr_module_file_index_inst_cmp(const void *ptr1, const void *ptr2)
+{
+    const struct sr_index_inst_s *inst1 = ptr1, *inst2 = ptr2;
+
+    return strcmp(inst1->path, inst2->path);
+}
+
+/**
+ * @brief Free running data list instances stored separately.
+ *
+ * @param[in] insts Instances to free.
+ * @param[in] inst_count Count of @p insts.
+ */
+static void
+sr_module_file_index_inst_free(struct sr_index_inst_s *insts, uint32_t inst_count)
+{
+    uint32_t i;
+
+    for (i = 0; i < inst_count; ++i) {
+        free(insts[i].path);
+    }
+    free(insts);
+}
+
+/**
+ * @brief Print running data of a module into the data file. If there are enough list instances, the data
+ * without them are printed first followed by each instance with its parent as a separate LYB data so that
+ * they can be loaded one by one using the index.
+ *
+ * @param[in] fd File descriptor of the data file positioned at its beginning.
+ * @param[in] mod_data Running data of the module, they are restored after being printed.
+ * @param[out] insts Separately printed instances with their paths and data offsets, NULL if none.
+ * @param[out] inst_count Count of @p insts.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_file_running_print(int fd, struct lyd_node *mod_data, struct sr_index_inst_s **insts, uint32_t *inst_count)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *first = NULL, *wrapper = NULL, *root;
+    struct sr_index_inst_s *inst;
+    uint32_t i, unlinked = 0;
+    off_t off = 0, end;
+    int r;
+
+    if ((err_info = sr_module_file_index_inst_collect(mod_data, insts, inst_count))) {
+        return err_info;
+    }
+    if (!*insts) {
+        /* print all the data */
+        if (lyd_print_fd(fd, mod_data, LYD_LYB, LYP_WITHSIBLINGS)) {
+            sr_errinfo_new_ly(&err_info, lyd_node_module(mod_data)->ctx);
+        }
+        return err_info;
+    }
+
+    /* the first top-level node that remains */
+    LY_TREE_FOR(mod_data, root) {
+        if (!sr_module_file_index_inst(root)) {
+            first = root;
+            break;
+        }
+    }
+
+    /* remember where the instances belong and unlink them */
+    for (i = 0; i < *inst_count; ++i) {
+        inst = &(*insts)[i];
+        inst->parent = inst->inst->parent;
+        inst->prev = inst->inst->prev->next ? inst->inst->prev : NULL;
+        inst->path = lyd_path(inst->inst);
+        SR_CHECK_MEM_GOTO(!inst->path, err_info, cleanup);
+    }
+    for (unlinked = 0; unlinked < *inst_count; ++unlinked) {
+        lyd_unlink((*insts)[unlinked].inst);
+    }
+
+    /* print the remaining data */
+    if (lyd_print_fd(fd, first, LYD_LYB, LYP_WITHSIBLINGS)) {
+        sr_errinfo_new_ly(&err_info, lyd_node_module(mod_data)->ctx);
+        goto cleanup;
+    }
+    if ((off = lseek(fd, 0, SEEK_CUR)) == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "lseek");
+        goto cleanup;
+    }
+
+    /* print each instance with its parent */
+    for (i = 0; i < *inst_count; ++i) {
+        inst = &(*insts)[i];
+        if (inst->parent) {
+            wrapper = lyd_dup(inst->parent, 0);
+            if (!wrapper || lyd_insert(wrapper, inst->inst)) {
+                sr_errinfo_new_ly(&err_info, lyd_node_module(mod_data)->ctx);
+                goto cleanup;
+            }
+        }
+        r = lyd_print_fd(fd, wrapper ? wrapper : inst->inst, LYD_LYB, 0);
+        if (wrapper) {
+            lyd_unlink(inst->inst);
+            lyd_free(wrapper);
+            wrapper = NULL;
+        }
+        if (r) {
+            sr_errinfo_new_ly(&err_info, lyd_node_module(mod_data)->ctx);
+            goto cleanup;
+        }
+        if ((end = lseek(fd, 0, SEEK_CUR)) == -1) {
+            SR_ERRINFO_SYSERRNO(&err_info, "lseek");
+            goto cleanup;
+        }
+        inst->data_off = off;
+        inst->data_len = end - off;
+        off = end;
+    }
+
+cleanup:
+    lyd_free(wrapper);
+
+    /* put the instances back in the original order */
+    for (i = 0; i < unlinked; ++i) {
+        inst = &(*insts)[i];
+        if (inst->prev) {
+            r = lyd_insert_after(inst->prev, inst->inst);
+        } else if (inst->parent) {
+            r = inst->parent->child ? lyd_insert_before(inst->parent->child, inst->inst) : lyd_insert(inst->parent, inst->inst);
+        } else {
+            r = first ? lyd_insert_before(first, inst->inst) : 0;
+            first = inst->inst;
+        }
+        if (r) {
+            sr_errinfo_new_ly(&err_info, lyd_node_module(mod_data)->ctx);
+        }
+    }
+
+    if (err_info) {
+        sr_module_file_index_inst_free(*insts, *inst_count);
+        *insts = NULL;
+        *inst_count = 0;
+    }
+    return err_info;
+}
+
+/**
+ * @brief Create running data index of a specific module unless it exists for the current data file.
+ * It maps the paths of the list instances stored separately in the data file to their LYB data
+ * so that ::sr_module_file_data_append_inst() can load them one by one.
+ *
+ * @param[in] mod_name Module name.
+ * @param[in] data_fd File descriptor of the running data file.
+ * @param[in] insts Instances stored separately in the data file, they are sorted.
+ * @param[in] inst_count Count of @p insts.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_file_index_update(const char *mod_name, int data_fd, struct sr_index_inst_s *insts, uint32_t inst_count)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_index_hdr_s hdr;
+    struct sr_index_rec_s *rec;
+    char *path = NULL, *idx = NULL, *out_ptr;
+    size_t idx_size, path_off, out_len;
+    ssize_t nwritten;
+    struct stat st;
+    uint32_t i;
+    int fd = -1;
+    mode_t um;
+
+    if (fstat(data_fd, &st) == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "fstat");
+        goto cleanup;
+    }
+    if ((err_info = sr_path_ds_index(mod_name, 0, &path))) {
+        goto cleanup;
+    }
+
+    /* check the current index */
+    fd = shm_open(path, O_RDONLY, 0);
+    if (fd > -1) {
+        if ((read(fd, &hdr, sizeof hdr) == sizeof hdr) && sr_module_file_index_valid(&hdr, &st)) {
+            /* up-to-date */
+            goto cleanup;
+        }
+        close(fd);
+        fd = -1;
+
+        /* created for previous data or still being created, replace it */
+        if ((shm_unlink(path) == -1) && (errno != ENOENT)) {
+            SR_LOG_WRN("Failed to unlink \"%s\" (%s).", path, strerror(errno));
+            goto cleanup;
+        }
+    } else if (errno != ENOENT) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+        goto cleanup;
+    }
+
+    /* sorted records followed by the paths */
+    qsort(insts, inst_count, sizeof *insts, sr_module_file_index_inst_cmp);
+    idx_size = sizeof hdr + inst_count * sizeof *rec;
+    for (i = 0; i < inst_count; ++i) {
+        idx_size += strlen(insts[i].path) + 1;
+    }
+    if (idx_size > UINT32_MAX) {
+        /* paths could not be referenced */
+        goto cleanup;
+    }
+    idx = malloc(idx_size);
+    SR_CHECK_MEM_GOTO(!idx, err_info, cleanup);
+    memset(&hdr, 0, sizeof hdr);
+    hdr.rec_count = inst_count;
+    memcpy(idx, &hdr, sizeof hdr);
+    rec = (struct sr_index_rec_s *)(idx + sizeof hdr);
+    path_off = sizeof hdr + inst_count * sizeof *rec;
+    for (i = 0; i < inst_count; ++i) {
+        rec[i].path_off = path_off;
+        rec[i].path_len = strlen(insts[i].path);
+        rec[i].data_off = insts[i].data_off;
+        rec[i].data_len = insts[i].data_len;
+        memcpy(idx + path_off, insts[i].path, rec[i].path_len + 1);
+        path_off += rec[i].path_len + 1;
+    }
+
+    /* create the index, it must share the permissions of the data file */
+    um = umask(00000);
+    fd = shm_open(path, O_WRONLY | O_CREAT | O_EXCL, st.st_mode & 00777);
+    umask(um);
+    if (fd == -1) {
+        if (errno != EEXIST) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+        }
+        /* else being created by someone else */
+        goto cleanup;
+    }
+    if (((st.st_uid != geteuid()) || (st.st_gid != getegid())) && (fchown(fd, st.st_uid, st.st_gid) == -1)) {
+        /* the index would not be accessible the same way as the data file, do without it */
+        SR_LOG_WRN("Failed to change owner of \"%s\" (%s).", path, strerror(errno));
+        goto cleanup_unlink;
+    }
+
+    /* write the records */
+    out_ptr = idx;
+    out_len = idx_size;
+    do {
+        nwritten = write(fd, out_ptr, out_len);
+        if (nwritten >= 0) {
+            out_len -= nwritten;
+            out_ptr += nwritten;
+        } else if (errno != EINTR) {
+            SR_ERRINFO_SYSERRNO(&err_info, "write");
+            goto cleanup_unlink;
+        }
+    } while (out_len);
+
+    /* the index is complete only once it has the header */
+    hdr.data_size = st.st_size;
+    hdr.data_mtime = st.st_mtim;
+    if (pwrite(fd, &hdr, sizeof hdr, 0) != sizeof hdr) {
+        SR_ERRINFO_SYSERRNO(&err_info, "pwrite");
+        goto cleanup_unlink;
+    }
+    goto cleanup;
+
+cleanup_unlink:
+    if (shm_unlink(path) == -1) {
+        SR_LOG_WRN("Failed to unlink \"%s\" (%s).", path, strerror(errno));
+    }
+
+cleanup:
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+    free(idx);
+    return err_info;
+}
+
+sr_error_info_t *
+sr_module_file_index_create(const struct lys_module *ly_mod)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *mod_data = NULL;
+    struct sr_index_inst_s *insts;
+    uint32_t inst_count;
+    char *path;
+    struct stat st;
+    int ret;
+
+    if ((err_info = sr_path_ds_shm(ly_mod->name, SR_DS_RUNNING, 1, &path))) {
+        return err_info;
+    }
+    ret = stat(path, &st);
+    free(path);
+    if (ret == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "stat");
+        return err_info;
+    }
+    if (st.st_size < SR_INDEX_MIN_INST) {
+        /* cannot hold enough list instances */
+        return NULL;
+    }
+
+    /* load the data */
+    if ((err_info = sr_module_file_data_append(ly_mod, SR_DS_RUNNING, &mod_data))) {
+        return err_info;
+    }
+
+    /* rewrite them with the instances stored separately, if there are enough of them */
+    if ((err_info = sr_module_file_index_inst_collect(mod_data, &insts, &inst_count))) {
+        goto cleanup;
+    }
+    if (insts) {
+        sr_module_file_index_inst_free(insts, inst_count);
+        err_info = sr_module_file_data_set(ly_mod->name, SR_DS_RUNNING, mod_data, 0, 0);
+    }
+
+cleanup:
+    lyd_free_withsiblings(mod_data);
+    return err_info;
+}
+
+sr_error_info_t *
+sr_module_file_index_remove(const char *mod_name)
+{
+    sr_error_info_t *err_info = NULL;
+    char *path;
+
+    if ((err_info = sr_path_ds_index(mod_name, 0, &path))) {
+        return err_info;
+    }
+    if ((shm_unlink(path) == -1) && (errno != ENOENT)) {
+        SR_LOG_WRN("Failed to unlink \"%s\" (%s).", path, strerror(errno));
+    }
+    free(path);
+
+    return NULL;
+}
+
+/**
+ * @brief Check whether an XPath selects only a list instance or its descendants.
+ *
+ * @param[in] xpath XPath to check.
+ * @param[in] inst_path Path of the list instance.
+ * @param[in] inst_path_len Length of @p inst_path.
+ * @return Whether the XPath matches or not.
+ */
+static int
+sr_xpath_inst_match(const char *xpath, const char *inst_path, size_t inst_path_len)
+{
+    const char *ptr;
+
+    if (strncmp(xpath, inst_path, inst_path_len)) {
+        return 0;
+    }
+
+    ptr = xpath + inst_path_len;
+    if (*ptr && (*ptr != '/')) {
+        return 0;
+    }
+
+    /* only simple descendant node names can follow */
+    for (; *ptr; ++ptr) {
+        if ((ptr[0] == '/') && ((ptr[1] == '/') || (ptr[1] == '.') || (ptr[1] == '\0'))) {
+            return 0;
+        }
+        if (!isalnum(*ptr) && !strchr("/:_-.", *ptr)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Find the index record of the list instance an XPath selects.
+ *
+ * @param[in] idx Mapped index.
+ * @param[in] idx_size Size of @p idx.
+ * @param[in] xpath XPath selecting the list instance or its descendants.
+ * @param[out] rec Found record, NULL if there is none.
+ * @return Whether the index is valid or not.
+ */
+static int
+sr_module_file_index_find(const char *idx, size_t idx_size, const char *xpath, const struct sr_index_rec_s **rec)
+{
+    const struct sr_index_hdr_s *hdr = (const struct sr_index_hdr_s *)idx;
+    const struct sr_index_rec_s *recs = (const struct sr_index_rec_s *)(idx + sizeof *hdr);
+    const char *ptr, *path;
+    size_t len;
+    uint32_t lo, hi, mid;
+    int cmp;
+
+    *rec = NULL;
+
+    if (hdr->rec_count > (idx_size - sizeof *hdr) / sizeof *recs) {
+        return 0;
+    }
+
+    /* the instance path can end only after a predicate */
+    for (ptr = strchr(xpath, ']'); ptr; ptr = strchr(ptr + 1, ']')) {
+        if ((ptr[1] != '/') && (ptr[1] != '\0')) {
+            continue;
+        }
+        len = (ptr + 1) - xpath;
+
+        /* binary search of the prefix */
+        lo = 0;
+        hi = hdr->rec_count;
+        while (lo < hi) {
+            mid = lo + (hi - lo) / 2;
+            if ((recs[mid].path_off > idx_size) || (recs[mid].path_len >= idx_size - recs[mid].path_off)) {
+                return 0;
+            }
+            path = idx + recs[mid].path_off;
+
+            cmp = strncmp(xpath, path, len);
+            if (!cmp && (recs[mid].path_len > len)) {
+                /* shorter */
+                cmp = -1;
+            }
+            if (!cmp) {
+                if (sr_xpath_inst_match(xpath, path, len)) {
+                    *rec = &recs[mid];
+                }
+                return 1;
+            }
+
+            if (cmp < 0) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+    }
+
+    return 1;
+}
+
+sr_error_info_t *
+sr_module_file_data_append_inst(const struct lys_module *ly_mod, const char *xpath, struct lyd_node **data, int *loaded)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *mod_data = NULL;
+    const struct sr_index_rec_s *rec;
+    struct sr_index_hdr_s hdr;
+    char *path = NULL, *addr = MAP_FAILED, *inst_path = NULL, *lyb = NULL;
+    size_t len, size = 0, journal_off;
+    uint32_t journal_base;
+    struct stat st;
+    int fd = -1, data_fd = -1, applied;
+
+    *loaded = 0;
+
+    /* the XPath must select data of this module */
+    len = strlen(ly_mod->name);
+    if ((xpath[0] != '/') || strncmp(xpath + 1, ly_mod->name, len) || (xpath[len + 1] != ':')) {
+        goto cleanup;
+    }
+
+    /* learn the data file stat */
+    if ((err_info = sr_path_ds_shm(ly_mod->name, SR_DS_RUNNING, 0, &path))) {
+        goto cleanup;
+    }
+    data_fd = shm_open(path, O_RDONLY, 0);
+    if (data_fd == -1) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+        goto cleanup;
+    }
+    if (fstat(data_fd, &st) == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "fstat");
+        goto cleanup;
+    }
+    free(path);
+    path = NULL;
+
+    /* open the index, if any */
+    if ((err_info = sr_path_ds_index(ly_mod->name, 0, &path))) {
+        goto cleanup;
+    }
+    fd = shm_open(path, O_RDONLY, 0);
+    if (fd == -1) {
+        if (errno != ENOENT) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+        }
+        goto cleanup;
+    }
+    if ((err_info = sr_file_get_size(fd, &size))) {
+        goto cleanup;
+    }
+    if (size < sizeof hdr) {
+        goto cleanup;
+    }
+    addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        sr_errinfo_new(&err_info, SR_ERR_NOMEM, NULL, "Failed to map \"%s\" (%s).", path, strerror(errno));
+        goto cleanup;
+    }
+    memcpy(&hdr, addr, sizeof hdr);
+    if (!sr_module_file_index_valid(&hdr, &st)) {
+        /* not for the current data */
+        goto cleanup;
+    }
+
+    /* find the instance */
+    if (!sr_module_file_index_find(addr, size, xpath, &rec)) {
+        SR_LOG_WRN("Index \"%s\" is corrupted, ignoring it.", path);
+        goto cleanup;
+    }
+    if (!rec) {
+        /* not an existing indexed instance */
+        goto cleanup;
+    }
+    if ((rec->data_off < 0) || (rec->data_off > st.st_size) || (rec->data_len > st.st_size - rec->data_off)) {
+        SR_LOG_WRN("Index \"%s\" is corrupted, ignoring it.", path);
+        goto cleanup;
+    }
+    inst_path = strndup(addr + rec->path_off, rec->path_len);
+    SR_CHECK_MEM_GOTO(!inst_path, err_info, cleanup);
+
+    /* read only the instance data */
+    lyb = malloc(rec->data_len);
+    SR_CHECK_MEM_GOTO(!lyb, err_info, cleanup);
+    if (pread(data_fd, lyb, rec->data_len, rec->data_off) != (ssize_t)rec->data_len) {
+        SR_ERRINFO_SYSERRNO(&err_info, "pread");
+        goto cleanup;
+    }
+    ly_errno = 0;
+    mod_data = lyd_parse_mem(ly_mod->ctx, lyb, LYD_LYB, LYD_OPT_CONFIG | LYD_OPT_STRICT | LYD_OPT_TRUSTED);
+    if (ly_errno) {
+        sr_errinfo_new_ly(&err_info, ly_mod->ctx);
+        goto cleanup;
+    }
+
+    /* apply any changes of the instance not yet compacted into the data file */
+    if ((err_info = sr_module_file_journal_apply(ly_mod, 0, 0, &journal_base, &journal_off, inst_path, &mod_data,
+            &applied))) {
+        goto cleanup;
+    }
+
+    if (*data && mod_data) {
+        sr_ly_link(*data, mod_data);
+    } else if (mod_data) {
+        *data = mod_data;
+    }
+    mod_data = NULL;
+    *loaded = 1;
+    SR_LOG_DBG("Instance \"%s\" loaded from the running data index.", inst_path);
+
+cleanup:
+    if (addr != MAP_FAILED) {
+        munmap(addr, size);
+    }
+    if (fd > -1) {
+        close(fd);
+    }
+    if (data_fd > -1) {
+        close(data_fd);
+    }
+    free(path);
+    free(inst_path);
+    free(lyb);
+    lyd_free_withsiblings(mod_data);
+    return err_info;
+}
+
+/**
+ * @brief Link running data of a list instance stored separately in the data file with the rest of the data.
+ *
+ * @param[in] inst_data Instance with its parent, if any.
+ * @param[in,out] mod_data Module data to link to.
+ * @param[in,out] last_parent Parent the previous instance was linked into, instances of one list follow each other.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_file_data_link_inst(struct lyd_node *inst_data, struct lyd_node **mod_data, struct lyd_node **last_parent)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *parent = NULL;
+
+    if (inst_data->schema->nodetype == LYS_CONTAINER) {
+        if (*last_parent && ((*last_parent)->schema == inst_data->schema)) {
+            parent = *last_parent;
+        } else {
+            /* find the parent container, it could have been printed only with the instances */
+            LY_TREE_FOR(*mod_data, parent) {
+                if (parent->schema == inst_data->schema) {
+                    break;
+                }
+            }
+        }
+    }
+
+    if (parent) {
+        /* move the instance into it */
+        if (lyd_insert(parent, inst_data->child)) {
+            sr_errinfo_new_ly(&err_info, lyd_node_module(inst_data)->ctx);
+        }
+        lyd_free(inst_data);
+    } else {
+        if (*mod_data) {
+            sr_ly_link(*mod_data, inst_data);
+        } else {
+            *mod_data = inst_data;
+        }
+        parent = (inst_data->schema->nodetype == LYS_CONTAINER) ? inst_data : NULL;
+    }
+    *last_parent = parent;
+
+    return err_info;
+}
+
+sr_error_info_t *
+sr_module_file_data_append(const struct lys_module *ly_mod, sr_datastore_t ds, struct lyd_node **data)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *mod_data = NULL, *inst_data, *last_parent = NULL;
+    char *path = NULL, *addr = MAP_FAILED;
+    size_t size = 0, off, journal_off;
+    uint32_t journal_base;
+    int fd = -1, flags, applied;
+
+retry_open:
+    /* prepare correct file path */
+    if (ds == SR_DS_STARTUP) {
+        err_info = sr_path_startup_file(ly_mod->name, &path);
+    } else {
+        err_info = sr_path_ds_shm(ly_mod->name, ds, 0, &path);
+    }
+    if (err_info) {
+        goto error;
+    }
+
+    /* open fd */
+    if (ds == SR_DS_STARTUP) {
+        fd = open(path, O_RDONLY);
+    } else {
+        fd = shm_open(path, O_RDONLY, 0);
+    }
+    if (fd == -1) {
+        if ((errno == ENOENT) && (ds == SR_DS_CANDIDATE)) {
+            free(path);
+            if (SR_CANDIDATE_DIFF) {
+                /* no candidate changes exist */
+                return NULL;
+            }
+
+            /* no candidate exists, just use running */
+            ds = SR_DS_RUNNING;
+            path = NULL;
+            goto retry_open;
+        }
 
         sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
         goto error;
     }
 
+    /* map the file, it is parsed directly from the mapping */
+    if ((err_info = sr_file_get_size(fd, &size))) {
+        goto error;
+    }
+    if (size) {
+        addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            sr_errinfo_new(&err_info, SR_ERR_NOMEM, NULL, "Failed to map \"%s\" (%s).", path, strerror(errno));
+            goto error;
+        }
+        madvise(addr, size, MADV_SEQUENTIAL);
+    }
+
     /* load the data */
     ly_errno = 0;
     switch (ds) {
@@ -3946,17 +6049,42 @@ retry_open:
         flags = LYD_OPT_EDIT | LYD_OPT_STRICT | LYD_OPT_NOEXTDEPS;
         break;
     case SR_DS_CANDIDATE:
-        flags = LYD_OPT_CONFIG | LYD_OPT_STRICT | LYD_OPT_NOEXTDEPS;
+        flags = (SR_CANDIDATE_DIFF ? LYD_OPT_EDIT : LYD_OPT_CONFIG) | LYD_OPT_STRICT | LYD_OPT_NOEXTDEPS;
         break;
     case SR_DS_STARTUP:
     case SR_DS_RUNNING:
         flags = LYD_OPT_CONFIG | LYD_OPT_STRICT | LYD_OPT_TRUSTED;
         break;
     }
-    mod_data = lyd_parse_fd(ly_mod->ctx, fd, LYD_LYB, flags);
-    if (ly_errno) {
-        sr_errinfo_new_ly(&err_info, ly_mod->ctx);
-        goto error;
+    if (size) {
+        mod_data = lyd_parse_mem(ly_mod->ctx, addr, LYD_LYB, flags);
+        if (ly_errno) {
+            sr_errinfo_new_ly(&err_info, ly_mod->ctx);
+            goto error;
+        }
+
+        /* running data may be followed by list instances stored separately */
+        for (off = lyd_lyb_data_length(addr); (ds == SR_DS_RUNNING) && (off < size); off += lyd_lyb_data_length(addr + off)) {
+            inst_data = lyd_parse_mem(ly_mod->ctx, addr + off, LYD_LYB, flags);
+            if (ly_errno) {
+                sr_errinfo_new_ly(&err_info, ly_mod->ctx);
+                goto error;
+            }
+            if (inst_data && (err_info = sr_module_file_data_link_inst(inst_data, &mod_data, &last_parent))) {
+                goto error;
+            }
+        }
+
+        munmap(addr, size);
+        addr = MAP_FAILED;
+    }
+
+    if (ds == SR_DS_RUNNING) {
+        /* apply any changes not yet compacted into the data file */
+        if ((err_info = sr_module_file_journal_apply(ly_mod, 0, 0, &journal_base, &journal_off, NULL, &mod_data,
+                &applied))) {
+            goto error;
+        }
     }
 
     if (*data && mod_data) {
@@ -3969,6 +6097,9 @@ retry_open:
     return NULL;
 
 error:
+    if (addr != MAP_FAILED) {
+        munmap(addr, size);
+    }
     if (fd > -1) {
         close(fd);
     }
@@ -3977,6 +6108,420 @@ error:
     return err_info;
 }
 
+/**
+ * @brief Get the paths to a module startup file, its temporary file, and its backup file.
+ *
+ * @param[in] mod_name Module name.
+ * @param[out] path Startup file path.
+ * @param[out] tmp_path Temporary startup file path.
+ * @param[out] bak_path Optional backup startup file path.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_path_startup_tmp_file(const char *mod_name, char **path, char **tmp_path, char **bak_path)
+{
+    sr_error_info_t *err_info = NULL;
+
+    *tmp_path = NULL;
+    if (bak_path) {
+        *bak_path = NULL;
+    }
+
+    if ((err_info = sr_path_startup_file(mod_name, path))) {
+        return err_info;
+    }
+    if (asprintf(tmp_path, "%s.tmp", *path) == -1) {
+        *tmp_path = NULL;
+        goto error;
+    }
+    if (bak_path && (asprintf(bak_path, "%s.bak", *path) == -1)) {
+        *bak_path = NULL;
+        goto error;
+    }
+    return NULL;
+
+error:
+    free(*path);
+    *path = NULL;
+    free(*tmp_path);
+    *tmp_path = NULL;
+    SR_ERRINFO_MEM(&err_info);
+    return err_info;
+}
+
+sr_error_info_t *
+sr_module_file_startup_write(const char *mod_name, struct lyd_node *mod_data, int create_flags, mode_t create_mode)
+{
+    sr_error_info_t *err_info = NULL;
+    char *path = NULL, *tmp_path = NULL;
+    struct stat st;
+    int fd = -1, in_place = 0;
+    mode_t um;
+
+    if ((err_info = sr_path_startup_tmp_file(mod_name, &path, &tmp_path, NULL))) {
+        goto cleanup;
+    }
+
+    if (!SR_STARTUP_DURABILITY) {
+        in_place = 1;
+    } else if (stat(path, &st) == -1) {
+        if ((errno != ENOENT) || !(create_flags & O_CREAT)) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+            goto cleanup;
+        }
+
+        /* a new file will be created */
+        st.st_mode = create_mode;
+        st.st_uid = geteuid();
+        st.st_gid = getegid();
+    } else if (create_flags & O_EXCL) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(EEXIST));
+        goto cleanup;
+    }
+
+    if (!in_place) {
+        /* set umask so that the correct permissions are really set */
+        um = umask(00000);
+        fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 00777);
+        umask(um);
+        if (fd == -1) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", tmp_path, strerror(errno));
+            goto cleanup;
+        }
+
+        if (((st.st_uid != geteuid()) || (st.st_gid != getegid())) && (fchown(fd, st.st_uid, st.st_gid) == -1)) {
+            /* replacing the file would change its owner, rewrite it in place instead */
+            close(fd);
+            fd = -1;
+            if (unlink(tmp_path) == -1) {
+                SR_LOG_WRN("Failed to unlink \"%s\" (%s).", tmp_path, strerror(errno));
+            }
+            in_place = 1;
+        }
+    }
+
+    if (in_place) {
+        /* set umask so that the correct permissions are really set if the file is created */
+        um = umask(00000);
+        fd = open(path, O_WRONLY | O_TRUNC | create_flags, create_mode);
+        umask(um);
+        if (fd == -1) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+            goto cleanup;
+        }
+    }
+
+    /* print data */
+    if ((err_info = sr_module_file_running_print(fd, mod_data, &insts, &inst_count))) {
+        sr_errinfo_new(&err_info, SR_ERR_INTERNAL, NULL, "Failed to store data into \"%s\".", in_place ? path : tmp_path);
+        goto cleanup_unlink;
+    }
+
+    /* make sure the data are on the disk before the file is moved into place */
+    if ((SR_STARTUP_DURABILITY > 1) && (fsync(fd) == -1)) {
+        SR_ERRINFO_SYSERRNO(&err_info, "fsync");
+        goto cleanup_unlink;
+    }
+    goto cleanup;
+
+cleanup_unlink:
+    /* do not leave incomplete temporary file behind */
+    if (!in_place && (unlink(tmp_path) == -1)) {
+        SR_LOG_WRN("Failed to unlink \"%s\" (%s).", tmp_path, strerror(errno));
+    }
+
+cleanup:
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+    free(tmp_path);
+    return err_info;
+}
+
+/** previous startup file of a module is kept as a backup during commit */
+#define SR_STARTUP_COMMIT_BACKUP 0x01
+
+/** startup file of a module was replaced by its temporary file during commit */
+#define SR_STARTUP_COMMIT_REPLACED 0x02
+
+sr_error_info_t *
+sr_module_file_startup_commit(const char **mod_names, uint32_t mod_count)
+{
+    sr_error_info_t *err_info = NULL;
+    char *path = NULL, *tmp_path = NULL, *bak_path = NULL, *state = NULL;
+    uint32_t i;
+    int dir_fd = -1;
+
+    if (!SR_STARTUP_DURABILITY || !mod_count) {
+        /* nothing to do */
+        return NULL;
+    }
+
+    /* remember what was done for every module so that it can be reverted */
+    state = calloc(mod_count, sizeof *state);
+    SR_CHECK_MEM_GOTO(!state, err_info, rollback);
+
+    /* move all the new files into place, keeping the previous files until all of them are replaced */
+    for (i = 0; i < mod_count; ++i) {
+        if ((err_info = sr_path_startup_tmp_file(mod_names[i], &path, &tmp_path, &bak_path))) {
+            goto rollback;
+        }
+        if (access(tmp_path, F_OK) == -1) {
+            /* the file was written in place */
+            goto next_mod;
+        }
+
+        if ((unlink(bak_path) == -1) && (errno != ENOENT)) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to unlink \"%s\" (%s).", bak_path, strerror(errno));
+            goto rollback;
+        }
+        if (link(path, bak_path) == -1) {
+            if (errno != ENOENT) {
+                sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to link \"%s\" (%s).", bak_path, strerror(errno));
+                goto rollback;
+            }
+        } else {
+            state[i] |= SR_STARTUP_COMMIT_BACKUP;
+        }
+
+        if (rename(tmp_path, path) == -1) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to rename \"%s\" (%s).", tmp_path, strerror(errno));
+            goto rollback;
+        }
+        state[i] |= SR_STARTUP_COMMIT_REPLACED;
+
+next_mod:
+        free(path);
+        free(tmp_path);
+        free(bak_path);
+        path = NULL;
+        tmp_path = NULL;
+        bak_path = NULL;
+    }
+
+    if (SR_STARTUP_DURABILITY > 1) {
+        /* sync the directory only once for all the renamed files */
+        if ((err_info = sr_path_startup_dir(&path))) {
+            goto rollback;
+        }
+        dir_fd = open(path, O_RDONLY | O_DIRECTORY);
+        if (dir_fd == -1) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+            goto rollback;
+        }
+        if (fsync(dir_fd) == -1) {
+            SR_ERRINFO_SYSERRNO(&err_info, "fsync");
+            goto rollback;
+        }
+        free(path);
+        path = NULL;
+    }
+
+    /* all the files were replaced, the previous ones are no longer needed */
+    for (i = 0; i < mod_count; ++i) {
+        if (!(state[i] & SR_STARTUP_COMMIT_BACKUP)) {
+            continue;
+        }
+        if (sr_path_startup_tmp_file(mod_names[i], &path, &tmp_path, &bak_path)) {
+            /* leave it */
+            continue;
+        }
+        if (unlink(bak_path) == -1) {
+            SR_LOG_WRN("Failed to unlink \"%s\" (%s).", bak_path, strerror(errno));
+        }
+        free(path);
+        free(tmp_path);
+        free(bak_path);
+        path = NULL;
+        tmp_path = NULL;
+        bak_path = NULL;
+    }
+    goto cleanup;
+
+rollback:
+    free(path);
+    free(tmp_path);
+    free(bak_path);
+    path = NULL;
+    tmp_path = NULL;
+    bak_path = NULL;
+
+    /* move back all the previous files and remove the new ones */
+    for (i = 0; i < mod_count; ++i) {
+        if (sr_path_startup_tmp_file(mod_names[i], &path, &tmp_path, &bak_path)) {
+            continue;
+        }
+        if (state && (state[i] & SR_STARTUP_COMMIT_REPLACED)) {
+            if (state[i] & SR_STARTUP_COMMIT_BACKUP) {
+                if (rename(bak_path, path) == -1) {
+                    SR_LOG_WRN("Failed to rename \"%s\" (%s).", bak_path, strerror(errno));
+                }
+            } else if (unlink(path) == -1) {
+                SR_LOG_WRN("Failed to unlink \"%s\" (%s).", path, strerror(errno));
+            }
+        } else if (state && (state[i] & SR_STARTUP_COMMIT_BACKUP) && (unlink(bak_path) == -1)) {
+            SR_LOG_WRN("Failed to unlink \"%s\" (%s).", bak_path, strerror(errno));
+        }
+        free(path);
+        free(tmp_path);
+        free(bak_path);
+        path = NULL;
+        tmp_path = NULL;
+        bak_path = NULL;
+    }
+
+    /* and any temporary files not moved into place */
+    sr_module_file_startup_abort(mod_names, mod_count);
+
+cleanup:
+    if (dir_fd > -1) {
+        close(dir_fd);
+    }
+    free(path);
+    free(tmp_path);
+    free(bak_path);
+    free(state);
+    return err_info;
+}
+
+void
+sr_module_file_startup_abort(const char **mod_names, uint32_t mod_count)
+{
+    char *path, *tmp_path;
+    uint32_t i;
+
+    if (!SR_STARTUP_DURABILITY) {
+        /* no temporary files */
+        return;
+    }
+
+    for (i = 0; i < mod_count; ++i) {
+        if (sr_path_startup_tmp_file(mod_names[i], &path, &tmp_path, NULL)) {
+            continue;
+        }
+        if ((unlink(tmp_path) == -1) && (errno != ENOENT)) {
+            SR_LOG_WRN("Failed to unlink \"%s\" (%s).", tmp_path, strerror(errno));
+        }
+        free(path);
+        free(tmp_path);
+    }
+}
+
+/**
+ * @brief Replace running data file of a specific module. The new data are written into a temporary file
+ * that is moved into place once complete, only then are the journal and the index of the previous data removed.
+ *
+ * @param[in] mod_name Module name.
+ * @param[in] mod_data Module data.
+ * @param[in] create_flags Additional flags to use for opening the file.
+ * @param[in] create_mode Permissions of the file, if it is created.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_file_running_replace(const char *mod_name, struct lyd_node *mod_data, int create_flags, mode_t create_mode)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_index_inst_s *insts = NULL;
+    uint32_t inst_count = 0;
+    char *path = NULL, *tmp_path = NULL;
+    struct stat st;
+    int fd = -1, in_place = 0;
+    mode_t um;
+
+    if ((err_info = sr_path_ds_shm(mod_name, SR_DS_RUNNING, 1, &path))) {
+        goto cleanup;
+    }
+    if (asprintf(&tmp_path, "%s.tmp", path) == -1) {
+        tmp_path = NULL;
+        SR_ERRINFO_MEM(&err_info);
+        goto cleanup;
+    }
+
+    if (stat(path, &st) == -1) {
+        if ((errno != ENOENT) || !(create_flags & O_CREAT)) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+            goto cleanup;
+        }
+
+        /* a new file will be created */
+        st.st_mode = create_mode;
+        st.st_uid = geteuid();
+        st.st_gid = getegid();
+    } else if (create_flags & O_EXCL) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(EEXIST));
+        goto cleanup;
+    }
+
+    /* set umask so that the correct permissions are really set, SHM names are relative to the SHM directory */
+    um = umask(00000);
+    fd = shm_open(tmp_path + strlen(SR_SHM_DIR), O_WRONLY | O_CREAT | O_TRUNC, st.st_mode & 00777);
+    umask(um);
+    if (fd == -1) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", tmp_path, strerror(errno));
+        goto cleanup;
+    }
+
+    if (((st.st_uid != geteuid()) || (st.st_gid != getegid())) && (fchown(fd, st.st_uid, st.st_gid) == -1)) {
+        /* replacing the file would change its owner, rewrite it in place instead */
+        close(fd);
+        fd = -1;
+        if (unlink(tmp_path) == -1) {
+            SR_LOG_WRN("Failed to unlink \"%s\" (%s).", tmp_path, strerror(errno));
+        }
+        in_place = 1;
+
+        fd = shm_open(path + strlen(SR_SHM_DIR), O_WRONLY | O_TRUNC, 0);
+        if (fd == -1) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
+            goto cleanup;
+        }
+    }
+
+    /* print data */
+    if (lyd_print_fd(fd, mod_data, LYD_LYB, LYP_WITHSIBLINGS)) {
+        sr_errinfo_new_ly(&err_info, lyd_node_module(mod_data)->ctx);
+        sr_errinfo_new(&err_info, SR_ERR_INTERNAL, NULL, "Failed to store data into \"%s\".", in_place ? path : tmp_path);
+        goto cleanup_unlink;
+    }
+
+    /* move the complete new data into place */
+    if (!in_place && (rename(tmp_path, path) == -1)) {
+        sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to rename \"%s\" (%s).", tmp_path, strerror(errno));
+        goto cleanup_unlink;
+    }
+
+    /* the journal is compacted into the new data and the index was created for the previous data */
+    if ((err_info = sr_module_file_journal_remove(mod_name))) {
+        goto cleanup;
+    }
+    if ((err_info = sr_module_file_index_remove(mod_name))) {
+        goto cleanup;
+    }
+
+    /* make sure the separately stored list instances can be loaded one by one, the data are stored even if
+     * the index cannot be created, they will just always be loaded whole */
+    if (insts && (err_info = sr_module_file_index_update(mod_name, fd, insts, inst_count))) {
+        sr_errinfo_free(&err_info);
+    }
+    goto cleanup;
+
+cleanup_unlink:
+    /* the previous data file with its journal remains valid */
+    if (!in_place && (unlink(tmp_path) == -1)) {
+        SR_LOG_WRN("Failed to unlink \"%s\" (%s).", tmp_path, strerror(errno));
+    }
+
+cleanup:
+    if (fd > -1) {
+        close(fd);
+    }
+    free(path);
+    free(tmp_path);
+    sr_module_file_index_inst_free(insts, inst_count);
+    return err_info;
+}
+
 sr_error_info_t *
 sr_module_file_data_set(const char *mod_name, sr_datastore_t ds, struct lyd_node *mod_data, int create_flags,
         mode_t create_mode)
@@ -3986,18 +6531,19 @@ sr_module_file_data_set(const char *mod_name, sr_datastore_t ds, struct lyd_node
     int fd = -1;
     mode_t um;
 
-    /* learn path */
-    switch (ds) {
-    case SR_DS_STARTUP:
-        err_info = sr_path_startup_file(mod_name, &path);
-        break;
-    case SR_DS_RUNNING:
-    case SR_DS_CANDIDATE:
-    case SR_DS_OPERATIONAL:
-        err_info = sr_path_ds_shm(mod_name, ds, 0, &path);
-        break;
+    if (ds == SR_DS_STARTUP) {
+        /* durably replace the startup file */
+        if ((err_info = sr_module_file_startup_write(mod_name, mod_data, create_flags, create_mode))) {
+            return err_info;
+        }
+        return sr_module_file_startup_commit(&mod_name, 1);
+    } else if (ds == SR_DS_RUNNING) {
+        /* replace the running file before its journal is discarded */
+        return sr_module_file_running_replace(mod_name, mod_data, create_flags, create_mode);
     }
-    if (err_info) {
+
+    /* learn path */
+    if ((err_info = sr_path_ds_shm(mod_name, ds, 0, &path))) {
         goto cleanup;
     }
 
@@ -4005,11 +6551,7 @@ sr_module_file_data_set(const char *mod_name, sr_datastore_t ds, struct lyd_node
     um = umask(00000);
 
     /* open */
-    if (ds == SR_DS_STARTUP) {
-        fd = open(path, O_WRONLY | O_TRUNC | create_flags, create_mode);
-    } else {
-        fd = shm_open(path, O_WRONLY | O_TRUNC | create_flags, create_mode);
-    }
+    fd = shm_open(path, O_WRONLY | O_TRUNC | create_flags, create_mode);
     umask(um);
     if (fd == -1) {
         sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Failed to open \"%s\" (%s).", path, strerror(errno));
@@ -4078,6 +6620,7 @@ sr_module_update_oper_diff(sr_conn_ctx_t *conn, const char *mod_name)
     if ((err_info = sr_module_file_data_set(ly_mod->name, SR_DS_OPERATIONAL, diff, 0, 0))) {
         goto cleanup;
     }
+    ATOMIC_INC_RELAXED(mod_info.mods[0].shm_mod->oper_ver);
 
 cleanup:
     /* MODULES UNLOCK */
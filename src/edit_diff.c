@@ -40,8 +40,325 @@ enum insert_val {
     INSERT_AFTER
 };
 
+/**
+ * @brief Temporary hash index of data tree siblings, built lazily once enough lookups are performed in them.
+ */
+struct sr_edit_idx_s {
+    struct sr_edit_idx_item_s {
+        struct lyd_node *node;  /**< Indexed sibling. */
+        uint32_t hash;          /**< Sibling hash. */
+    } *items;                   /**< Hash table with linear probing. */
+    uint32_t size;              /**< Hash table size (power of 2), 0 if the index is not built. */
+    uint32_t count;             /**< Number of indexed siblings. */
+    uint32_t lookups;           /**< Number of lookups performed before building the index. */
+    int disabled;               /**< Set if the siblings cannot be indexed. */
+};
+
 static sr_error_info_t *sr_diff_merge_r(const struct lyd_node *src_node, enum edit_op parent_op, void *oper_conn,
-        struct lyd_node *diff_parent, struct lyd_node **diff_root, int *change);
+        struct lyd_node *diff_parent, struct lyd_node **diff_root, struct sr_edit_idx_s *idx, int *change);
+
+/**
+ * @brief Get hash of a node for the sibling index.
+ *
+ * @param[in] node Node to hash.
+ * @param[out] hash Node hash.
+ * @return 1 on success, 0 if the node is never looked up using the index, -1 if it cannot be indexed.
+ */
+static int
+sr_edit_idx_hash(const struct lyd_node *node, uint32_t *hash)
+{
+    const struct lys_node_list *slist;
+    const struct lyd_node *key;
+    uint32_t h;
+    uint8_t i;
+
+    if ((node->schema->nodetype & (LYS_LIST | LYS_LEAFLIST)) && (node->schema->flags & LYS_CONFIG_R)) {
+        /* instances may not be unique */
+        return 0;
+    }
+
+    h = (uint32_t)((uintptr_t)node->schema >> 4);
+    if (node->schema->nodetype == LYS_LIST) {
+        /* keys are always the first children */
+        slist = (const struct lys_node_list *)node->schema;
+        key = node->child;
+        for (i = 0; i < slist->keys_size; ++i) {
+            if (!key || (key->schema != (struct lys_node *)slist->keys[i])) {
+                return -1;
+            }
+            h = h * 31 + sr_str_hash(sr_ly_leaf_value_str(key));
+            key = key->next;
+        }
+    } else if (node->schema->nodetype == LYS_LEAFLIST) {
+        h = h * 31 + sr_str_hash(sr_ly_leaf_value_str(node));
+    }
+
+    *hash = h;
+    return 1;
+}
+
+/**
+ * @brief Check whether 2 indexed nodes are equal (same schema and same keys or value).
+ *
+ * @param[in] node1 First node.
+ * @param[in] node2 Second node.
+ * @return 0 if not equal, non-zero if equal.
+ */
+static int
+sr_edit_idx_equal(const struct lyd_node *node1, const struct lyd_node *node2)
+{
+    const struct lyd_node *key1, *key2;
+    uint8_t i;
+
+    if (node1->schema != node2->schema) {
+        return 0;
+    }
+
+    if (node1->schema->nodetype == LYS_LIST) {
+        key1 = node1->child;
+        key2 = node2->child;
+        for (i = 0; i < ((struct lys_node_list *)node1->schema)->keys_size; ++i) {
+            if (strcmp(sr_ly_leaf_value_str(key1), sr_ly_leaf_value_str(key2))) {
+                return 0;
+            }
+            key1 = key1->next;
+            key2 = key2->next;
+        }
+    } else if (node1->schema->nodetype == LYS_LEAFLIST) {
+        if (strcmp(sr_ly_leaf_value_str(node1), sr_ly_leaf_value_str(node2))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Free sibling index hash table, it can be built again.
+ *
+ * @param[in] idx Sibling index.
+ */
+static void
+sr_edit_idx_clear(struct sr_edit_idx_s *idx)
+{
+    free(idx->items);
+    idx->items = NULL;
+    idx->size = 0;
+    idx->count = 0;
+}
+
+/**
+ * @brief Insert a node into sibling index hash table, which must be large enough.
+ *
+ * @param[in] idx Sibling index.
+ * @param[in] node Node to insert.
+ * @param[in] hash Node hash.
+ */
+static void
+sr_edit_idx_insert(struct sr_edit_idx_s *idx, struct lyd_node *node, uint32_t hash)
+{
+    uint32_t i;
+
+    for (i = hash & (idx->size - 1); idx->items[i].node; i = (i + 1) & (idx->size - 1));
+    idx->items[i].node = node;
+    idx->items[i].hash = hash;
+    ++idx->count;
+}
+
+/**
+ * @brief Resize sibling index hash table.
+ *
+ * @param[in] idx Sibling index.
+ * @param[in] size New hash table size (power of 2).
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_edit_idx_resize(struct sr_edit_idx_s *idx, uint32_t size)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_edit_idx_item_s *items;
+    uint32_t i, old_size;
+
+    items = idx->items;
+    old_size = idx->size;
+
+    idx->items = calloc(size, sizeof *idx->items);
+    if (!idx->items) {
+        idx->items = items;
+        SR_ERRINFO_MEM(&err_info);
+        return err_info;
+    }
+    idx->size = size;
+    idx->count = 0;
+
+    /* reinsert all the nodes */
+    for (i = 0; i < old_size; ++i) {
+        if (items[i].node) {
+            sr_edit_idx_insert(idx, items[i].node, items[i].hash);
+        }
+    }
+    free(items);
+
+    return NULL;
+}
+
+/**
+ * @brief Build sibling index of all the siblings.
+ *
+ * @param[in] idx Sibling index.
+ * @param[in] first_node First sibling.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_edit_idx_build(struct sr_edit_idx_s *idx, const struct lyd_node *first_node)
+{
+    sr_error_info_t *err_info = NULL;
+    const struct lyd_node *iter;
+    uint32_t count = 0, size, hash;
+    int r;
+
+    LY_TREE_FOR(first_node, iter) {
+        ++count;
+    }
+    for (size = 16; size < count * 2; size <<= 1);
+    if ((err_info = sr_edit_idx_resize(idx, size))) {
+        return err_info;
+    }
+
+    LY_TREE_FOR(first_node, iter) {
+        r = sr_edit_idx_hash(iter, &hash);
+        if (r == -1) {
+            /* fall back to lookups without the index */
+            sr_edit_idx_clear(idx);
+            idx->disabled = 1;
+            break;
+        } else if (r) {
+            sr_edit_idx_insert(idx, (struct lyd_node *)iter, hash);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Find a sibling using the sibling index. It is built if enough lookups were performed.
+ *
+ * @param[in] idx Sibling index.
+ * @param[in] first_node First sibling.
+ * @param[in] node Node to find.
+ * @param[out] match Matching sibling, NULL if there is none.
+ * @param[out] used Whether the index was used, if not, the lookup needs to be performed in another way.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_edit_idx_find(struct sr_edit_idx_s *idx, const struct lyd_node *first_node, const struct lyd_node *node,
+        struct lyd_node **match, int *used)
+{
+    sr_error_info_t *err_info = NULL;
+    uint32_t i, hash;
+
+    *match = NULL;
+    *used = 0;
+
+    if (idx->disabled || !first_node || (sr_edit_idx_hash(node, &hash) < 1)) {
+        return NULL;
+    }
+
+    if (!idx->size) {
+        if (++idx->lookups < SR_EDIT_IDX_MIN_LOOKUPS) {
+            /* not worth building the index yet */
+            return NULL;
+        }
+
+        /* build the index */
+        if ((err_info = sr_edit_idx_build(idx, first_node))) {
+            return err_info;
+        }
+        if (idx->disabled) {
+            return NULL;
+        }
+    }
+
+    for (i = hash & (idx->size - 1); idx->items[i].node; i = (i + 1) & (idx->size - 1)) {
+        if ((idx->items[i].hash == hash) && sr_edit_idx_equal(idx->items[i].node, node)) {
+            *match = idx->items[i].node;
+            break;
+        }
+    }
+    *used = 1;
+
+    return NULL;
+}
+
+/**
+ * @brief Add a new sibling into sibling index, if built.
+ *
+ * @param[in] idx Sibling index, may be NULL.
+ * @param[in] node Inserted sibling.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_edit_idx_add(struct sr_edit_idx_s *idx, struct lyd_node *node)
+{
+    sr_error_info_t *err_info = NULL;
+    uint32_t hash;
+    int r;
+
+    if (!idx || !idx->size) {
+        return NULL;
+    }
+
+    r = sr_edit_idx_hash(node, &hash);
+    if (r == -1) {
+        sr_edit_idx_clear(idx);
+        idx->disabled = 1;
+        return NULL;
+    } else if (!r) {
+        return NULL;
+    }
+
+    if (((idx->count + 1) * 2 > idx->size) && (err_info = sr_edit_idx_resize(idx, idx->size << 1))) {
+        return err_info;
+    }
+    sr_edit_idx_insert(idx, node, hash);
+
+    return NULL;
+}
+
+/**
+ * @brief Remove a sibling from sibling index, if built, before it is unlinked.
+ *
+ * @param[in] idx Sibling index, may be NULL.
+ * @param[in] node Removed sibling.
+ */
+static void
+sr_edit_idx_del(struct sr_edit_idx_s *idx, const struct lyd_node *node)
+{
+    uint32_t i, j, k, mask, hash;
+
+    if (!idx || !idx->size || (sr_edit_idx_hash(node, &hash) < 1)) {
+        return;
+    }
+    mask = idx->size - 1;
+
+    for (i = hash & mask; idx->items[i].node != node; i = (i + 1) & mask) {
+        if (!idx->items[i].node) {
+            /* not indexed */
+            return;
+        }
+    }
+
+    /* shift back all the following items that would no longer be found */
+    for (j = (i + 1) & mask; idx->items[j].node; j = (j + 1) & mask) {
+        k = idx->items[j].hash & mask;
+        if ((j > i) ? ((k <= i) || (k > j)) : ((k <= i) && (k > j))) {
+            idx->items[i] = idx->items[j];
+            i = j;
+        }
+    }
+    idx->items[i].node = NULL;
+    --idx->count;
+}
 
 /**
  * @brief Find a previous (leaf-)list instance.
@@ -168,19 +485,20 @@ sr_edit_find_userord_predicate(const struct lyd_node *sibling, const struct lyd_
  * @param[in] insert Optional insert place of the operation.
  * @param[in] key_or_value Optional predicate of relative (leaf-)list instance of the operation.
  * @param[in] dflt_ll_skip Whether to skip found default leaf-list instance.
+ * @param[in] idx Optional index of the data tree siblings.
  * @param[out] match_p Matching node.
  * @param[out] val_equal_p Whether even the value matches.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
 sr_edit_find(const struct lyd_node *first_node, const struct lyd_node *edit_node, enum edit_op op, enum insert_val insert,
-        const char *key_or_value, int dflt_ll_skip, struct lyd_node **match_p, int *val_equal_p)
+        const char *key_or_value, int dflt_ll_skip, struct sr_edit_idx_s *idx, struct lyd_node **match_p, int *val_equal_p)
 {
     sr_error_info_t *err_info = NULL;
     struct lyd_node *anchor_node;
     struct ly_set *set;
     const struct lyd_node *iter, *match = NULL;
-    int val_equal = 0;
+    int val_equal = 0, used = 0;
 
     if ((op == EDIT_PURGE) && (edit_node->schema->nodetype & (LYS_LIST | LYS_LEAFLIST))) {
         LY_TREE_FOR(first_node, iter) {
@@ -204,7 +522,10 @@ sr_edit_find(const struct lyd_node *first_node, const struct lyd_node *edit_node
             }
             ly_set_free(set);
         } else {
-            if (lyd_find_sibling(first_node, edit_node, (struct lyd_node **)&match)) {
+            if (idx && (err_info = sr_edit_idx_find(idx, first_node, edit_node, (struct lyd_node **)&match, &used))) {
+                return err_info;
+            }
+            if (!used && lyd_find_sibling(first_node, edit_node, (struct lyd_node **)&match)) {
                 sr_errinfo_new_ly(&err_info, lyd_node_module(edit_node)->ctx);
                 return err_info;
             }
@@ -951,7 +1272,7 @@ sr_edit_diff_add(struct lyd_node *node, const char *attr_val, const char *prev_a
 
     if ((node_dup->schema->nodetype == LYS_LEAFLIST) && ((struct lys_node_leaflist *)node_dup->schema)->dflt && (op == EDIT_CREATE)) {
         /* default leaf-list with the same value may have been removed, so we need to merge these 2 diffs */
-        if ((err_info = sr_diff_merge_r(node_dup, op, NULL, diff_parent, diff_root, NULL))) {
+        if ((err_info = sr_diff_merge_r(node_dup, op, NULL, diff_parent, diff_root, NULL, NULL))) {
             goto error;
         }
         /* it was duplicated, so free it and do not return any diff node (since it has no children, it is okay) */
@@ -1593,20 +1914,23 @@ sr_edit_apply_delete(struct lyd_node *match_node, const struct lyd_node *edit_no
  * @param[in] parent_op Parent operation.
  * @param[in] diff_parent Current sysrepo diff parent.
  * @param[in,out] diff_root Sysrepo diff root node.
+ * @param[in] idx Optional index of the data tree siblings.
  * @param[in] flags Flags modifying the behavior.
  * @param[out] change Set if there are some data changes.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
 sr_edit_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, const struct lyd_node *edit_node,
-        enum edit_op parent_op, struct lyd_node *diff_parent, struct lyd_node **diff_root, int flags, int *change)
+        enum edit_op parent_op, struct lyd_node *diff_parent, struct lyd_node **diff_root, struct sr_edit_idx_s *idx,
+        int flags, int *change)
 {
     sr_error_info_t *err_info = NULL;
     struct lyd_node *match = NULL, *child, *next, *edit_match, *diff_node = NULL;
+    struct sr_edit_idx_s child_idx = {0}, edit_idx = {0};
     enum edit_op op, next_op, prev_op = 0;
     enum insert_val insert;
     const char *key_or_value, *origin;
-    int val_equal;
+    int val_equal, created;
 
     assert(first_node || (flags & EDIT_APPLY_CHECK_OP_R));
     /* if data node is set, it must be the first sibling */
@@ -1623,7 +1947,7 @@ reapply:
         /* we have no data */
         match = NULL;
     } else {
-        if ((err_info = sr_edit_find(*first_node, edit_node, op, insert, key_or_value, 1, &match, &val_equal))) {
+        if ((err_info = sr_edit_find(*first_node, edit_node, op, insert, key_or_value, 1, idx, &match, &val_equal))) {
             return err_info;
         }
     }
@@ -1653,6 +1977,10 @@ reapply:
                     &diff_node, &next_op, change))) {
                 goto op_error;
             }
+            /* the node was created if we should continue */
+            if ((next_op == EDIT_CONTINUE) && (err_info = sr_edit_idx_add(idx, match))) {
+                return err_info;
+            }
             break;
         case EDIT_MERGE:
             if (flags & EDIT_APPLY_CHECK_OP_R) {
@@ -1674,16 +2002,23 @@ reapply:
             prev_op = next_op;
             /* fallthrough */
         case EDIT_REMOVE:
+            if (match) {
+                sr_edit_idx_del(idx, match);
+            }
             if ((err_info = sr_edit_apply_remove(first_node, parent_node, match, diff_parent, diff_root, &diff_node,
                     &next_op, &flags, change))) {
                 goto op_error;
             }
             break;
         case EDIT_MOVE:
+            created = match ? 0 : 1;
             if ((err_info = sr_edit_apply_move(first_node, parent_node, edit_node, &match, insert, key_or_value,
                     diff_parent, diff_root, &diff_node, &next_op, change))) {
                 goto op_error;
             }
+            if (created && (err_info = sr_edit_idx_add(idx, match))) {
+                return err_info;
+            }
             break;
         case EDIT_NONE:
             if ((err_info = sr_edit_apply_none(match, edit_node, diff_parent, diff_root, &diff_node, &next_op, change))) {
@@ -1735,12 +2070,12 @@ reapply:
     if (flags & EDIT_APPLY_REPLACE_R) {
         /* remove all children that are not in the edit, recursively */
         LY_TREE_FOR_SAFE(sr_lyd_child(match, 1), next, child) {
-            if ((err_info = sr_edit_find(edit_node->child, child, EDIT_DELETE, 0, NULL, 0, &edit_match, NULL))) {
-                return err_info;
+            if ((err_info = sr_edit_find(edit_node->child, child, EDIT_DELETE, 0, NULL, 0, &edit_idx, &edit_match, NULL))) {
+                goto cleanup;
             }
             if (!edit_match && (err_info = sr_edit_apply_r(&match->child, match, child, EDIT_DELETE, diff_parent,
-                    diff_root, flags, change))) {
-                return err_info;
+                    diff_root, &child_idx, flags, change))) {
+                goto cleanup;
             }
         }
     }
@@ -1749,12 +2084,12 @@ reapply:
     LY_TREE_FOR(sr_lyd_child(edit_node, 1), child) {
         if (flags & EDIT_APPLY_CHECK_OP_R) {
             /* we do not operate with any datastore data or diff anymore */
-            err_info = sr_edit_apply_r(NULL, NULL, child, op, NULL, NULL, flags, change);
+            err_info = sr_edit_apply_r(NULL, NULL, child, op, NULL, NULL, NULL, flags, change);
         } else {
-            err_info = sr_edit_apply_r(&match->child, match, child, op, diff_parent, diff_root, flags, change);
+            err_info = sr_edit_apply_r(&match->child, match, child, op, diff_parent, diff_root, &child_idx, flags, change);
         }
         if (err_info) {
-            return err_info;
+            goto cleanup;
         }
     }
 
@@ -1768,7 +2103,10 @@ reapply:
         }
     }
 
-    return NULL;
+cleanup:
+    sr_edit_idx_clear(&child_idx);
+    sr_edit_idx_clear(&edit_idx);
+    return err_info;
 
 op_error:
     assert(err_info);
@@ -1783,6 +2121,7 @@ sr_edit_mod_apply(const struct lyd_node *edit, const struct lys_module *ly_mod,
     sr_error_info_t *err_info = NULL;
     const struct lyd_node *root;
     struct lyd_node *mod_diff;
+    struct sr_edit_idx_s idx = {0}, diff_idx = {0};
 
     if (change) {
         *change = 0;
@@ -1796,9 +2135,10 @@ sr_edit_mod_apply(const struct lyd_node *edit, const struct lys_module *ly_mod,
 
         /* apply relevant nodes from the edit datatree */
         mod_diff = NULL;
-        if ((err_info = sr_edit_apply_r(data, NULL, root, EDIT_CONTINUE, NULL, diff ? &mod_diff : NULL, 0, change))) {
+        if ((err_info = sr_edit_apply_r(data, NULL, root, EDIT_CONTINUE, NULL, diff ? &mod_diff : NULL, &idx, 0,
+                change))) {
             lyd_free_withsiblings(mod_diff);
-            return err_info;
+            goto cleanup;
         }
 
         if (diff && mod_diff) {
@@ -1806,15 +2146,18 @@ sr_edit_mod_apply(const struct lyd_node *edit, const struct lys_module *ly_mod,
             if (!*diff) {
                 *diff = mod_diff;
             } else {
-                if ((err_info = sr_diff_merge_r(mod_diff, EDIT_CONTINUE, NULL, NULL, diff, NULL))) {
-                    return err_info;
+                if ((err_info = sr_diff_merge_r(mod_diff, EDIT_CONTINUE, NULL, NULL, diff, &diff_idx, NULL))) {
+                    goto cleanup;
                 }
                 lyd_free_withsiblings(mod_diff);
             }
         }
     }
 
-    return NULL;
+cleanup:
+    sr_edit_idx_clear(&idx);
+    sr_edit_idx_clear(&diff_idx);
+    return err_info;
 }
 
 /**
@@ -2314,15 +2657,17 @@ sr_diff_check_pid_conn(struct lyd_node *diff_node, pid_t cur_pid, void *cur_conn
  * @param[in] oper_conn Connection pointer in case it is operational diff. Otherwise should be NULL.
  * @param[in] diff_parent Current sysrepo diff parent.
  * @param[in,out] diff_root Sysrepo diff root node.
+ * @param[in] idx Optional index of the diff siblings.
  * @param[out] change Set if there are some data changes.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
 sr_diff_merge_r(const struct lyd_node *src_node, enum edit_op parent_op, void *oper_conn, struct lyd_node *diff_parent,
-        struct lyd_node **diff_root, int *change)
+        struct lyd_node **diff_root, struct sr_edit_idx_s *idx, int *change)
 {
     sr_error_info_t *err_info = NULL;
     struct lyd_node *child, *diff_node = NULL;
+    struct sr_edit_idx_s child_idx = {0};
     enum edit_op src_op, cur_op;
     pid_t pid;
     void *conn_ptr;
@@ -2336,7 +2681,7 @@ sr_diff_merge_r(const struct lyd_node *src_node, enum edit_op parent_op, void *o
 
     /* find an equal node in the current diff */
     if ((err_info = sr_edit_find(diff_parent ? sr_lyd_child(diff_parent, 1) : *diff_root, src_node, src_op, INSERT_DEFAULT,
-            NULL, 0, &diff_node, &val_equal))) {
+            NULL, 0, idx, &diff_node, &val_equal))) {
         return err_info;
     }
 
@@ -2399,15 +2744,22 @@ sr_diff_merge_r(const struct lyd_node *src_node, enum edit_op parent_op, void *o
 
         /* merge src_diff recursively */
         LY_TREE_FOR(sr_lyd_child(src_node, 1), child) {
-            if ((err_info = sr_diff_merge_r(child, src_op, oper_conn, diff_parent, diff_root, change))) {
-                return err_info;
+            if ((err_info = sr_diff_merge_r(child, src_op, oper_conn, diff_parent, diff_root, &child_idx, change))) {
+                break;
             }
         }
+        sr_edit_idx_clear(&child_idx);
+        if (err_info) {
+            return err_info;
+        }
     } else {
         /* add new diff node with all descendants */
         if ((err_info = sr_diff_add(src_node, diff_parent, diff_root, &diff_node))) {
             return err_info;
         }
+        if ((err_info = sr_edit_idx_add(idx, diff_node))) {
+            return err_info;
+        }
         if (change) {
             *change = 1;
         }
@@ -2443,6 +2795,7 @@ sr_diff_merge_r(const struct lyd_node *src_node, enum edit_op parent_op, void *o
 
     /* remove any redundant nodes */
     if (diff_parent && sr_diff_is_redundant(diff_parent)) {
+        sr_edit_idx_del(idx, diff_parent);
         if (diff_parent == *diff_root) {
             *diff_root = (*diff_root)->next;
         }
@@ -2463,6 +2816,7 @@ sr_diff_mod_merge(const struct lyd_node *src_diff, void *oper_conn, const struct
 {
     sr_error_info_t *err_info = NULL;
     const struct lyd_node *src_node;
+    struct sr_edit_idx_s idx = {0};
 
     if (change) {
         *change = 0;
@@ -2475,12 +2829,13 @@ sr_diff_mod_merge(const struct lyd_node *src_diff, void *oper_conn, const struct
         }
 
         /* apply relevant nodes from the diff datatree */
-        if ((err_info = sr_diff_merge_r(src_node, EDIT_CONTINUE, oper_conn, NULL, diff, change))) {
-            return err_info;
+        if ((err_info = sr_diff_merge_r(src_node, EDIT_CONTINUE, oper_conn, NULL, diff, &idx, change))) {
+            break;
         }
     }
 
-    return NULL;
+    sr_edit_idx_clear(&idx);
+    return err_info;
 }
 
 /**
@@ -2560,16 +2915,18 @@ sr_diff_op(const struct lyd_node *diff_node, enum edit_op *op, const char **key_
  * @param[in] parent_node Parent of the first sibling.
  * @param[in] diff_node Sysrepo diff node.
  * @param[in] with_origin Whether to copy origin from diff into data.
+ * @param[in,out] idx Optional index of the data tree siblings, kept up-to-date.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
 sr_diff_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, const struct lyd_node *diff_node,
-        int with_origin)
+        int with_origin, struct sr_edit_idx_s *idx)
 {
     sr_error_info_t *err_info = NULL;
     enum edit_op op;
     struct lyd_node *match, *diff_child, *anchor_node;
     const char *key_or_value, *origin;
+    struct sr_edit_idx_s child_idx = {0};
     int ret;
     struct ly_ctx *ly_ctx = lyd_node_module(diff_node)->ctx;
 
@@ -2584,7 +2941,7 @@ sr_diff_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, cons
         if (op == EDIT_REPLACE) {
             /* find the node (we must have some siblings because the node was only moved) */
             assert(*first_node);
-            if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+            if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, idx, &match, NULL))) {
                 return err_info;
             }
             SR_CHECK_INT_RET(!match, err_info);
@@ -2609,6 +2966,9 @@ sr_diff_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, cons
             }
             return err_info;
         }
+        if ((op == EDIT_CREATE) && (err_info = sr_edit_idx_add(idx, match))) {
+            return err_info;
+        }
 
         goto next_iter_r;
     }
@@ -2618,7 +2978,7 @@ sr_diff_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, cons
     case EDIT_NONE:
         /* find the node */
         SR_CHECK_INT_RET(!(*first_node), err_info);
-        if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+        if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, idx, &match, NULL))) {
             return err_info;
         }
         SR_CHECK_INT_RET(!match, err_info);
@@ -2652,12 +3012,15 @@ sr_diff_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, cons
             sr_errinfo_new_ly(&err_info, ly_ctx);
             return err_info;
         }
+        if ((err_info = sr_edit_idx_add(idx, match))) {
+            return err_info;
+        }
 
         break;
     case EDIT_DELETE:
         /* find the node */
         SR_CHECK_INT_RET(!(*first_node), err_info);
-        if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+        if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, idx, &match, NULL))) {
             return err_info;
         }
         SR_CHECK_INT_RET(!match, err_info);
@@ -2669,6 +3032,7 @@ sr_diff_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, cons
             *first_node = (*first_node)->next;
         }
         anchor_node = match->parent;
+        sr_edit_idx_del(idx, match);
         lyd_free(match);
 
         /* set empty non-presence container dflt flag */
@@ -2681,7 +3045,7 @@ sr_diff_apply_r(struct lyd_node **first_node, struct lyd_node *parent_node, cons
 
         /* find the node */
         SR_CHECK_INT_RET(!(*first_node), err_info);
-        if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+        if ((err_info = sr_edit_find(*first_node, diff_node, op, 0, NULL, 0, idx, &match, NULL))) {
             return err_info;
         }
         SR_CHECK_INT_RET(!match, err_info);
@@ -2731,12 +3095,13 @@ next_iter_r:
 
     /* apply diff recursively */
     LY_TREE_FOR(sr_lyd_child(diff_node, 1), diff_child) {
-        if ((err_info = sr_diff_apply_r(&match->child, match, diff_child, with_origin))) {
-            return err_info;
+        if ((err_info = sr_diff_apply_r(&match->child, match, diff_child, with_origin, &child_idx))) {
+            break;
         }
     }
 
-    return NULL;
+    sr_edit_idx_clear(&child_idx);
+    return err_info;
 }
 
 sr_error_info_t *
@@ -2744,6 +3109,7 @@ sr_diff_mod_apply(const struct lyd_node *diff, const struct lys_module *ly_mod,
 {
     sr_error_info_t *err_info = NULL;
     const struct lyd_node *root;
+    struct sr_edit_idx_s idx = {0};
 
     LY_TREE_FOR(diff, root) {
         if (lyd_node_module(root) != ly_mod) {
@@ -2752,12 +3118,83 @@ sr_diff_mod_apply(const struct lyd_node *diff, const struct lys_module *ly_mod,
         }
 
         /* apply relevant nodes from the diff datatree */
-        if ((err_info = sr_diff_apply_r(data, NULL, (struct lyd_node *)root, with_origin))) {
-            return err_info;
+        if ((err_info = sr_diff_apply_r(data, NULL, (struct lyd_node *)root, with_origin, &idx))) {
+            break;
         }
     }
 
-    return NULL;
+    sr_edit_idx_clear(&idx);
+    return err_info;
+}
+
+/**
+ * @brief Check whether a created diff subtree is equal to an existing data subtree.
+ *
+ * @param[in] match Existing data node.
+ * @param[in] diff_node Created sysrepo diff node.
+ * @return Whether the subtrees are equal or not.
+ */
+static int
+sr_diff_created_equal(const struct lyd_node *match, const struct lyd_node *diff_node)
+{
+    const struct lyd_node *child;
+    struct lyd_node *child_match;
+    uint32_t diff_count = 0, data_count = 0;
+
+    switch (diff_node->schema->nodetype) {
+    case LYS_LEAF:
+    case LYS_LEAFLIST:
+        return sr_ly_leaf_value_str(match) == sr_ly_leaf_value_str(diff_node);
+    case LYS_CONTAINER:
+    case LYS_LIST:
+        break;
+    default:
+        /* not compared */
+        return 0;
+    }
+
+    /* every created child must exist with the same value */
+    LY_TREE_FOR(diff_node->child, child) {
+        if (child->dflt) {
+            continue;
+        }
+        if (lyd_find_sibling(match->child, child, &child_match) || !child_match
+                || !sr_diff_created_equal(child_match, child)) {
+            return 0;
+        }
+        ++diff_count;
+    }
+
+    /* and there must be no other children */
+    LY_TREE_FOR(match->child, child) {
+        if (!child->dflt) {
+            ++data_count;
+        }
+    }
+    return diff_count == data_count;
+}
+
+/**
+ * @brief Check whether a sysrepo diff subtree creates or replaces any nodes.
+ *
+ * @param[in] diff_node Sysrepo diff node.
+ * @return Whether any node is created or replaced.
+ */
+static int
+sr_diff_has_changes(const struct lyd_node *diff_node)
+{
+    const struct lyd_node *next, *elem;
+    enum edit_op op;
+
+    LY_TREE_DFS_BEGIN(diff_node, next, elem) {
+        op = sr_edit_find_oper(elem, 0, NULL);
+        if ((op == EDIT_CREATE) || (op == EDIT_REPLACE)) {
+            return 1;
+        }
+        LY_TREE_DFS_END(diff_node, next, elem);
+    }
+
+    return 0;
 }
 
 /**
@@ -2765,16 +3202,20 @@ sr_diff_mod_apply(const struct lyd_node *diff, const struct lys_module *ly_mod,
  *
  * @param[in] first_node First sibling of the data tree.
  * @param[in] diff_node Sysrepo diff node.
+ * @param[in] rebase 0 to only update, otherwise also remove created nodes that exist and refresh previous values
+ * of replaced leaves. Removed changes conflicting with the data are logged for 1 and fail the rebase for 2.
  * @param[in,out] diff_root Diff root node.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
-sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node, struct lyd_node **diff_root)
+sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node, int rebase, struct lyd_node **diff_root)
 {
     sr_error_info_t *err_info = NULL;
     enum edit_op op;
     struct lyd_node *match = NULL, *next, *diff_child;
     const char *key_or_value;
+    char *path;
+    int lost = 0;
 
     /* read all the valid attributes */
     if ((err_info = sr_diff_op(diff_node, &op, &key_or_value))) {
@@ -2786,21 +3227,40 @@ sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node,
         assert((op == EDIT_CREATE) || (op == EDIT_REPLACE));
         if (op == EDIT_REPLACE) {
             /* find the node */
-            if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+            if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, NULL, &match, NULL))) {
                 return err_info;
             }
             if (!match) {
                 goto next_iter_r;
             }
+        } else if (rebase) {
+            /* the node must not exist */
+            if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, NULL, &match, NULL))) {
+                return err_info;
+            }
+            if (match) {
+                match = NULL;
+                lost = 1;
+                goto next_iter_r;
+            }
+            if (!key_or_value[0]) {
+                /* inserted first, always possible */
+                return NULL;
+            }
         }
 
-        /* find the anchor */
+        /* find the anchor, the node cannot be placed without it */
+        lost = 1;
         if (key_or_value[0] && first_node) {
             if ((err_info = sr_edit_find_userord_predicate(first_node, diff_node, key_or_value, &match))) {
                 return err_info;
             }
         }
 
+        if (match && rebase && (op == EDIT_CREATE)) {
+            /* keep the whole created subtree */
+            return NULL;
+        }
         goto next_iter_r;
     }
 
@@ -2808,7 +3268,7 @@ sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node,
     switch (op) {
     case EDIT_NONE:
         /* find the node */
-        if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+        if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, NULL, &match, NULL))) {
             return err_info;
         }
 
@@ -2817,14 +3277,30 @@ sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node,
             if (match->dflt == diff_node->dflt) {
                 match = NULL;
             }
+        } else if (!match) {
+            /* the parent of any changes is gone */
+            lost = sr_diff_has_changes(diff_node);
         }
         break;
     case EDIT_CREATE:
+        if (rebase) {
+            /* the node must not exist, unless only as a default node */
+            if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, NULL, &match, NULL))) {
+                return err_info;
+            }
+            if (match && (!match->dflt || diff_node->dflt)) {
+                /* a conflict unless created the same way */
+                lost = !sr_diff_created_equal(match, diff_node);
+                match = NULL;
+                goto next_iter_r;
+            }
+        }
+
         /* nothing to do and do not continue recursively, redundant */
         return NULL;
     case EDIT_DELETE:
         /* find the node */
-        if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+        if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, NULL, &match, NULL))) {
             return err_info;
         }
         break;
@@ -2832,7 +3308,7 @@ sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node,
         SR_CHECK_INT_RET(diff_node->schema->nodetype != LYS_LEAF, err_info);
 
         /* find the node */
-        if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, &match, NULL))) {
+        if ((err_info = sr_edit_find(first_node, diff_node, op, 0, NULL, 0, NULL, &match, NULL))) {
             return err_info;
         }
 
@@ -2841,6 +3317,19 @@ sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node,
             if ((match->dflt == diff_node->dflt) && (sr_ly_leaf_value_str(match) == sr_ly_leaf_value_str(diff_node))) {
                 match = NULL;
             }
+        } else {
+            /* the leaf is gone */
+            lost = 1;
+        }
+        if (match && rebase) {
+            /* the previous value is the current one */
+            sr_edit_del_attr(diff_node, "orig-value");
+            sr_edit_del_attr(diff_node, "orig-dflt");
+            if (!lyd_insert_attr(diff_node, NULL, SR_YANG_MOD ":orig-value", sr_ly_leaf_value_str(match))
+                    || (match->dflt && !lyd_insert_attr(diff_node, NULL, SR_YANG_MOD ":orig-dflt", ""))) {
+                sr_errinfo_new_ly(&err_info, lyd_node_module(diff_node)->ctx);
+                return err_info;
+            }
         }
         break;
     default:
@@ -2850,6 +3339,20 @@ sr_diff_update_r(const struct lyd_node *first_node, struct lyd_node *diff_node,
 
 next_iter_r:
     if (!match) {
+        if (rebase && lost) {
+            /* the change conflicts with the data */
+            path = lyd_path(diff_node);
+            SR_CHECK_MEM_RET(!path, err_info);
+            if (rebase == 2) {
+                sr_errinfo_new(&err_info, SR_ERR_OPERATION_FAILED, path, "Change of \"%s\" conflicts with the current"
+                        " data.", path);
+                free(path);
+                return err_info;
+            }
+            SR_LOG_WRN("Change of \"%s\" conflicts with the current data, it is not applied.", path);
+            free(path);
+        }
+
         /* diff failed to be applied */
         if (diff_node == *diff_root) {
             *diff_root = (*diff_root)->next;
@@ -2877,7 +3380,7 @@ next_iter_r:
 
     /* update diff recursively */
     LY_TREE_FOR_SAFE(sr_lyd_child(diff_node, 1), next, diff_child) {
-        if ((err_info = sr_diff_update_r(match->child, diff_child, diff_root))) {
+        if ((err_info = sr_diff_update_r(match->child, diff_child, rebase, diff_root))) {
             return err_info;
         }
     }
@@ -2905,7 +3408,30 @@ sr_diff_mod_update(struct lyd_node **diff, const struct lys_module *ly_mod, cons
         }
 
         /* update relevant nodes from the diff datatree */
-        if ((err_info = sr_diff_update_r(mod_data, *diff, diff))) {
+        if ((err_info = sr_diff_update_r(mod_data, *diff, 0, diff))) {
+            return err_info;
+        }
+    }
+
+    return NULL;
+}
+
+sr_error_info_t *
+sr_diff_mod_rebase(struct lyd_node **diff, const struct lys_module *ly_mod, const struct lyd_node *mod_data, int strict)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *root, *next;
+
+    assert(diff);
+
+    LY_TREE_FOR_SAFE(*diff, next, root) {
+        if (lyd_node_module(root) != ly_mod) {
+            /* skip data nodes from different modules */
+            continue;
+        }
+
+        /* rebase relevant nodes from the diff datatree */
+        if ((err_info = sr_diff_update_r(mod_data, root, strict ? 2 : 1, diff))) {
             return err_info;
         }
     }
@@ -2981,13 +3507,13 @@ sr_ly_val_diff_merge(struct lyd_node **diff, LYD_DIFFTYPE type, struct lyd_node
                 LY_TREE_DFS_END(tmp, next, elem);
             }
 
-            if ((err_info = sr_diff_merge_r(tmp, EDIT_CREATE, NULL, diff_parent, diff, change))) {
+            if ((err_info = sr_diff_merge_r(tmp, EDIT_CREATE, NULL, diff_parent, diff, NULL, change))) {
                 return err_info;
             }
         }
     } else {
         LY_TREE_FOR(first, tmp) {
-            if ((err_info = sr_diff_merge_r(tmp, EDIT_DELETE, NULL, diff_parent, diff, change))) {
+            if ((err_info = sr_diff_merge_r(tmp, EDIT_DELETE, NULL, diff_parent, diff, NULL, change))) {
                 return err_info;
             }
         }
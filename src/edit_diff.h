@@ -154,6 +154,21 @@ sr_error_info_t *sr_diff_mod_apply(const struct lyd_node *diff, const struct lys
  */
 sr_error_info_t *sr_diff_mod_update(struct lyd_node **diff, const struct lys_module *ly_mod, const struct lyd_node *mod_data);
 
+/**
+ * @brief Rebase sysrepo diff of a specific module on a changed data tree.
+ * Meaning remove diff parts that cannot be applied or were already performed and
+ * update the previous values of replaced leaves. Removed changes that conflict with the data
+ * (were not performed the same way) are logged.
+ *
+ * @param[in,out] diff Diff to rebase, may be partially rebased on error.
+ * @param[in] ly_mod Data tree module.
+ * @param[in] mod_data Data tree to rebase on.
+ * @param[in] strict Whether to fail on the first conflicting change instead of removing it.
+ * @return err_info, NULL on success.
+ */
+sr_error_info_t *sr_diff_mod_rebase(struct lyd_node **diff, const struct lys_module *ly_mod, const struct lyd_node *mod_data,
+        int strict);
+
 /**
  * @brief Merge libyang validation diff into sysrepo diff.
  *
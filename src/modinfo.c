@@ -31,6 +31,51 @@
 
 #include <libyang/libyang.h>
 
+/**
+ * @brief Learn whether a module has any instance-identifier data dependencies.
+ *
+ * @param[in] ext_shm_addr Ext SHM address.
+ * @param[in] shm_mod SHM module.
+ * @return 0 if it has none, non-zero if it has some.
+ */
+static int
+sr_modinfo_mod_has_instid_deps(char *ext_shm_addr, sr_mod_t *shm_mod)
+{
+    sr_mod_data_dep_t *shm_deps;
+    uint16_t i;
+
+    shm_deps = (sr_mod_data_dep_t *)(ext_shm_addr + shm_mod->data_deps);
+    for (i = 0; i < shm_mod->data_dep_count; ++i) {
+        if (shm_deps[i].type == SR_DEP_INSTID) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Learn whether instance-identifiers of a module can reference data of another module.
+ *
+ * @param[in] mod_info Mod info with the datastore.
+ * @param[in] shm_mod SHM module with instance-identifiers.
+ * @param[in] target_mod SHM module that may be referenced.
+ * @return 0 if they cannot, non-zero if they can.
+ */
+static int
+sr_modinfo_instid_may_target(struct sr_mod_info_s *mod_info, sr_mod_t *shm_mod, sr_mod_t *target_mod)
+{
+    uint32_t targets;
+
+    if ((mod_info->ds != SR_DS_RUNNING) && (mod_info->ds != SR_DS_STARTUP)) {
+        /* references are tracked only for the stored valid data */
+        return 1;
+    }
+
+    targets = ATOMIC_LOAD_RELAXED(shm_mod->instid_targets[mod_info->ds]);
+    return (targets >> (SR_SHM_MOD_IDX(target_mod, mod_info->conn->main_shm) % 32)) & 1;
+}
+
 sr_error_info_t *
 sr_modinfo_add_mod(sr_mod_t *shm_mod, const struct lys_module *ly_mod, int mod_type, int mod_req_deps,
         struct sr_mod_info_s *mod_info)
@@ -88,7 +133,7 @@ sr_modinfo_add_mod(sr_mod_t *shm_mod, const struct lys_module *ly_mod, int mod_t
             }
 
             /* find the dependency */
-            dep_mod = sr_shmmain_find_module(&mod_info->conn->main_shm, NULL, NULL, shm_deps[i].module);
+            dep_mod = sr_shmmain_find_module(&mod_info->conn->main_shm, mod_info->conn->ext_shm.addr, NULL, shm_deps[i].module);
             SR_CHECK_INT_RET(!dep_mod, err_info);
 
             /* find ly module */
@@ -116,7 +161,7 @@ sr_modinfo_add_mod(sr_mod_t *shm_mod, const struct lys_module *ly_mod, int mod_t
             SR_CHECK_INT_RET(!ly_mod, err_info);
 
             /* find SHM module */
-            dep_mod = sr_shmmain_find_module(&mod_info->conn->main_shm, NULL, NULL, shm_inv_deps[i]);
+            dep_mod = sr_shmmain_find_module(&mod_info->conn->main_shm, mod_info->conn->ext_shm.addr, NULL, shm_inv_deps[i]);
             SR_CHECK_INT_RET(!dep_mod, err_info);
 
             /* add inverse dependency */
@@ -124,6 +169,23 @@ sr_modinfo_add_mod(sr_mod_t *shm_mod, const struct lys_module *ly_mod, int mod_t
                 return err_info;
             }
          }
+
+        /* instance-identifiers can reference data of any module, so add the modules with them referencing this one */
+        SR_SHM_MOD_FOR(mod_info->conn->main_shm.addr, mod_info->conn->main_shm.size, dep_mod) {
+            if ((dep_mod == shm_mod) || !sr_modinfo_mod_has_instid_deps(mod_info->conn->ext_shm.addr, dep_mod)
+                    || !sr_modinfo_instid_may_target(mod_info, dep_mod, shm_mod)) {
+                continue;
+            }
+
+            ly_mod = ly_ctx_get_module(ly_mod->ctx, mod_info->conn->ext_shm.addr + dep_mod->name, NULL, 1);
+            SR_CHECK_INT_RET(!ly_mod, err_info);
+
+            SR_LOG_DBG("Module \"%s\" with instance-identifiers referencing module \"%s\" added.", ly_mod->name,
+                    mod_info->conn->ext_shm.addr + shm_mod->name);
+            if ((err_info = sr_modinfo_add_mod(dep_mod, ly_mod, MOD_INFO_INV_DEP, mod_req_deps, mod_info))) {
+                return err_info;
+            }
+        }
      }
 
     return NULL;
@@ -395,6 +457,70 @@ sr_modinfo_replace(struct sr_mod_info_s *mod_info, struct lyd_node **src_data)
     return NULL;
 }
 
+sr_error_info_t *
+sr_modinfo_candidate_apply(struct sr_mod_info_s *mod_info, struct lyd_node **cand_diff)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_mod_info_mod_s *mod;
+    struct lyd_node *diff;
+    uint32_t i;
+
+    assert(!mod_info->diff && !mod_info->data_cached);
+
+    for (i = 0; i < mod_info->mod_count; ++i) {
+        mod = &mod_info->mods[i];
+        if (mod->state & MOD_INFO_REQ) {
+            diff = sr_module_data_unlink(cand_diff, mod->ly_mod);
+
+            /* running data may have changed since the candidate changes were stored, they must all still apply */
+            if (diff && (err_info = sr_diff_mod_rebase(&diff, mod->ly_mod, mod_info->data, 1))) {
+                lyd_free_withsiblings(diff);
+                return err_info;
+            }
+            if (!diff) {
+                continue;
+            }
+
+            /* update data */
+            if ((err_info = sr_diff_mod_apply(diff, mod->ly_mod, 0, &mod_info->data))) {
+                lyd_free_withsiblings(diff);
+                return err_info;
+            }
+            mod->state |= MOD_INFO_CHANGED;
+
+            /* the candidate changes are the diff */
+            if (mod_info->diff) {
+                sr_ly_link(mod_info->diff, diff);
+            } else {
+                mod_info->diff = diff;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+sr_error_info_t *
+sr_modinfo_candidate_diff_load(struct sr_mod_info_s *mod_info, struct lyd_node **cand_diff)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_mod_info_mod_s *mod;
+    uint32_t i;
+
+    *cand_diff = NULL;
+    for (i = 0; i < mod_info->mod_count; ++i) {
+        mod = &mod_info->mods[i];
+        if ((mod->state & MOD_INFO_REQ) && (err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_CANDIDATE,
+                cand_diff))) {
+            lyd_free_withsiblings(*cand_diff);
+            *cand_diff = NULL;
+            return err_info;
+        }
+    }
+
+    return NULL;
+}
+
 /**
  * @brief Check whether operational data are required based on a predicate.
  *
@@ -580,6 +706,7 @@ sr_xpath_oper_data_required(const char *request_xpath, const char *sub_xpath)
 /**
  * @brief Get specific operational data from a subscriber.
  *
+ * @param[in] conn Connection to use.
  * @param[in] ly_mod libyang module of the data.
  * @param[in] xpath XPath of the provided data.
  * @param[in] request_xpath XPath of the data request.
@@ -592,8 +719,8 @@ sr_xpath_oper_data_required(const char *request_xpath, const char *sub_xpath)
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
-sr_xpath_oper_data_get(const struct lys_module *ly_mod, const char *xpath, const char *request_xpath, sr_sid_t sid,
-        uint32_t evpipe_num, const struct lyd_node *parent, uint32_t timeout_ms, struct lyd_node **oper_data,
+sr_xpath_oper_data_get(sr_conn_ctx_t *conn, const struct lys_module *ly_mod, const char *xpath, const char *request_xpath,
+        sr_sid_t sid, uint32_t evpipe_num, const struct lyd_node *parent, uint32_t timeout_ms, struct lyd_node **oper_data,
         sr_error_info_t **cb_error_info)
 {
     sr_error_info_t *err_info = NULL;
@@ -625,7 +752,7 @@ sr_xpath_oper_data_get(const struct lys_module *ly_mod, const char *xpath, const
     }
 
     /* get data from client */
-    if ((err_info = sr_shmsub_oper_notify(ly_mod, xpath, request_xpath, parent_dup, sid, evpipe_num, timeout_ms,
+    if ((err_info = sr_shmsub_oper_notify(conn, ly_mod, xpath, request_xpath, parent_dup, sid, evpipe_num, timeout_ms,
             oper_data, cb_error_info))) {
         goto cleanup;
     }
@@ -643,6 +770,7 @@ cleanup:
 /**
  * @brief Append operational data for a specific XPath.
  *
+ * @param[in] conn Connection to use.
  * @param[in] shm_msub SHM subscription.
  * @param[in] ly_mod Module of the data to get.
  * @param[in] sub_xpath Subscription XPath.
@@ -655,15 +783,15 @@ cleanup:
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
-sr_xpath_oper_data_append(sr_mod_oper_sub_t *shm_msub, const struct lys_module *ly_mod, const char *sub_xpath,
-        const char *request_xpath, struct lyd_node *oper_parent, sr_sid_t sid, uint32_t timeout_ms,
+sr_xpath_oper_data_append(sr_conn_ctx_t *conn, sr_mod_oper_sub_t *shm_msub, const struct lys_module *ly_mod,
+        const char *sub_xpath, const char *request_xpath, struct lyd_node *oper_parent, sr_sid_t sid, uint32_t timeout_ms,
         struct lyd_node **data, sr_error_info_t **cb_error_info)
 {
     sr_error_info_t *err_info = NULL;
     struct lyd_node *oper_data;
 
     /* get oper data from the client */
-    if ((err_info = sr_xpath_oper_data_get(ly_mod, sub_xpath, request_xpath, sid, shm_msub->evpipe_num,
+    if ((err_info = sr_xpath_oper_data_get(conn, ly_mod, sub_xpath, request_xpath, sid, shm_msub->evpipe_num,
             oper_parent, timeout_ms, &oper_data, cb_error_info))) {
         return err_info;
     }
@@ -680,13 +808,135 @@ sr_xpath_oper_data_append(sr_mod_oper_sub_t *shm_msub, const struct lys_module *
     return NULL;
 }
 
+/**
+ * @brief Apply stored operational diff of a specific module.
+ *
+ * @param[in] mod Mod info module to process.
+ * @param[in] opts Get oper data options.
+ * @param[in,out] data Operational data tree.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_oper_data_load_stored(struct sr_mod_info_mod_s *mod, sr_get_oper_options_t opts, struct lyd_node **data)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *diff = NULL;
+
+    if ((err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_OPERATIONAL, &diff))) {
+        return err_info;
+    }
+    err_info = sr_diff_mod_apply(diff, mod->ly_mod, opts & SR_OPER_WITH_ORIGIN, data);
+    lyd_free_withsiblings(diff);
+    if (err_info) {
+        return err_info;
+    }
+
+    if (!*data) {
+        /* add possible default state data nodes */
+        lyd_validate_modules(data, &mod->ly_mod, 1, LYD_OPT_DATA | LYD_OPT_TRUSTED);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Load stored candidate diff of a specific module, rebased if running data changed since it was stored.
+ *
+ * @param[in] mod Mod info module to process.
+ * @param[in] ver Module running data version of @p run_data.
+ * @param[in] run_data Running data the diff will be applied on.
+ * @param[out] diff Candidate diff, NULL if there are no candidate changes.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_candidate_diff_load(struct sr_mod_info_mod_s *mod, uint32_t ver, const struct lyd_node *run_data,
+        struct lyd_node **diff)
+{
+    sr_error_info_t *err_info = NULL;
+
+    *diff = NULL;
+    if ((err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_CANDIDATE, diff))) {
+        return err_info;
+    }
+
+    if (*diff && (((uint32_t)ATOMIC_LOAD_RELAXED(mod->shm_mod->cand_ver) != ver) || (mod->shm_mod->ver != ver))) {
+        /* running data moved underneath, skip the changes that no longer apply, they remain stored */
+        if ((err_info = sr_diff_mod_rebase(diff, mod->ly_mod, run_data, 0))) {
+            lyd_free_withsiblings(*diff);
+            *diff = NULL;
+            return err_info;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Store candidate changes of a specific module as a diff against running data.
+ *
+ * @param[in] mod_info Mod info with the new changes.
+ * @param[in] mod Mod info module to process.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_module_candidate_diff_store(struct sr_mod_info_s *mod_info, struct sr_mod_info_mod_s *mod)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *run_data = NULL, *diff = NULL;
+    uint32_t ver;
+    char *path;
+
+    /* load the stored changes */
+    ver = mod->shm_mod->ver;
+    if ((err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_CANDIDATE, &diff))) {
+        goto cleanup;
+    }
+
+    if (diff && ((uint32_t)ATOMIC_LOAD_RELAXED(mod->shm_mod->cand_ver) != ver)) {
+        /* running data moved underneath, rebase the stored changes first, none of them can be lost */
+        if ((err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_RUNNING, &run_data))) {
+            goto cleanup;
+        }
+        if ((err_info = sr_diff_mod_rebase(&diff, mod->ly_mod, run_data, 1))) {
+            goto cleanup;
+        }
+    }
+
+    /* add the new changes */
+    if ((err_info = sr_diff_mod_merge(mod_info->diff, NULL, mod->ly_mod, &diff, NULL))) {
+        goto cleanup;
+    }
+
+    if (diff) {
+        /* store the changes */
+        if ((err_info = sr_module_file_data_set(mod->ly_mod->name, SR_DS_CANDIDATE, diff, O_CREAT, SR_FILE_PERM))) {
+            goto cleanup;
+        }
+    } else {
+        /* candidate data are the same as running data */
+        if ((err_info = sr_path_ds_shm(mod->ly_mod->name, SR_DS_CANDIDATE, 0, &path))) {
+            goto cleanup;
+        }
+        if ((shm_unlink(path) == -1) && (errno != ENOENT)) {
+            SR_LOG_WRN("Failed to unlink \"%s\" (%s).", path, strerror(errno));
+        }
+        free(path);
+    }
+    ATOMIC_STORE_RELAXED(mod->shm_mod->cand_ver, ver);
+
+cleanup:
+    lyd_free_withsiblings(run_data);
+    lyd_free_withsiblings(diff);
+    return err_info;
+}
+
 /**
  * @brief Update (replace or append) operational data for a specific module.
  *
  * @param[in] mod Mod info module to process.
  * @param[in] sid Sysrepo session ID.
  * @param[in] request_xpath XPath of the data request.
- * @param[in] ext_shm_addr Ext SHM address.
+ * @param[in] conn Connection to use.
  * @param[in] timeout_ms Operational callback timeout in milliseconds.
  * @param[in] opts Get oper data options.
  * @param[in,out] data Operational data tree.
@@ -694,33 +944,15 @@ sr_xpath_oper_data_append(sr_mod_oper_sub_t *shm_msub, const struct lys_module *
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
-sr_module_oper_data_update(struct sr_mod_info_mod_s *mod, sr_sid_t *sid, const char *request_xpath, char *ext_shm_addr,
+sr_module_oper_data_update(struct sr_mod_info_mod_s *mod, sr_sid_t *sid, const char *request_xpath, sr_conn_ctx_t *conn,
         uint32_t timeout_ms, sr_get_oper_options_t opts, struct lyd_node **data, sr_error_info_t **cb_error_info)
 {
     sr_error_info_t *err_info = NULL;
     sr_mod_oper_sub_t *shm_msub;
     const char *sub_xpath;
-    char *parent_xpath = NULL;
+    char *parent_xpath = NULL, *ext_shm_addr = conn->ext_shm.addr;
     uint16_t i, j;
     struct ly_set *set = NULL;
-    struct lyd_node *diff = NULL;
-
-    if (!(opts & SR_OPER_NO_STORED)) {
-        /* apply stored operational diff */
-        if ((err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_OPERATIONAL, &diff))) {
-            return err_info;
-        }
-        err_info = sr_diff_mod_apply(diff, mod->ly_mod, opts & SR_OPER_WITH_ORIGIN, data);
-        lyd_free_withsiblings(diff);
-        if (err_info) {
-            return err_info;
-        }
-
-        if (!*data) {
-            /* add possible default state data nodes */
-            lyd_validate_modules(data, &mod->ly_mod, 1, LYD_OPT_DATA | LYD_OPT_TRUSTED);
-        }
-    }
 
     if (opts & SR_OPER_NO_SUBS) {
         /* do not get data from subscribers */
@@ -774,8 +1006,8 @@ sr_module_oper_data_update(struct sr_mod_info_mod_s *mod, sr_sid_t *sid, const c
 
             /* nested data */
             for (j = 0; j < set->number; ++j) {
-                if ((err_info = sr_xpath_oper_data_append(shm_msub, mod->ly_mod, sub_xpath, request_xpath, set->set.d[j],
-                        *sid, timeout_ms, data, cb_error_info))) {
+                if ((err_info = sr_xpath_oper_data_append(conn, shm_msub, mod->ly_mod, sub_xpath, request_xpath,
+                        set->set.d[j], *sid, timeout_ms, data, cb_error_info))) {
                     goto error;
                 }
             }
@@ -787,7 +1019,7 @@ next_iter:
             set = NULL;
         } else {
             /* top-level data */
-            if ((err_info = sr_xpath_oper_data_append(shm_msub, mod->ly_mod, sub_xpath, request_xpath, NULL, *sid,
+            if ((err_info = sr_xpath_oper_data_append(conn, shm_msub, mod->ly_mod, sub_xpath, request_xpath, NULL, *sid,
                     timeout_ms, data, cb_error_info))) {
                 goto error;
             }
@@ -948,23 +1180,77 @@ sr_module_oper_data_dup_enabled(const struct lyd_node *data, char *ext_shm_addr,
     return NULL;
 }
 
+/**
+ * @brief Release a reference of a module cache snapshot, free it if it was the last one.
+ *
+ * @param[in] snap Snapshot to release.
+ */
+static void
+sr_modcache_snap_release(struct sr_mod_cache_snap_s *snap)
+{
+    if (!__atomic_sub_fetch(&snap->refs, 1, __ATOMIC_ACQ_REL)) {
+        lyd_free_withsiblings(snap->data);
+        free(snap);
+    }
+}
+
+/**
+ * @brief Get a reference of the current snapshot of the cached data.
+ * Cache READ lock is held only for the time needed to take the reference.
+ *
+ * @param[in] mod_cache Module cache.
+ * @param[out] snap Referenced snapshot, NULL if there are no cached data.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_modcache_snap_get(struct sr_mod_cache_s *mod_cache, struct sr_mod_cache_snap_s **snap)
+{
+    sr_error_info_t *err_info = NULL;
+
+    /* CACHE READ LOCK */
+    if ((err_info = sr_rwlock(&mod_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
+        return err_info;
+    }
+
+    *snap = mod_cache->snap;
+    if (*snap) {
+        __atomic_add_fetch(&(*snap)->refs, 1, __ATOMIC_RELAXED);
+    }
+
+    /* CACHE READ UNLOCK */
+    sr_rwunlock(&mod_cache->lock, SR_LOCK_READ, __func__);
+
+    return NULL;
+}
+
 /**
  * @brief Update cached running module data (if required).
+ * Cached data being read are never modified. The current snapshot is changed in place only if it is not
+ * referenced by any readers, otherwise it is copied and the changed copy replaces it.
  *
  * @param[in] mod_cache Module cache.
- * @param[in] mod Mod info module to process.
+ * @param[in] mod Mod info module to process, its data cannot change.
  * @param[in] upd_mod_data Optional current (updated) module data to store in cache.
- * @param[in] read_locked Whether the cache is READ locked.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
 sr_modcache_module_running_update(struct sr_mod_cache_s *mod_cache, struct sr_mod_info_mod_s *mod,
-        const struct lyd_node *upd_mod_data, int read_locked)
+        const struct lyd_node *upd_mod_data)
 {
     sr_error_info_t *err_info = NULL;
-    struct lyd_node *mod_data;
-    uint32_t i;
+    struct sr_mod_cache_snap_s *old_snap = NULL, *snap;
+    struct lyd_node *mod_data = NULL;
+    uint32_t i, ver, prev_ver;
     void *mem;
+    int applied = 0;
+
+    /* the data version the cache is updated to */
+    ver = mod->shm_mod->ver;
+
+    /* CACHE READ LOCK */
+    if ((err_info = sr_rwlock(&mod_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
+        return err_info;
+    }
 
     /* find the module in the cache */
     for (i = 0; i < mod_cache->mod_count; ++i) {
@@ -972,81 +1258,237 @@ sr_modcache_module_running_update(struct sr_mod_cache_s *mod_cache, struct sr_mo
             break;
         }
     }
+    if ((i < mod_cache->mod_count) && (mod_cache->mods[i].ver == ver)) {
+        /* cached data are current, CACHE READ UNLOCK */
+        sr_rwunlock(&mod_cache->lock, SR_LOCK_READ, __func__);
+        return NULL;
+    }
 
-    if (i < mod_cache->mod_count) {
-        /* this module data are already in the cache */
-        assert(mod->shm_mod->ver >= mod_cache->mods[i].ver);
-        if (mod->shm_mod->ver > mod_cache->mods[i].ver) {
-            if (read_locked) {
-                /* CACHE READ UNLOCK */
-                sr_rwunlock(&mod_cache->lock, SR_LOCK_READ, __func__);
-            }
+    /* CACHE READ UNLOCK */
+    sr_rwunlock(&mod_cache->lock, SR_LOCK_READ, __func__);
 
-            /* CACHE WRITE LOCK */
-            if ((err_info = sr_rwlock(&mod_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_WRITE, __func__))) {
-                goto error_rlock;
-            }
-
-            /* data needs to be updated, remove old data */
-            lyd_free_withsiblings(sr_module_data_unlink(&mod_cache->data, mod->ly_mod));
-            mod_cache->mods[i].ver = 0;
-        }
-    } else {
-        if (read_locked) {
-            /* CACHE READ UNLOCK */
-            sr_rwunlock(&mod_cache->lock, SR_LOCK_READ, __func__);
-        }
+    /* CACHE WRITE LOCK */
+    if ((err_info = sr_rwlock(&mod_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_WRITE, __func__))) {
+        return err_info;
+    }
 
-        /* CACHE WRITE LOCK */
-        if ((err_info = sr_rwlock(&mod_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_WRITE, __func__))) {
-            goto error_rlock;
+    /* find the module in the cache again, it could have been updated meanwhile */
+    for (i = 0; i < mod_cache->mod_count; ++i) {
+        if (mod->ly_mod == mod_cache->mods[i].ly_mod) {
+            break;
         }
-
+    }
+    if (i == mod_cache->mod_count) {
         /* module is not in cache yet, add an item */
         mem = realloc(mod_cache->mods, (i + 1) * sizeof *mod_cache->mods);
-        SR_CHECK_MEM_RET(!mem, err_info);
+        SR_CHECK_MEM_GOTO(!mem, err_info, cleanup_unlock);
         mod_cache->mods = mem;
         ++mod_cache->mod_count;
 
         mod_cache->mods[i].ly_mod = mod->ly_mod;
         mod_cache->mods[i].ver = 0;
+        mod_cache->mods[i].journal_base = 0;
+        mod_cache->mods[i].journal_off = 0;
+    } else if (mod_cache->mods[i].ver == ver) {
+        /* updated meanwhile */
+        goto cleanup_unlock;
+    }
+
+    /* no new readers can reference the snapshot now, change it in place if there are none */
+    snap = mod_cache->snap;
+    if (!snap || (__atomic_load_n(&snap->refs, __ATOMIC_ACQUIRE) > 1)) {
+        /* it is being read, change its copy */
+        snap = calloc(1, sizeof *snap);
+        SR_CHECK_MEM_GOTO(!snap, err_info, cleanup_unlock);
+        snap->refs = 1;
+        if (mod_cache->snap && mod_cache->snap->data) {
+            snap->data = lyd_dup_withsiblings(mod_cache->snap->data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_WHEN);
+            if (!snap->data) {
+                free(snap);
+                sr_errinfo_new_ly(&err_info, mod->ly_mod->ctx);
+                goto cleanup_unlock;
+            }
+        }
+
+        /* the previous snapshot is released by its last reader */
+        old_snap = mod_cache->snap;
+        mod_cache->snap = snap;
     }
 
-    /* append current data */
-    if (!mod_cache->mods[i].ver) {
-        if (upd_mod_data) {
-            /* current data were provided, use them */
-            mod_data = lyd_dup_withsiblings(upd_mod_data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_WHEN);
-            if (!mod_data) {
+    /* take the module data out of the snapshot, they are not valid until updated */
+    mod_data = sr_module_data_unlink(&snap->data, mod->ly_mod);
+    prev_ver = mod_cache->mods[i].ver;
+    mod_cache->mods[i].ver = 0;
+
+    /* prepare the new data */
+    if (upd_mod_data) {
+        /* current data were provided, use them */
+        lyd_free_withsiblings(mod_data);
+        mod_data = lyd_dup_withsiblings(upd_mod_data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_WHEN);
+        if (!mod_data) {
+            sr_errinfo_new_ly(&err_info, mod->ly_mod->ctx);
+            goto cleanup_unlock;
+        }
+    } else if (prev_ver) {
+        /* try to apply only the changes made since */
+        if ((err_info = sr_module_file_journal_apply(mod->ly_mod, prev_ver, ver, &mod_cache->mods[i].journal_base,
+                &mod_cache->mods[i].journal_off, NULL, &mod_data, &applied))) {
+            goto cleanup_unlock;
+        }
+        if (!applied) {
+            lyd_free_withsiblings(mod_data);
+            mod_data = NULL;
+        }
+    } else {
+        lyd_free_withsiblings(mod_data);
+        mod_data = NULL;
+    }
+    if (!upd_mod_data && !applied) {
+        /* we need to load current data from persistent storage */
+        if ((err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_RUNNING, &mod_data))) {
+            goto cleanup_unlock;
+        }
+    }
+    if (!applied) {
+        /* remember the part of the journal the data include */
+        if ((err_info = sr_module_file_journal_size(mod->ly_mod->name, &mod_cache->mods[i].journal_base,
+                &mod_cache->mods[i].journal_off))) {
+            goto cleanup_unlock;
+        }
+    }
+
+    /* put the module data back */
+    if (snap->data && mod_data) {
+        sr_ly_link(snap->data, mod_data);
+    } else if (mod_data) {
+        snap->data = mod_data;
+    }
+    mod_data = NULL;
+    mod_cache->mods[i].ver = ver;
+
+cleanup_unlock:
+    /* CACHE WRITE UNLOCK */
+    sr_rwunlock(&mod_cache->lock, SR_LOCK_WRITE, __func__);
+
+    if (old_snap) {
+        sr_modcache_snap_release(old_snap);
+    }
+    lyd_free_withsiblings(mod_data);
+    return err_info;
+}
+
+/**
+ * @brief Duplicate merged operational data of a specific module from the operational data cache, if current.
+ *
+ * @param[in] oper_cache Operational data cache.
+ * @param[in] mod Mod info module to process.
+ * @param[in] ver Current module running data version.
+ * @param[in] oper_ver Current module operational data version.
+ * @param[in] opts Get oper data options.
+ * @param[out] mod_data Duplicated module data.
+ * @param[out] cached Set if the module data were found in the cache.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_opercache_module_dup(struct sr_oper_cache_s *oper_cache, struct sr_mod_info_mod_s *mod, uint32_t ver,
+        uint32_t oper_ver, sr_get_oper_options_t opts, struct lyd_node **mod_data, int *cached)
+{
+    sr_error_info_t *err_info = NULL;
+    uint32_t i;
+
+    *mod_data = NULL;
+    *cached = 0;
+
+    /* CACHE READ LOCK */
+    if ((err_info = sr_rwlock(&oper_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
+        return err_info;
+    }
+
+    for (i = 0; i < oper_cache->mod_count; ++i) {
+        if (mod->ly_mod == oper_cache->mods[i].ly_mod) {
+            break;
+        }
+    }
+    if ((i < oper_cache->mod_count) && (oper_cache->mods[i].ver == ver) && (oper_cache->mods[i].oper_ver == oper_ver)
+            && (oper_cache->mods[i].with_origin == ((opts & SR_OPER_WITH_ORIGIN) ? 1 : 0))) {
+        /* cached data are current */
+        if (oper_cache->mods[i].data) {
+            *mod_data = lyd_dup_withsiblings(oper_cache->mods[i].data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_WHEN);
+            if (!*mod_data) {
                 sr_errinfo_new_ly(&err_info, mod->ly_mod->ctx);
-                goto error_wrunlock;
-            }
-            if (mod_cache->data) {
-                sr_ly_link(mod_cache->data, mod_data);
-            } else {
-                mod_cache->data = mod_data;
-            }
-        } else {
-            /* we need to load current data from persistent storage */
-            if ((err_info = sr_module_file_data_append(mod->ly_mod, SR_DS_RUNNING, &mod_cache->data))) {
-                goto error_wrunlock;
+                goto cleanup_rdunlock;
             }
         }
-        mod_cache->mods[i].ver = mod->shm_mod->ver;
+        *cached = 1;
+    }
 
-error_wrunlock:
-        /* CACHE WRITE UNLOCK */
-        sr_rwunlock(&mod_cache->lock, SR_LOCK_WRITE, __func__);
+cleanup_rdunlock:
+    /* CACHE READ UNLOCK */
+    sr_rwunlock(&oper_cache->lock, SR_LOCK_READ, __func__);
+    return err_info;
+}
 
-error_rlock:
-        if (read_locked) {
-            /* CACHE READ LOCK */
-            if ((err_info = sr_rwlock(&mod_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
-                return err_info;
-            }
+/**
+ * @brief Store merged operational data of a specific module in the operational data cache.
+ *
+ * @param[in] oper_cache Operational data cache.
+ * @param[in] mod Mod info module to process.
+ * @param[in] ver Module running data version the data were merged from.
+ * @param[in] oper_ver Module operational data version the data were merged from.
+ * @param[in] opts Get oper data options.
+ * @param[in] data Data with the module data to store.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_opercache_module_update(struct sr_oper_cache_s *oper_cache, struct sr_mod_info_mod_s *mod, uint32_t ver,
+        uint32_t oper_ver, sr_get_oper_options_t opts, const struct lyd_node *data)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *mod_data;
+    uint32_t i;
+    void *mem;
+
+    /* copy the module data outside of the lock */
+    if ((err_info = sr_module_data_dup(data, mod->ly_mod, &mod_data))) {
+        return err_info;
+    }
+
+    /* CACHE WRITE LOCK */
+    if ((err_info = sr_rwlock(&oper_cache->lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_WRITE, __func__))) {
+        lyd_free_withsiblings(mod_data);
+        return err_info;
+    }
+
+    for (i = 0; i < oper_cache->mod_count; ++i) {
+        if (mod->ly_mod == oper_cache->mods[i].ly_mod) {
+            break;
         }
     }
+    if (i == oper_cache->mod_count) {
+        /* module is not in cache yet, add an item */
+        mem = realloc(oper_cache->mods, (i + 1) * sizeof *oper_cache->mods);
+        if (!mem) {
+            lyd_free_withsiblings(mod_data);
+            SR_ERRINFO_MEM(&err_info);
+            goto cleanup_wrunlock;
+        }
+        oper_cache->mods = mem;
+        ++oper_cache->mod_count;
 
+        oper_cache->mods[i].ly_mod = mod->ly_mod;
+        oper_cache->mods[i].data = NULL;
+    }
+
+    /* replace the cached data */
+    lyd_free_withsiblings(oper_cache->mods[i].data);
+    oper_cache->mods[i].data = mod_data;
+    oper_cache->mods[i].ver = ver;
+    oper_cache->mods[i].oper_ver = oper_ver;
+    oper_cache->mods[i].with_origin = (opts & SR_OPER_WITH_ORIGIN) ? 1 : 0;
+
+cleanup_wrunlock:
+    /* CACHE WRITE UNLOCK */
+    sr_rwunlock(&oper_cache->lock, SR_LOCK_WRITE, __func__);
     return err_info;
 }
 
@@ -1369,12 +1811,9 @@ sr_modinfo_module_srmon_connection(sr_main_shm_t *main_shm, char *ext_shm_addr,
 
     /* main-lock */
     if (shm_conn->main_lock.mode) {
-        if (shm_conn->main_lock.mode == SR_LOCK_READ) {
-            sprintf(buf, "read");
-        } else {
-            sprintf(buf, "write");
-        }
-        SR_CHECK_LY_RET(!lyd_new_leaf(sr_conn, NULL, "main-lock", buf), ly_ctx, err_info);
+        /* only WRITE lock is tracked */
+        assert(shm_conn->main_lock.mode == SR_LOCK_WRITE);
+        SR_CHECK_LY_RET(!lyd_new_leaf(sr_conn, NULL, "main-lock", "write"), ly_ctx, err_info);
     }
 
     mod_locks = (sr_conn_shm_lock_t (*)[SR_DS_COUNT])(ext_shm_addr + shm_conn->mod_locks);
@@ -1408,6 +1847,57 @@ sr_modinfo_module_srmon_connection(sr_main_shm_t *main_shm, char *ext_shm_addr,
     return NULL;
 }
 
+/**
+ * @brief Append an "ext-shm" data node with ext SHM allocation statistics to sysrepo-monitoring data.
+ *
+ * @param[in] shm_ext Ext SHM.
+ * @param[in,out] sr_state Main container node of sysrepo-monitoring.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_modinfo_module_srmon_ext_shm(sr_shm_t *shm_ext, struct lyd_node *sr_state)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *sr_ext;
+    sr_ext_shm_t *ext_shm;
+    char buf[22];
+    struct ly_ctx *ly_ctx;
+
+    ly_ctx = lyd_node_module(sr_state)->ctx;
+    ext_shm = (sr_ext_shm_t *)shm_ext->addr;
+
+    if (!ly_ctx_get_node(ly_ctx, NULL, "/sysrepo-monitoring:sysrepo-state/ext-shm", 0)) {
+        /* older revision of the module installed */
+        return NULL;
+    }
+
+    /* ext-shm */
+    sr_ext = lyd_new(sr_state, NULL, "ext-shm");
+    SR_CHECK_LY_RET(!sr_ext, ly_ctx, err_info);
+
+    /* size */
+    sprintf(buf, "%lu", (unsigned long)shm_ext->size);
+    SR_CHECK_LY_RET(!lyd_new_leaf(sr_ext, NULL, "size", buf), ly_ctx, err_info);
+
+    /* wasted */
+    sprintf(buf, "%lu", (unsigned long)ext_shm->wasted);
+    SR_CHECK_LY_RET(!lyd_new_leaf(sr_ext, NULL, "wasted", buf), ly_ctx, err_info);
+
+    /* allocations */
+    sprintf(buf, "%"PRIu32, ext_shm->alloc_count);
+    SR_CHECK_LY_RET(!lyd_new_leaf(sr_ext, NULL, "allocations", buf), ly_ctx, err_info);
+
+    /* reused */
+    sprintf(buf, "%"PRIu32, ext_shm->reuse_count);
+    SR_CHECK_LY_RET(!lyd_new_leaf(sr_ext, NULL, "reused", buf), ly_ctx, err_info);
+
+    /* defragmentations */
+    sprintf(buf, "%"PRIu32, ext_shm->defrag_count);
+    SR_CHECK_LY_RET(!lyd_new_leaf(sr_ext, NULL, "defragmentations", buf), ly_ctx, err_info);
+
+    return NULL;
+}
+
 /**
  * @brief Load module data of the sysrepo-monitoring module. They are actually generated.
  *
@@ -1460,6 +1950,11 @@ sr_modinfo_module_data_load_srmon(struct sr_mod_info_s *mod_info)
         }
     }
 
+    /* ext SHM */
+    if ((err_info = sr_modinfo_module_srmon_ext_shm(&mod_info->conn->ext_shm, mod_data))) {
+        goto cleanup;
+    }
+
     /* connect to the rest of data */
     if (!mod_info->data) {
         mod_info->data = mod_data;
@@ -1494,33 +1989,60 @@ sr_modinfo_module_data_load(struct sr_mod_info_s *mod_info, struct sr_mod_info_m
     sr_error_info_t *err_info = NULL;
     sr_conn_ctx_t *conn = mod_info->conn;
     struct sr_mod_cache_s *mod_cache = NULL;
+    struct sr_oper_cache_s *oper_cache = NULL;
+    struct sr_mod_cache_snap_s *snap;
     struct lyd_node *mod_data;
     sr_datastore_t conf_ds;
+    uint32_t ver = 0, oper_ver = 0;
+    int loaded = 0, oper_cached = 0;
 
     if (((mod_info->ds == SR_DS_RUNNING) || (mod_info->ds == SR_DS_OPERATIONAL)) && (conn->opts & SR_CONN_CACHE_RUNNING)) {
         /* we are caching, so in all cases load the module into cache if not yet there */
         mod_cache = &conn->mod_cache;
-        if ((err_info = sr_modcache_module_running_update(mod_cache, mod, NULL, mod_info->data_cached))) {
+        if ((err_info = sr_modcache_module_running_update(mod_cache, mod, NULL))) {
             return err_info;
         }
     }
 
+    if ((mod_info->ds == SR_DS_OPERATIONAL) && (conn->opts & SR_CONN_CACHE_RUNNING) && !(opts & SR_OPER_NO_STORED)
+            && strcmp(mod->ly_mod->name, "ietf-yang-library") && strcmp(mod->ly_mod->name, "sysrepo-monitoring")) {
+        /* merged operational data can be cached, learn the versions they are merged from */
+        oper_cache = &conn->oper_cache;
+        ver = mod->shm_mod->ver;
+        oper_ver = ATOMIC_LOAD_RELAXED(mod->shm_mod->oper_ver);
+    }
+
     if (!mod_info->data_cached) {
-        if (mod_cache) {
+        if (oper_cache && (err_info = sr_opercache_module_dup(oper_cache, mod, ver, oper_ver, opts, &mod_data,
+                &oper_cached))) {
+            return err_info;
+        }
+
+        if (oper_cached) {
+            /* use the cached enabled running data merged with stored operational data */
+            if (mod_info->data && mod_data) {
+                sr_ly_link(mod_info->data, mod_data);
+            } else if (mod_data) {
+                mod_info->data = mod_data;
+            }
+        } else if (mod_cache) {
             assert((mod_info->ds == SR_DS_RUNNING) || (mod_info->ds == SR_DS_OPERATIONAL));
 
-            /* we are caching, copy module data from the cache and link it */
+            /* we are caching, copy module data from the current cache snapshot and link it */
+            if ((err_info = sr_modcache_snap_get(mod_cache, &snap))) {
+                return err_info;
+            }
+            SR_CHECK_INT_RET(!snap, err_info);
             if (mod_info->ds == SR_DS_OPERATIONAL) {
                 /* copy only enabled module data */
-                if ((err_info = sr_module_oper_data_dup_enabled(mod_cache->data, conn->ext_shm.addr, mod, opts,
-                            &mod_data))) {
-                    return err_info;
-                }
+                err_info = sr_module_oper_data_dup_enabled(snap->data, conn->ext_shm.addr, mod, opts, &mod_data);
             } else {
                 /* copy all module data */
-                if ((err_info = sr_module_data_dup(mod_cache->data, mod->ly_mod, &mod_data))) {
-                    return err_info;
-                }
+                err_info = sr_module_data_dup(snap->data, mod->ly_mod, &mod_data);
+            }
+            sr_modcache_snap_release(snap);
+            if (err_info) {
+                return err_info;
             }
             if (mod_info->data) {
                 sr_ly_link(mod_info->data, mod_data);
@@ -1529,16 +2051,39 @@ sr_modinfo_module_data_load(struct sr_mod_info_s *mod_info, struct sr_mod_info_m
             }
         } else {
             /* get current persistent data */
-            if (mod_info->ds == SR_DS_OPERATIONAL) {
+            if ((mod_info->ds == SR_DS_OPERATIONAL) || ((mod_info->ds == SR_DS_CANDIDATE) && SR_CANDIDATE_DIFF)) {
                 conf_ds = SR_DS_RUNNING;
             } else {
                 conf_ds = mod_info->ds;
             }
-            if ((err_info = sr_module_file_data_append(mod->ly_mod, conf_ds, &mod_info->data))) {
+            if ((mod_info->ds == SR_DS_CANDIDATE) && SR_CANDIDATE_DIFF) {
+                /* remember the running data version before loading them */
+                ver = mod->shm_mod->ver;
+            }
+            if ((mod_info->ds == SR_DS_RUNNING) && request_xpath) {
+                /* try to load only the requested list instance */
+                if ((err_info = sr_module_file_data_append_inst(mod->ly_mod, request_xpath, &mod_info->data, &loaded))) {
+                    return err_info;
+                }
+                if (loaded) {
+                    mod->state |= MOD_INFO_PARTIAL;
+                }
+            }
+            if (!loaded && (err_info = sr_module_file_data_append(mod->ly_mod, conf_ds, &mod_info->data))) {
                 return err_info;
             }
 
-            if (mod_info->ds == SR_DS_OPERATIONAL) {
+            if ((mod_info->ds == SR_DS_CANDIDATE) && SR_CANDIDATE_DIFF) {
+                /* apply the candidate changes on running data */
+                if ((err_info = sr_module_candidate_diff_load(mod, ver, mod_info->data, &mod_data))) {
+                    return err_info;
+                }
+                err_info = sr_diff_mod_apply(mod_data, mod->ly_mod, 0, &mod_info->data);
+                lyd_free_withsiblings(mod_data);
+                if (err_info) {
+                    return err_info;
+                }
+            } else if (mod_info->ds == SR_DS_OPERATIONAL) {
                 /* keep only enabled module data */
                 if ((err_info = sr_module_oper_data_dup_enabled(mod_info->data, conn->ext_shm.addr, mod, opts,
                             &mod_data))) {
@@ -1566,8 +2111,19 @@ sr_modinfo_module_data_load(struct sr_mod_info_s *mod_info, struct sr_mod_info_m
                 }
             }
 
+            if (!oper_cached && !(opts & SR_OPER_NO_STORED)) {
+                /* apply stored operational diff */
+                if ((err_info = sr_module_oper_data_load_stored(mod, opts, &mod_info->data))) {
+                    return err_info;
+                }
+                if (oper_cache && (err_info = sr_opercache_module_update(oper_cache, mod, ver, oper_ver, opts,
+                        mod_info->data))) {
+                    return err_info;
+                }
+            }
+
             /* append any operational data provided by clients */
-            if ((err_info = sr_module_oper_data_update(mod, sid, request_xpath, conn->ext_shm.addr,
+            if ((err_info = sr_module_oper_data_update(mod, sid, request_xpath, conn,
                         timeout_ms, opts, &mod_info->data, cb_error_info))) {
                 return err_info;
             }
@@ -1576,10 +2132,8 @@ sr_modinfo_module_data_load(struct sr_mod_info_s *mod_info, struct sr_mod_info_m
             sr_oper_data_trim_r(&mod_info->data, mod_info->data, opts);
         }
     } else {
+        /* cached data snapshot is used once all the modules are up-to-date */
         assert(mod_cache && SR_IS_CONVENTIONAL_DS(mod_info->ds));
-
-        /* just use cached data */
-        mod_info->data = mod_cache->data;
     }
 
     return NULL;
@@ -1650,7 +2204,7 @@ sr_modinfo_add_instid_deps_data(struct sr_mod_info_s *mod_info, sr_mod_data_dep_
                 }
             } else if (shm_deps[i].module) {
                 /* assume a default value will be used even though it may not be */
-                dep_mod = sr_shmmain_find_module(&conn->main_shm, NULL, NULL, shm_deps[i].module);
+                dep_mod = sr_shmmain_find_module(&conn->main_shm, conn->ext_shm.addr, NULL, shm_deps[i].module);
                 SR_CHECK_INT_GOTO(!dep_mod, err_info, cleanup);
 
                 if (ly_set_add(dep_set, (void *)dep_mod, 0) == -1) {
@@ -1731,6 +2285,69 @@ sr_modinfo_ly_val_diff_merge(struct sr_mod_info_s *mod_info, struct lyd_difflist
     return NULL;
 }
 
+/**
+ * @brief Learn whether a module needs to be validated based on the changes of the modules.
+ * Stored data of running and startup are always valid so only modules whose data were changed
+ * or that reference changed data of other modules need to be revalidated. Instance-identifiers can
+ * reference data of any module so modules with them are revalidated on a change of any module they point to.
+ *
+ * @param[in] mod_info Mod info to use.
+ * @param[in] mod Mod info module to examine.
+ * @return 0 if the module data are valid, non-zero if they must be validated.
+ */
+static int
+sr_modinfo_mod_needs_validation(struct sr_mod_info_s *mod_info, struct sr_mod_info_mod_s *mod)
+{
+    sr_mod_data_dep_t *shm_deps;
+    uint32_t i, j;
+
+    switch (mod->state & MOD_INFO_TYPE_MASK) {
+    case MOD_INFO_REQ:
+    case MOD_INFO_INV_DEP:
+        break;
+    default:
+        /* never validated */
+        return 0;
+    }
+
+    if ((mod_info->ds != SR_DS_RUNNING) && (mod_info->ds != SR_DS_STARTUP)) {
+        /* stored data are not guaranteed to be valid */
+        return 1;
+    }
+    if (mod_info->conn->opts & SR_CONN_FULL_VALIDATION) {
+        /* always validate all the modules */
+        return 1;
+    }
+
+    if (mod->state & MOD_INFO_CHANGED) {
+        /* module data changed */
+        return 1;
+    }
+
+    /* check whether any referenced module data changed */
+    shm_deps = (sr_mod_data_dep_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->data_deps);
+    for (i = 0; i < mod->shm_mod->data_dep_count; ++i) {
+        if (shm_deps[i].type == SR_DEP_INSTID) {
+            /* instance-identifiers can reference data of any module they currently point to */
+            for (j = 0; j < mod_info->mod_count; ++j) {
+                if ((mod_info->mods[j].state & MOD_INFO_CHANGED)
+                        && sr_modinfo_instid_may_target(mod_info, mod->shm_mod, mod_info->mods[j].shm_mod)) {
+                    return 1;
+                }
+            }
+            continue;
+        }
+
+        for (j = 0; j < mod_info->mod_count; ++j) {
+            if ((mod_info->mods[j].shm_mod->name == shm_deps[i].module) && (mod_info->mods[j].state & MOD_INFO_CHANGED)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
 sr_error_info_t *
 sr_modinfo_validate(struct sr_mod_info_s *mod_info, int finish_diff, sr_sid_t *sid, sr_error_info_t **cb_error_info)
 {
@@ -1738,7 +2355,7 @@ sr_modinfo_validate(struct sr_mod_info_s *mod_info, int finish_diff, sr_sid_t *s
     struct sr_mod_info_mod_s *mod;
     struct lyd_difflist *diff = NULL;
     const struct lys_module **valid_mods = NULL;
-    uint32_t i, j, valid_mod_count = 0;
+    uint32_t i, valid_mod_count = 0;
     int flags;
 
     assert(SR_IS_CONVENTIONAL_DS(mod_info->ds) || (sid && cb_error_info));
@@ -1748,11 +2365,10 @@ sr_modinfo_validate(struct sr_mod_info_s *mod_info, int finish_diff, sr_sid_t *s
         mod = &mod_info->mods[i];
         switch (mod->state & MOD_INFO_TYPE_MASK) {
         case MOD_INFO_REQ:
-            /* this module will be validated */
-            ++valid_mod_count;
-
-            if (mod->state & MOD_INFO_CHANGED) {
-                /* check all instids and add their target modules as deps, other inst-ids do not need to be revalidated */
+        case MOD_INFO_INV_DEP:
+            if (sr_modinfo_mod_needs_validation(mod_info, mod)) {
+                /* check all instids and add their target modules as deps, inst-ids of modules that will not be
+                 * validated do not need to be revalidated */
                 if ((err_info = sr_modinfo_add_instid_deps_data(mod_info,
                         (sr_mod_data_dep_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->data_deps),
                         mod->shm_mod->data_dep_count, mod_info->data, sid, 0, cb_error_info))) {
@@ -1760,42 +2376,36 @@ sr_modinfo_validate(struct sr_mod_info_s *mod_info, int finish_diff, sr_sid_t *s
                 }
             }
             break;
-        case MOD_INFO_INV_DEP:
-            /* this module reference targets could have been changed, needs to be validated */
-            ++valid_mod_count;
-            /* fallthrough */
         case MOD_INFO_DEP:
-            /* this module will not be validated */
             break;
         default:
             SR_CHECK_INT_GOTO(0, err_info, cleanup);
         }
     }
 
-    /* create an array of all the modules that will be validated */
-    valid_mods = malloc(valid_mod_count * sizeof *valid_mods);
+    /* create an array of all the modules that will be validated, only the affected ones (the module itself or
+     * its reference targets could have been changed) */
+    valid_mods = malloc(mod_info->mod_count * sizeof *valid_mods);
     SR_CHECK_MEM_GOTO(!valid_mods, err_info, cleanup);
-    for (i = 0, j = 0; i < mod_info->mod_count; ++i) {
+    for (i = 0; i < mod_info->mod_count; ++i) {
         mod = &mod_info->mods[i];
-        switch (mod->state & MOD_INFO_TYPE_MASK) {
-        case MOD_INFO_REQ:
-        case MOD_INFO_INV_DEP:
-            valid_mods[j] = mod->ly_mod;
-            ++j;
-            break;
-        case MOD_INFO_DEP:
-            /* is not validated */
-            break;
+        if (sr_modinfo_mod_needs_validation(mod_info, mod)) {
+            valid_mods[valid_mod_count] = mod->ly_mod;
+            ++valid_mod_count;
         }
     }
-    assert(j == valid_mod_count);
+    if (!valid_mod_count) {
+        /* all the data are valid */
+        goto cleanup;
+    }
 
-    /* validate */
     if (SR_IS_CONVENTIONAL_DS(mod_info->ds)) {
         flags = LYD_OPT_CONFIG | LYD_OPT_WHENAUTODEL | LYD_OPT_VAL_DIFF;
     } else {
         flags = LYD_OPT_DATA | LYD_OPT_WHENAUTODEL | LYD_OPT_VAL_DIFF;
     }
+
+    /* validate */
     if (lyd_validate_modules(&mod_info->data, valid_mods, valid_mod_count, flags, &diff)) {
         sr_errinfo_new_ly(&err_info, mod_info->conn->ly_ctx);
         SR_ERRINFO_VALID(&err_info);
@@ -1953,16 +2563,12 @@ sr_modinfo_data_load(struct sr_mod_info_s *mod_info, uint8_t mod_type, int cache
 {
     sr_error_info_t *err_info = NULL;
     struct sr_mod_info_mod_s *mod;
+    struct sr_mod_cache_snap_s *snap;
     uint32_t i;
 
     assert(!mod_info->data);
 
     if (cache && (mod_info->conn->opts & SR_CONN_CACHE_RUNNING) && (mod_info->ds == SR_DS_RUNNING)) {
-        /* CACHE READ LOCK */
-        if ((err_info = sr_rwlock(&mod_info->conn->mod_cache.lock, SR_MOD_CACHE_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
-            return err_info;
-        }
-
         /* we can cache the data */
         mod_info->data_cached = 1;
     }
@@ -1972,12 +2578,21 @@ sr_modinfo_data_load(struct sr_mod_info_s *mod_info, uint8_t mod_type, int cache
         mod = &mod_info->mods[i];
         if (mod->state & mod_type) {
             if ((err_info = sr_modinfo_module_data_load(mod_info, mod, sid, request_xpath, timeout_ms, opts, cb_error_info))) {
-                /* if cached, we keep both cache lock and flag, so it is fine */
+                /* if cached, we keep the flag, so it is fine */
                 return err_info;
             }
         }
     }
 
+    if (mod_info->data_cached) {
+        /* use the current cache snapshot, it is never modified and the data of the modules cannot change */
+        if ((err_info = sr_modcache_snap_get(&mod_info->conn->mod_cache, &snap))) {
+            return err_info;
+        }
+        mod_info->data_snap = snap;
+        mod_info->data = snap ? snap->data : NULL;
+    }
+
     return NULL;
 }
 
@@ -1986,7 +2601,7 @@ sr_modinfo_get_filter(struct sr_mod_info_s *mod_info, const char *xpath, sr_sess
 {
     sr_error_info_t *err_info = NULL;
     struct sr_mod_info_mod_s *mod;
-    struct lyd_node *edit, *diff;
+    struct lyd_node *edit, *diff, *data;
     uint32_t i;
 
     *result = NULL;
@@ -2024,11 +2639,30 @@ sr_modinfo_get_filter(struct sr_mod_info_s *mod_info, const char *xpath, sr_sess
 
             if (mod_info->data_cached && (session->ds == SR_DS_RUNNING) && (edit || diff)) {
                 /* data will be changed, we cannot use the cache anymore */
-                mod_info->data = lyd_dup_withsiblings(mod_info->data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_WHEN);
+                if (mod_info->data) {
+                    data = lyd_dup_withsiblings(mod_info->data, LYD_DUP_OPT_RECURSIVE | LYD_DUP_OPT_WITH_WHEN);
+                    if (!data) {
+                        sr_errinfo_new_ly(&err_info, mod_info->conn->ly_ctx);
+                        goto cleanup;
+                    }
+                    mod_info->data = data;
+                }
                 mod_info->data_cached = 0;
 
-                /* CACHE READ UNLOCK */
-                sr_rwunlock(&mod_info->conn->mod_cache.lock, SR_LOCK_READ, __func__);
+                /* release the snapshot */
+                if (mod_info->data_snap) {
+                    sr_modcache_snap_release(mod_info->data_snap);
+                    mod_info->data_snap = NULL;
+                }
+            }
+
+            if ((mod->state & MOD_INFO_PARTIAL) && (edit || diff)) {
+                /* changes may depend on any other module data, load them all */
+                lyd_free_withsiblings(sr_module_data_unlink(&mod_info->data, mod->ly_mod));
+                if ((err_info = sr_module_file_data_append(mod->ly_mod, mod_info->ds, &mod_info->data))) {
+                    goto cleanup;
+                }
+                mod->state &= ~MOD_INFO_PARTIAL;
             }
 
             /* apply any currently handled changes (diff) or additional performed ones (edit) to get
@@ -2222,8 +2856,8 @@ sr_modinfo_generate_config_change_notif(struct sr_mod_info_s *mod_info, sr_sessi
     tmp_err_info = sr_replay_store(session, notif, notif_ts);
 
     /* send the notification (non-validated, if everything works correctly it must be valid) */
-    if (notif_sub_count && (err_info = sr_shmsub_notif_notify(notif, notif_ts, session->sid, (uint32_t *)notif_subs,
-            notif_sub_count))) {
+    if (notif_sub_count && (err_info = sr_shmsub_notif_notify(session->conn, notif, notif_ts, session->sid,
+            (uint32_t *)notif_subs, notif_sub_count))) {
         goto cleanup;
     }
 
@@ -2243,22 +2877,82 @@ cleanup:
     return err_info;
 }
 
+/**
+ * @brief Remember the modules referenced by the instance-identifiers of a module in the stored data.
+ *
+ * @param[in] mod_info Mod info with the data to be stored.
+ * @param[in] mod Mod info module with instance-identifiers.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_modinfo_instid_targets_update(struct sr_mod_info_s *mod_info, struct sr_mod_info_mod_s *mod)
+{
+    sr_error_info_t *err_info = NULL;
+    sr_conn_ctx_t *conn = mod_info->conn;
+    sr_mod_data_dep_t *shm_deps;
+    sr_mod_t *dep_mod;
+    struct ly_set *set = NULL;
+    char *mod_name;
+    uint32_t i, j, targets = 0;
+
+    shm_deps = (sr_mod_data_dep_t *)(conn->ext_shm.addr + mod->shm_mod->data_deps);
+    for (i = 0; i < mod->shm_mod->data_dep_count; ++i) {
+        if (shm_deps[i].type != SR_DEP_INSTID) {
+            continue;
+        }
+
+        if (shm_deps[i].module) {
+            /* a default value may be used */
+            dep_mod = sr_shmmain_find_module(&conn->main_shm, conn->ext_shm.addr, NULL, shm_deps[i].module);
+            SR_CHECK_INT_GOTO(!dep_mod, err_info, cleanup);
+            targets |= (uint32_t)1 << (SR_SHM_MOD_IDX(dep_mod, conn->main_shm) % 32);
+        }
+        if (!mod_info->data) {
+            continue;
+        }
+
+        set = lyd_find_path(mod_info->data, conn->ext_shm.addr + shm_deps[i].xpath);
+        if (!set) {
+            sr_errinfo_new_ly(&err_info, conn->ly_ctx);
+            goto cleanup;
+        }
+        for (j = 0; j < set->number; ++j) {
+            mod_name = sr_get_first_ns(sr_ly_leaf_value_str(set->set.d[j]));
+            dep_mod = sr_shmmain_find_module(&conn->main_shm, conn->ext_shm.addr, mod_name, 0);
+            free(mod_name);
+            SR_CHECK_INT_GOTO(!dep_mod, err_info, cleanup);
+            targets |= (uint32_t)1 << (SR_SHM_MOD_IDX(dep_mod, conn->main_shm) % 32);
+        }
+        ly_set_free(set);
+        set = NULL;
+    }
+
+cleanup:
+    ly_set_free(set);
+    if (err_info) {
+        /* not known */
+        targets = UINT32_MAX;
+    }
+    ATOMIC_STORE_RELAXED(mod->shm_mod->instid_targets[mod_info->ds], targets);
+    return err_info;
+}
+
 sr_error_info_t *
 sr_modinfo_data_store(struct sr_mod_info_s *mod_info)
 {
     sr_error_info_t *err_info = NULL, *tmp_err_info = NULL;
     struct sr_mod_info_mod_s *mod;
     struct lyd_node *mod_data, *diff = NULL;
-    uint32_t i;
-    int change, create_flags;
+    const char **startup_mods = NULL;
+    uint32_t i, startup_count = 0;
+    int change, compact;
 
     assert(!mod_info->data_cached);
 
-    /* candidate file may need to be created */
-    if (mod_info->ds == SR_DS_CANDIDATE) {
-        create_flags = O_CREAT;
-    } else {
-        create_flags = 0;
+    if (mod_info->ds == SR_DS_STARTUP) {
+        /* startup files are all replaced at once */
+        startup_mods = malloc(mod_info->mod_count * sizeof *startup_mods);
+        SR_CHECK_MEM_RET(!startup_mods, err_info);
     }
 
     for (i = 0; i < mod_info->mod_count; ++i) {
@@ -2274,18 +2968,56 @@ sr_modinfo_data_store(struct sr_mod_info_s *mod_info)
                 }
 
                 /* store the new diff */
-                if (change && (err_info = sr_module_file_data_set(mod->ly_mod->name, SR_DS_OPERATIONAL, diff, 0, 0))) {
-                    goto cleanup;
+                if (change) {
+                    if ((err_info = sr_module_file_data_set(mod->ly_mod->name, SR_DS_OPERATIONAL, diff, 0, 0))) {
+                        goto cleanup;
+                    }
+
+                    /* update module operational data version */
+                    ATOMIC_INC_RELAXED(mod->shm_mod->oper_ver);
                 }
                 lyd_free_withsiblings(diff);
                 diff = NULL;
             } else {
+                if (((mod_info->ds == SR_DS_RUNNING) || (mod_info->ds == SR_DS_STARTUP))
+                        && sr_modinfo_mod_has_instid_deps(mod_info->conn->ext_shm.addr, mod->shm_mod)
+                        && (err_info = sr_modinfo_instid_targets_update(mod_info, mod))) {
+                    goto cleanup;
+                }
+
                 /* separate data of this module */
                 mod_data = sr_module_data_unlink(&mod_info->data, mod->ly_mod);
 
-                /* store the new data */
-                if ((err_info = sr_module_file_data_set(mod->ly_mod->name, mod_info->ds, mod_data, create_flags, SR_FILE_PERM))) {
-                    goto cleanup;
+                if (mod_info->ds == SR_DS_STARTUP) {
+                    /* write the new data, they are committed with all the other modules */
+                    if ((err_info = sr_module_file_startup_write(mod->ly_mod->name, mod_data, 0, SR_FILE_PERM))) {
+                        goto cleanup;
+                    }
+                    startup_mods[startup_count++] = mod->ly_mod->name;
+                } else if ((mod_info->ds == SR_DS_CANDIDATE) && SR_CANDIDATE_DIFF) {
+                    /* store only the changes against running data */
+                    if ((err_info = sr_module_candidate_diff_store(mod_info, mod))) {
+                        goto cleanup;
+                    }
+                } else if (mod_info->ds == SR_DS_CANDIDATE) {
+                    /* store the new data, the file may need to be created */
+                    if ((err_info = sr_module_file_data_set(mod->ly_mod->name, SR_DS_CANDIDATE, mod_data, O_CREAT,
+                            SR_FILE_PERM))) {
+                        goto cleanup;
+                    }
+                } else {
+                    /* append the module diff into the running journal */
+                    compact = 1;
+                    if ((err_info = sr_module_file_journal_append(mod->ly_mod, mod_info->diff, mod->shm_mod->ver + 1,
+                            &compact))) {
+                        goto cleanup;
+                    }
+
+                    /* store the new data only once their journal grew too large */
+                    if (compact && (err_info = sr_module_file_data_set(mod->ly_mod->name, mod_info->ds, mod_data,
+                            0, SR_FILE_PERM))) {
+                        goto cleanup;
+                    }
                 }
 
                 if (mod_info->ds == SR_DS_RUNNING) {
@@ -2294,7 +3026,7 @@ sr_modinfo_data_store(struct sr_mod_info_s *mod_info)
 
                     if (mod_info->conn->opts & SR_CONN_CACHE_RUNNING) {
                         /* we are caching so update cache with these data */
-                        tmp_err_info = sr_modcache_module_running_update(&mod_info->conn->mod_cache, mod, mod_data, 0);
+                        tmp_err_info = sr_modcache_module_running_update(&mod_info->conn->mod_cache, mod, mod_data);
                         if (tmp_err_info) {
                             /* always store all changed modules, if possible */
                             sr_errinfo_merge(&err_info, tmp_err_info);
@@ -2331,11 +3063,22 @@ sr_modinfo_data_store(struct sr_mod_info_s *mod_info)
         }
     }
 
+    if (startup_count) {
+        /* replace all the written startup files */
+        err_info = sr_module_file_startup_commit(startup_mods, startup_count);
+        startup_count = 0;
+    }
+
 cleanup:
+    if (startup_count) {
+        /* some startup files were not written, none are committed */
+        sr_module_file_startup_abort(startup_mods, startup_count);
+    }
     if (tmp_err_info) {
         sr_errinfo_merge(&err_info, tmp_err_info);
     }
     lyd_free_withsiblings(diff);
+    free(startup_mods);
     return err_info;
 
 }
@@ -2373,8 +3116,11 @@ sr_modinfo_free(struct sr_mod_info_s *mod_info)
     if (mod_info->data_cached) {
         mod_info->data_cached = 0;
 
-        /* CACHE READ UNLOCK */
-        sr_rwunlock(&mod_info->conn->mod_cache.lock, SR_LOCK_READ, __func__);
+        /* release the snapshot */
+        if (mod_info->data_snap) {
+            sr_modcache_snap_release(mod_info->data_snap);
+            mod_info->data_snap = NULL;
+        }
     } else {
         lyd_free_withsiblings(mod_info->data);
     }
@@ -35,6 +35,7 @@
 #define MOD_INFO_WLOCK   0x10   /* write-locked module (main DS) */
 #define MOD_INFO_RLOCK2  0x20   /* read-locked module (secondary DS, it can be only read locked) */
 #define MOD_INFO_CHANGED 0x40   /* module data were changed */
+#define MOD_INFO_PARTIAL 0x80   /* only the data of the requested list instance were loaded */
 
 /**
  * @brief Mod info structure, used for keeping all relevant modules for a data operation.
@@ -44,7 +45,8 @@ struct sr_mod_info_s {
     sr_datastore_t ds2;         /**< Secondary datastore valid only if differs from the main one. Used only for locking. */
     struct lyd_node *diff;      /**< Diff with previous data. */
     struct lyd_node *data;      /**< Data tree. */
-    int data_cached;            /**< Whether the data are actually in cache (conn cache READ lock is held). */
+    int data_cached;            /**< Whether the data are actually in cache (@p data_snap is referenced). */
+    struct sr_mod_cache_snap_s *data_snap;  /**< Referenced cache snapshot with the data, if cached. */
     sr_conn_ctx_t *conn;        /**< Associated connection. */
 
     struct sr_mod_info_mod_s {
@@ -53,6 +55,8 @@ struct sr_mod_info_s {
         const struct lys_module *ly_mod;    /**< Module libyang structure. */
 
         uint32_t request_id;    /**< Request ID of the published event. */
+        int change_published;   /**< Whether "change" event was published for this module, which then needs "abort"
+                                     on failure (with concurrent change events). */
     } *mods;                    /**< Relevant modules. */
     uint32_t mod_count;         /**< Modules count. */
 };
@@ -121,7 +125,26 @@ sr_error_info_t *sr_modinfo_diff_merge(struct sr_mod_info_s *mod_info, const str
 sr_error_info_t *sr_modinfo_replace(struct sr_mod_info_s *mod_info, struct lyd_node **src_data);
 
 /**
- * @brief Validate data for modules in mod info.
+ * @brief Apply stored candidate changes on the current mod info data and use them as the diff.
+ *
+ * @param[in] mod_info Mod info to use.
+ * @param[in,out] cand_diff Candidate diff of the modules, applied parts are spent.
+ * @return err_info, NULL on success.
+ */
+sr_error_info_t *sr_modinfo_candidate_apply(struct sr_mod_info_s *mod_info, struct lyd_node **cand_diff);
+
+/**
+ * @brief Load stored candidate changes of all the required modules.
+ *
+ * @param[in] mod_info Mod info to use.
+ * @param[out] cand_diff Candidate diff of the modules, NULL if there are no changes.
+ * @return err_info, NULL on success.
+ */
+sr_error_info_t *sr_modinfo_candidate_diff_load(struct sr_mod_info_s *mod_info, struct lyd_node **cand_diff);
+
+/**
+ * @brief Validate data for modules in mod info. For running and startup, only the modules
+ * whose data were changed or that reference changed data are validated unless ::SR_CONN_FULL_VALIDATION is used.
  *
  * @param[in] mod_info Mod info to use.
  * @param[in] finish_diff Whether to update diff with possible changes caused by validation.
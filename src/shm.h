@@ -33,7 +33,9 @@
 #define SR_MAIN_SHM "/sr_main"              /**< Main SHM name. */
 #define SR_EXT_SHM "/sr_ext"                /**< External SHM name. */
 #define SR_MAIN_SHM_LOCK "sr_main_lock"     /**< Main SHM file lock name. */
-#define SR_SHM_VER 1                        /**< Main and ext SHM version of their expected content structures. */
+#define SR_SHM_VER 8                        /**< Main and ext SHM version of their expected content structures. */
+#define SR_SHM_HASH_MIN_SIZE 8              /**< Minimal number of buckets of main SHM hash tables. */
+#define SR_EXT_SHM_FREE_LISTS 32            /**< Number of ext SHM free lists (chunk size classes). */
 
 /**
  * Main SHM organization
@@ -47,14 +49,35 @@
  * modules, each with a ::sr_mod_t structure until the end of main SHM. All `off_t`
  * types in these structures are offset pointers to ext SHM.
  *
- * Ext shm starts with a `size_t` value representing the number of wasted
- * bytes in this SHM segment. It is followed by arrays and strings pointed to
+ * Ext shm starts with ::sr_ext_shm_t header with the number of wasted bytes in this SHM segment
+ * and free lists of the unused chunks that are reused by new allocations. It is followed by arrays and strings pointed to
  * by main SHM `off_t` pointers. First, there is the sysrepo connections state ::sr_conn_shm_t
  * meaning all currently running connections. Then, there is information from ::sr_mod_t
  * which includes names, dependencies, and subscriptions. Lastly, there are RPCs ::sr_rpc_t.
  * Also, any pointers in all the previous structures point, again, into ext SHM.
  */
 
+/**
+ * @brief Ext SHM free chunk, stored in the unused memory itself.
+ */
+typedef struct sr_ext_shm_free_s {
+    off_t next;                 /**< Next free chunk in the same free list, 0 if the last one. */
+    size_t size;                /**< Size of the chunk, set only for the chunks in the last (large chunk) free list. */
+} sr_ext_shm_free_t;
+
+/**
+ * @brief Ext SHM header.
+ */
+typedef struct sr_ext_shm_s {
+    size_t wasted;              /**< Number of unused bytes in ext SHM, includes all the chunks in free lists. */
+    off_t free_lists[SR_EXT_SHM_FREE_LISTS]; /**< Free lists of unused chunks, list i holds chunks of
+                                     (i + 1) * SR_SHM_MEM_ALIGN bytes, the last one all the larger chunks. */
+
+    uint32_t alloc_count;       /**< Number of allocations, statistics. */
+    uint32_t reuse_count;       /**< Number of allocations that reused a free chunk, statistics. */
+    uint32_t defrag_count;      /**< Number of defragmentations, statistics. */
+} sr_ext_shm_t;
+
 /**
  * @brief Ext SHM module dependency type.
  */
@@ -138,6 +161,12 @@ struct sr_mod_s {
     } data_lock_info[SR_DS_COUNT]; /**< Module data lock information for each datastore. */
     sr_rwlock_t replay_lock;    /**< Process-shared lock for accessing stored notifications for replay. */
     uint32_t ver;               /**< Module data version (non-zero). */
+    ATOMIC_T oper_ver;          /**< Module operational data version (non-zero), changed with stored operational data
+                                     and running change subscriptions. */
+    ATOMIC_T cand_ver;          /**< Module data version the stored candidate changes are based on (0 if unknown). */
+    ATOMIC_T instid_targets[SR_DS_COUNT];   /**< Modules referenced by the instance-identifiers in the stored data
+                                                 for each datastore, bit of the module index modulo 32 (all set if
+                                                 not known). */
 
     off_t name;                 /**< Module name. */
     char rev[11];               /**< Module revision. */
@@ -207,7 +236,7 @@ typedef struct sr_conn_shm_s {
     sr_conn_ctx_t *conn_ctx;    /**< Connection, process-specific pointer, do not access! */
     pid_t pid;                  /**< PID of process that created this connection. */
 
-    sr_conn_shm_lock_t main_lock; /**< Held main SHM lock. */
+    sr_conn_shm_lock_t main_lock; /**< Held main SHM WRITE lock, READ locks are not tracked. */
     off_t mod_locks;            /**< Held SHM module locks, points to (sr_conn_state_lock_t (*)[SR_DS_COUNT]). */
 
     off_t evpipes;              /**< Array of event pipe numbers (uint32_t) of subscriptions on this connection. */
@@ -224,12 +253,20 @@ typedef struct sr_main_shm_s {
                                      accessing attributes that can be changed (subscriptions, replay support). */
     pthread_mutex_t lydmods_lock; /**< Process-shared lock for accessing sysrepo module data. */
     uint32_t mod_count;         /**< Number of installed modules stored after this structure. */
+    off_t mod_hash;             /**< Hash table of modules (uint32_t module index + 1, 0 for an empty bucket)
+                                     with module name hash keys and linear probing. */
+    uint32_t mod_hash_size;     /**< Number of module hash table buckets, power of 2. */
 
     off_t rpc_subs;             /**< Array of RPC/action subscriptions. */
     uint16_t rpc_sub_count;     /**< Number of RPC/action subscriptions. */
+    off_t rpc_hash;             /**< Hash table of RPC/action subscriptions (uint32_t RPC index + 1, 0 for an empty
+                                     bucket) with operation path hash keys and linear probing. */
+    uint32_t rpc_hash_size;     /**< Number of RPC/action hash table buckets, power of 2. */
 
     ATOMIC_T new_sr_sid;        /**< SID for a new session. */
     ATOMIC_T new_evpipe_num;    /**< Event pipe number for a new subscription. */
+    ATOMIC_T ext_gen;           /**< Ext SHM generation, increased whenever it could have been resized so that
+                                     connections know to remap it. */
 
     off_t conns;                /**< Array of existing connections (connection state). */
     uint16_t conn_count;        /**< Number of existing connections. */
@@ -469,27 +506,27 @@ sr_error_info_t *sr_shmmain_ext_open(sr_shm_t *shm, int zero);
  */
 
 /**
- * @brief Find a specific main SHM module.
+ * @brief Find a specific main SHM module using the module hash table.
  *
  * Either name or name_off must be set.
  *
  * @param[in] shm_main Main SHM.
  * @param[in] ext_shm_addr Ext SHM address.
  * @param[in] name String name of the module.
- * @param[in] name_off Ext SHM offset of the name (faster lookup, \p main_ext_shm_addr is not needed).
+ * @param[in] name_off Ext SHM offset of the name (faster comparison).
  * @return Main SHM module, NULL if not found.
  */
 sr_mod_t *sr_shmmain_find_module(sr_shm_t *shm_main, char *ext_shm_addr, const char *name, off_t name_off);
 
 /**
- * @brief Find a specific main SHM RPC.
+ * @brief Find a specific main SHM RPC using the RPC hash table.
  *
  * Either op_path or op_path_off must be set.
  *
  * @param[in] main_shm Main SHM structure.
  * @param[in] ext_shm_addr Ext SHM address.
  * @param[in] op_path String name of the RPCmodule.
- * @param[in] op_path_off Ext SHM offset of the op_path (faster lookup, \p ext_shm_addr is not needed).
+ * @param[in] op_path_off Ext SHM offset of the op_path (faster comparison).
  * @return Main SHM RPC, NULL if not found.
  */
 sr_rpc_t *sr_shmmain_find_rpc(sr_main_shm_t *main_shm, char *ext_shm_addr, const char *op_path, off_t op_path_off);
@@ -628,9 +665,12 @@ sr_error_info_t *sr_shmmod_modinfo_collect_edit(struct sr_mod_info_s *mod_info,
  *
  * @param[in,out] mod_info Modified mod info.
  * @param[in] xpath XPath to be evaluated.
+ * @param[in] xp_lock Lock guarding @p xp_cache.
+ * @param[in] xp_cache Optional XPath cache to use and update.
  * @return err_info, NULL on success.
  */
-sr_error_info_t *sr_shmmod_modinfo_collect_xpath(struct sr_mod_info_s *mod_info, const char *xpath);
+sr_error_info_t *sr_shmmod_modinfo_collect_xpath(struct sr_mod_info_s *mod_info, const char *xpath,
+        pthread_mutex_t *xp_lock, struct sr_xpath_cache_s *xp_cache);
 
 /**
  * @brief Collect required modules into mod info based on a specific module.
@@ -786,11 +826,11 @@ sr_error_info_t *sr_shmmod_oper_subscription_add(sr_shm_t *shm_ext, sr_mod_t *sh
  * @param[in] xpath Subscription XPath.
  * @param[in] evpipe_num Subscription event pipe number.
  * @param[in] only_evpipe Whether to match only on \p evpipe_num.
- * @param[out] xpath_p Optionally return the xpath of the removed subscription.
+ * @param[out] xpath_hash_p Optionally return the hash of the xpath of the removed subscription.
  * @return 0 if removed, 1 if no matching found.
  */
 int sr_shmmod_oper_subscription_del(char *ext_shm_addr, sr_mod_t *shm_mod, const char *xpath, uint32_t evpipe_num,
-        int only_evpipe, const char **xpath_p);
+        int only_evpipe, uint32_t *xpath_hash_p);
 
 /**
  * @brief Remove main SHM module operational subscription and do a proper cleanup.
@@ -870,11 +910,20 @@ sr_error_info_t *sr_shmsub_open_map(const char *name, const char *suffix1, int64
 
 /**
  * @brief Write into a subscriber event pipe to notify it there is a new event.
+ * The event pipe is opened only once and then kept opened in the connection cache.
  *
+ * @param[in] conn Connection to use.
  * @param[in] evpipe_num Subscriber event pipe number.
  * @return err_info, NULL on success.
  */
-sr_error_info_t *sr_shmsub_notify_evpipe(uint32_t evpipe_num);
+sr_error_info_t *sr_shmsub_notify_evpipe(sr_conn_ctx_t *conn, uint32_t evpipe_num);
+
+/**
+ * @brief Close all the cached event pipes of a connection.
+ *
+ * @param[in] conn Connection to use.
+ */
+void sr_shmsub_evpipe_cache_clear(sr_conn_ctx_t *conn);
 
 /**
  * @brief Notify about (generate) a change "update" event.
@@ -934,6 +983,7 @@ sr_error_info_t *sr_shmsub_change_notify_change_abort(struct sr_mod_info_s *mod_
 /**
  * @brief Notify about (generate) an operational event.
  *
+ * @param[in] conn Connection to use.
  * @param[in] ly_mod Module to use.
  * @param[in] xpath Subscription XPath.
  * @param[in] request_xpath Requested XPath.
@@ -945,9 +995,9 @@ sr_error_info_t *sr_shmsub_change_notify_change_abort(struct sr_mod_info_s *mod_
  * @param[out] cb_err_info Callback error information generated by a subscriber, if any.
  * @return err_info, NULL on success.
  */
-sr_error_info_t *sr_shmsub_oper_notify(const struct lys_module *ly_mod, const char *xpath, const char *request_xpath,
-        const struct lyd_node *parent, sr_sid_t sid, uint32_t evpipe_num, uint32_t timeout_ms, struct lyd_node **data,
-        sr_error_info_t **cb_err_info);
+sr_error_info_t *sr_shmsub_oper_notify(sr_conn_ctx_t *conn, const struct lys_module *ly_mod, const char *xpath,
+        const char *request_xpath, const struct lyd_node *parent, sr_sid_t sid, uint32_t evpipe_num, uint32_t timeout_ms,
+        struct lyd_node **data, sr_error_info_t **cb_err_info);
 
 /**
  * @brief Notify about (generate) an RPC/action event.
@@ -982,6 +1032,7 @@ sr_error_info_t *sr_shmsub_rpc_notify_abort(sr_conn_ctx_t *conn, const char *op_
 /**
  * @brief Notify about (generate) a notification event.
  *
+ * @param[in] conn Connection to use.
  * @param[in] notif Notification data tree.
  * @param[in] notif_ts Notification timestamp.
  * @param[in] sid Originator sysrepo session ID.
@@ -989,7 +1040,7 @@ sr_error_info_t *sr_shmsub_rpc_notify_abort(sr_conn_ctx_t *conn, const char *op_
  * @param[in] notif_sub_count Number of subscribers.
  * @return err_info, NULL on success.
  */
-sr_error_info_t *sr_shmsub_notif_notify(const struct lyd_node *notif, time_t notif_ts, sr_sid_t sid,
+sr_error_info_t *sr_shmsub_notif_notify(sr_conn_ctx_t *conn, const struct lyd_node *notif, time_t notif_ts, sr_sid_t sid,
         uint32_t *notif_sub_evpipe_nums, uint32_t notif_sub_count);
 
 /**
@@ -1065,6 +1116,51 @@ sr_error_info_t *sr_shmsub_notif_listen_module_stop_time(struct modsub_notif_s *
  */
 sr_error_info_t *sr_shmsub_notif_listen_module_replay(struct modsub_notif_s *notif_subs, sr_subscription_ctx_t *subs);
 
+#ifdef SR_HAVE_EPOLL
+
+/**
+ * @brief Initialize connection subscription event dispatcher. Its threads are started only once needed.
+ *
+ * @param[in] conn Connection to use.
+ * @return err_info, NULL on success.
+ */
+sr_error_info_t *sr_shmsub_disp_init(sr_conn_ctx_t *conn);
+
+/**
+ * @brief Stop all the threads of a connection subscription event dispatcher and free it.
+ * There must be no subscriptions left in the dispatcher.
+ *
+ * @param[in] conn Connection to use.
+ */
+void sr_shmsub_disp_destroy(sr_conn_ctx_t *conn);
+
+/**
+ * @brief Start dispatching events of a subscription by its connection dispatcher, which
+ * processes them in a worker thread. Events of one subscription are never processed concurrently.
+ *
+ * @param[in] subs Subscription to add.
+ * @return err_info, NULL on success.
+ */
+sr_error_info_t *sr_shmsub_disp_add(sr_subscription_ctx_t *subs);
+
+/**
+ * @brief Set the maximum number of worker threads of a connection subscription event dispatcher.
+ *
+ * @param[in] conn Connection to use.
+ * @param[in] worker_max Maximum number of worker threads, 0 for no limit.
+ */
+void sr_shmsub_disp_set_worker_max(sr_conn_ctx_t *conn, uint32_t worker_max);
+
+/**
+ * @brief Stop dispatching events of a subscription, waits until any of its events being processed are finished.
+ *
+ * @param[in] subs Subscription to remove.
+ * @return err_info, NULL on success.
+ */
+sr_error_info_t *sr_shmsub_disp_del(sr_subscription_ctx_t *subs);
+
+#else
+
 /**
  * @brief Listener handler thread of all subscriptions.
  *
@@ -1074,3 +1170,5 @@ sr_error_info_t *sr_shmsub_notif_listen_module_replay(struct modsub_notif_s *not
 void *sr_shmsub_listen_thread(void *arg);
 
 #endif
+
+#endif
@@ -126,6 +126,7 @@ sr_shmmain_ext_print(sr_shm_t *shm_main, char *ext_shm_addr, size_t ext_shm_size
     sr_rpc_t *shm_rpc;
     sr_rpc_sub_t *rpc_subs;
     sr_main_shm_t *main_shm;
+    sr_ext_shm_t *ext_shm;
     sr_conn_shm_t *shm_conn;
     struct shm_item *items;
     size_t i, j, item_count, printed, wasted;
@@ -138,12 +139,15 @@ sr_shmmain_ext_print(sr_shm_t *shm_main, char *ext_shm_addr, size_t ext_shm_size
         return;
     }
 
-    /* add wasted */
+    ext_shm = (sr_ext_shm_t *)ext_shm_addr;
+
+    /* add header */
     item_count = 0;
     items = malloc(sizeof *items);
     items[item_count].start = 0;
-    items[item_count].size = sizeof(size_t);
-    asprintf(&(items[item_count].name), "ext wasted %lu", *((size_t *)ext_shm_addr));
+    items[item_count].size = SR_SHM_SIZE(sizeof *ext_shm);
+    asprintf(&(items[item_count].name), "ext header (wasted %lu, allocs %u, reused %u, defrags %u)", ext_shm->wasted,
+            ext_shm->alloc_count, ext_shm->reuse_count, ext_shm->defrag_count);
     ++item_count;
 
     main_shm = (sr_main_shm_t *)shm_main->addr;
@@ -176,6 +180,24 @@ sr_shmmain_ext_print(sr_shm_t *shm_main, char *ext_shm_addr, size_t ext_shm_size
         }
     }
 
+    if (main_shm->mod_hash) {
+        /* add module hash table */
+        items = sr_realloc(items, (item_count + 1) * sizeof *items);
+        items[item_count].start = main_shm->mod_hash;
+        items[item_count].size = SR_SHM_SIZE(main_shm->mod_hash_size * sizeof(uint32_t));
+        asprintf(&(items[item_count].name), "module hash table (%u)", main_shm->mod_hash_size);
+        ++item_count;
+    }
+
+    if (main_shm->rpc_hash) {
+        /* add RPC hash table */
+        items = sr_realloc(items, (item_count + 1) * sizeof *items);
+        items[item_count].start = main_shm->rpc_hash;
+        items[item_count].size = SR_SHM_SIZE(main_shm->rpc_hash_size * sizeof(uint32_t));
+        asprintf(&(items[item_count].name), "rpc hash table (%u)", main_shm->rpc_hash_size);
+        ++item_count;
+    }
+
     if (main_shm->rpc_sub_count) {
         /* add RPCs */
         items = sr_realloc(items, (item_count + 1) * sizeof *items);
@@ -385,7 +407,7 @@ sr_shmmain_ext_print(sr_shm_t *shm_main, char *ext_shm_addr, size_t ext_shm_size
     /* check that no item exists after the mapped segment */
     assert((unsigned)cur_off <= ext_shm_size);
     /* check that wasted memory is correct */
-    assert(*((size_t *)ext_shm_addr) == wasted);
+    assert(ext_shm->wasted == wasted);
 }
 
 /**
@@ -548,6 +570,7 @@ sr_shmmain_ext_defrag(sr_shm_t *shm_main, sr_shm_t *shm_ext, char **defrag_ext_b
     char *ext_buf, *ext_buf_cur, *mod_name;
     sr_conn_shm_t *shm_conn;
     sr_main_shm_t *main_shm;
+    sr_ext_shm_t *ext_shm;
     sr_mod_notif_sub_t *notif_subs;
     sr_conn_shm_lock_t (*mod_locks)[SR_DS_COUNT];
     uint32_t *evpipes;
@@ -556,19 +579,27 @@ sr_shmmain_ext_defrag(sr_shm_t *shm_main, sr_shm_t *shm_ext, char **defrag_ext_b
     *defrag_ext_buf = NULL;
 
     /* resulting defragmented size is known */
-    ext_buf_cur = ext_buf = malloc(shm_ext->size - *((size_t *)shm_ext->addr));
+    ext_buf_cur = ext_buf = malloc(shm_ext->size - ((sr_ext_shm_t *)shm_ext->addr)->wasted);
     SR_CHECK_MEM_RET(!ext_buf, err_info);
 
-    /* wasted ext number */
-    *((size_t *)ext_buf_cur) = 0;
-    ext_buf_cur += sizeof(size_t);
+    /* header with no wasted memory and empty free lists, keep the statistics */
+    ext_shm = (sr_ext_shm_t *)ext_buf_cur;
+    memset(ext_shm, 0, sizeof *ext_shm);
+    ext_shm->alloc_count = ((sr_ext_shm_t *)shm_ext->addr)->alloc_count;
+    ext_shm->reuse_count = ((sr_ext_shm_t *)shm_ext->addr)->reuse_count;
+    ext_shm->defrag_count = ((sr_ext_shm_t *)shm_ext->addr)->defrag_count + 1;
+    ext_buf_cur += SR_SHM_SIZE(sizeof *ext_shm);
 
-    /* 1) copy all module names so that dependencies can reference them */
+    main_shm = (sr_main_shm_t *)shm_main->addr;
+
+    /* 1) copy all module names and the module hash table so that dependencies can reference them */
     SR_SHM_MOD_FOR(shm_main->addr, shm_main->size, shm_mod) {
         /* copy module name and update offset */
         mod_name = shm_ext->addr + shm_mod->name;
         shm_mod->name = sr_shmstrcpy(ext_buf, mod_name, &ext_buf_cur);
     }
+    main_shm->mod_hash = sr_shmcpy(ext_buf, shm_ext->addr + main_shm->mod_hash,
+            SR_SHM_SIZE(main_shm->mod_hash_size * sizeof(uint32_t)), &ext_buf_cur);
 
     /* 2) copy the rest of arrays */
     SR_SHM_MOD_FOR(shm_main->addr, shm_main->size, shm_mod) {
@@ -613,8 +644,6 @@ sr_shmmain_ext_defrag(sr_shm_t *shm_main, sr_shm_t *shm_ext, char **defrag_ext_b
         shm_mod->notif_subs = sr_shmcpy(ext_buf, notif_subs, SR_SHM_SIZE(shm_mod->notif_sub_count * sizeof *notif_subs), &ext_buf_cur);
     }
 
-    main_shm = (sr_main_shm_t *)shm_main->addr;
-
     /* 3) copy connection state */
     shm_conn = (sr_conn_shm_t *)(shm_ext->addr + main_shm->conns);
     /* copy connections */
@@ -642,8 +671,12 @@ sr_shmmain_ext_defrag(sr_shm_t *shm_main, sr_shm_t *shm_ext, char **defrag_ext_b
                 sizeof(sr_rpc_sub_t), shm_rpc[i].sub_count, ext_buf, &ext_buf_cur);
     }
 
+    /* copy RPC hash table */
+    main_shm->rpc_hash = sr_shmcpy(ext_buf, shm_ext->addr + main_shm->rpc_hash,
+            SR_SHM_SIZE(main_shm->rpc_hash_size * sizeof(uint32_t)), &ext_buf_cur);
+
     /* check size */
-    if ((unsigned)(ext_buf_cur - ext_buf) != shm_ext->size - *((size_t *)shm_ext->addr)) {
+    if ((unsigned)(ext_buf_cur - ext_buf) != shm_ext->size - ((sr_ext_shm_t *)shm_ext->addr)->wasted) {
         SR_ERRINFO_INT(&err_info);
         free(ext_buf);
         return err_info;
@@ -801,7 +834,6 @@ sr_shmmain_conn_del(sr_main_shm_t *main_shm, char *ext_shm_addr, sr_conn_ctx_t *
 {
     sr_error_info_t *err_info = NULL;
     sr_conn_shm_t *shm_conn;
-    size_t dyn_attr_size;
     uint16_t i;
 
     /* find the connection */
@@ -818,9 +850,9 @@ sr_shmmain_conn_del(sr_main_shm_t *main_shm, char *ext_shm_addr, sr_conn_ctx_t *
     }
 
     /* remove the connection with its mod locks and evpipes */
-    dyn_attr_size = SR_SHM_SIZE(main_shm->mod_count * sizeof(sr_conn_shm_lock_t[SR_DS_COUNT]))
-            + SR_SHM_SIZE(shm_conn[i].evpipe_count * sizeof(uint32_t));
-    sr_shmrealloc_del(ext_shm_addr, &main_shm->conns, &main_shm->conn_count, sizeof *shm_conn, i, dyn_attr_size);
+    sr_shmfree(ext_shm_addr, shm_conn[i].mod_locks, SR_SHM_SIZE(main_shm->mod_count * sizeof(sr_conn_shm_lock_t[SR_DS_COUNT])));
+    sr_shmfree(ext_shm_addr, shm_conn[i].evpipes, SR_SHM_SIZE(shm_conn[i].evpipe_count * sizeof(uint32_t)));
+    sr_shmrealloc_del(ext_shm_addr, &main_shm->conns, &main_shm->conn_count, sizeof *shm_conn, i);
 }
 
 sr_conn_shm_t *
@@ -895,7 +927,7 @@ sr_shmmain_conn_del_evpipe(sr_conn_ctx_t *conn, uint32_t evpipe_num)
     }
 
     /* delete the evpipe num */
-    sr_shmrealloc_del(conn->ext_shm.addr, &shm_conn->evpipes, &shm_conn->evpipe_count, sizeof evpipe_num, i, 0);
+    sr_shmrealloc_del(conn->ext_shm.addr, &shm_conn->evpipes, &shm_conn->evpipe_count, sizeof evpipe_num, i);
 
 cleanup:
     sr_errinfo_free(&err_info);
@@ -932,20 +964,10 @@ sr_shmmain_conn_recover(sr_conn_ctx_t *conn)
         if (!sr_process_exists(shm_conn[i].pid)) {
             SR_LOG_WRN("Cleaning up after a non-existent sysrepo client with PID %ld.", (long)shm_conn[i].pid);
 
-            /* recover held main SHM locks */
-            switch (shm_conn[i].main_lock.mode) {
-            case SR_LOCK_READ:
-                /* remove all read locks */
-                assert(shm_conn[i].main_lock.rcount && (main_shm->lock.readers >= shm_conn[i].main_lock.rcount));
-                main_shm->lock.readers -= shm_conn[i].main_lock.rcount;
-                break;
-            case SR_LOCK_WRITE:
+            /* recover held main SHM lock (READ locks are not tracked, we could not have gotten here if any were held) */
+            if (shm_conn[i].main_lock.mode == SR_LOCK_WRITE) {
                 /* not supported */
                 sr_errinfo_new(&err_info, SR_ERR_UNSUPPORTED, NULL, "Client crashed while holding SHM WRITE lock, not recoverable!");
-                break;
-            case SR_LOCK_NONE:
-                /* nothing to do */
-                break;
             }
 
             /* recover held module locks */
@@ -962,8 +984,7 @@ sr_shmmain_conn_recover(sr_conn_ctx_t *conn)
                             SR_ERRINFO_LOCK(&err_info, __func__, ret);
                         } else {
                             /* unlock all read locks */
-                            assert(shm_lock->lock.readers >= mod_locks[j][k].rcount);
-                            shm_lock->lock.readers -= mod_locks[j][k].rcount;
+                            sr_rwlock_recover_readers(&shm_lock->lock, mod_locks[j][k].rcount);
 
                             /* unlock fake write lock */
                             if (mod_locks[j][k].mode == SR_LOCK_WRITE) {
@@ -1078,6 +1099,7 @@ sr_shmmain_ext_get_size_main_shm(sr_shm_t *shm_main, char *ext_shm_addr)
         shm_size += SR_SHM_SIZE(shm_rpc[i].sub_count * sizeof *rpc_subs);
     }
     shm_size += SR_SHM_SIZE(main_shm->rpc_sub_count * sizeof *shm_rpc);
+    shm_size += SR_SHM_SIZE(main_shm->rpc_hash_size * sizeof(uint32_t));
 
     /* existing module subscriptions */
     SR_SHM_MOD_FOR(shm_main->addr, shm_main->size, shm_mod) {
@@ -1225,6 +1247,7 @@ sr_shmmain_files_startup2running(sr_conn_ctx_t *conn, int replace)
 {
     sr_error_info_t *err_info = NULL;
     sr_mod_t *shm_mod = NULL;
+    const struct lys_module *ly_mod;
     char *startup_path, *running_path;
     const char *mod_name;
 
@@ -1250,6 +1273,22 @@ sr_shmmain_files_startup2running(sr_conn_ctx_t *conn, int replace)
         if (err_info) {
             goto error;
         }
+
+        /* any journaled changes belong to the previous running data */
+        if ((err_info = sr_module_file_journal_remove(mod_name))) {
+            goto error;
+        }
+        if ((err_info = sr_module_file_index_remove(mod_name))) {
+            goto error;
+        }
+
+        /* the data file was not written by sysrepo, create its index now */
+        ly_mod = ly_ctx_get_module(conn->ly_ctx, mod_name, NULL, 1);
+        SR_CHECK_INT_GOTO(!ly_mod, err_info, error);
+        if ((err_info = sr_module_file_index_create(ly_mod))) {
+            /* the data will just always be loaded whole */
+            sr_errinfo_free(&err_info);
+        }
     }
 
     if (replace) {
@@ -1374,6 +1413,11 @@ sr_shmmain_add_modules(char *ext_shm_addr, struct lyd_node *first_sr_mod, sr_mod
             return err_info;
         }
         first_shm_mod->ver = 1;
+        ATOMIC_STORE_RELAXED(first_shm_mod->oper_ver, 1);
+        for (i = 0; i < SR_DS_COUNT; ++i) {
+            /* referenced modules are not known until the data are stored */
+            ATOMIC_STORE_RELAXED(first_shm_mod->instid_targets[i], ATOMIC_T_MAX);
+        }
 
         /* set all arrays and pointers to ext SHM */
         LY_TREE_FOR(first_sr_mod->child, sr_child) {
@@ -1571,63 +1615,62 @@ sr_shmmain_del_modules_deps(sr_shm_t *shm_main, char *ext_shm_addr, sr_mod_t *fi
 {
     sr_mod_data_dep_t *shm_data_deps, *shm_op_data_deps;
     sr_mod_op_dep_t *shm_op_deps;
-    size_t *ext_wasted;
     uint32_t i, j;
 
     assert(first_shm_mod);
-    ext_wasted = (size_t *)ext_shm_addr;
 
     do {
         shm_data_deps = (sr_mod_data_dep_t *)(ext_shm_addr + first_shm_mod->data_deps);
         for (i = 0; i < first_shm_mod->data_dep_count; ++i) {
-            /* add wasted for xpath */
+            /* free xpath */
             if (shm_data_deps[i].xpath) {
-                *ext_wasted += sr_strshmlen(ext_shm_addr + shm_data_deps[i].xpath);
+                sr_shmfree(ext_shm_addr, shm_data_deps[i].xpath, sr_strshmlen(ext_shm_addr + shm_data_deps[i].xpath));
             }
         }
 
-        /* add wasted for data deps array and clear it */
-        *ext_wasted += first_shm_mod->data_dep_count * sizeof(sr_mod_data_dep_t);
+        /* free data deps array and clear it */
+        sr_shmfree(ext_shm_addr, first_shm_mod->data_deps,
+                SR_SHM_SIZE(first_shm_mod->data_dep_count * sizeof(sr_mod_data_dep_t)));
         first_shm_mod->data_deps = 0;
         first_shm_mod->data_dep_count = 0;
 
-        /* add wasted for inv data deps array and clear it */
-        *ext_wasted += first_shm_mod->inv_data_dep_count * sizeof(off_t);
+        /* free inv data deps array and clear it */
+        sr_shmfree(ext_shm_addr, first_shm_mod->inv_data_deps, SR_SHM_SIZE(first_shm_mod->inv_data_dep_count * sizeof(off_t)));
         first_shm_mod->inv_data_deps = 0;
         first_shm_mod->inv_data_dep_count = 0;
 
         shm_op_deps = (sr_mod_op_dep_t *)(ext_shm_addr + first_shm_mod->op_deps);
         for (i = 0; i < first_shm_mod->op_dep_count; ++i) {
             if (shm_op_deps[i].xpath) {
-                /* add wasted for xpath */
-                *ext_wasted += sr_strshmlen(ext_shm_addr + shm_op_deps[i].xpath);
+                /* free xpath */
+                sr_shmfree(ext_shm_addr, shm_op_deps[i].xpath, sr_strshmlen(ext_shm_addr + shm_op_deps[i].xpath));
             }
 
             shm_op_data_deps = (sr_mod_data_dep_t *)(ext_shm_addr + shm_op_deps[i].in_deps);
             for (j = 0; j < shm_op_deps[i].in_dep_count; ++j) {
                 if (shm_op_data_deps[j].xpath) {
-                    /* add wasted for xpath */
-                    *ext_wasted += sr_strshmlen(ext_shm_addr + shm_op_data_deps[j].xpath);
+                    /* free xpath */
+                    sr_shmfree(ext_shm_addr, shm_op_data_deps[j].xpath, sr_strshmlen(ext_shm_addr + shm_op_data_deps[j].xpath));
                 }
             }
 
-            /* add wasted for in deps array */
-            *ext_wasted += shm_op_deps[i].in_dep_count * sizeof(sr_mod_data_dep_t);
+            /* free in deps array */
+            sr_shmfree(ext_shm_addr, shm_op_deps[i].in_deps, SR_SHM_SIZE(shm_op_deps[i].in_dep_count * sizeof(sr_mod_data_dep_t)));
 
             shm_op_data_deps = (sr_mod_data_dep_t *)(ext_shm_addr + shm_op_deps[i].out_deps);
             for (j = 0; j < shm_op_deps[i].out_dep_count; ++j) {
                 if (shm_op_data_deps[j].xpath) {
-                    /* add wasted for xpath */
-                    *ext_wasted += sr_strshmlen(ext_shm_addr + shm_op_data_deps[j].xpath);
+                    /* free xpath */
+                    sr_shmfree(ext_shm_addr, shm_op_data_deps[j].xpath, sr_strshmlen(ext_shm_addr + shm_op_data_deps[j].xpath));
                 }
             }
 
-            /* add wasted for out deps array */
-            *ext_wasted += shm_op_deps[i].out_dep_count * sizeof(sr_mod_data_dep_t);
+            /* free out deps array */
+            sr_shmfree(ext_shm_addr, shm_op_deps[i].out_deps, SR_SHM_SIZE(shm_op_deps[i].out_dep_count * sizeof(sr_mod_data_dep_t)));
         }
 
-        /* add wasted for op deps array and clear it */
-        *ext_wasted += first_shm_mod->op_dep_count * sizeof(sr_mod_op_dep_t);
+        /* free op deps array and clear it */
+        sr_shmfree(ext_shm_addr, first_shm_mod->op_deps, SR_SHM_SIZE(first_shm_mod->op_dep_count * sizeof(sr_mod_op_dep_t)));
         first_shm_mod->op_deps = 0;
         first_shm_mod->op_dep_count = 0;
 
@@ -1636,6 +1679,85 @@ sr_shmmain_del_modules_deps(sr_shm_t *shm_main, char *ext_shm_addr, sr_mod_t *fi
     } while ((char *)first_shm_mod != shm_main->addr + shm_main->size);
 }
 
+/**
+ * @brief Get the number of buckets of a main SHM hash table for a number of items.
+ *
+ * @param[in] count Item count.
+ * @return Hash table size, 0 if no hash table is needed.
+ */
+static uint32_t
+sr_shmmain_hash_size(uint32_t count)
+{
+    uint32_t size;
+
+    if (!count) {
+        return 0;
+    }
+
+    /* keep at least half of the buckets empty so that the probing is short and always terminates */
+    for (size = SR_SHM_HASH_MIN_SIZE; size < 2 * count; size <<= 1);
+    return size;
+}
+
+/**
+ * @brief Insert an item into a main SHM hash table.
+ *
+ * @param[in] hash_table Hash table.
+ * @param[in] hash_size Hash table size.
+ * @param[in] key Item key.
+ * @param[in] idx Item index.
+ */
+static void
+sr_shmmain_hash_insert(uint32_t *hash_table, uint32_t hash_size, const char *key, uint32_t idx)
+{
+    uint32_t i;
+
+    for (i = sr_str_hash(key) & (hash_size - 1); hash_table[i]; i = (i + 1) & (hash_size - 1));
+    hash_table[i] = idx + 1;
+}
+
+/**
+ * @brief Fill the module hash table with all the modules in main SHM.
+ *
+ * @param[in] main_shm Main SHM structure.
+ * @param[in] ext_shm_addr Ext SHM address.
+ */
+static void
+sr_shmmain_mod_hash_fill(sr_main_shm_t *main_shm, char *ext_shm_addr)
+{
+    sr_mod_t *shm_mod;
+    uint32_t *hash_table, i;
+
+    hash_table = (uint32_t *)(ext_shm_addr + main_shm->mod_hash);
+    memset(hash_table, 0, main_shm->mod_hash_size * sizeof *hash_table);
+
+    shm_mod = SR_FIRST_SHM_MOD(main_shm);
+    for (i = 0; i < main_shm->mod_count; ++i) {
+        sr_shmmain_hash_insert(hash_table, main_shm->mod_hash_size, ext_shm_addr + shm_mod[i].name, i);
+    }
+}
+
+/**
+ * @brief Fill the RPC hash table with all the RPCs in main SHM.
+ *
+ * @param[in] main_shm Main SHM structure.
+ * @param[in] ext_shm_addr Ext SHM address.
+ */
+static void
+sr_shmmain_rpc_hash_fill(sr_main_shm_t *main_shm, char *ext_shm_addr)
+{
+    sr_rpc_t *shm_rpc;
+    uint32_t *hash_table, i;
+
+    hash_table = (uint32_t *)(ext_shm_addr + main_shm->rpc_hash);
+    memset(hash_table, 0, main_shm->rpc_hash_size * sizeof *hash_table);
+
+    shm_rpc = (sr_rpc_t *)(ext_shm_addr + main_shm->rpc_subs);
+    for (i = 0; i < main_shm->rpc_sub_count; ++i) {
+        sr_shmmain_hash_insert(hash_table, main_shm->rpc_hash_size, ext_shm_addr + shm_rpc[i].op_path, i);
+    }
+}
+
 sr_error_info_t *
 sr_shmmain_add(sr_conn_ctx_t *conn, struct lyd_node *sr_mod)
 {
@@ -1645,6 +1767,7 @@ sr_shmmain_add(sr_conn_ctx_t *conn, struct lyd_node *sr_mod)
     sr_main_shm_t *main_shm;
     off_t main_end, ext_end;
     size_t *wasted_ext, new_ext_size, new_mod_count;
+    uint32_t new_hash_size;
 
     /* count how many modules are we going to add */
     new_mod_count = 0;
@@ -1654,6 +1777,13 @@ sr_shmmain_add(sr_conn_ctx_t *conn, struct lyd_node *sr_mod)
         }
     }
 
+    /* the module hash table will be recreated for all the modules, free the previous one */
+    main_shm = (sr_main_shm_t *)conn->main_shm.addr;
+    new_hash_size = sr_shmmain_hash_size(main_shm->mod_count + new_mod_count);
+    sr_shmfree(conn->ext_shm.addr, main_shm->mod_hash, SR_SHM_SIZE(main_shm->mod_hash_size * sizeof(uint32_t)));
+    main_shm->mod_hash = 0;
+    main_shm->mod_hash_size = 0;
+
     /* remember current SHM and ext SHM end (size) */
     main_end = conn->main_shm.size;
     ext_end = conn->ext_shm.size;
@@ -1664,13 +1794,13 @@ sr_shmmain_add(sr_conn_ctx_t *conn, struct lyd_node *sr_mod)
     }
 
     /* enlarge ext SHM */
-    wasted_ext = (size_t *)conn->ext_shm.addr;
-    new_ext_size = sizeof(size_t) + sr_shmmain_ext_get_size_main_shm(&conn->main_shm, conn->ext_shm.addr) +
-            sr_shmmain_ext_get_lydmods_size(sr_mod->parent);
+    wasted_ext = &((sr_ext_shm_t *)conn->ext_shm.addr)->wasted;
+    new_ext_size = SR_SHM_SIZE(sizeof(sr_ext_shm_t)) + sr_shmmain_ext_get_size_main_shm(&conn->main_shm, conn->ext_shm.addr) +
+            sr_shmmain_ext_get_lydmods_size(sr_mod->parent) + SR_SHM_SIZE(new_hash_size * sizeof(uint32_t));
     if ((err_info = sr_shm_remap(&conn->ext_shm, new_ext_size + *wasted_ext))) {
         return err_info;
     }
-    wasted_ext = (size_t *)conn->ext_shm.addr;
+    wasted_ext = &((sr_ext_shm_t *)conn->ext_shm.addr)->wasted;
 
     /* add all newly implemented modules into SHM */
     if ((err_info = sr_shmmain_add_modules(conn->ext_shm.addr, sr_mod, (sr_mod_t *)(conn->main_shm.addr + main_end),
@@ -1683,6 +1813,12 @@ sr_shmmain_add(sr_conn_ctx_t *conn, struct lyd_node *sr_mod)
     main_shm->mod_count += new_mod_count;
     assert(main_shm->mod_count == (conn->main_shm.size - sizeof *main_shm) / sizeof *shm_mod);
 
+    /* add the module hash table */
+    main_shm->mod_hash = ext_end;
+    main_shm->mod_hash_size = new_hash_size;
+    ext_end += SR_SHM_SIZE(new_hash_size * sizeof(uint32_t));
+    sr_shmmain_mod_hash_fill(main_shm, conn->ext_shm.addr);
+
     /*
      * Dependencies of old modules are rebuild because of possible
      * 1) new inverse dependencies when new modules depend on the old ones;
@@ -1697,7 +1833,7 @@ sr_shmmain_add(sr_conn_ctx_t *conn, struct lyd_node *sr_mod)
     if ((err_info = sr_shm_remap(&conn->ext_shm, new_ext_size + *wasted_ext))) {
         return err_info;
     }
-    wasted_ext = (size_t *)conn->ext_shm.addr;
+    wasted_ext = &((sr_ext_shm_t *)conn->ext_shm.addr)->wasted;
 
     /* add all dependencies for all modules in SHM */
     if ((err_info = sr_shmmain_add_modules_deps(&conn->main_shm, conn->ext_shm.addr, sr_mod->parent->child,
@@ -1757,6 +1893,7 @@ sr_shmmain_main_open(sr_shm_t *shm, int *created)
         }
         ATOMIC_STORE_RELAXED(main_shm->new_sr_sid, 1);
         ATOMIC_STORE_RELAXED(main_shm->new_evpipe_num, 1);
+        ATOMIC_STORE_RELAXED(main_shm->ext_gen, 1);
 
         /* remove leftover event pipes */
         sr_remove_evpipes();
@@ -1796,11 +1933,11 @@ sr_shmmain_ext_open(sr_shm_t *shm, int zero)
     }
 
     /* either zero the memory or keep it exactly the way it was */
-    if ((err_info = sr_shm_remap(shm, zero ? sizeof(size_t) : 0))) {
+    if ((err_info = sr_shm_remap(shm, zero ? SR_SHM_SIZE(sizeof(sr_ext_shm_t)) : 0))) {
         goto error;
     }
     if (zero) {
-        *((size_t *)shm->addr) = 0;
+        memset(shm->addr, 0, SR_SHM_SIZE(sizeof(sr_ext_shm_t)));
     }
 
     return NULL;
@@ -1813,14 +1950,29 @@ error:
 sr_mod_t *
 sr_shmmain_find_module(sr_shm_t *shm_main, char *ext_shm_addr, const char *name, off_t name_off)
 {
+    sr_main_shm_t *main_shm;
     sr_mod_t *shm_mod;
+    uint32_t *hash_table, i;
 
-    assert(name || name_off);
+    assert(ext_shm_addr && (name || name_off));
 
-    SR_SHM_MOD_FOR(shm_main->addr, shm_main->size, shm_mod) {
+    main_shm = (sr_main_shm_t *)shm_main->addr;
+    if (!main_shm->mod_hash_size) {
+        /* no modules */
+        return NULL;
+    }
+    if (!name) {
+        name = ext_shm_addr + name_off;
+    }
+
+    hash_table = (uint32_t *)(ext_shm_addr + main_shm->mod_hash);
+    for (i = sr_str_hash(name) & (main_shm->mod_hash_size - 1);
+            hash_table[i];
+            i = (i + 1) & (main_shm->mod_hash_size - 1)) {
+        shm_mod = SR_FIRST_SHM_MOD(main_shm) + (hash_table[i] - 1);
         if (name_off && (shm_mod->name == name_off)) {
             return shm_mod;
-        } else if (name && !strcmp(ext_shm_addr + shm_mod->name, name)) {
+        } else if (!name_off && !strcmp(ext_shm_addr + shm_mod->name, name)) {
             return shm_mod;
         }
     }
@@ -1832,16 +1984,27 @@ sr_rpc_t *
 sr_shmmain_find_rpc(sr_main_shm_t *main_shm, char *ext_shm_addr, const char *op_path, off_t op_path_off)
 {
     sr_rpc_t *shm_rpc;
-    uint16_t i;
+    uint32_t *hash_table, i;
 
-    assert(op_path || op_path_off);
+    assert(ext_shm_addr && (op_path || op_path_off));
+
+    if (!main_shm->rpc_hash_size) {
+        /* no RPCs */
+        return NULL;
+    }
+    if (!op_path) {
+        op_path = ext_shm_addr + op_path_off;
+    }
 
+    hash_table = (uint32_t *)(ext_shm_addr + main_shm->rpc_hash);
     shm_rpc = (sr_rpc_t *)(ext_shm_addr + main_shm->rpc_subs);
-    for (i = 0; i < main_shm->rpc_sub_count; ++i) {
-        if (op_path_off && (shm_rpc[i].op_path == op_path_off)) {
-            return &shm_rpc[i];
-        } else if (op_path && !strcmp(ext_shm_addr + shm_rpc[i].op_path, op_path)) {
-            return &shm_rpc[i];
+    for (i = sr_str_hash(op_path) & (main_shm->rpc_hash_size - 1);
+            hash_table[i];
+            i = (i + 1) & (main_shm->rpc_hash_size - 1)) {
+        if (op_path_off && (shm_rpc[hash_table[i] - 1].op_path == op_path_off)) {
+            return &shm_rpc[hash_table[i] - 1];
+        } else if (!op_path_off && !strcmp(ext_shm_addr + shm_rpc[hash_table[i] - 1].op_path, op_path)) {
+            return &shm_rpc[hash_table[i] - 1];
         }
     }
 
@@ -1849,49 +2012,29 @@ sr_shmmain_find_rpc(sr_main_shm_t *main_shm, char *ext_shm_addr, const char *op_
 }
 
 /**
- * @brief Update information about currently held main lock.
+ * @brief Update information about currently held main WRITE lock. READ locks are not tracked
+ * so that they do not write into any shared memory.
  *
  * @param[in] conn Connection to update.
- * @param[in] mode Lock mode.
  * @param[in] lock Whether the lock was LOCKED or UNLOCKED.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
-sr_shmmain_conn_lock_update(sr_conn_ctx_t *conn, sr_lock_mode_t mode, int lock)
+sr_shmmain_conn_lock_update(sr_conn_ctx_t *conn, int lock)
 {
     sr_error_info_t *err_info = NULL;
     sr_conn_shm_t *shm_conn;
 
-    assert(mode != SR_LOCK_NONE);
-
     /* update information about the held lock */
     shm_conn = sr_shmmain_conn_find(conn->main_shm.addr, conn->ext_shm.addr, conn, getpid());
     SR_CHECK_INT_RET(!shm_conn, err_info);
 
     if (lock) {
-        if (mode == SR_LOCK_READ) {
-            /* recursive read locks are supported */
-            assert(((shm_conn->main_lock.mode == SR_LOCK_NONE) && !shm_conn->main_lock.rcount)
-                || ((shm_conn->main_lock.mode == SR_LOCK_READ) && shm_conn->main_lock.rcount));
-            shm_conn->main_lock.mode = mode;
-            assert(shm_conn->main_lock.rcount < UINT8_MAX);
-            ++shm_conn->main_lock.rcount;
-        } else {
-            assert(shm_conn->main_lock.mode == SR_LOCK_NONE);
-            shm_conn->main_lock.mode = mode;
-        }
+        assert(shm_conn->main_lock.mode == SR_LOCK_NONE);
+        shm_conn->main_lock.mode = SR_LOCK_WRITE;
     } else {
-        if (mode == SR_LOCK_READ) {
-            /* handle recursive read locks */
-            assert((shm_conn->main_lock.mode == mode) && shm_conn->main_lock.rcount);
-            --shm_conn->main_lock.rcount;
-            if (!shm_conn->main_lock.rcount) {
-                shm_conn->main_lock.mode = SR_LOCK_NONE;
-            }
-        } else {
-            assert(shm_conn->main_lock.mode == mode);
-            shm_conn->main_lock.mode = SR_LOCK_NONE;
-        }
+        assert(shm_conn->main_lock.mode == SR_LOCK_WRITE);
+        shm_conn->main_lock.mode = SR_LOCK_NONE;
     }
 
     return NULL;
@@ -1901,10 +2044,11 @@ sr_error_info_t *
 sr_shmmain_lock_remap(sr_conn_ctx_t *conn, sr_lock_mode_t mode, int remap, const char *func)
 {
     sr_error_info_t *err_info = NULL;
+    sr_main_shm_t *main_shm = (sr_main_shm_t *)conn->main_shm.addr;
     size_t shm_file_size;
 
     /* SHM LOCK */
-    if ((err_info = sr_rwlock(&((sr_main_shm_t *)conn->main_shm.addr)->lock, SR_MAIN_LOCK_TIMEOUT * 1000, mode, func))) {
+    if ((err_info = sr_rwlock(&main_shm->lock, SR_MAIN_LOCK_TIMEOUT * 1000, mode, func))) {
         return err_info;
     }
 
@@ -1920,33 +2064,40 @@ sr_shmmain_lock_remap(sr_conn_ctx_t *conn, sr_lock_mode_t mode, int remap, const
         if ((err_info = sr_shm_remap(&conn->ext_shm, 0))) {
             goto error_shm_remap_unlock;
         }
-    } else {
-        if ((err_info = sr_file_get_size(conn->ext_shm.fd, &shm_file_size))) {
-            goto error_shm_remap_unlock;
-        }
-        if (shm_file_size > conn->ext_shm.size) {
-            /* ext SHM is larger now and we need to remap it */
+        conn->ext_gen = ATOMIC_LOAD_RELAXED(main_shm->ext_gen);
+    } else if ((uint32_t)ATOMIC_LOAD_RELAXED(main_shm->ext_gen) != conn->ext_gen) {
+        /* ext SHM may have been resized and we need to remap it */
 
-            /* REMAP READ UNLOCK */
-            sr_rwunlock(&conn->ext_remap_lock, SR_LOCK_READ, func);
-            /* REMAP WRITE LOCK */
-            if ((err_info = sr_rwlock(&conn->ext_remap_lock, SR_MAIN_LOCK_TIMEOUT * 1000, SR_LOCK_WRITE, func))) {
-                goto error_shm_unlock;
-            }
+        /* REMAP READ UNLOCK */
+        sr_rwunlock(&conn->ext_remap_lock, SR_LOCK_READ, func);
+        /* REMAP WRITE LOCK */
+        if ((err_info = sr_rwlock(&conn->ext_remap_lock, SR_MAIN_LOCK_TIMEOUT * 1000, SR_LOCK_WRITE, func))) {
+            goto error_shm_unlock;
+        }
 
-            if ((err_info = sr_shm_remap(&conn->ext_shm, shm_file_size))) {
+        /* another thread could have remapped it meanwhile */
+        if ((uint32_t)ATOMIC_LOAD_RELAXED(main_shm->ext_gen) != conn->ext_gen) {
+            if ((err_info = sr_file_get_size(conn->ext_shm.fd, &shm_file_size))) {
                 remap = 1;
                 goto error_shm_remap_unlock;
             }
-
-            /* REMAP WRITE UNLOCK */
-            sr_rwunlock(&conn->ext_remap_lock, SR_LOCK_WRITE, func);
-            /* REMAP READ LOCK */
-            if ((err_info = sr_rwlock(&conn->ext_remap_lock, SR_MAIN_LOCK_TIMEOUT * 1000, SR_LOCK_READ, func))) {
-                goto error_shm_unlock;
+            if (shm_file_size > conn->ext_shm.size) {
+                /* ext SHM is larger now, if it was defragmented the larger mapping can be kept */
+                if ((err_info = sr_shm_remap(&conn->ext_shm, shm_file_size))) {
+                    remap = 1;
+                    goto error_shm_remap_unlock;
+                }
             }
-        } /* else no remapping needed */
-    }
+            conn->ext_gen = ATOMIC_LOAD_RELAXED(main_shm->ext_gen);
+        }
+
+        /* REMAP WRITE UNLOCK */
+        sr_rwunlock(&conn->ext_remap_lock, SR_LOCK_WRITE, func);
+        /* REMAP READ LOCK */
+        if ((err_info = sr_rwlock(&conn->ext_remap_lock, SR_MAIN_LOCK_TIMEOUT * 1000, SR_LOCK_READ, func))) {
+            goto error_shm_unlock;
+        }
+    } /* else no remapping needed */
 
     if (mode == SR_LOCK_WRITE) {
         /* check that all connections still exist */
@@ -1955,9 +2106,9 @@ sr_shmmain_lock_remap(sr_conn_ctx_t *conn, sr_lock_mode_t mode, int remap, const
         }
     }
 
-    if (strcmp(func, "sr_connect") && strcmp(func, "sr_disconnect")) {
+    if ((mode == SR_LOCK_WRITE) && strcmp(func, "sr_connect") && strcmp(func, "sr_disconnect")) {
         /* store information about the held lock */
-        if ((err_info = sr_shmmain_conn_lock_update(conn, mode, 1))) {
+        if ((err_info = sr_shmmain_conn_lock_update(conn, 1))) {
             goto error_shm_remap_unlock;
         }
     }
@@ -1968,7 +2119,7 @@ error_shm_remap_unlock:
     sr_rwunlock(&conn->ext_remap_lock, remap ? SR_LOCK_WRITE : SR_LOCK_READ, func);
 
 error_shm_unlock:
-    sr_rwunlock(&((sr_main_shm_t *)conn->main_shm.addr)->lock, mode, func);
+    sr_rwunlock(&main_shm->lock, mode, func);
     return err_info;
 }
 
@@ -1976,17 +2127,20 @@ void
 sr_shmmain_unlock(sr_conn_ctx_t *conn, sr_lock_mode_t mode, int remap, const char *func)
 {
     sr_error_info_t *err_info = NULL;
+    sr_ext_shm_t *ext_shm;
     char *buf;
 
-    if (strcmp(func, "sr_connect") && strcmp(func, "sr_disconnect")) {
+    if ((mode == SR_LOCK_WRITE) && strcmp(func, "sr_connect") && strcmp(func, "sr_disconnect")) {
         /* update information about the held lock */
-        if ((err_info = sr_shmmain_conn_lock_update(conn, mode, 0))) {
+        if ((err_info = sr_shmmain_conn_lock_update(conn, 0))) {
             sr_errinfo_free(&err_info);
         }
     }
 
-    /* in case remap WRITE lock was held, it means wasted memory could have been added, defragment if needed */
-    if (remap && (*((size_t *)conn->ext_shm.addr) > SR_SHM_WASTED_MAX_MEM)) {
+    /* in case remap WRITE lock was held, it means wasted memory could have been added, defragment if needed
+     * (free chunks are being reused so only if most of ext SHM is unused) */
+    ext_shm = (sr_ext_shm_t *)conn->ext_shm.addr;
+    if (remap && (ext_shm->wasted > SR_SHM_WASTED_MAX_MEM) && (ext_shm->wasted > conn->ext_shm.size / 2)) {
         assert(mode == SR_LOCK_WRITE);
 
         SR_LOG_DBGMSG("#SHM before defrag");
@@ -1995,9 +2149,10 @@ sr_shmmain_unlock(sr_conn_ctx_t *conn, sr_lock_mode_t mode, int remap, const cha
         /* defrag mem into a separate memory */
         if (!(err_info = sr_shmmain_ext_defrag(&conn->main_shm, &conn->ext_shm, &buf))) {
             /* remap ext SHM, it does not matter if it fails, will just be kept larger than needed */
-            err_info = sr_shm_remap(&conn->ext_shm, conn->ext_shm.size - *((size_t *)conn->ext_shm.addr));
+            err_info = sr_shm_remap(&conn->ext_shm, conn->ext_shm.size - ext_shm->wasted);
+            ext_shm = (sr_ext_shm_t *)conn->ext_shm.addr;
 
-            SR_LOG_INF("Ext SHM was defragmented and %u B were saved.", *((size_t *)conn->ext_shm.addr));
+            SR_LOG_INF("Ext SHM was defragmented and %lu B were saved.", (unsigned long)ext_shm->wasted);
 
             /* copy the defragmented memory into ext SHM (has wasted set to 0) */
             memcpy(conn->ext_shm.addr, buf, conn->ext_shm.size);
@@ -2009,6 +2164,11 @@ sr_shmmain_unlock(sr_conn_ctx_t *conn, sr_lock_mode_t mode, int remap, const cha
         sr_errinfo_free(&err_info);
     }
 
+    if (remap) {
+        /* ext SHM could have been resized, let all the other connections know they need to remap it */
+        conn->ext_gen = ATOMIC_INC_RELAXED(((sr_main_shm_t *)conn->main_shm.addr)->ext_gen) + 1;
+    }
+
     /* REMAP UNLOCK */
     sr_rwunlock(&conn->ext_remap_lock, remap ? SR_LOCK_WRITE : SR_LOCK_READ, func);
 
@@ -2073,8 +2233,8 @@ sr_shmmain_rpc_subscription_del(char *ext_shm_addr, sr_rpc_t *shm_rpc, const cha
     }
 
     /* delete the subscription */
-    sr_shmrealloc_del(ext_shm_addr, &shm_rpc->subs, &shm_rpc->sub_count, sizeof *shm_sub, i,
-            sr_strshmlen(ext_shm_addr + shm_sub[i].xpath));
+    sr_shmfree(ext_shm_addr, shm_sub[i].xpath, sr_strshmlen(ext_shm_addr + shm_sub[i].xpath));
+    sr_shmrealloc_del(ext_shm_addr, &shm_rpc->subs, &shm_rpc->sub_count, sizeof *shm_sub, i);
 
     if (last_removed && !shm_rpc->subs) {
         *last_removed = 1;
@@ -2139,20 +2299,14 @@ sr_shmmain_add_rpc(sr_conn_ctx_t *conn, const char *op_path, sr_rpc_t **shm_rpc_
 {
     sr_error_info_t *err_info = NULL;
     sr_main_shm_t *main_shm;
-    off_t op_path_off;
+    off_t op_path_off, hash_off;
     sr_rpc_t *shm_rpc;
+    uint32_t hash_size;
 
     main_shm = (sr_main_shm_t *)conn->main_shm.addr;
-    shm_rpc = (sr_rpc_t *)(conn->ext_shm.addr + main_shm->rpc_subs);
-
-#ifndef NDEBUG
-    uint16_t i;
 
     /* check that this RPC does not exist yet */
-    for (i = 0; i < main_shm->rpc_sub_count; ++i) {
-        assert(strcmp(conn->ext_shm.addr + shm_rpc[i].op_path, op_path));
-    }
-#endif
+    assert(!sr_shmmain_find_rpc(main_shm, conn->ext_shm.addr, op_path, 0));
 
     /* add new RPC and allocate SHM for op_path */
     if ((err_info = sr_shmrealloc_add(&conn->ext_shm, &main_shm->rpc_subs, &main_shm->rpc_sub_count, 0,
@@ -2166,8 +2320,22 @@ sr_shmmain_add_rpc(sr_conn_ctx_t *conn, const char *op_path, sr_rpc_t **shm_rpc_
     shm_rpc->subs = 0;
     shm_rpc->sub_count = 0;
 
+    hash_size = sr_shmmain_hash_size(main_shm->rpc_sub_count);
+    if (hash_size > main_shm->rpc_hash_size) {
+        /* allocate a larger RPC hash table and free the previous one */
+        if ((err_info = sr_shmalloc(&conn->ext_shm, SR_SHM_SIZE(hash_size * sizeof(uint32_t)), &hash_off))) {
+            return err_info;
+        }
+        sr_shmfree(conn->ext_shm.addr, main_shm->rpc_hash, SR_SHM_SIZE(main_shm->rpc_hash_size * sizeof(uint32_t)));
+        main_shm->rpc_hash = hash_off;
+        main_shm->rpc_hash_size = hash_size;
+    }
+
+    /* rebuild the hash table */
+    sr_shmmain_rpc_hash_fill(main_shm, conn->ext_shm.addr);
+
     if (shm_rpc_p) {
-        *shm_rpc_p = shm_rpc;
+        *shm_rpc_p = (sr_rpc_t *)(conn->ext_shm.addr + main_shm->rpc_subs) + (main_shm->rpc_sub_count - 1);
     }
     return NULL;
 }
@@ -2186,8 +2354,18 @@ sr_shmmain_del_rpc(sr_main_shm_t *main_shm, char *ext_shm_addr, const char *op_p
     i = shm_rpc - ((sr_rpc_t *)(ext_shm_addr + main_shm->rpc_subs));
 
     /* remove the RPC and its op_path */
-    sr_shmrealloc_del(ext_shm_addr, &main_shm->rpc_subs, &main_shm->rpc_sub_count, sizeof *shm_rpc, i,
-            sr_strshmlen(ext_shm_addr + shm_rpc->op_path));
+    sr_shmfree(ext_shm_addr, shm_rpc->op_path, sr_strshmlen(ext_shm_addr + shm_rpc->op_path));
+    sr_shmrealloc_del(ext_shm_addr, &main_shm->rpc_subs, &main_shm->rpc_sub_count, sizeof *shm_rpc, i);
+
+    if (!main_shm->rpc_sub_count) {
+        /* no RPCs left, free the hash table */
+        sr_shmfree(ext_shm_addr, main_shm->rpc_hash, SR_SHM_SIZE(main_shm->rpc_hash_size * sizeof(uint32_t)));
+        main_shm->rpc_hash = 0;
+        main_shm->rpc_hash_size = 0;
+    } else {
+        /* RPC indices have changed, rebuild the hash table */
+        sr_shmmain_rpc_hash_fill(main_shm, ext_shm_addr);
+    }
 
     return NULL;
 }
@@ -2281,6 +2459,30 @@ sr_shmmain_check_data_files(sr_conn_ctx_t *conn)
             if (err_info) {
                 goto error;
             }
+
+            /* running journal, may not exist */
+            if ((err_info = sr_path_ds_journal(mod_name, 1, &path))) {
+                goto error;
+            }
+            if (sr_file_exists(path)) {
+                err_info = sr_chmodown(path, cur_owner, cur_group, cur_perm);
+            }
+            free(path);
+            if (err_info) {
+                goto error;
+            }
+
+            /* running index, may not exist */
+            if ((err_info = sr_path_ds_index(mod_name, 1, &path))) {
+                goto error;
+            }
+            if (sr_file_exists(path)) {
+                err_info = sr_chmodown(path, cur_owner, cur_group, cur_perm);
+            }
+            free(path);
+            if (err_info) {
+                goto error;
+            }
         }
 
         /*
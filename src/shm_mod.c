@@ -48,11 +48,17 @@ sr_shmmod_lock(const char *mod_name, struct sr_mod_lock_s *shm_lock, int timeout
 {
     sr_error_info_t *err_info = NULL;
     struct timespec timeout_ts;
+    uint32_t cond_seq;
     int ret;
 
     assert(timeout_ms > 0);
     assert((mode == SR_LOCK_READ) || (mode == SR_LOCK_WRITE));
 
+    if (mode == SR_LOCK_READ) {
+        /* read lock, data can be read even if the module is WRITE or DS locked */
+        return sr_rwlock(&shm_lock->lock, timeout_ms, SR_LOCK_READ, __func__);
+    }
+
     sr_time_get(&timeout_ts, timeout_ms);
 
     /* MUTEX LOCK */
@@ -62,34 +68,27 @@ sr_shmmod_lock(const char *mod_name, struct sr_mod_lock_s *shm_lock, int timeout
         return err_info;
     }
 
-    if (mode == SR_LOCK_WRITE) {
-        /* write lock */
-        ret = 0;
-        while (!ret && (shm_lock->lock.readers || ((shm_lock->write_locked || shm_lock->ds_locked) && (shm_lock->sid.sr != sid.sr)))) {
-            /* COND WAIT */
-            ret = pthread_cond_timedwait(&shm_lock->lock.cond, &shm_lock->lock.mutex, &timeout_ts);
-        }
+    /* write lock */
+    ret = 0;
+    while (!ret && (sr_rwlock_has_readers(&shm_lock->lock, &cond_seq)
+            || ((shm_lock->write_locked || shm_lock->ds_locked) && (shm_lock->sid.sr != sid.sr)))) {
+        /* COND WAIT */
+        ret = sr_rwlock_cond_wait(&shm_lock->lock, cond_seq, &timeout_ts);
+    }
 
-        if (ret) {
-            /* MUTEX UNLOCK */
-            pthread_mutex_unlock(&shm_lock->lock.mutex);
+    if (ret) {
+        /* MUTEX UNLOCK */
+        sr_rwlock_cond_unlock(&shm_lock->lock);
 
-            if ((ret == ETIMEDOUT) && (shm_lock->write_locked || shm_lock->ds_locked)) {
-                /* timeout */
-                sr_errinfo_new(&err_info, SR_ERR_LOCKED, NULL, "Module \"%s\" is %s by session %u (NC SID %u).",
-                        mod_name, shm_lock->ds_locked ? "locked" : "being used", shm_lock->sid.sr, shm_lock->sid.nc);
-            } else {
-                /* other error */
-                SR_ERRINFO_COND(&err_info, __func__, ret);
-            }
-            return err_info;
+        if ((ret == ETIMEDOUT) && (shm_lock->write_locked || shm_lock->ds_locked)) {
+            /* timeout */
+            sr_errinfo_new(&err_info, SR_ERR_LOCKED, NULL, "Module \"%s\" is %s by session %u (NC SID %u).",
+                    mod_name, shm_lock->ds_locked ? "locked" : "being used", shm_lock->sid.sr, shm_lock->sid.nc);
+        } else {
+            /* other error */
+            SR_ERRINFO_COND(&err_info, __func__, ret);
         }
-    } else {
-        /* read lock */
-        ++shm_lock->lock.readers;
-
-        /* MUTEX UNLOCK */
-        pthread_mutex_unlock(&shm_lock->lock.mutex);
+        return err_info;
     }
 
     return NULL;
@@ -158,17 +157,30 @@ sr_shmmod_modinfo_collect_edit(struct sr_mod_info_s *mod_info, const struct lyd_
     return NULL;
 }
 
-sr_error_info_t *
-sr_shmmod_modinfo_collect_xpath(struct sr_mod_info_s *mod_info, const char *xpath)
+/**
+ * @brief Learn all the modules with data selected by an XPath.
+ *
+ * @param[in] mod_info Mod info with the connection and datastore.
+ * @param[in] xpath XPath to be evaluated.
+ * @param[out] ly_mods Array of found modules.
+ * @param[out] ly_mod_count Count of @p ly_mods.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmmod_xpath_modules(struct sr_mod_info_s *mod_info, const char *xpath, const struct lys_module ***ly_mods,
+        uint32_t *ly_mod_count)
 {
     sr_error_info_t *err_info = NULL;
-    sr_mod_t *shm_mod;
     char *module_name;
     const struct lys_module *ly_mod;
     const struct lys_node *ctx_node;
     struct ly_set *set = NULL;
+    void *mem;
     uint32_t i;
 
+    *ly_mods = NULL;
+    *ly_mod_count = 0;
+
     /* get the module */
     module_name = sr_get_first_ns(xpath);
     if (!module_name) {
@@ -198,7 +210,7 @@ sr_shmmod_modinfo_collect_xpath(struct sr_mod_info_s *mod_info, const char *xpat
         return err_info;
     }
 
-    /* add all the other modules */
+    /* learn all the other modules */
     ly_mod = NULL;
     for (i = 0; i < set->number; ++i) {
         /* skip uninteresting nodes */
@@ -218,10 +230,53 @@ sr_shmmod_modinfo_collect_xpath(struct sr_mod_info_s *mod_info, const char *xpat
             continue;
         }
 
+        mem = realloc(*ly_mods, (*ly_mod_count + 1) * sizeof **ly_mods);
+        SR_CHECK_MEM_GOTO(!mem, err_info, cleanup);
+        *ly_mods = mem;
+        (*ly_mods)[*ly_mod_count] = ly_mod;
+        ++(*ly_mod_count);
+    }
+
+    /* success */
+
+cleanup:
+    ly_set_free(set);
+    if (err_info) {
+        free(*ly_mods);
+        *ly_mods = NULL;
+        *ly_mod_count = 0;
+    }
+    return err_info;
+}
+
+sr_error_info_t *
+sr_shmmod_modinfo_collect_xpath(struct sr_mod_info_s *mod_info, const char *xpath, pthread_mutex_t *xp_lock,
+        struct sr_xpath_cache_s *xp_cache)
+{
+    sr_error_info_t *err_info = NULL;
+    const struct lys_module **ly_mods = NULL;
+    uint32_t i, ly_mod_count = 0;
+    sr_mod_t *shm_mod;
+    int conventional, cached = 0;
+
+    conventional = SR_IS_CONVENTIONAL_DS(mod_info->ds) ? 1 : 0;
+    if (xp_cache && (err_info = sr_xpath_cache_find(xp_lock, xp_cache, xpath, conventional, &ly_mods, &ly_mod_count,
+            &cached))) {
+        return err_info;
+    }
+    if (!cached) {
+        /* evaluate the XPath */
+        if ((err_info = sr_shmmod_xpath_modules(mod_info, xpath, &ly_mods, &ly_mod_count))) {
+            return err_info;
+        }
+    }
+
+    /* add all the modules */
+    for (i = 0; i < ly_mod_count; ++i) {
         /* find the module in SHM and add it with any dependencies */
-        shm_mod = sr_shmmain_find_module(&mod_info->conn->main_shm, mod_info->conn->ext_shm.addr, ly_mod->name, 0);
+        shm_mod = sr_shmmain_find_module(&mod_info->conn->main_shm, mod_info->conn->ext_shm.addr, ly_mods[i]->name, 0);
         SR_CHECK_INT_GOTO(!shm_mod, err_info, cleanup);
-        if ((err_info = sr_modinfo_add_mod(shm_mod, ly_mod, MOD_INFO_REQ, MOD_INFO_DEP | MOD_INFO_INV_DEP, mod_info))) {
+        if ((err_info = sr_modinfo_add_mod(shm_mod, ly_mods[i], MOD_INFO_REQ, MOD_INFO_DEP | MOD_INFO_INV_DEP, mod_info))) {
             goto cleanup;
         }
     }
@@ -229,10 +284,16 @@ sr_shmmod_modinfo_collect_xpath(struct sr_mod_info_s *mod_info, const char *xpat
     /* sort the modules based on their offsets in the SHM so that we have a uniform order for locking */
     qsort(mod_info->mods, mod_info->mod_count, sizeof *mod_info->mods, sr_modinfo_qsort_cmp);
 
+    if (xp_cache && !cached) {
+        /* cache the modules, the connection context and so the modules cannot change */
+        err_info = sr_xpath_cache_add(xp_lock, xp_cache, xpath, conventional, ly_mods, ly_mod_count);
+        ly_mods = NULL;
+    }
+
     /* success */
 
 cleanup:
-    ly_set_free(set);
+    free(ly_mods);
     return err_info;
 }
 
@@ -702,6 +763,11 @@ sr_shmmod_change_subscription_add(sr_shm_t *shm_ext, sr_mod_t *shm_mod, const ch
     shm_sub->opts = sub_opts;
     shm_sub->evpipe_num = evpipe_num;
 
+    if (ds == SR_DS_RUNNING) {
+        /* enabled operational data may have changed */
+        ATOMIC_INC_RELAXED(shm_mod->oper_ver);
+    }
+
     return NULL;
 }
 
@@ -736,8 +802,15 @@ sr_shmmod_change_subscription_del(char *ext_shm_addr, sr_mod_t *shm_mod, const c
     }
 
     /* remove the subscription and its xpath, if any */
-    sr_shmrealloc_del(ext_shm_addr, &shm_mod->change_sub[ds].subs, &shm_mod->change_sub[ds].sub_count, sizeof *shm_sub,
-            i, shm_sub[i].xpath ? sr_strshmlen(ext_shm_addr + shm_sub[i].xpath) : 0);
+    if (shm_sub[i].xpath) {
+        sr_shmfree(ext_shm_addr, shm_sub[i].xpath, sr_strshmlen(ext_shm_addr + shm_sub[i].xpath));
+    }
+    sr_shmrealloc_del(ext_shm_addr, &shm_mod->change_sub[ds].subs, &shm_mod->change_sub[ds].sub_count, sizeof *shm_sub, i);
+
+    if (ds == SR_DS_RUNNING) {
+        /* enabled operational data may have changed */
+        ATOMIC_INC_RELAXED(shm_mod->oper_ver);
+    }
 
     if (!shm_mod->change_sub[ds].subs && last_removed) {
         *last_removed = 1;
@@ -841,7 +914,7 @@ sr_shmmod_oper_subscription_add(sr_shm_t *shm_ext, sr_mod_t *shm_mod, const char
 
 int
 sr_shmmod_oper_subscription_del(char *ext_shm_addr, sr_mod_t *shm_mod, const char *xpath, uint32_t evpipe_num,
-        int only_evpipe, const char **xpath_p)
+        int only_evpipe, uint32_t *xpath_hash_p)
 {
     sr_mod_oper_sub_t *shm_sub;
     uint16_t i;
@@ -862,13 +935,15 @@ sr_shmmod_oper_subscription_del(char *ext_shm_addr, sr_mod_t *shm_mod, const cha
         return 1;
     }
 
-    if (xpath_p) {
-        *xpath_p = ext_shm_addr + shm_sub[i].xpath;
+    if (xpath_hash_p) {
+        *xpath_hash_p = sr_str_hash(ext_shm_addr + shm_sub[i].xpath);
     }
 
-    /* delete the subscription */
-    sr_shmrealloc_del(ext_shm_addr, &shm_mod->oper_subs, &shm_mod->oper_sub_count, sizeof *shm_sub, i,
-            shm_sub[i].xpath ? sr_strshmlen(ext_shm_addr + shm_sub[i].xpath) : 0);
+    /* delete the subscription and its xpath */
+    if (shm_sub[i].xpath) {
+        sr_shmfree(ext_shm_addr, shm_sub[i].xpath, sr_strshmlen(ext_shm_addr + shm_sub[i].xpath));
+    }
+    sr_shmrealloc_del(ext_shm_addr, &shm_mod->oper_subs, &shm_mod->oper_sub_count, sizeof *shm_sub, i);
 
     return 0;
 }
@@ -880,12 +955,13 @@ sr_shmmod_oper_subscription_stop(char *ext_shm_addr, sr_mod_t *shm_mod, const ch
     sr_error_info_t *err_info = NULL;
     const char *mod_name;
     char *path;
+    uint32_t xpath_hash;
 
     mod_name = ext_shm_addr + shm_mod->name;
 
     do {
         /* remove the subscriptions from the main SHM */
-        if (sr_shmmod_oper_subscription_del(ext_shm_addr, shm_mod, xpath, evpipe_num, all_evpipe, &xpath)) {
+        if (sr_shmmod_oper_subscription_del(ext_shm_addr, shm_mod, xpath, evpipe_num, all_evpipe, &xpath_hash)) {
             if (!all_evpipe) {
                 SR_ERRINFO_INT(&err_info);
             }
@@ -893,7 +969,7 @@ sr_shmmod_oper_subscription_stop(char *ext_shm_addr, sr_mod_t *shm_mod, const ch
         }
 
         /* delete the SHM file itself so that there is no leftover event */
-        if ((err_info = sr_path_sub_shm(mod_name, "oper", sr_str_hash(xpath), 0, &path))) {
+        if ((err_info = sr_path_sub_shm(mod_name, "oper", xpath_hash, 0, &path))) {
             break;
         }
         if (shm_unlink(path) == -1) {
@@ -946,7 +1022,7 @@ sr_shmmod_notif_subscription_del(char *ext_shm_addr, sr_mod_t *shm_mod, uint32_t
     }
 
     /* remove the subscription */
-    sr_shmrealloc_del(ext_shm_addr, &shm_mod->notif_subs, &shm_mod->notif_sub_count, sizeof *shm_sub, i, 0);
+    sr_shmrealloc_del(ext_shm_addr, &shm_mod->notif_subs, &shm_mod->notif_sub_count, sizeof *shm_sub, i);
 
     if (!shm_mod->notif_subs && last_removed) {
         *last_removed = 1;
@@ -1045,6 +1121,7 @@ sr_shmmod_oper_stored_del_conn(sr_conn_ctx_t *conn, sr_conn_ctx_t *del_conn, pid
             if ((err_info = sr_module_file_data_set(mod->ly_mod->name, SR_DS_OPERATIONAL, diff, 0, 0))) {
                 goto cleanup;
             }
+            ATOMIC_INC_RELAXED(mod->shm_mod->oper_ver);
             lyd_free_withsiblings(diff);
             diff = NULL;
         }
@@ -26,6 +26,12 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#ifdef SR_HAVE_EPOLL
+# include <sys/epoll.h>
+# include <sys/eventfd.h>
+#endif
 #include <string.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -109,6 +115,7 @@ sr_shmsub_notify_new_wrlock(sr_sub_shm_t *sub_shm, const char *shm_name, sr_sub_
 {
     sr_error_info_t *err_info = NULL;
     struct timespec timeout_ts;
+    uint32_t cond_seq;
     int ret;
 
     sr_time_get(&timeout_ts, SR_MAIN_LOCK_TIMEOUT * 1000);
@@ -122,14 +129,15 @@ sr_shmsub_notify_new_wrlock(sr_sub_shm_t *sub_shm, const char *shm_name, sr_sub_
 
     /* wait until there is no event */
     ret = 0;
-    while (!ret && (sub_shm->lock.readers || (sub_shm->event && (sub_shm->event != lock_event)))) {
+    while (!ret && (sr_rwlock_has_readers(&sub_shm->lock, &cond_seq)
+            || (sub_shm->event && (sub_shm->event != lock_event)))) {
         /* COND WAIT */
-        ret = pthread_cond_timedwait(&sub_shm->lock.cond, &sub_shm->lock.mutex, &timeout_ts);
+        ret = sr_rwlock_cond_wait(&sub_shm->lock, cond_seq, &timeout_ts);
     }
 
     if (ret) {
         /* MUTEX UNLOCK */
-        pthread_mutex_unlock(&sub_shm->lock.mutex);
+        sr_rwlock_cond_unlock(&sub_shm->lock);
 
         if ((ret == ETIMEDOUT) && sub_shm->event) {
             /* timeout */
@@ -168,7 +176,7 @@ sr_shmsub_notify_finish_wrunlock(sr_sub_shm_t *sub_shm, size_t shm_struct_size,
     sr_error_t err_code;
     char *ptr, *err_msg, *err_xpath;
     sr_sub_event_t event;
-    uint32_t request_id;
+    uint32_t request_id, cond_seq;
     int ret;
 
     assert((expected_ev == SR_SUB_EV_NONE) || (expected_ev == SR_SUB_EV_SUCCESS) || (expected_ev == SR_SUB_EV_ERROR));
@@ -179,9 +187,10 @@ sr_shmsub_notify_finish_wrunlock(sr_sub_shm_t *sub_shm, size_t shm_struct_size,
 
     /* wait until this event was processed */
     ret = 0;
-    while (!ret && (sub_shm->lock.readers || (!SR_IS_NOTIFY_EVENT(sub_shm->event) && (sub_shm->event != SR_SUB_EV_NONE)))) {
+    while (!ret && (sr_rwlock_has_readers(&sub_shm->lock, &cond_seq)
+            || (!SR_IS_NOTIFY_EVENT(sub_shm->event) && (sub_shm->event != SR_SUB_EV_NONE)))) {
         /* COND WAIT */
-        ret = pthread_cond_timedwait(&sub_shm->lock.cond, &sub_shm->lock.mutex, &timeout_ts);
+        ret = sr_rwlock_cond_wait(&sub_shm->lock, cond_seq, &timeout_ts);
     }
 
     if (ret) {
@@ -189,9 +198,9 @@ sr_shmsub_notify_finish_wrunlock(sr_sub_shm_t *sub_shm, size_t shm_struct_size,
             /* handle corner-case when the subscriber has just woken up and is processing this event,
              * lock should never be held for long */
             sr_time_get(&timeout_ts, SR_RWLOCK_READ_TIMEOUT);
-            while (sub_shm->lock.readers) {
+            while (sr_rwlock_has_readers(&sub_shm->lock, &cond_seq)) {
                 /* COND WAIT */
-                pthread_cond_timedwait(&sub_shm->lock.cond, &sub_shm->lock.mutex, &timeout_ts);
+                sr_rwlock_cond_wait(&sub_shm->lock, cond_seq, &timeout_ts);
             }
 
             /* event timeout */
@@ -248,7 +257,32 @@ sr_shmsub_notify_finish_wrunlock(sr_sub_shm_t *sub_shm, size_t shm_struct_size,
     }
 
     /* MUTEX UNLOCK */
-    pthread_mutex_unlock(&sub_shm->lock.mutex);
+    sr_rwlock_cond_unlock(&sub_shm->lock);
+
+    return err_info;
+}
+
+/**
+ * @brief Lock a subscription SHM with an already published event again so that
+ * ::sr_shmsub_notify_finish_wrunlock() can be used to wait for it.
+ *
+ * @param[in] sub_shm Subscription SHM to lock.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmsub_notify_relock(sr_sub_shm_t *sub_shm)
+{
+    sr_error_info_t *err_info = NULL;
+    struct timespec timeout_ts;
+    int ret;
+
+    sr_time_get(&timeout_ts, SR_MAIN_LOCK_TIMEOUT * 1000);
+
+    /* MUTEX LOCK */
+    ret = pthread_mutex_timedlock(&sub_shm->lock.mutex, &timeout_ts);
+    if (ret) {
+        SR_ERRINFO_LOCK(&err_info, __func__, ret);
+    }
 
     return err_info;
 }
@@ -380,28 +414,101 @@ sr_shmsub_change_is_valid(sr_sub_event_t ev, sr_subscr_options_t sub_opts)
     return 1;
 }
 
+/**
+ * @brief Whether a diff includes any changes selected by a change subscription XPath.
+ *
+ * @param[in] diff Diff of the event.
+ * @param[in] xpath Subscription XPath, NULL for the whole module.
+ * @return 0 if not, non-zero if it does.
+ */
+static int
+sr_shmsub_change_filter_is_valid(const struct lyd_node *diff, const char *xpath)
+{
+    struct ly_set *set = NULL;
+    const struct lyd_node *next, *elem;
+    uint32_t i;
+    enum edit_op op;
+    int ret = 0;
+
+    if (!xpath) {
+        return 1;
+    }
+
+    set = lyd_find_path(diff, xpath);
+    assert(set);
+
+    for (i = 0; i < set->number; ++i) {
+        LY_TREE_DFS_BEGIN(set->set.d[i], next, elem) {
+            op = sr_edit_find_oper(elem, 0, NULL);
+            if (op && (op != EDIT_NONE)) {
+                ret = 1;
+                break;
+            }
+            LY_TREE_DFS_END(set->set.d[i], next, elem);
+        }
+        if (ret) {
+            break;
+        }
+    }
+    ly_set_free(set);
+
+    return ret;
+}
+
+/**
+ * @brief Evaluate XPath filters of all module change subscriptions on a diff so that only the subscribers
+ * interested in the changes are counted and notified. Subscribers evaluate the very same filters.
+ *
+ * @param[in] ext_shm_addr Ext SHM address.
+ * @param[in] shm_msub Module change subscriptions in ext SHM.
+ * @param[in] msub_count Number of @p shm_msub.
+ * @param[in] diff Diff of the event.
+ * @param[in,out] match_p Flag for every subscription whether it is interested in the changes, previous array is reused.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmsub_change_notify_filter(char *ext_shm_addr, sr_mod_change_sub_t *shm_msub, uint32_t msub_count,
+        const struct lyd_node *diff, uint8_t **match_p)
+{
+    sr_error_info_t *err_info = NULL;
+    uint8_t *match;
+    uint32_t i;
+
+    if (!msub_count) {
+        return NULL;
+    }
+
+    match = realloc(*match_p, msub_count * sizeof *match);
+    SR_CHECK_MEM_RET(!match, err_info);
+    *match_p = match;
+
+    for (i = 0; i < msub_count; ++i) {
+        match[i] = sr_shmsub_change_filter_is_valid(diff, shm_msub[i].xpath ? ext_shm_addr + shm_msub[i].xpath : NULL);
+    }
+
+    return NULL;
+}
+
 /**
  * @brief Learn whether there is a subscription for a change event.
  *
- * @param[in] ext_shm_addr Main SHM mapping address.
- * @param[in] mod Mod info module to use.
- * @param[in] ds Datastore.
+ * @param[in] shm_msub Module change subscriptions, either in ext SHM or their snapshot.
+ * @param[in] msub_count Number of @p shm_msub.
+ * @param[in] match Optional flags of subscriptions interested in the changes, see ::sr_shmsub_change_notify_filter().
  * @param[in] ev Event.
  * @param[out] max_priority_p Highest priority among the valid subscribers.
  * @return 0 if not, non-zero if there is.
  */
 static int
-sr_shmsub_change_notify_has_subscription(char *ext_shm_addr, struct sr_mod_info_mod_s *mod, sr_datastore_t ds,
+sr_shmsub_change_notify_has_subscription(sr_mod_change_sub_t *shm_msub, uint32_t msub_count, const uint8_t *match,
         sr_sub_event_t ev, uint32_t *max_priority_p)
 {
     int has_sub = 0;
     uint32_t i;
-    sr_mod_change_sub_t *shm_msub;
 
-    shm_msub = (sr_mod_change_sub_t *)(ext_shm_addr + mod->shm_mod->change_sub[ds].subs);
     *max_priority_p = 0;
-    for (i = 0; i < mod->shm_mod->change_sub[ds].sub_count; ++i) {
-        if (!sr_shmsub_change_is_valid(ev, shm_msub[i].opts)) {
+    for (i = 0; i < msub_count; ++i) {
+        if (!sr_shmsub_change_is_valid(ev, shm_msub[i].opts) || (match && !match[i])) {
             continue;
         }
 
@@ -418,9 +525,9 @@ sr_shmsub_change_notify_has_subscription(char *ext_shm_addr, struct sr_mod_info_
 /**
  * @brief Learn the priority of the next valid subscriber for a change event.
  *
- * @param[in] ext_shm_addr Main SHM mapping address.
- * @param[in] mod Mod info module to use.
- * @param[in] ds Datastore.
+ * @param[in] shm_msub Module change subscriptions, either in ext SHM or their snapshot.
+ * @param[in] msub_count Number of @p shm_msub.
+ * @param[in] match Optional flags of subscriptions interested in the changes, see ::sr_shmsub_change_notify_filter().
  * @param[in] ev Change event.
  * @param[in] last_priority Last priorty of a subscriber.
  * @param[out] next_priorty_p Next priorty of a subsciber(s).
@@ -428,17 +535,15 @@ sr_shmsub_change_notify_has_subscription(char *ext_shm_addr, struct sr_mod_info_
  * @param[out] opts_p Optional options of all subscribers with this priority.
  */
 static void
-sr_shmsub_change_notify_next_subscription(char *ext_shm_addr, struct sr_mod_info_mod_s *mod, sr_datastore_t ds,
+sr_shmsub_change_notify_next_subscription(sr_mod_change_sub_t *shm_msub, uint32_t msub_count, const uint8_t *match,
         sr_sub_event_t ev, uint32_t last_priority, uint32_t *next_priority_p, uint32_t *sub_count_p, int *opts_p)
 {
     uint32_t i;
-    sr_mod_change_sub_t *shm_msub;
     int opts = 0;
 
-    shm_msub = (sr_mod_change_sub_t *)(ext_shm_addr + mod->shm_mod->change_sub[ds].subs);
     *sub_count_p = 0;
-    for (i = 0; i < mod->shm_mod->change_sub[ds].sub_count; ++i) {
-        if (!sr_shmsub_change_is_valid(ev, shm_msub[i].opts)) {
+    for (i = 0; i < msub_count; ++i) {
+        if (!sr_shmsub_change_is_valid(ev, shm_msub[i].opts) || (match && !match[i])) {
             continue;
         }
 
@@ -470,70 +575,218 @@ sr_shmsub_change_notify_next_subscription(char *ext_shm_addr, struct sr_mod_info
     }
 }
 
-sr_error_info_t *
-sr_shmsub_notify_evpipe(uint32_t evpipe_num)
+/**
+ * @brief Remove cached event pipes whose readers are gone (subscriptions were removed).
+ *
+ * Connection event pipe lock is expected to be held.
+ *
+ * @param[in] conn Connection to use.
+ */
+static void
+sr_shmsub_evpipe_cache_prune(sr_conn_ctx_t *conn)
+{
+    struct pollfd *fds;
+    uint32_t i, j;
+
+    if (!conn->evpipe_count) {
+        return;
+    }
+
+    fds = malloc(conn->evpipe_count * sizeof *fds);
+    if (!fds) {
+        /* just do not prune */
+        return;
+    }
+    for (i = 0; i < conn->evpipe_count; ++i) {
+        fds[i].fd = conn->evpipes[i].fd;
+        fds[i].events = POLLOUT;
+        fds[i].revents = 0;
+    }
+
+    /* write end of a FIFO reports an error once there are no readers */
+    if (poll(fds, conn->evpipe_count, 0) > 0) {
+        for (i = 0, j = 0; i < conn->evpipe_count; ++i) {
+            if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                close(conn->evpipes[i].fd);
+                continue;
+            }
+            conn->evpipes[j++] = conn->evpipes[i];
+        }
+        conn->evpipe_count = j;
+    }
+
+    free(fds);
+}
+
+/**
+ * @brief Get a cached opened write file descriptor of an event pipe, open and cache it if not yet opened.
+ *
+ * Connection event pipe lock is expected to be held.
+ *
+ * @param[in] conn Connection to use.
+ * @param[in] evpipe_num Subscriber event pipe number.
+ * @param[out] idx Index of the event pipe in the connection cache.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmsub_evpipe_cache_get(sr_conn_ctx_t *conn, uint32_t evpipe_num, uint32_t *idx)
 {
     sr_error_info_t *err_info = NULL;
-    char *path = NULL, buf[1] = {0};
-    int fd = -1, ret;
+    char *path = NULL;
+    void *mem;
+    int fd;
+
+    for (*idx = 0; *idx < conn->evpipe_count; ++(*idx)) {
+        if (conn->evpipes[*idx].evpipe_num == evpipe_num) {
+            return NULL;
+        }
+    }
+
+    /* new event pipe, a good time to forget the ones that will not be needed anymore */
+    sr_shmsub_evpipe_cache_prune(conn);
 
     /* get path to the pipe */
     if ((err_info = sr_path_evpipe(evpipe_num, &path))) {
-        goto cleanup;
+        return err_info;
     }
 
     /* open pipe for writing */
     if ((fd = open(path, O_WRONLY | O_NONBLOCK)) == -1) {
         sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Opening \"%s\" for writing failed (%s).", path, strerror(errno));
-        goto cleanup;
+        free(path);
+        return err_info;
+    }
+    free(path);
+
+    /* cache it */
+    mem = realloc(conn->evpipes, (conn->evpipe_count + 1) * sizeof *conn->evpipes);
+    if (!mem) {
+        close(fd);
+        SR_ERRINFO_MEM(&err_info);
+        return err_info;
     }
+    conn->evpipes = mem;
+    *idx = conn->evpipe_count;
+    conn->evpipes[*idx].evpipe_num = evpipe_num;
+    conn->evpipes[*idx].fd = fd;
+    ++conn->evpipe_count;
+
+    return NULL;
+}
+
+/**
+ * @brief Write one byte into an event pipe without generating SIGPIPE if there are no readers.
+ *
+ * @param[in] fd Event pipe write file descriptor.
+ * @return Same as write(2).
+ */
+static ssize_t
+sr_shmsub_evpipe_write(int fd)
+{
+    sigset_t sigpipe_mask, old_mask, pending;
+    struct timespec ts = {0};
+    char buf[1] = {0};
+    ssize_t ret;
+    int err;
+
+    sigemptyset(&sigpipe_mask);
+    sigaddset(&sigpipe_mask, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe_mask, &old_mask);
 
     /* write one arbitrary byte */
     do {
         ret = write(fd, buf, 1);
     } while (!ret);
-    if (ret == -1) {
+    err = errno;
+
+    if ((ret == -1) && (err == EPIPE) && !sigismember(&old_mask, SIGPIPE)) {
+        /* consume the generated signal so that it is not delivered once unblocked */
+        sigpending(&pending);
+        if (sigismember(&pending, SIGPIPE)) {
+            sigtimedwait(&sigpipe_mask, NULL, &ts);
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    errno = err;
+    return ret;
+}
+
+sr_error_info_t *
+sr_shmsub_notify_evpipe(sr_conn_ctx_t *conn, uint32_t evpipe_num)
+{
+    sr_error_info_t *err_info = NULL;
+    uint32_t idx;
+
+    /* EVPIPE LOCK */
+    if ((err_info = sr_mlock(&conn->evpipe_lock, SR_MAIN_LOCK_TIMEOUT * 1000, __func__))) {
+        return err_info;
+    }
+
+    /* get the opened pipe */
+    if ((err_info = sr_shmsub_evpipe_cache_get(conn, evpipe_num, &idx))) {
+        goto cleanup_unlock;
+    }
+
+    if (sr_shmsub_evpipe_write(conn->evpipes[idx].fd) == -1) {
         SR_ERRINFO_SYSERRNO(&err_info, "write");
-        goto cleanup;
+
+        /* the pipe is unusable, do not keep it */
+        close(conn->evpipes[idx].fd);
+        --conn->evpipe_count;
+        if (idx < conn->evpipe_count) {
+            conn->evpipes[idx] = conn->evpipes[conn->evpipe_count];
+        }
+        goto cleanup_unlock;
     }
 
     /* success */
 
-cleanup:
-    if (fd > -1) {
-        close(fd);
-    }
-    free(path);
+cleanup_unlock:
+    /* EVPIPE UNLOCK */
+    sr_munlock(&conn->evpipe_lock);
     return err_info;
 }
 
+void
+sr_shmsub_evpipe_cache_clear(sr_conn_ctx_t *conn)
+{
+    uint32_t i;
+
+    for (i = 0; i < conn->evpipe_count; ++i) {
+        close(conn->evpipes[i].fd);
+    }
+    free(conn->evpipes);
+    conn->evpipes = NULL;
+    conn->evpipe_count = 0;
+}
+
 /**
  * @brief Write into change subscribers event pipe to notify them there is a new event.
  *
- * @param[in] ext_shm_addr Ext SHM address.
- * @param[in] mod Mod info module to use.
- * @param[in] ds Datastore.
+ * @param[in] conn Connection to use.
+ * @param[in] shm_msub Module change subscriptions, either in ext SHM or their snapshot.
+ * @param[in] msub_count Number of @p shm_msub.
+ * @param[in] match Optional flags of subscriptions interested in the changes, see ::sr_shmsub_change_notify_filter().
  * @param[in] ev Change event.
  * @param[in] priority Priority of the subscribers with new event.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
-sr_shmsub_change_notify_evpipe(char *ext_shm_addr, struct sr_mod_info_mod_s *mod, sr_datastore_t ds, sr_sub_event_t ev,
-        uint32_t priority)
+sr_shmsub_change_notify_evpipe(sr_conn_ctx_t *conn, sr_mod_change_sub_t *shm_msub, uint32_t msub_count,
+        const uint8_t *match, sr_sub_event_t ev, uint32_t priority)
 {
     sr_error_info_t *err_info = NULL;
     uint32_t i;
-    sr_mod_change_sub_t *shm_msub;
 
-    shm_msub = (sr_mod_change_sub_t *)(ext_shm_addr + mod->shm_mod->change_sub[ds].subs);
-    for (i = 0; i < mod->shm_mod->change_sub[ds].sub_count; ++i) {
-        if (!sr_shmsub_change_is_valid(ev, shm_msub[i].opts)) {
+    for (i = 0; i < msub_count; ++i) {
+        if (!sr_shmsub_change_is_valid(ev, shm_msub[i].opts) || (match && !match[i])) {
             continue;
         }
 
         /* valid subscription */
         if (shm_msub[i].priority == priority) {
-            if ((err_info = sr_shmsub_notify_evpipe(shm_msub[i].evpipe_num))) {
+            if ((err_info = sr_shmsub_notify_evpipe(conn, shm_msub[i].evpipe_num))) {
                 return err_info;
             }
         }
@@ -574,103 +827,448 @@ sr_shmsub_change_notify_diff_has_changes(struct sr_mod_info_mod_s *mod, const st
     return 0;
 }
 
-sr_error_info_t *
-sr_shmsub_change_notify_update(struct sr_mod_info_s *mod_info, sr_sid_t sid, uint32_t timeout_ms,
+/**
+ * @brief Module state of a concurrently delivered change event.
+ */
+struct sr_shmsub_change_mod_s {
+    struct sr_mod_info_mod_s *mod;  /**< Mod info module. */
+    sr_mod_change_sub_t *shm_msub;  /**< Module change subscriptions, either in ext SHM or @p msub_snap. */
+    sr_mod_change_sub_t *msub_snap; /**< Snapshot of the module change subscriptions, if made. */
+    uint32_t msub_count;            /**< Number of module change subscriptions. */
+    uint8_t *match;                 /**< Subscriptions interested in the changes. */
+    sr_shm_t shm_sub;               /**< Module subscription SHM. */
+    char *diff_lyb;                 /**< Module diff in LYB. */
+    uint32_t diff_lyb_len;          /**< Length of @p diff_lyb. */
+    uint32_t cur_priority;          /**< Priority of the subscribers being notified. */
+    uint32_t subscriber_count;      /**< Number of subscribers with @p cur_priority, 0 if all were notified. */
+    int published;                  /**< Whether the event was published in the current round. */
+    struct lyd_node *edit;          /**< Collected "update" edit. */
+};
+
+/**
+ * @brief Notify subscribers of all the modules about a change event concurrently.
+ *
+ * The event is delivered in rounds. In each round the event for the next priority of every module is published
+ * first and only then all of them are waited for so the subscribers of independent modules process it in parallel.
+ * Priorities of a single module are still notified in order. Once any subscriber fails, no more rounds are published
+ * and all the modules stay with the priority they have processed, which is what "abort" relies on.
+ *
+ * @param[in] mod_info Mod info to use.
+ * @param[in] sid Originator sysrepo session ID.
+ * @param[in] ev Change event, "update", "change", or "done".
+ * @param[in] timeout_ms Timeout in milliseconds, 0 to not wait for "done" subscribers.
+ * @param[out] update_edit Collected "update" edit, only for ::SR_SUB_EV_UPDATE.
+ * @param[out] cb_err_info Callback error information generated by a subscriber, if any.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmsub_change_notify_concurrent(struct sr_mod_info_s *mod_info, sr_sid_t sid, sr_sub_event_t ev, uint32_t timeout_ms,
         struct lyd_node **update_edit, sr_error_info_t **cb_err_info)
 {
-    sr_error_info_t *err_info = NULL;
+    sr_error_info_t *err_info = NULL, *tmp_err_info, *mod_cb_err_info = NULL;
     sr_multi_sub_shm_t *multi_sub_shm;
     struct sr_mod_info_mod_s *mod = NULL;
+    struct sr_shmsub_change_mod_s *cmods = NULL, *cmod;
+    sr_mod_change_sub_t *shm_msub;
     struct lyd_node *edit;
-    uint32_t cur_priority, subscriber_count, diff_lyb_len, *aux = NULL;
-    char *diff_lyb = NULL;
     struct ly_ctx *ly_ctx;
-    sr_shm_t shm_sub = SR_SHM_INITIALIZER;
+    sr_sub_event_t expected_ev;
+    uint32_t i, j, cmod_count = 0, msub_count, cur_priority, *aux = NULL;
+    uint8_t *match = NULL;
+    int unlock = 0, unlocked = 0, failed = 0, pending;
+    void *mem;
+
+    assert((ev == SR_SUB_EV_UPDATE) || (ev == SR_SUB_EV_CHANGE) || (ev == SR_SUB_EV_DONE));
+    assert((ev == SR_SUB_EV_UPDATE) == !!update_edit);
 
-    assert(mod_info->diff);
-    *update_edit = NULL;
     ly_ctx = lyd_node_module(mod_info->diff)->ctx;
+    if (ev == SR_SUB_EV_DONE) {
+        expected_ev = SR_SUB_EV_NONE;
+    } else if (ev == SR_SUB_EV_UPDATE) {
+        expected_ev = SR_SUB_EV_ERROR;
+        *update_edit = NULL;
+    } else {
+        expected_ev = SR_SUB_EV_SUCCESS;
+    }
 
+    /* learn about all the modules with subscribers */
     while ((mod = sr_modinfo_next_mod(mod, mod_info, mod_info->diff, &aux))) {
+        /* module change subscriptions */
+        shm_msub = (sr_mod_change_sub_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->change_sub[mod_info->ds].subs);
+        msub_count = mod->shm_mod->change_sub[mod_info->ds].sub_count;
+
         /* first check that there actually are some value changes (and not only dflt changes) */
         if (!sr_shmsub_change_notify_diff_has_changes(mod, mod_info->diff)) {
             continue;
         }
 
+        /* learn which subscriptions are interested in the changes */
+        if ((err_info = sr_shmsub_change_notify_filter(mod_info->conn->ext_shm.addr, shm_msub, msub_count,
+                mod_info->diff, &match))) {
+            goto cleanup;
+        }
+
         /* just find out whether there are any subscriptions and if so, what is the highest priority */
-        if (!sr_shmsub_change_notify_has_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_UPDATE,
-                &cur_priority)) {
+        if (!sr_shmsub_change_notify_has_subscription(shm_msub, msub_count, match, ev, &cur_priority)) {
+            if ((ev == SR_SUB_EV_CHANGE) && (mod_info->ds == SR_DS_RUNNING) && !sr_shmsub_change_notify_has_subscription(
+                    shm_msub, msub_count, match, SR_SUB_EV_DONE, &cur_priority)) {
+                SR_LOG_INF("There are no subscribers for changes of the module \"%s\" in %s DS.",
+                        mod->ly_mod->name, sr_ds2str(mod_info->ds));
+            }
             continue;
         }
 
-        /* prepare diff to write into SHM */
-        if (!diff_lyb && lyd_print_mem(&diff_lyb, mod_info->diff, LYD_LYB, LYP_WITHSIBLINGS)) {
-            sr_errinfo_new_ly(&err_info, ly_ctx);
-            SR_ERRINFO_INT(&err_info);
+        mem = realloc(cmods, (cmod_count + 1) * sizeof *cmods);
+        SR_CHECK_MEM_GOTO(!mem, err_info, cleanup);
+        cmods = mem;
+        cmod = &cmods[cmod_count];
+        ++cmod_count;
+
+        memset(cmod, 0, sizeof *cmod);
+        cmod->shm_sub.fd = -1;
+        cmod->mod = mod;
+        cmod->shm_msub = shm_msub;
+        cmod->msub_count = msub_count;
+        cmod->match = match;
+        match = NULL;
+
+        /* prepare the diff of this module to write into subscription SHM */
+        if ((err_info = sr_module_data_print_lyb(mod_info->diff, mod->ly_mod, &cmod->diff_lyb,
+                &cmod->diff_lyb_len))) {
             goto cleanup;
         }
-        diff_lyb_len = lyd_lyb_data_length(diff_lyb);
 
         /* open sub SHM and map it */
-        if ((err_info = sr_shmsub_open_map(mod->ly_mod->name, sr_ds2str(mod_info->ds), -1, &shm_sub, sizeof *multi_sub_shm))) {
+        if ((err_info = sr_shmsub_open_map(mod->ly_mod->name, sr_ds2str(mod_info->ds), -1, &cmod->shm_sub,
+                sizeof *multi_sub_shm))) {
             goto cleanup;
         }
-        multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
 
         /* correctly start the loop, with fake last priority 1 higher than the actual highest */
-        sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_UPDATE,
-                cur_priority + 1, &cur_priority, &subscriber_count, NULL);
+        sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, cmod->match, ev, cur_priority + 1,
+                &cmod->cur_priority, &cmod->subscriber_count, NULL);
+
+        if (ev == SR_SUB_EV_CHANGE) {
+            for (j = 0; j < msub_count; ++j) {
+                if ((shm_msub[j].opts & SR_SUBSCR_UNLOCKED) && cmod->match[j]
+                        && sr_shmsub_change_is_valid(ev, shm_msub[j].opts)) {
+                    unlock = 1;
+                }
+            }
+        }
+    }
 
-        do {
-            /* there cannot be more subscribers on one module with the same priority */
-            assert(subscriber_count == 1);
+    if (unlock) {
+        /* some subscribers want subscriptions (main/ext SHM) unlocked, so make a snapshot of only
+         * the module change subscriptions, they are all we need, and unlock it for the whole delivery */
+        for (i = 0; i < cmod_count; ++i) {
+            cmods[i].msub_snap = malloc(cmods[i].msub_count * sizeof *cmods[i].msub_snap);
+            SR_CHECK_MEM_GOTO(!cmods[i].msub_snap, err_info, cleanup);
+            memcpy(cmods[i].msub_snap, cmods[i].shm_msub, cmods[i].msub_count * sizeof *cmods[i].msub_snap);
+
+            /* update pointers */
+            cmods[i].shm_msub = cmods[i].msub_snap;
+        }
+
+        /* SHM UNLOCK */
+        sr_shmmain_unlock(mod_info->conn, SR_LOCK_READ, 0, __func__);
+        unlocked = 1;
+    }
+
+    do {
+        /* publish the event for the current priority of all the modules first */
+        for (i = 0; i < cmod_count; ++i) {
+            cmod = &cmods[i];
+            cmod->published = 0;
+            if (!cmod->subscriber_count) {
+                continue;
+            }
+            multi_sub_shm = (sr_multi_sub_shm_t *)cmod->shm_sub.addr;
 
             /* SUB WRITE LOCK */
-            if ((err_info = sr_shmsub_notify_new_wrlock((sr_sub_shm_t *)multi_sub_shm, mod->ly_mod->name, 0))) {
-                goto cleanup;
+            if ((err_info = sr_shmsub_notify_new_wrlock((sr_sub_shm_t *)multi_sub_shm, cmod->mod->ly_mod->name, 0))) {
+                break;
             }
 
             /* remap sub SHM once we have the lock, it will do anything only on the first call */
-            err_info = sr_shm_remap(&shm_sub, sizeof *multi_sub_shm + diff_lyb_len);
-            if (err_info) {
-                goto cleanup_wrunlock;
+            if ((err_info = sr_shm_remap(&cmod->shm_sub, sizeof *multi_sub_shm + cmod->diff_lyb_len))) {
+                /* SUB WRITE UNLOCK */
+                sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
+                break;
             }
-            multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
+            multi_sub_shm = (sr_multi_sub_shm_t *)cmod->shm_sub.addr;
 
-            /* write "update" event */
-            if (!mod->request_id) {
-                mod->request_id = ++multi_sub_shm->request_id;
+            /* write the event */
+            if (!cmod->mod->request_id) {
+                cmod->mod->request_id = ++multi_sub_shm->request_id;
             }
-            sr_shmsub_multi_notify_write_event(multi_sub_shm, mod->request_id, cur_priority, SR_SUB_EV_UPDATE, &sid,
-                    subscriber_count, 0, diff_lyb, diff_lyb_len, mod->ly_mod->name);
-
-            /* notify using event pipe and wait until all the subscribers have processed the event */
-            if ((err_info = sr_shmsub_change_notify_evpipe(mod_info->conn->ext_shm.addr, mod, mod_info->ds,
-                    SR_SUB_EV_UPDATE, cur_priority))) {
-                goto cleanup_wrunlock;
+            sr_shmsub_multi_notify_write_event(multi_sub_shm, cmod->mod->request_id, cmod->cur_priority, ev, &sid,
+                    cmod->subscriber_count, 0, cmod->diff_lyb, cmod->diff_lyb_len, cmod->mod->ly_mod->name);
+            cmod->published = 1;
+            if (ev == SR_SUB_EV_CHANGE) {
+                /* its subscribers will need "abort" on failure, request ID was possibly set by "update" already */
+                cmod->mod->change_published = 1;
             }
 
+            /* notify using event pipe */
+            err_info = sr_shmsub_change_notify_evpipe(mod_info->conn, cmod->shm_msub, cmod->msub_count, cmod->match, ev,
+                    cmod->cur_priority);
+
             /* SUB WRITE UNLOCK */
-            if ((err_info = sr_shmsub_notify_finish_wrunlock((sr_sub_shm_t *)multi_sub_shm, sizeof *multi_sub_shm,
-                    SR_SUB_EV_ERROR, timeout_ms, cb_err_info))) {
-                goto cleanup;
-            }
+            sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
 
-            if (*cb_err_info) {
-                /* failed callback or timeout */
-                SR_LOG_WRN("Event \"%s\" with ID %u priority %u failed (%s).", sr_ev2str(SR_SUB_EV_UPDATE),
-                        mod->request_id, cur_priority, sr_strerror((*cb_err_info)->err_code));
-                goto cleanup;
-            } else {
-                SR_LOG_INF("Event \"%s\" with ID %u priority %u succeeded.", sr_ev2str(SR_SUB_EV_UPDATE),
-                        mod->request_id, cur_priority);
+            if (err_info) {
+                break;
             }
+        }
 
-            /* SUB READ LOCK */
-            if ((err_info = sr_rwlock(&multi_sub_shm->lock, SR_MAIN_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
-                goto cleanup;
+        /* wait until all the published events are processed, even on error */
+        pending = 0;
+        for (i = 0; i < cmod_count; ++i) {
+            cmod = &cmods[i];
+            if (!cmod->published) {
+                continue;
             }
-            assert(multi_sub_shm->event == SR_SUB_EV_SUCCESS);
+            multi_sub_shm = (sr_multi_sub_shm_t *)cmod->shm_sub.addr;
+
+            if ((ev != SR_SUB_EV_DONE) || timeout_ms) {
+                /* SUB WRITE LOCK */
+                if ((tmp_err_info = sr_shmsub_notify_relock((sr_sub_shm_t *)multi_sub_shm))) {
+                    sr_errinfo_merge(&err_info, tmp_err_info);
+                    continue;
+                }
+
+                /* SUB WRITE UNLOCK */
+                if ((tmp_err_info = sr_shmsub_notify_finish_wrunlock((sr_sub_shm_t *)multi_sub_shm, sizeof *multi_sub_shm,
+                        expected_ev, timeout_ms, &mod_cb_err_info))) {
+                    sr_errinfo_merge(&err_info, tmp_err_info);
+                    continue;
+                }
+
+                if (ev == SR_SUB_EV_DONE) {
+                    /* we do not care about an error */
+                    sr_errinfo_free(&mod_cb_err_info);
+                } else if (mod_cb_err_info) {
+                    /* failed callback or timeout */
+                    SR_LOG_WRN("Event \"%s\" with ID %u priority %u failed (%s).", sr_ev2str(ev),
+                            cmod->mod->request_id, cmod->cur_priority, sr_strerror(mod_cb_err_info->err_code));
+                    sr_errinfo_merge(cb_err_info, mod_cb_err_info);
+                    mod_cb_err_info = NULL;
+                    failed = 1;
+                    continue;
+                } else {
+                    SR_LOG_INF("Event \"%s\" with ID %u priority %u succeeded.", sr_ev2str(ev),
+                            cmod->mod->request_id, cmod->cur_priority);
+                }
+            }
+
+            if (ev == SR_SUB_EV_UPDATE) {
+                /* SUB READ LOCK */
+                if ((tmp_err_info = sr_rwlock(&multi_sub_shm->lock, SR_MAIN_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
+                    sr_errinfo_merge(&err_info, tmp_err_info);
+                    continue;
+                }
+                assert(multi_sub_shm->event == SR_SUB_EV_SUCCESS);
+
+                /* remap sub SHM */
+                if (!(tmp_err_info = sr_shm_remap(&cmod->shm_sub, 0))) {
+                    multi_sub_shm = (sr_multi_sub_shm_t *)cmod->shm_sub.addr;
+
+                    /* parse updated edit */
+                    ly_errno = 0;
+                    edit = lyd_parse_mem(ly_ctx, cmod->shm_sub.addr + sizeof *multi_sub_shm, LYD_LYB,
+                            LYD_OPT_EDIT | LYD_OPT_STRICT);
+                    if (ly_errno) {
+                        sr_errinfo_new_ly(&tmp_err_info, ly_ctx);
+                        sr_errinfo_new(&tmp_err_info, SR_ERR_VALIDATION_FAILED, NULL, "Failed to parse \"update\" edit.");
+                    } else {
+                        /* event fully processed */
+                        multi_sub_shm->event = SR_SUB_EV_NONE;
+                    }
+                }
+
+                /* SUB READ UNLOCK */
+                sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_READ, __func__);
+
+                if (tmp_err_info) {
+                    sr_errinfo_merge(&err_info, tmp_err_info);
+                    continue;
+                }
+
+                /* collect new edits of this module (they may not be any) */
+                if (!cmod->edit) {
+                    cmod->edit = edit;
+                } else if (edit && lyd_insert_after(cmod->edit->prev, edit)) {
+                    sr_errinfo_new_ly(&err_info, ly_ctx);
+                    lyd_free_withsiblings(edit);
+                    continue;
+                }
+            }
+
+            /* find out what is the next priority and how many subscribers have it */
+            sr_shmsub_change_notify_next_subscription(cmod->shm_msub, cmod->msub_count, cmod->match, ev,
+                    cmod->cur_priority, &cmod->cur_priority, &cmod->subscriber_count, NULL);
+            if (cmod->subscriber_count) {
+                pending = 1;
+            }
+        }
+
+        if (err_info) {
+            goto cleanup;
+        }
+    } while (!failed && pending);
+
+    if ((ev == SR_SUB_EV_UPDATE) && !failed) {
+        /* join all the edits, in the order of the modules */
+        for (i = 0; i < cmod_count; ++i) {
+            if (!cmods[i].edit) {
+                continue;
+            }
+
+            if (!*update_edit) {
+                *update_edit = cmods[i].edit;
+            } else if (lyd_insert_after((*update_edit)->prev, cmods[i].edit)) {
+                sr_errinfo_new_ly(&err_info, ly_ctx);
+                goto cleanup;
+            }
+            cmods[i].edit = NULL;
+        }
+    }
+
+cleanup:
+    for (i = 0; i < cmod_count; ++i) {
+        free(cmods[i].msub_snap);
+        free(cmods[i].match);
+        free(cmods[i].diff_lyb);
+        sr_shm_clear(&cmods[i].shm_sub);
+        lyd_free_withsiblings(cmods[i].edit);
+    }
+    free(cmods);
+    free(match);
+    free(aux);
+    if (unlocked) {
+        /* SHM LOCK */
+        if ((tmp_err_info = sr_shmmain_lock_remap(mod_info->conn, SR_LOCK_READ, 0, __func__))) {
+            sr_errinfo_merge(&err_info, tmp_err_info);
+        }
+    }
+    if ((ev == SR_SUB_EV_UPDATE) && (err_info || *cb_err_info)) {
+        lyd_free_withsiblings(*update_edit);
+        *update_edit = NULL;
+    }
+    return err_info;
+}
+
+sr_error_info_t *
+sr_shmsub_change_notify_update(struct sr_mod_info_s *mod_info, sr_sid_t sid, uint32_t timeout_ms,
+        struct lyd_node **update_edit, sr_error_info_t **cb_err_info)
+{
+    sr_error_info_t *err_info = NULL;
+    sr_multi_sub_shm_t *multi_sub_shm;
+    struct sr_mod_info_mod_s *mod = NULL;
+    struct lyd_node *edit;
+    sr_mod_change_sub_t *shm_msub;
+    uint32_t cur_priority, subscriber_count, diff_lyb_len, msub_count, *aux = NULL;
+    uint8_t *match = NULL;
+    char *diff_lyb = NULL;
+    struct ly_ctx *ly_ctx;
+    sr_shm_t shm_sub = SR_SHM_INITIALIZER;
+
+    assert(mod_info->diff);
+    *update_edit = NULL;
+    ly_ctx = lyd_node_module(mod_info->diff)->ctx;
+
+    if (mod_info->conn->opts & SR_CONN_CONCURRENT_CHANGE_EVENTS) {
+        /* notify subscribers of all the modules at once */
+        return sr_shmsub_change_notify_concurrent(mod_info, sid, SR_SUB_EV_UPDATE, timeout_ms, update_edit, cb_err_info);
+    }
+
+    while ((mod = sr_modinfo_next_mod(mod, mod_info, mod_info->diff, &aux))) {
+        /* module change subscriptions */
+        shm_msub = (sr_mod_change_sub_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->change_sub[mod_info->ds].subs);
+        msub_count = mod->shm_mod->change_sub[mod_info->ds].sub_count;
+
+        /* first check that there actually are some value changes (and not only dflt changes) */
+        if (!sr_shmsub_change_notify_diff_has_changes(mod, mod_info->diff)) {
+            continue;
+        }
+
+        /* learn which subscriptions are interested in the changes */
+        if ((err_info = sr_shmsub_change_notify_filter(mod_info->conn->ext_shm.addr, shm_msub, msub_count,
+                mod_info->diff, &match))) {
+            goto cleanup;
+        }
+
+        /* just find out whether there are any subscriptions and if so, what is the highest priority */
+        if (!sr_shmsub_change_notify_has_subscription(shm_msub, msub_count, match, SR_SUB_EV_UPDATE, &cur_priority)) {
+            continue;
+        }
+
+        /* prepare diff of this module to write into SHM */
+        if ((err_info = sr_module_data_print_lyb(mod_info->diff, mod->ly_mod, &diff_lyb, &diff_lyb_len))) {
+            goto cleanup;
+        }
+
+        /* open sub SHM and map it */
+        if ((err_info = sr_shmsub_open_map(mod->ly_mod->name, sr_ds2str(mod_info->ds), -1, &shm_sub, sizeof *multi_sub_shm))) {
+            goto cleanup;
+        }
+        multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
+
+        /* correctly start the loop, with fake last priority 1 higher than the actual highest */
+        sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_UPDATE,
+                cur_priority + 1, &cur_priority, &subscriber_count, NULL);
+
+        do {
+            /* there cannot be more subscribers on one module with the same priority */
+            assert(subscriber_count == 1);
+
+            /* SUB WRITE LOCK */
+            if ((err_info = sr_shmsub_notify_new_wrlock((sr_sub_shm_t *)multi_sub_shm, mod->ly_mod->name, 0))) {
+                goto cleanup;
+            }
+
+            /* remap sub SHM once we have the lock, it will do anything only on the first call */
+            err_info = sr_shm_remap(&shm_sub, sizeof *multi_sub_shm + diff_lyb_len);
+            if (err_info) {
+                goto cleanup_wrunlock;
+            }
+            multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
+
+            /* write "update" event */
+            if (!mod->request_id) {
+                mod->request_id = ++multi_sub_shm->request_id;
+            }
+            sr_shmsub_multi_notify_write_event(multi_sub_shm, mod->request_id, cur_priority, SR_SUB_EV_UPDATE, &sid,
+                    subscriber_count, 0, diff_lyb, diff_lyb_len, mod->ly_mod->name);
+
+            /* notify using event pipe and wait until all the subscribers have processed the event */
+            if ((err_info = sr_shmsub_change_notify_evpipe(mod_info->conn, shm_msub, msub_count, match,
+                    SR_SUB_EV_UPDATE, cur_priority))) {
+                goto cleanup_wrunlock;
+            }
+
+            /* SUB WRITE UNLOCK */
+            if ((err_info = sr_shmsub_notify_finish_wrunlock((sr_sub_shm_t *)multi_sub_shm, sizeof *multi_sub_shm,
+                    SR_SUB_EV_ERROR, timeout_ms, cb_err_info))) {
+                goto cleanup;
+            }
+
+            if (*cb_err_info) {
+                /* failed callback or timeout */
+                SR_LOG_WRN("Event \"%s\" with ID %u priority %u failed (%s).", sr_ev2str(SR_SUB_EV_UPDATE),
+                        mod->request_id, cur_priority, sr_strerror((*cb_err_info)->err_code));
+                goto cleanup;
+            } else {
+                SR_LOG_INF("Event \"%s\" with ID %u priority %u succeeded.", sr_ev2str(SR_SUB_EV_UPDATE),
+                        mod->request_id, cur_priority);
+            }
+
+            /* SUB READ LOCK */
+            if ((err_info = sr_rwlock(&multi_sub_shm->lock, SR_MAIN_LOCK_TIMEOUT * 1000, SR_LOCK_READ, __func__))) {
+                goto cleanup;
+            }
+            assert(multi_sub_shm->event == SR_SUB_EV_SUCCESS);
 
             /* remap sub SHM */
             if ((err_info = sr_shm_remap(&shm_sub, 0))) {
@@ -704,7 +1302,7 @@ sr_shmsub_change_notify_update(struct sr_mod_info_s *mod_info, sr_sid_t sid, uin
             }
 
             /* find out what is the next priority and how many subscribers have it */
-            sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_UPDATE,
+            sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_UPDATE,
                     cur_priority, &cur_priority, &subscriber_count, NULL);
         } while (subscriber_count);
 
@@ -723,6 +1321,7 @@ cleanup_rdunlock:
     sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_READ, __func__);
 cleanup:
     free(aux);
+    free(match);
     free(diff_lyb);
     sr_shm_clear(&shm_sub);
     if (err_info || *cb_err_info) {
@@ -738,10 +1337,19 @@ sr_shmsub_change_notify_clear(struct sr_mod_info_s *mod_info, sr_sub_event_t ev)
     sr_error_info_t *err_info = NULL;
     sr_multi_sub_shm_t *multi_sub_shm;
     struct sr_mod_info_mod_s *mod = NULL;
-    uint32_t cur_priority, subscriber_count, *aux = NULL;
+    sr_mod_change_sub_t *shm_msub;
+    uint32_t cur_priority, subscriber_count, msub_count, *aux = NULL;
     sr_shm_t shm_sub = SR_SHM_INITIALIZER;
+    int concurrent;
+
+    /* with concurrent delivery, more modules could have failed */
+    concurrent = mod_info->conn->opts & SR_CONN_CONCURRENT_CHANGE_EVENTS;
 
     while ((mod = sr_modinfo_next_mod(mod, mod_info, mod_info->diff, &aux))) {
+        /* module change subscriptions */
+        shm_msub = (sr_mod_change_sub_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->change_sub[mod_info->ds].subs);
+        msub_count = mod->shm_mod->change_sub[mod_info->ds].sub_count;
+
         /* open sub SHM and map it */
         if ((err_info = sr_shmsub_open_map(mod->ly_mod->name, sr_ds2str(mod_info->ds), -1, &shm_sub, sizeof *multi_sub_shm))) {
             goto cleanup;
@@ -749,7 +1357,7 @@ sr_shmsub_change_notify_clear(struct sr_mod_info_s *mod_info, sr_sub_event_t ev)
         multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
 
         /* just find out whether there are any subscriptions and if so, what is the highest priority */
-        if (!sr_shmsub_change_notify_has_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, ev, &cur_priority)) {
+        if (!sr_shmsub_change_notify_has_subscription(shm_msub, msub_count, NULL, ev, &cur_priority)) {
             /* it is still possible that the subscription unsubscribed already */
 
             /* SUB WRITE LOCK */
@@ -774,7 +1382,7 @@ sr_shmsub_change_notify_clear(struct sr_mod_info_s *mod_info, sr_sub_event_t ev)
         }
 
         /* correctly start the loop, with fake last priority 1 higher than the actual highest */
-        sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, ev,
+        sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, NULL, ev,
                 cur_priority + 1, &cur_priority, &subscriber_count, NULL);
 
         do {
@@ -801,6 +1409,11 @@ clear_event:
                 /* SUB WRITE UNLOCK */
                 sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
 
+                if (concurrent) {
+                    /* there may be other failed sub SHMs */
+                    goto next_mod;
+                }
+
                 /* we have found the failed sub SHM */
                 goto cleanup;
             }
@@ -809,17 +1422,19 @@ clear_event:
             sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
 
             /* find out what is the next priority and how many subscribers have it */
-            sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, ev,
+            sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, NULL, ev,
                     cur_priority, &cur_priority, &subscriber_count, NULL);
         } while (subscriber_count);
 
         /* this module event succeeded, let us check the next one */
+next_mod:
         sr_shm_clear(&shm_sub);
     }
 
-    /* we have not found the failed sub SHM */
-    SR_ERRINFO_INT(&err_info);
-    return err_info;
+    if (!concurrent) {
+        /* we have not found the failed sub SHM */
+        SR_ERRINFO_INT(&err_info);
+    }
 
 cleanup:
     free(aux);
@@ -833,25 +1448,37 @@ sr_shmsub_change_notify_change(struct sr_mod_info_s *mod_info, sr_sid_t sid, uin
     sr_error_info_t *err_info = NULL;
     sr_multi_sub_shm_t *multi_sub_shm;
     struct sr_mod_info_mod_s *mod = NULL;
-    uint32_t cur_priority, subscriber_count, diff_lyb_len, *aux = NULL;
-    char *diff_lyb = NULL, *ext_shm_addr, *ext_shm_buf = NULL;
+    uint32_t cur_priority, subscriber_count, diff_lyb_len, msub_count, *aux = NULL;
+    uint8_t *match = NULL;
+    char *diff_lyb = NULL;
+    sr_mod_change_sub_t *shm_msub, *msub_snap = NULL;
     sr_shm_t shm_sub = SR_SHM_INITIALIZER;
     int opts;
 
-    /* use our ext SHM mapping by default */
-    ext_shm_addr = mod_info->conn->ext_shm.addr;
+    if (mod_info->conn->opts & SR_CONN_CONCURRENT_CHANGE_EVENTS) {
+        /* notify subscribers of all the modules at once */
+        return sr_shmsub_change_notify_concurrent(mod_info, sid, SR_SUB_EV_CHANGE, timeout_ms, NULL, cb_err_info);
+    }
 
     while ((mod = sr_modinfo_next_mod(mod, mod_info, mod_info->diff, &aux))) {
+        /* module change subscriptions */
+        shm_msub = (sr_mod_change_sub_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->change_sub[mod_info->ds].subs);
+        msub_count = mod->shm_mod->change_sub[mod_info->ds].sub_count;
+
         /* first check that there actually are some value changes (and not only dflt changes) */
         if (!sr_shmsub_change_notify_diff_has_changes(mod, mod_info->diff)) {
             continue;
         }
 
+        /* learn which subscriptions are interested in the changes */
+        if ((err_info = sr_shmsub_change_notify_filter(mod_info->conn->ext_shm.addr, shm_msub, msub_count,
+                mod_info->diff, &match))) {
+            goto cleanup;
+        }
+
         /* just find out whether there are any subscriptions and if so, what is the highest priority */
-        if (!sr_shmsub_change_notify_has_subscription(ext_shm_addr, mod, mod_info->ds, SR_SUB_EV_CHANGE,
-                    &cur_priority)) {
-            if (!sr_shmsub_change_notify_has_subscription(ext_shm_addr, mod, mod_info->ds, SR_SUB_EV_DONE,
-                    &cur_priority)) {
+        if (!sr_shmsub_change_notify_has_subscription(shm_msub, msub_count, match, SR_SUB_EV_CHANGE, &cur_priority)) {
+            if (!sr_shmsub_change_notify_has_subscription(shm_msub, msub_count, match, SR_SUB_EV_DONE, &cur_priority)) {
                 if (mod_info->ds == SR_DS_RUNNING) {
                     SR_LOG_INF("There are no subscribers for changes of the module \"%s\" in %s DS.",
                             mod->ly_mod->name, sr_ds2str(mod_info->ds));
@@ -860,13 +1487,9 @@ sr_shmsub_change_notify_change(struct sr_mod_info_s *mod_info, sr_sid_t sid, uin
             continue;
         }
 
-        /* prepare the diff to write into subscription SHM */
-        if (!diff_lyb) {
-            if (lyd_print_mem(&diff_lyb, mod_info->diff, LYD_LYB, LYP_WITHSIBLINGS)) {
-                sr_errinfo_new_ly(&err_info, mod->ly_mod->ctx);
-                goto cleanup;
-            }
-            diff_lyb_len = lyd_lyb_data_length(diff_lyb);
+        /* prepare the diff of this module to write into subscription SHM */
+        if ((err_info = sr_module_data_print_lyb(mod_info->diff, mod->ly_mod, &diff_lyb, &diff_lyb_len))) {
+            goto cleanup;
         }
 
         /* open sub SHM and map it */
@@ -877,18 +1500,19 @@ sr_shmsub_change_notify_change(struct sr_mod_info_s *mod_info, sr_sid_t sid, uin
         multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
 
         /* correctly start the loop, with fake last priority 1 higher than the actual highest */
-        sr_shmsub_change_notify_next_subscription(ext_shm_addr, mod, mod_info->ds, SR_SUB_EV_CHANGE,
+        sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_CHANGE,
                 cur_priority + 1, &cur_priority, &subscriber_count, &opts);
 
         do {
-            if ((opts & SR_SUBSCR_UNLOCKED) && !ext_shm_buf) {
-                /* subscriber wants subscriptions (main/ext SHM) unlocked, so make a copy and unlock it */
-                ext_shm_buf = malloc(mod_info->conn->ext_shm.size);
-                SR_CHECK_MEM_GOTO(!ext_shm_buf, err_info, cleanup);
-                memcpy(ext_shm_buf, mod_info->conn->ext_shm.addr, mod_info->conn->ext_shm.size);
+            if ((opts & SR_SUBSCR_UNLOCKED) && !msub_snap) {
+                /* subscriber wants subscriptions (main/ext SHM) unlocked, so make a snapshot of only
+                 * the module change subscriptions, they are all we need, and unlock it */
+                msub_snap = malloc(msub_count * sizeof *msub_snap);
+                SR_CHECK_MEM_GOTO(!msub_snap, err_info, cleanup);
+                memcpy(msub_snap, shm_msub, msub_count * sizeof *msub_snap);
 
                 /* update pointers */
-                ext_shm_addr = ext_shm_buf;
+                shm_msub = msub_snap;
 
                 /* SHM UNLOCK */
                 sr_shmmain_unlock(mod_info->conn, SR_LOCK_READ, 0, __func__);
@@ -913,7 +1537,7 @@ sr_shmsub_change_notify_change(struct sr_mod_info_s *mod_info, sr_sid_t sid, uin
                     subscriber_count, 0, diff_lyb, diff_lyb_len, mod->ly_mod->name);
 
             /* notify using event pipe and wait until all the subscribers have processed the event */
-            if ((err_info = sr_shmsub_change_notify_evpipe(ext_shm_addr, mod, mod_info->ds,
+            if ((err_info = sr_shmsub_change_notify_evpipe(mod_info->conn, shm_msub, msub_count, match,
                     SR_SUB_EV_CHANGE, cur_priority))) {
                 goto cleanup_wrunlock;
             }
@@ -935,17 +1559,16 @@ sr_shmsub_change_notify_change(struct sr_mod_info_s *mod_info, sr_sid_t sid, uin
             }
 
             /* find out what is the next priority and how many subscribers have it */
-            sr_shmsub_change_notify_next_subscription(ext_shm_addr, mod, mod_info->ds, SR_SUB_EV_CHANGE,
+            sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_CHANGE,
                     cur_priority, &cur_priority, &subscriber_count, &opts);
         } while (subscriber_count);
 
         /* next module */
         sr_shm_clear(&shm_sub);
-        if (ext_shm_buf) {
+        if (msub_snap) {
             /* the unlocked callback was called, lock again */
-            free(ext_shm_buf);
-            ext_shm_buf = NULL;
-            ext_shm_addr = mod_info->conn->ext_shm.addr;
+            free(msub_snap);
+            msub_snap = NULL;
             /* SHM LOCK */
             err_info = sr_shmmain_lock_remap(mod_info->conn, SR_LOCK_READ, 0, __func__);
         }
@@ -959,10 +1582,11 @@ cleanup_wrunlock:
     sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
 cleanup:
     free(aux);
+    free(match);
     free(diff_lyb);
     sr_shm_clear(&shm_sub);
-    if (ext_shm_buf) {
-        free(ext_shm_buf);
+    if (msub_snap) {
+        free(msub_snap);
         /* SHM LOCK */
         err_info = sr_shmmain_lock_remap(mod_info->conn, SR_LOCK_READ, 0, __func__);
     }
@@ -975,29 +1599,41 @@ sr_shmsub_change_notify_change_done(struct sr_mod_info_s *mod_info, sr_sid_t sid
     sr_error_info_t *err_info = NULL, *cb_err_info = NULL;
     sr_multi_sub_shm_t *multi_sub_shm;
     struct sr_mod_info_mod_s *mod = NULL;
-    uint32_t cur_priority, subscriber_count, diff_lyb_len, *aux = NULL;
+    sr_mod_change_sub_t *shm_msub;
+    uint32_t cur_priority, subscriber_count, diff_lyb_len, msub_count, *aux = NULL;
+    uint8_t *match = NULL;
     char *diff_lyb = NULL;
     sr_shm_t shm_sub = SR_SHM_INITIALIZER;
 
+    if (mod_info->conn->opts & SR_CONN_CONCURRENT_CHANGE_EVENTS) {
+        /* notify subscribers of all the modules at once */
+        return sr_shmsub_change_notify_concurrent(mod_info, sid, SR_SUB_EV_DONE, timeout_ms, NULL, &cb_err_info);
+    }
+
     while ((mod = sr_modinfo_next_mod(mod, mod_info, mod_info->diff, &aux))) {
+        /* module change subscriptions */
+        shm_msub = (sr_mod_change_sub_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->change_sub[mod_info->ds].subs);
+        msub_count = mod->shm_mod->change_sub[mod_info->ds].sub_count;
+
         /* first check that there actually are some value changes (and not only dflt changes) */
         if (!sr_shmsub_change_notify_diff_has_changes(mod, mod_info->diff)) {
             continue;
         }
 
-        if (!sr_shmsub_change_notify_has_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_DONE,
-                &cur_priority)) {
+        /* learn which subscriptions are interested in the changes */
+        if ((err_info = sr_shmsub_change_notify_filter(mod_info->conn->ext_shm.addr, shm_msub, msub_count,
+                mod_info->diff, &match))) {
+            goto cleanup;
+        }
+
+        if (!sr_shmsub_change_notify_has_subscription(shm_msub, msub_count, match, SR_SUB_EV_DONE, &cur_priority)) {
             /* no subscriptions interested in this event */
             continue;
         }
 
-        /* prepare the diff to write into subscription SHM */
-        if (!diff_lyb) {
-            if (lyd_print_mem(&diff_lyb, mod_info->diff, LYD_LYB, LYP_WITHSIBLINGS)) {
-                sr_errinfo_new_ly(&err_info, mod->ly_mod->ctx);
-                goto cleanup;
-            }
-            diff_lyb_len = lyd_lyb_data_length(diff_lyb);
+        /* prepare the diff of this module to write into subscription SHM */
+        if ((err_info = sr_module_data_print_lyb(mod_info->diff, mod->ly_mod, &diff_lyb, &diff_lyb_len))) {
+            goto cleanup;
         }
 
         /* open sub SHM and map it */
@@ -1008,7 +1644,7 @@ sr_shmsub_change_notify_change_done(struct sr_mod_info_s *mod_info, sr_sid_t sid
         multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
 
         /* correctly start the loop, with fake last priority 1 higher than the actual highest */
-        sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_DONE,
+        sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_DONE,
                 cur_priority + 1, &cur_priority, &subscriber_count, NULL);
 
         do {
@@ -1031,7 +1667,7 @@ sr_shmsub_change_notify_change_done(struct sr_mod_info_s *mod_info, sr_sid_t sid
                     subscriber_count, 0, diff_lyb, diff_lyb_len, mod->ly_mod->name);
 
             /* notify using event pipe and do not wait for subscribers */
-            if ((err_info = sr_shmsub_change_notify_evpipe(mod_info->conn->ext_shm.addr, mod, mod_info->ds,
+            if ((err_info = sr_shmsub_change_notify_evpipe(mod_info->conn, shm_msub, msub_count, match,
                     SR_SUB_EV_DONE, cur_priority))) {
                 goto cleanup_wrunlock;
             }
@@ -1053,7 +1689,7 @@ sr_shmsub_change_notify_change_done(struct sr_mod_info_s *mod_info, sr_sid_t sid
             }
 
             /* find out what is the next priority and how many subscribers have it */
-            sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_DONE,
+            sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_DONE,
                     cur_priority, &cur_priority, &subscriber_count, NULL);
         } while (subscriber_count);
 
@@ -1068,6 +1704,7 @@ cleanup_wrunlock:
     sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
 cleanup:
     free(aux);
+    free(match);
     free(diff_lyb);
     sr_shm_clear(&shm_sub);
     return err_info;
@@ -1078,27 +1715,46 @@ sr_shmsub_change_notify_change_abort(struct sr_mod_info_s *mod_info, sr_sid_t si
 {
     sr_error_info_t *err_info = NULL, *cb_err_info = NULL;
     sr_multi_sub_shm_t *multi_sub_shm;
-    struct lyd_node *abort_diff;
+    struct lyd_node *abort_diff = NULL;
     struct sr_mod_info_mod_s *mod = NULL;
-    uint32_t cur_priority, err_priority, subscriber_count, err_subscriber_count, diff_lyb_len, *aux = NULL;
+    sr_mod_change_sub_t *shm_msub;
+    uint32_t cur_priority, err_priority, subscriber_count, err_subscriber_count, diff_lyb_len, msub_count, *aux = NULL;
+    uint8_t *match = NULL;
     char *diff_lyb = NULL;
     sr_shm_t shm_sub = SR_SHM_INITIALIZER;
-    int last_subscr = 0;
+    int last_subscr = 0, concurrent;
+
+    /* with concurrent delivery, more modules could have been notified after the failed one */
+    concurrent = mod_info->conn->opts & SR_CONN_CONCURRENT_CHANGE_EVENTS;
 
     while ((mod = sr_modinfo_next_mod(mod, mod_info, mod_info->diff, &aux))) {
+        /* module change subscriptions */
+        shm_msub = (sr_mod_change_sub_t *)(mod_info->conn->ext_shm.addr + mod->shm_mod->change_sub[mod_info->ds].subs);
+        msub_count = mod->shm_mod->change_sub[mod_info->ds].sub_count;
+
         /* first check that there actually are some value changes (and not only dflt changes) */
         if (!sr_shmsub_change_notify_diff_has_changes(mod, mod_info->diff)) {
             continue;
         }
 
+        /* first reverse change diff for abort */
+        if (!abort_diff && (err_info = sr_diff_reverse(mod_info->diff, &abort_diff))) {
+            goto cleanup;
+        }
+
+        /* learn which subscriptions are interested in the changes */
+        if ((err_info = sr_shmsub_change_notify_filter(mod_info->conn->ext_shm.addr, shm_msub, msub_count, abort_diff,
+                &match))) {
+            goto cleanup;
+        }
+
         /* open sub SHM and map it */
         if ((err_info = sr_shmsub_open_map(mod->ly_mod->name, sr_ds2str(mod_info->ds), -1, &shm_sub, sizeof *multi_sub_shm))) {
             goto cleanup;
         }
         multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
 
-        if (!sr_shmsub_change_notify_has_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_ABORT,
-                &cur_priority)) {
+        if (!sr_shmsub_change_notify_has_subscription(shm_msub, msub_count, match, SR_SUB_EV_ABORT, &cur_priority)) {
             /* no subscriptions interested in this event, but we still want to clear the event */
 clear_shm:
             /* SUB WRITE LOCK */
@@ -1115,6 +1771,12 @@ clear_shm:
                 }
                 multi_sub_shm = (sr_multi_sub_shm_t *)shm_sub.addr;
 
+                if (concurrent) {
+                    /* SUB WRITE UNLOCK */
+                    sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
+                    goto next_mod;
+                }
+
                 /* we have found the last subscription that processed the event, success */
                 goto cleanup_wrunlock;
             }
@@ -1128,32 +1790,31 @@ clear_shm:
         }
 
         /* remember what priority callback failed, that is the first priority callbacks that will NOT be called */
+        last_subscr = 0;
         if (multi_sub_shm->event == SR_SUB_EV_ERROR) {
             err_priority = multi_sub_shm->priority;
             err_subscriber_count = multi_sub_shm->subscriber_count;
             last_subscr = 1;
-        }
-
-        assert(mod_info->diff);
-
-        /* prepare the diff to write into subscription SHM */
-        if (!diff_lyb) {
-            /* first reverse change diff for abort */
-            if ((err_info = sr_diff_reverse(mod_info->diff, &abort_diff))) {
-                goto cleanup;
+        } else if (concurrent) {
+            if (!mod->change_published) {
+                /* "change" event was never published for this module, its subscribers could have seen only "update" */
+                sr_shm_clear(&shm_sub);
+                continue;
             }
 
-            if (lyd_print_mem(&diff_lyb, abort_diff, LYD_LYB, LYP_WITHSIBLINGS)) {
-                lyd_free_withsiblings(abort_diff);
-                sr_errinfo_new_ly(&err_info, mod->ly_mod->ctx);
-                goto cleanup;
-            }
-            lyd_free_withsiblings(abort_diff);
-            diff_lyb_len = lyd_lyb_data_length(diff_lyb);
+            /* all the subscribers of the last published priority have processed it */
+            err_priority = multi_sub_shm->priority;
+            err_subscriber_count = 0;
+            last_subscr = 1;
+        }
+
+        /* prepare the diff of this module to write into subscription SHM */
+        if ((err_info = sr_module_data_print_lyb(abort_diff, mod->ly_mod, &diff_lyb, &diff_lyb_len))) {
+            goto cleanup;
         }
 
         /* correctly start the loop, with fake last priority 1 higher than the actual highest */
-        sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_ABORT,
+        sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_ABORT,
                 cur_priority + 1, &cur_priority, &subscriber_count, NULL);
         if (last_subscr && (err_priority == cur_priority)) {
             /* do not notify subscribers that did not process the previous event */
@@ -1180,7 +1841,7 @@ clear_shm:
                     subscriber_count, 0, diff_lyb, diff_lyb_len, mod->ly_mod->name);
 
             /* notify using event pipe */
-            if ((err_info = sr_shmsub_change_notify_evpipe(mod_info->conn->ext_shm.addr, mod, mod_info->ds,
+            if ((err_info = sr_shmsub_change_notify_evpipe(mod_info->conn, shm_msub, msub_count, match,
                     SR_SUB_EV_ABORT, cur_priority))) {
                 goto cleanup_wrunlock;
             }
@@ -1203,11 +1864,14 @@ clear_shm:
 
             if (last_subscr && (err_priority == cur_priority)) {
                 /* last priority subscribers handled */
+                if (concurrent) {
+                    goto next_mod;
+                }
                 goto cleanup;
             }
 
             /* find out what is the next priority and how many subscribers have it */
-            sr_shmsub_change_notify_next_subscription(mod_info->conn->ext_shm.addr, mod, mod_info->ds, SR_SUB_EV_ABORT,
+            sr_shmsub_change_notify_next_subscription(shm_msub, msub_count, match, SR_SUB_EV_ABORT,
                     cur_priority, &cur_priority, &subscriber_count, NULL);
 
             if (last_subscr && (err_priority == cur_priority)) {
@@ -1216,25 +1880,30 @@ clear_shm:
             }
         } while (subscriber_count);
 
+next_mod:
         sr_shm_clear(&shm_sub);
     }
 
-    /* unreachable unless the failed subscription was not found */
-    SR_ERRINFO_INT(&err_info);
-    return err_info;
+    if (!concurrent) {
+        /* unreachable unless the failed subscription was not found */
+        SR_ERRINFO_INT(&err_info);
+    }
+    goto cleanup;
 
 cleanup_wrunlock:
     /* SUB WRITE UNLOCK */
     sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_WRITE, __func__);
 cleanup:
     free(aux);
+    free(match);
     free(diff_lyb);
+    lyd_free_withsiblings(abort_diff);
     sr_shm_clear(&shm_sub);
     return err_info;
 }
 
 sr_error_info_t *
-sr_shmsub_oper_notify(const struct lys_module *ly_mod, const char *xpath, const char *request_xpath,
+sr_shmsub_oper_notify(sr_conn_ctx_t *conn, const struct lys_module *ly_mod, const char *xpath, const char *request_xpath,
         const struct lyd_node *parent, sr_sid_t sid, uint32_t evpipe_num, uint32_t timeout_ms, struct lyd_node **data,
         sr_error_info_t **cb_err_info)
 {
@@ -1277,7 +1946,7 @@ sr_shmsub_oper_notify(const struct lys_module *ly_mod, const char *xpath, const
     sr_shmsub_notify_write_event(sub_shm, request_id, SR_SUB_EV_OPER, &sid, request_xpath, parent_lyb, parent_lyb_len, xpath);
 
     /* notify using event pipe and wait until the subscriber has processed the event */
-    if ((err_info = sr_shmsub_notify_evpipe(evpipe_num))) {
+    if ((err_info = sr_shmsub_notify_evpipe(conn, evpipe_num))) {
         goto cleanup_wrunlock;
     }
 
@@ -1479,13 +2148,60 @@ cleanup:
     }
 }
 
+/**
+ * @brief Make a snapshot of RPC/action subscriptions so that they can be used without holding the main SHM lock.
+ * Only the subscriptions and their XPaths are copied.
+ *
+ * @param[in] ext_shm_addr Ext SHM address.
+ * @param[in] shm_rpc SHM RPC structure with the subscriptions.
+ * @param[out] snap_p Snapshot memory to be used instead of ext SHM, to be freed.
+ * @param[out] snap_rpc RPC structure referencing the subscriptions in @p snap_p.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmsub_rpc_subs_snapshot(char *ext_shm_addr, sr_rpc_t *shm_rpc, char **snap_p, sr_rpc_t *snap_rpc)
+{
+    sr_error_info_t *err_info = NULL;
+    sr_rpc_sub_t *shm_subs, *snap_subs;
+    char *snap_end;
+    size_t size;
+    uint32_t i;
+
+    shm_subs = (sr_rpc_sub_t *)(ext_shm_addr + shm_rpc->subs);
+
+    /* learn the snapshot size */
+    size = SR_SHM_SIZE(shm_rpc->sub_count * sizeof *shm_subs);
+    for (i = 0; i < shm_rpc->sub_count; ++i) {
+        size += sr_strshmlen(ext_shm_addr + shm_subs[i].xpath);
+    }
+
+    *snap_p = malloc(size);
+    SR_CHECK_MEM_RET(!*snap_p, err_info);
+
+    /* copy the subscriptions, their XPaths are placed after them */
+    snap_subs = (sr_rpc_sub_t *)*snap_p;
+    memcpy(snap_subs, shm_subs, shm_rpc->sub_count * sizeof *shm_subs);
+    snap_end = *snap_p + SR_SHM_SIZE(shm_rpc->sub_count * sizeof *shm_subs);
+    for (i = 0; i < shm_rpc->sub_count; ++i) {
+        snap_subs[i].xpath = sr_shmstrcpy(*snap_p, ext_shm_addr + shm_subs[i].xpath, &snap_end);
+    }
+
+    /* the RPC itself */
+    snap_rpc->op_path = 0;
+    snap_rpc->subs = 0;
+    snap_rpc->sub_count = shm_rpc->sub_count;
+
+    return NULL;
+}
+
 sr_error_info_t *
 sr_shmsub_rpc_notify(sr_conn_ctx_t *conn, const char *op_path, const struct lyd_node *input, sr_sid_t sid,
         uint32_t timeout_ms, uint32_t *request_id, struct lyd_node **output, sr_error_info_t **cb_err_info)
 {
     sr_error_info_t *err_info = NULL;
     sr_rpc_t *shm_rpc;
-    char *input_lyb = NULL, *ext_shm_addr, *ext_shm_buf = NULL;
+    sr_rpc_t rpc_snap;
+    char *input_lyb = NULL, *ext_shm_addr, *subs_snap = NULL;
     uint32_t i, input_lyb_len, cur_priority, subscriber_count, *evpipes = NULL;
     int opts;
     sr_multi_sub_shm_t *multi_sub_shm;
@@ -1525,16 +2241,16 @@ sr_shmsub_rpc_notify(sr_conn_ctx_t *conn, const char *op_path, const struct lyd_
             &evpipes, &subscriber_count, &opts);
 
     do {
-        if ((opts & SR_SUBSCR_UNLOCKED) && !ext_shm_buf) {
-            /* subscriber wants subscriptions (main/ext SHM) unlocked, so make a copy and unlock it */
-            ext_shm_buf = malloc(conn->ext_shm.size);
-            SR_CHECK_MEM_GOTO(!ext_shm_buf, err_info, cleanup);
-            memcpy(ext_shm_buf, conn->ext_shm.addr, conn->ext_shm.size);
+        if ((opts & SR_SUBSCR_UNLOCKED) && !subs_snap) {
+            /* subscriber wants subscriptions (main/ext SHM) unlocked, so make a snapshot of the RPC subscriptions
+             * and unlock it */
+            if ((err_info = sr_shmsub_rpc_subs_snapshot(ext_shm_addr, shm_rpc, &subs_snap, &rpc_snap))) {
+                goto cleanup;
+            }
 
             /* update pointers */
-            ext_shm_addr = ext_shm_buf;
-            shm_rpc = sr_shmmain_find_rpc((sr_main_shm_t *)conn->main_shm.addr, ext_shm_addr, op_path, 0);
-            assert(shm_rpc);
+            ext_shm_addr = subs_snap;
+            shm_rpc = &rpc_snap;
 
             /* SHM UNLOCK */
             sr_shmmain_unlock(conn, SR_LOCK_READ, 0, __func__);
@@ -1560,7 +2276,7 @@ sr_shmsub_rpc_notify(sr_conn_ctx_t *conn, const char *op_path, const struct lyd_
 
         /* notify using event pipe and wait until all the subscribers have processed the event */
         for (i = 0; i < subscriber_count; ++i) {
-            if ((err_info = sr_shmsub_notify_evpipe(evpipes[i]))) {
+            if ((err_info = sr_shmsub_notify_evpipe(conn, evpipes[i]))) {
                 goto cleanup_wrunlock;
             }
         }
@@ -1631,8 +2347,8 @@ cleanup:
     sr_shm_clear(&shm_sub);
     free(input_lyb);
     free(evpipes);
-    if (ext_shm_buf) {
-        free(ext_shm_buf);
+    if (subs_snap) {
+        free(subs_snap);
         /* SHM LOCK */
         err_info = sr_shmmain_lock_remap(conn, SR_LOCK_READ, 0, __func__);
     }
@@ -1736,7 +2452,7 @@ clear_shm:
 
         /* notify using event pipe but do not wait for the subscribers */
         for (i = 0; i < subscriber_count; ++i) {
-            if ((err_info = sr_shmsub_notify_evpipe(evpipes[i]))) {
+            if ((err_info = sr_shmsub_notify_evpipe(conn, evpipes[i]))) {
                 goto cleanup_wrunlock;
             }
         }
@@ -1765,8 +2481,8 @@ cleanup:
 }
 
 sr_error_info_t *
-sr_shmsub_notif_notify(const struct lyd_node *notif, time_t notif_ts, sr_sid_t sid, uint32_t *notif_sub_evpipe_nums,
-        uint32_t notif_sub_count)
+sr_shmsub_notif_notify(sr_conn_ctx_t *conn, const struct lyd_node *notif, time_t notif_ts, sr_sid_t sid,
+        uint32_t *notif_sub_evpipe_nums, uint32_t notif_sub_count)
 {
     sr_error_info_t *err_info = NULL;
     struct lys_module *ly_mod;
@@ -1810,7 +2526,7 @@ sr_shmsub_notif_notify(const struct lyd_node *notif, time_t notif_ts, sr_sid_t s
 
     /* notify all subscribers using event pipe and do not wait for them */
     for (i = 0; i < notif_sub_count; ++i) {
-        if ((err_info = sr_shmsub_notify_evpipe(notif_sub_evpipe_nums[i]))) {
+        if ((err_info = sr_shmsub_notify_evpipe(conn, notif_sub_evpipe_nums[i]))) {
             goto cleanup_wrunlock;
         }
     }
@@ -1869,63 +2585,22 @@ sr_shmsub_change_listen_is_new_event(sr_multi_sub_shm_t *multi_sub_shm, struct m
 }
 
 /**
- * @brief Whether there is a change (some diff) for the subscription.
+ * @brief Write the result of having processed a multi-subscriber event.
  *
- * @param[in] sub Change subscription.
- * @param[in] diff Full diff for the module.
- * @return 0 if not, non-zero if there is.
+ * @param[in] multi_sub_shm Multi subscription SHM to write to.
+ * @param[in] valid_subscr_count Number of subscribers that processed the event.
+ * @param[in] data Optional data to write after the structure.
+ * @param[in] data_len Additional data length.
+ * @param[in] err_code Optional error code if a callback failed.
  */
-static int
-sr_shmsub_change_listen_has_diff(struct modsub_changesub_s *sub, const struct lyd_node *diff)
+static void
+sr_shmsub_multi_listen_write_event(sr_multi_sub_shm_t *multi_sub_shm, uint32_t valid_subscr_count, const char *data,
+        uint32_t data_len, sr_error_t err_code)
 {
-    struct ly_set *set = NULL;
-    const struct lyd_node *next, *elem;
-    uint32_t i;
-    enum edit_op op;
-    int ret = 0;
-
-    if (!sub->xpath) {
-        return 1;
-    }
+    sr_error_info_t *err_info = NULL;
+    sr_sub_event_t event;
 
-    set = lyd_find_path(diff, sub->xpath);
-    assert(set);
-
-    for (i = 0; i < set->number; ++i) {
-        LY_TREE_DFS_BEGIN(set->set.d[i], next, elem) {
-            op = sr_edit_find_oper(elem, 0, NULL);
-            if (op && (op != EDIT_NONE)) {
-                ret = 1;
-                break;
-            }
-            LY_TREE_DFS_END(set->set.d[i], next, elem);
-        }
-        if (ret) {
-            break;
-        }
-    }
-    ly_set_free(set);
-
-    return ret;
-}
-
-/**
- * @brief Write the result of having processed a multi-subscriber event.
- *
- * @param[in] multi_sub_shm Multi subscription SHM to write to.
- * @param[in] valid_subscr_count Number of subscribers that processed the event.
- * @param[in] data Optional data to write after the structure.
- * @param[in] data_len Additional data length.
- * @param[in] err_code Optional error code if a callback failed.
- */
-static void
-sr_shmsub_multi_listen_write_event(sr_multi_sub_shm_t *multi_sub_shm, uint32_t valid_subscr_count, const char *data,
-        uint32_t data_len, sr_error_t err_code)
-{
-    sr_error_info_t *err_info = NULL;
-    sr_sub_event_t event;
-
-    event = multi_sub_shm->event;
+    event = multi_sub_shm->event;
 
     if ((multi_sub_shm->subscriber_count == valid_subscr_count) || err_code) {
         /* last subscriber finished or an error, update event */
@@ -2158,14 +2833,20 @@ sr_shmsub_change_listen_process_module_events(struct modsub_change_s *change_sub
         }
 
 process_event:
+        if (!sr_shmsub_change_filter_is_valid(diff, change_sub->xpath)) {
+            /* no changes for this subscription, the originator did not count it as a subscriber, remember
+             * request ID and event so that we do not evaluate it again (nor for "abort", it never saw "change") */
+            change_sub->request_id = sub_info.request_id;
+            change_sub->event = (sub_info.event == SR_SUB_EV_CHANGE) ? SR_SUB_EV_ABORT : sub_info.event;
+            continue;
+        }
+
         /* SUB READ UNLOCK */
         sr_rwunlock(&multi_sub_shm->lock, SR_LOCK_READ, __func__);
 
-        /* call callback if there are some changes */
-        if (sr_shmsub_change_listen_has_diff(change_sub, diff)) {
-            ret = change_sub->cb(&tmp_sess, change_subs->module_name, change_sub->xpath, sr_ev2api(sub_info.event),
-                    sub_info.request_id, change_sub->private_data);
-        }
+        /* call callback */
+        ret = change_sub->cb(&tmp_sess, change_subs->module_name, change_sub->xpath, sr_ev2api(sub_info.event),
+                sub_info.request_id, change_sub->private_data);
 
         /* SUB READ LOCK */
         if (sr_shmsub_change_listen_relock(multi_sub_shm, SR_LOCK_READ, &sub_info, change_sub, change_subs->module_name,
@@ -2199,6 +2880,11 @@ process_event:
         change_sub->event = multi_sub_shm->event;
     }
 
+    if (!valid_subscr_count && !err_code) {
+        /* none of our subscriptions are interested in this event */
+        goto cleanup_rdunlock;
+    }
+
     /*
      * prepare additional event data written into subscription SHM (after the structure)
      */
@@ -3184,6 +3870,587 @@ sr_shmsub_notif_listen_module_replay(struct modsub_notif_s *notif_subs, sr_subsc
     return NULL;
 }
 
+#ifdef SR_HAVE_EPOLL
+
+/** subscription is not in the dispatcher */
+#define SR_SUB_DISP_NONE 0
+/** subscription is waiting for an event */
+#define SR_SUB_DISP_IDLE 1
+/** subscription has an event and is waiting for a worker thread */
+#define SR_SUB_DISP_QUEUED 2
+/** subscription events are being processed by a worker thread */
+#define SR_SUB_DISP_PROCESSING 3
+
+/** maximum number of events returned by one epoll_wait() call */
+#define SR_SUB_DISP_EVENTS 32
+
+sr_error_info_t *
+sr_shmsub_disp_init(sr_conn_ctx_t *conn)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+
+    memset(disp, 0, sizeof *disp);
+    disp->epoll_fd = -1;
+    disp->wake_fd = -1;
+    disp->worker_max = SR_SUB_WORKER_MAX;
+
+    if ((err_info = sr_mutex_init(&disp->lock, 0))) {
+        return err_info;
+    }
+    if ((err_info = sr_cond_init(&disp->cond, 0))) {
+        pthread_mutex_destroy(&disp->lock);
+        return err_info;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Wake up the dispatcher thread so that it learns about changes.
+ *
+ * @param[in] disp Connection dispatcher.
+ */
+static void
+sr_shmsub_disp_wake(struct sr_sub_disp_s *disp)
+{
+    uint64_t val = 1;
+
+    if (write(disp->wake_fd, &val, sizeof val) == -1) {
+        /* the counter may only be full, the dispatcher will wake up anyway */
+        SR_LOG_WRN("Waking up the subscription dispatcher failed (%s).", strerror(errno));
+    }
+}
+
+/**
+ * @brief Stop dispatching events of a subscription.
+ *
+ * Dispatcher lock is expected to be held and the subscription must not be processed.
+ *
+ * @param[in] disp Connection dispatcher.
+ * @param[in] subs Subscription to remove.
+ */
+static void
+sr_shmsub_disp_remove(struct sr_sub_disp_s *disp, sr_subscription_ctx_t *subs)
+{
+    uint32_t i;
+
+    assert(subs->disp_state != SR_SUB_DISP_PROCESSING);
+
+    if (subs->disp_state == SR_SUB_DISP_NONE) {
+        return;
+    }
+
+    if (subs->disp_state == SR_SUB_DISP_QUEUED) {
+        /* remove from the queue, keep the order */
+        for (i = 0; disp->queue[i] != subs; ++i);
+        --disp->queue_count;
+        memmove(disp->queue + i, disp->queue + i + 1, (disp->queue_count - i) * sizeof *disp->queue);
+    }
+
+    /* stop listening on the event pipe */
+    if (epoll_ctl(disp->epoll_fd, EPOLL_CTL_DEL, subs->evpipe, NULL) == -1) {
+        SR_LOG_WRN("Removing an event pipe from epoll failed (%s).", strerror(errno));
+    }
+
+    /* remove from the subscriptions */
+    for (i = 0; disp->subs[i] != subs; ++i);
+    --disp->sub_count;
+    if (i < disp->sub_count) {
+        disp->subs[i] = disp->subs[disp->sub_count];
+    }
+
+    subs->disp_state = SR_SUB_DISP_NONE;
+}
+
+/**
+ * @brief Worker thread processing events of subscriptions queued by the dispatcher thread.
+ *
+ * @param[in] arg Pointer to the connection.
+ * @return Always NULL.
+ */
+static void *
+sr_shmsub_disp_worker_thread(void *arg)
+{
+    sr_error_info_t *err_info = NULL;
+    sr_conn_ctx_t *conn = (sr_conn_ctx_t *)arg;
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+    sr_subscription_ctx_t *subs;
+    struct epoll_event ev;
+    struct timespec abs_ts;
+    time_t stop_time_in;
+    uint32_t i;
+    int ret;
+
+    /* DISP LOCK */
+    pthread_mutex_lock(&disp->lock);
+
+    while (1) {
+        /* wait for a subscription with an event */
+        ret = 0;
+        while (disp->running && !disp->queue_count) {
+            if ((ret == ETIMEDOUT) && (disp->worker_count > 1)) {
+                /* idle for too long and there are other workers */
+                break;
+            }
+
+            sr_time_get(&abs_ts, SR_SUB_WORKER_IDLE_TIMEOUT * 1000);
+            ++disp->idle_count;
+            ret = pthread_cond_timedwait(&disp->cond, &disp->lock, &abs_ts);
+            --disp->idle_count;
+        }
+        if (!disp->queue_count) {
+            break;
+        }
+
+        /* take the first waiting subscription */
+        subs = disp->queue[0];
+        --disp->queue_count;
+        memmove(disp->queue, disp->queue + 1, disp->queue_count * sizeof *disp->queue);
+        subs->disp_state = SR_SUB_DISP_PROCESSING;
+        subs->tid = pthread_self();
+
+        /* DISP UNLOCK */
+        pthread_mutex_unlock(&disp->lock);
+
+        /* process the new event (or subscription stop time has elapsed) */
+        ret = sr_process_events(subs, NULL, &stop_time_in);
+
+        /* DISP LOCK */
+        pthread_mutex_lock(&disp->lock);
+
+        subs->disp_state = SR_SUB_DISP_IDLE;
+        if ((ret != SR_ERR_OK) && (ret != SR_ERR_TIME_OUT)) {
+            /* stop handling this subscription, continue on time out */
+            ATOMIC_STORE_RELAXED(subs->thread_running, 0);
+            sr_shmsub_disp_remove(disp, subs);
+        } else {
+            subs->disp_stop_time = stop_time_in ? time(NULL) + stop_time_in : 0;
+            if (subs->disp_stop_time) {
+                /* dispatcher needs to learn the new stop time */
+                sr_shmsub_disp_wake(disp);
+            }
+
+            /* listen for another event on its pipe */
+            ev.events = EPOLLIN | EPOLLONESHOT;
+            ev.data.u32 = subs->evpipe_num;
+            if (epoll_ctl(disp->epoll_fd, EPOLL_CTL_MOD, subs->evpipe, &ev) == -1) {
+                /* it is printed */
+                SR_ERRINFO_SYSERRNO(&err_info, "epoll_ctl");
+                sr_errinfo_free(&err_info);
+                ATOMIC_STORE_RELAXED(subs->thread_running, 0);
+                sr_shmsub_disp_remove(disp, subs);
+            }
+        }
+
+        /* someone may be waiting for the subscription to be processed */
+        pthread_cond_broadcast(&disp->cond);
+    }
+
+    /* let this thread be joined */
+    for (i = 0; !pthread_equal(disp->workers[i].tid, pthread_self()); ++i);
+    disp->workers[i].finished = 1;
+    --disp->worker_count;
+    pthread_cond_broadcast(&disp->cond);
+
+    /* DISP UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+    return NULL;
+}
+
+/**
+ * @brief Join all the finished worker threads.
+ *
+ * Dispatcher lock is expected to be held.
+ *
+ * @param[in] disp Connection dispatcher.
+ */
+static void
+sr_shmsub_disp_join_workers(struct sr_sub_disp_s *disp)
+{
+    uint32_t i;
+    int ret;
+
+    i = 0;
+    while (i < disp->worker_thread_count) {
+        if (!disp->workers[i].finished) {
+            ++i;
+            continue;
+        }
+
+        /* the thread has already released the lock so it is just terminating */
+        ret = pthread_join(disp->workers[i].tid, NULL);
+        if (ret) {
+            SR_LOG_WRN("Joining a subscription worker thread failed (%s).", strerror(ret));
+        }
+
+        --disp->worker_thread_count;
+        if (i < disp->worker_thread_count) {
+            disp->workers[i] = disp->workers[disp->worker_thread_count];
+        }
+    }
+}
+
+/**
+ * @brief Create a new worker thread.
+ *
+ * Dispatcher lock is expected to be held.
+ *
+ * @param[in] conn Connection of the dispatcher.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmsub_disp_new_worker(sr_conn_ctx_t *conn)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+    void *mem;
+    int ret;
+
+    /* get rid of the workers that terminated meanwhile */
+    sr_shmsub_disp_join_workers(disp);
+
+    mem = realloc(disp->workers, (disp->worker_thread_count + 1) * sizeof *disp->workers);
+    SR_CHECK_MEM_RET(!mem, err_info);
+    disp->workers = mem;
+
+    ret = pthread_create(&disp->workers[disp->worker_thread_count].tid, NULL, sr_shmsub_disp_worker_thread, conn);
+    if (ret) {
+        sr_errinfo_new(&err_info, SR_ERR_INTERNAL, NULL, "Creating a new thread failed (%s).", strerror(ret));
+        return err_info;
+    }
+
+    /* the worker cannot finish before we release the lock */
+    disp->workers[disp->worker_thread_count].finished = 0;
+    ++disp->worker_thread_count;
+    ++disp->worker_count;
+
+    return NULL;
+}
+
+/**
+ * @brief Queue a subscription with an event to be processed by a worker thread, create a new worker if none is idle.
+ *
+ * Dispatcher lock is expected to be held.
+ *
+ * @param[in] conn Connection of the dispatcher.
+ * @param[in] subs Subscription to queue.
+ */
+static void
+sr_shmsub_disp_queue(sr_conn_ctx_t *conn, sr_subscription_ctx_t *subs)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+
+    assert(subs->disp_state == SR_SUB_DISP_IDLE);
+
+    /* there is always enough space, each subscription can be queued only once */
+    disp->queue[disp->queue_count] = subs;
+    ++disp->queue_count;
+    subs->disp_state = SR_SUB_DISP_QUEUED;
+
+    if (disp->idle_count >= disp->queue_count) {
+        /* wake an idle worker */
+        pthread_cond_broadcast(&disp->cond);
+        return;
+    }
+
+    if (disp->worker_max && (disp->worker_count >= disp->worker_max)) {
+        /* limit reached, the subscription will be processed once a worker is free */
+        return;
+    }
+
+    /* all the workers are busy, a callback may even be waiting for another subscription, so create a new one */
+    if ((err_info = sr_shmsub_disp_new_worker(conn))) {
+        /* it is printed, the subscription will be processed once a worker is free */
+        sr_errinfo_free(&err_info);
+    }
+}
+
+/**
+ * @brief Dispatcher thread of all the subscriptions of a connection.
+ *
+ * @param[in] arg Pointer to the connection.
+ * @return Always NULL.
+ */
+static void *
+sr_shmsub_disp_thread(void *arg)
+{
+    sr_error_info_t *err_info = NULL;
+    sr_conn_ctx_t *conn = (sr_conn_ctx_t *)arg;
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+    struct epoll_event events[SR_SUB_DISP_EVENTS];
+    sr_subscription_ctx_t *subs;
+    uint64_t val;
+    time_t now;
+    uint32_t i;
+    int ret, j, timeout;
+
+    /* DISP LOCK */
+    pthread_mutex_lock(&disp->lock);
+
+    while (disp->running) {
+        /* queue subscriptions with an elapsed stop time and learn the nearest one */
+        now = time(NULL);
+        timeout = -1;
+        for (i = 0; i < disp->sub_count; ++i) {
+            subs = disp->subs[i];
+            if ((subs->disp_state != SR_SUB_DISP_IDLE) || !subs->disp_stop_time) {
+                continue;
+            }
+
+            if (subs->disp_stop_time <= now) {
+                subs->disp_stop_time = 0;
+                sr_shmsub_disp_queue(conn, subs);
+            } else if ((timeout == -1) || ((subs->disp_stop_time - now) * 1000 < timeout)) {
+                timeout = (subs->disp_stop_time - now) * 1000;
+            }
+        }
+
+        /* DISP UNLOCK */
+        pthread_mutex_unlock(&disp->lock);
+
+        /* wait for new events */
+        ret = epoll_wait(disp->epoll_fd, events, SR_SUB_DISP_EVENTS, timeout);
+
+        /* DISP LOCK */
+        pthread_mutex_lock(&disp->lock);
+
+        if (ret == -1) {
+            if (errno == EINTR) {
+                /* signal received, retry */
+                continue;
+            }
+            SR_ERRINFO_SYSERRNO(&err_info, "epoll_wait");
+            sr_errinfo_free(&err_info);
+            break;
+        }
+
+        for (j = 0; j < ret; ++j) {
+            if (!events[j].data.u32) {
+                /* woken up, just read the counter */
+                if (read(disp->wake_fd, &val, sizeof val) == -1) {
+                    SR_LOG_WRN("Reading the subscription dispatcher eventfd failed (%s).", strerror(errno));
+                }
+                continue;
+            }
+
+            /* find the subscription, it may have been removed meanwhile */
+            for (i = 0; i < disp->sub_count; ++i) {
+                if (disp->subs[i]->evpipe_num == events[j].data.u32) {
+                    break;
+                }
+            }
+            if ((i < disp->sub_count) && (disp->subs[i]->disp_state == SR_SUB_DISP_IDLE)) {
+                sr_shmsub_disp_queue(conn, disp->subs[i]);
+            }
+        }
+    }
+
+    /* DISP UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+    return NULL;
+}
+
+/**
+ * @brief Create the epoll instance and start the dispatcher thread.
+ *
+ * Dispatcher lock is expected to be held.
+ *
+ * @param[in] conn Connection of the dispatcher.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_shmsub_disp_start(sr_conn_ctx_t *conn)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+    struct epoll_event ev;
+    int ret;
+
+    disp->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (disp->epoll_fd == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "epoll_create1");
+        goto error;
+    }
+
+    disp->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (disp->wake_fd == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "eventfd");
+        goto error;
+    }
+
+    /* event pipe numbers start from 1, use 0 for the wake up eventfd */
+    ev.events = EPOLLIN;
+    ev.data.u32 = 0;
+    if (epoll_ctl(disp->epoll_fd, EPOLL_CTL_ADD, disp->wake_fd, &ev) == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "epoll_ctl");
+        goto error;
+    }
+
+    disp->running = 1;
+    ret = pthread_create(&disp->tid, NULL, sr_shmsub_disp_thread, conn);
+    if (ret) {
+        sr_errinfo_new(&err_info, SR_ERR_INTERNAL, NULL, "Creating a new thread failed (%s).", strerror(ret));
+        disp->running = 0;
+        goto error;
+    }
+
+    return NULL;
+
+error:
+    if (disp->wake_fd > -1) {
+        close(disp->wake_fd);
+        disp->wake_fd = -1;
+    }
+    if (disp->epoll_fd > -1) {
+        close(disp->epoll_fd);
+        disp->epoll_fd = -1;
+    }
+    return err_info;
+}
+
+void
+sr_shmsub_disp_destroy(sr_conn_ctx_t *conn)
+{
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+
+    assert(!disp->sub_count);
+
+    if (disp->epoll_fd > -1) {
+        /* DISP LOCK */
+        pthread_mutex_lock(&disp->lock);
+
+        /* stop all the threads */
+        disp->running = 0;
+        pthread_cond_broadcast(&disp->cond);
+        sr_shmsub_disp_wake(disp);
+
+        /* DISP UNLOCK */
+        pthread_mutex_unlock(&disp->lock);
+
+        pthread_join(disp->tid, NULL);
+
+        /* DISP LOCK */
+        pthread_mutex_lock(&disp->lock);
+
+        /* wait for the workers to terminate and join them so that none is using the dispatcher anymore */
+        while (disp->worker_count) {
+            pthread_cond_wait(&disp->cond, &disp->lock);
+        }
+        sr_shmsub_disp_join_workers(disp);
+        assert(!disp->worker_thread_count);
+
+        /* DISP UNLOCK */
+        pthread_mutex_unlock(&disp->lock);
+
+        close(disp->wake_fd);
+        close(disp->epoll_fd);
+    }
+
+    free(disp->subs);
+    free(disp->queue);
+    free(disp->workers);
+    pthread_cond_destroy(&disp->cond);
+    pthread_mutex_destroy(&disp->lock);
+}
+
+sr_error_info_t *
+sr_shmsub_disp_add(sr_subscription_ctx_t *subs)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_sub_disp_s *disp = &subs->conn->sub_disp;
+    struct epoll_event ev;
+    void *mem;
+
+    /* DISP LOCK */
+    pthread_mutex_lock(&disp->lock);
+
+    if ((disp->epoll_fd == -1) && (err_info = sr_shmsub_disp_start(subs->conn))) {
+        goto cleanup_unlock;
+    }
+
+    /* make space for the subscription, also in the queue */
+    mem = realloc(disp->subs, (disp->sub_count + 1) * sizeof *disp->subs);
+    SR_CHECK_MEM_GOTO(!mem, err_info, cleanup_unlock);
+    disp->subs = mem;
+    mem = realloc(disp->queue, (disp->sub_count + 1) * sizeof *disp->queue);
+    SR_CHECK_MEM_GOTO(!mem, err_info, cleanup_unlock);
+    disp->queue = mem;
+
+    /* listen on its event pipe */
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.u32 = subs->evpipe_num;
+    if (epoll_ctl(disp->epoll_fd, EPOLL_CTL_ADD, subs->evpipe, &ev) == -1) {
+        SR_ERRINFO_SYSERRNO(&err_info, "epoll_ctl");
+        goto cleanup_unlock;
+    }
+
+    disp->subs[disp->sub_count] = subs;
+    ++disp->sub_count;
+    subs->disp_state = SR_SUB_DISP_IDLE;
+    subs->disp_stop_time = 0;
+
+cleanup_unlock:
+    /* DISP UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+    return err_info;
+}
+
+void
+sr_shmsub_disp_set_worker_max(sr_conn_ctx_t *conn, uint32_t worker_max)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_sub_disp_s *disp = &conn->sub_disp;
+    uint32_t new_count = 0;
+
+    /* DISP LOCK */
+    pthread_mutex_lock(&disp->lock);
+
+    disp->worker_max = worker_max;
+
+    /* a higher limit may allow new workers for the waiting subscriptions */
+    while ((disp->queue_count > disp->idle_count + new_count)
+            && (!disp->worker_max || (disp->worker_count < disp->worker_max))) {
+        if ((err_info = sr_shmsub_disp_new_worker(conn))) {
+            sr_errinfo_free(&err_info);
+            break;
+        }
+        ++new_count;
+    }
+
+    /* DISP UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+}
+
+sr_error_info_t *
+sr_shmsub_disp_del(sr_subscription_ctx_t *subs)
+{
+    sr_error_info_t *err_info = NULL;
+    struct sr_sub_disp_s *disp = &subs->conn->sub_disp;
+
+    /* DISP LOCK */
+    pthread_mutex_lock(&disp->lock);
+
+    /* wait until its events are processed */
+    while (subs->disp_state == SR_SUB_DISP_PROCESSING) {
+        if (pthread_equal(subs->tid, pthread_self())) {
+            sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Joining the subscriber thread failed (%s).", strerror(EDEADLK));
+            goto cleanup_unlock;
+        }
+        pthread_cond_wait(&disp->cond, &disp->lock);
+    }
+
+    sr_shmsub_disp_remove(disp, subs);
+
+cleanup_unlock:
+    /* DISP UNLOCK */
+    pthread_mutex_unlock(&disp->lock);
+    return err_info;
+}
+
+#else
+
 void *
 sr_shmsub_listen_thread(void *arg)
 {
@@ -3239,3 +4506,5 @@ error:
     pthread_detach(pthread_self());
     return NULL;
 }
+
+#endif
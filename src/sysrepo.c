@@ -38,6 +38,8 @@
 #include <libyang/libyang.h>
 
 static sr_error_info_t *_sr_session_stop(sr_session_ctx_t *session);
+
+static sr_error_info_t *sr_oper_push_store(sr_session_ctx_t *session);
 static sr_error_info_t *_sr_unsubscribe(sr_subscription_ctx_t *subscription);
 
 /**
@@ -74,16 +76,38 @@ sr_conn_new(const sr_conn_options_t opts, sr_conn_ctx_t **conn_p)
         goto error4;
     }
 
+    if ((err_info = sr_mutex_init(&conn->evpipe_lock, 0))) {
+        goto error5;
+    }
+
+#ifdef SR_HAVE_EPOLL
+    if ((err_info = sr_shmsub_disp_init(conn))) {
+        goto error6;
+    }
+#endif
+
     conn->main_shm.fd = -1;
     conn->ext_shm.fd = -1;
 
     if ((conn->opts & SR_CONN_CACHE_RUNNING) && (err_info = sr_rwlock_init(&conn->mod_cache.lock, 0))) {
-        goto error5;
+        goto error7;
+    }
+
+    if ((conn->opts & SR_CONN_CACHE_RUNNING) && (err_info = sr_rwlock_init(&conn->oper_cache.lock, 0))) {
+        goto error8;
     }
 
     *conn_p = conn;
     return NULL;
 
+error8:
+    sr_rwlock_destroy(&conn->mod_cache.lock);
+error7:
+#ifdef SR_HAVE_EPOLL
+    sr_shmsub_disp_destroy(conn);
+#endif
+error6:
+    pthread_mutex_destroy(&conn->evpipe_lock);
 error5:
     sr_rwlock_destroy(&conn->ext_remap_lock);
 error4:
@@ -105,12 +129,28 @@ error1:
 static void
 sr_conn_free(sr_conn_ctx_t *conn)
 {
+    uint32_t i;
+
     if (conn) {
+#ifdef SR_HAVE_EPOLL
+        /* stop subscription threads first */
+        sr_shmsub_disp_destroy(conn);
+#endif
+
         /* free cache before context */
         if (conn->opts & SR_CONN_CACHE_RUNNING) {
             sr_rwlock_destroy(&conn->mod_cache.lock);
-            lyd_free_withsiblings(conn->mod_cache.data);
+            if (conn->mod_cache.snap) {
+                lyd_free_withsiblings(conn->mod_cache.snap->data);
+                free(conn->mod_cache.snap);
+            }
             free(conn->mod_cache.mods);
+
+            sr_rwlock_destroy(&conn->oper_cache.lock);
+            for (i = 0; i < conn->oper_cache.mod_count; ++i) {
+                lyd_free_withsiblings(conn->oper_cache.mods[i].data);
+            }
+            free(conn->oper_cache.mods);
         }
 
         ly_ctx_destroy(conn->ly_ctx, NULL);
@@ -119,6 +159,8 @@ sr_conn_free(sr_conn_ctx_t *conn)
             close(conn->main_create_lock);
         }
         sr_rwlock_destroy(&conn->ext_remap_lock);
+        sr_shmsub_evpipe_cache_clear(conn);
+        pthread_mutex_destroy(&conn->evpipe_lock);
         sr_shm_clear(&conn->main_shm);
         sr_shm_clear(&conn->ext_shm);
 
@@ -285,13 +327,15 @@ sr_connect(const sr_conn_options_t opts, sr_conn_ctx_t **conn_p)
         }
         main_shm = (sr_main_shm_t *)conn->main_shm.addr;
         main_shm->mod_count = 0;
+        main_shm->mod_hash = 0;
+        main_shm->mod_hash_size = 0;
 
         /* clear ext SHM (there can be no connections and no modules) */
-        if ((err_info = sr_shm_remap(&conn->ext_shm, sizeof(size_t)))) {
+        if ((err_info = sr_shm_remap(&conn->ext_shm, SR_SHM_SIZE(sizeof(sr_ext_shm_t))))) {
             goto cleanup_unlock;
         }
-        /* set wasted mem to 0 */
-        *((size_t *)conn->ext_shm.addr) = 0;
+        /* clear the header, no wasted memory nor free chunks */
+        memset(conn->ext_shm.addr, 0, SR_SHM_SIZE(sizeof(sr_ext_shm_t)));
 
         /* add all the modules in lydmods data into main SHM */
         if ((err_info = sr_shmmain_add(conn, sr_mods->child))) {
@@ -529,6 +573,8 @@ sr_session_start(sr_conn_ctx_t *conn, const sr_datastore_t datastore, sr_session
     if ((err_info = sr_rwlock_init(&(*session)->notif_buf.lock, 0))) {
         goto error;
     }
+    (*session)->oper_push.max_count = SR_OPER_PUSH_MAX_COUNT;
+    (*session)->oper_push.max_delay_ms = SR_OPER_PUSH_MAX_DELAY;
 
     SR_LOG_INF("Session %u (user \"%s\") created.", (*session)->sid.sr, (*session)->sid.user);
 
@@ -569,9 +615,10 @@ _sr_session_stop(sr_session_ctx_t *session)
         /* signal the thread */
         ATOMIC_STORE_RELAXED(session->notif_buf.thread_running, 0);
 
-        /* wake up the thread (by fake unlocking a read lock) */
-        ++session->notif_buf.lock.readers;
-        sr_rwunlock(&session->notif_buf.lock, SR_LOCK_READ, __func__);
+        /* wake up the thread */
+        pthread_mutex_lock(&session->notif_buf.lock.mutex);
+        pthread_cond_broadcast(&session->notif_buf.lock.cond);
+        pthread_mutex_unlock(&session->notif_buf.lock.mutex);
 
         if (!tmp_err) {
             /* join the thread, it will make sure all the buffered notifications are stored */
@@ -589,6 +636,8 @@ _sr_session_stop(sr_session_ctx_t *session)
     for (i = 0; i < SR_DS_COUNT; ++i) {
         lyd_free_withsiblings(session->dt[i].edit);
     }
+    lyd_free_withsiblings(session->oper_push.edit);
+    sr_xpath_cache_free(&session->xpath_cache);
     sr_errinfo_free(&session->err_info);
     pthread_mutex_destroy(&session->ptr_lock);
     sr_rwlock_destroy(&session->notif_buf.lock);
@@ -610,6 +659,12 @@ sr_session_stop(sr_session_ctx_t *session)
 
     conn = session->conn;
 
+    /* store any batched operational data updates */
+    if (session->oper_push.edit) {
+        tmp_err = sr_oper_push_store(session);
+        sr_errinfo_merge(&err_info, tmp_err);
+    }
+
     /* stop all subscriptions of this session */
     while (session->subscription_count) {
         if (!wr_lock) {
@@ -1380,6 +1435,34 @@ sr_set_module_access(sr_conn_ctx_t *conn, const char *module_name, const char *o
         goto cleanup_unlock;
     }
 
+    /* get running journal SHM file path */
+    if ((err_info = sr_path_ds_journal(module_name, 1, &path))) {
+        goto cleanup_unlock;
+    }
+
+    /* update running journal permissions and owner, if it exists */
+    if (sr_file_exists(path)) {
+        err_info = sr_chmodown(path, owner, group, perm);
+    }
+    free(path);
+    if (err_info) {
+        goto cleanup_unlock;
+    }
+
+    /* get running index SHM file path */
+    if ((err_info = sr_path_ds_index(module_name, 1, &path))) {
+        goto cleanup_unlock;
+    }
+
+    /* update running index permissions and owner, if it exists */
+    if (sr_file_exists(path)) {
+        err_info = sr_chmodown(path, owner, group, perm);
+    }
+    free(path);
+    if (err_info) {
+        goto cleanup_unlock;
+    }
+
     /* get operational SHM file path */
     if ((err_info = sr_path_ds_shm(module_name, SR_DS_OPERATIONAL, 1, &path))) {
         goto cleanup_unlock;
@@ -1562,7 +1645,7 @@ sr_get_item(sr_session_ctx_t *session, const char *path, uint32_t timeout_ms, sr
     }
 
     /* collect all required modules */
-    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, path))) {
+    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, path, &session->ptr_lock, &session->xpath_cache))) {
         goto cleanup_shm_unlock;
     }
 
@@ -1623,9 +1706,21 @@ cleanup_shm_unlock:
     return sr_api_ret(session, err_info);
 }
 
-API int
-sr_get_items(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms, const sr_get_oper_options_t opts,
-        sr_val_t **values, size_t *value_cnt)
+/**
+ * @brief Get values of data nodes.
+ *
+ * @param[in] session Session to use.
+ * @param[in] xpath XPath selecting the data.
+ * @param[in] timeout_ms Operational callback timeout in milliseconds.
+ * @param[in] opts Options overriding default get behaviour.
+ * @param[in] arena Whether to return all the values in a single allocation.
+ * @param[out] values Array of values.
+ * @param[out] value_cnt Number of @p values.
+ * @return err_code (SR_ERR_OK on success).
+ */
+static int
+_sr_get_items(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms, const sr_get_oper_options_t opts,
+        int arena, sr_val_t **values, size_t *value_cnt)
 {
     sr_error_info_t *err_info = NULL, *cb_err_info = NULL;
     struct ly_set *set = NULL;
@@ -1649,7 +1744,7 @@ sr_get_items(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms,
     }
 
     /* collect all required modules */
-    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, xpath))) {
+    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, xpath, &session->ptr_lock, &session->xpath_cache))) {
         goto cleanup_shm_unlock;
     }
 
@@ -1674,6 +1769,15 @@ sr_get_items(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms,
         goto cleanup_mods_unlock;
     }
 
+    if (arena) {
+        /* all the values in one allocation */
+        if ((err_info = sr_vals_ly2sr_arena(set->set.d, set->number, values))) {
+            goto cleanup_mods_unlock;
+        }
+        *value_cnt = set->number;
+        goto cleanup_mods_unlock;
+    }
+
     if (set->number) {
         *values = calloc(set->number, sizeof **values);
         SR_CHECK_MEM_GOTO(!*values, err_info, cleanup_mods_unlock);
@@ -1704,13 +1808,160 @@ cleanup_shm_unlock:
         err_info->err_code = SR_ERR_CALLBACK_FAILED;
     }
     if (err_info) {
-        sr_free_values(*values, *value_cnt);
+        if (arena) {
+            sr_free_values_arena(*values);
+        } else {
+            sr_free_values(*values, *value_cnt);
+        }
         *values = NULL;
         *value_cnt = 0;
     }
     return sr_api_ret(session, err_info);
 }
 
+API int
+sr_get_items(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms, const sr_get_oper_options_t opts,
+        sr_val_t **values, size_t *value_cnt)
+{
+    return _sr_get_items(session, xpath, timeout_ms, opts, 0, values, value_cnt);
+}
+
+API int
+sr_get_items_arena(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms, const sr_get_oper_options_t opts,
+        sr_val_t **values, size_t *value_cnt)
+{
+    return _sr_get_items(session, xpath, timeout_ms, opts, 1, values, value_cnt);
+}
+
+API int
+sr_get_items_iter_start(sr_session_ctx_t *session, const char *xpath, uint32_t page_size, uint32_t timeout_ms,
+        const sr_get_oper_options_t opts, sr_get_items_iter_t **iter)
+{
+    sr_error_info_t *err_info = NULL, *cb_err_info = NULL;
+    struct sr_mod_info_s *mod_info;
+
+    SR_CHECK_ARG_APIRET(!session || !xpath || !page_size || !iter || ((session->ds != SR_DS_OPERATIONAL) && opts),
+            session, err_info);
+
+    if (!timeout_ms) {
+        timeout_ms = SR_OPER_CB_TIMEOUT;
+    }
+
+    *iter = calloc(1, sizeof **iter);
+    if (!*iter) {
+        SR_ERRINFO_MEM(&err_info);
+        return sr_api_ret(session, err_info);
+    }
+    (*iter)->page_size = page_size;
+
+    /* the iterator keeps the mod info with the data snapshot */
+    mod_info = malloc(sizeof *mod_info);
+    SR_CHECK_MEM_GOTO(!mod_info, err_info, cleanup);
+    /* for operational, use operational and running datastore */
+    SR_MODINFO_INIT(*mod_info, session->conn, session->ds, session->ds == SR_DS_OPERATIONAL ? SR_DS_RUNNING : session->ds);
+    (*iter)->mod_info = mod_info;
+
+    /* SHM LOCK (reading subscriptions if using oper data) */
+    if ((err_info = sr_shmmain_lock_remap(session->conn, SR_LOCK_READ, 0, __func__))) {
+        goto cleanup;
+    }
+
+    /* collect all required modules */
+    if ((err_info = sr_shmmod_modinfo_collect_xpath(mod_info, xpath, &session->ptr_lock, &session->xpath_cache))) {
+        goto cleanup_shm_unlock;
+    }
+
+    /* check read perm */
+    if ((err_info = sr_modinfo_perm_check(mod_info, 0, 0))) {
+        goto cleanup_shm_unlock;
+    }
+
+    /* MODULES READ LOCK */
+    if ((err_info = sr_shmmod_modinfo_rdlock(mod_info, 0, session->sid))) {
+        goto cleanup_mods_unlock;
+    }
+
+    /* load modules data, cached data are a referenced cache snapshot that is never modified */
+    if ((err_info = sr_modinfo_data_load(mod_info, MOD_INFO_REQ, 1, &session->sid, xpath, timeout_ms, opts, &cb_err_info))
+            || cb_err_info) {
+        goto cleanup_mods_unlock;
+    }
+
+    /* filter the required data, the pages are then created from these nodes */
+    if ((err_info = sr_modinfo_get_filter(mod_info, xpath, session, &(*iter)->set))) {
+        goto cleanup_mods_unlock;
+    }
+
+    /* success */
+
+cleanup_mods_unlock:
+    /* MODULES UNLOCK */
+    sr_shmmod_modinfo_unlock(mod_info, 0);
+
+cleanup_shm_unlock:
+    /* SHM UNLOCK */
+    sr_shmmain_unlock(session->conn, SR_LOCK_READ, 0, __func__);
+
+cleanup:
+    if (cb_err_info) {
+        /* return callback error if some was generated */
+        sr_errinfo_merge(&err_info, cb_err_info);
+        err_info->err_code = SR_ERR_CALLBACK_FAILED;
+    }
+    if (err_info) {
+        sr_free_get_items_iter(*iter);
+        *iter = NULL;
+    }
+    return sr_api_ret(session, err_info);
+}
+
+API int
+sr_get_items_iter_next(sr_session_ctx_t *session, sr_get_items_iter_t *iter, sr_val_t **values, size_t *value_cnt)
+{
+    sr_error_info_t *err_info = NULL;
+    uint32_t count;
+
+    SR_CHECK_ARG_APIRET(!session || !iter || !values || !value_cnt, session, err_info);
+
+    *values = NULL;
+    *value_cnt = 0;
+
+    if (iter->idx >= iter->set->number) {
+        /* no more values */
+        return SR_ERR_NOT_FOUND;
+    }
+
+    /* transform the page into values */
+    count = iter->set->number - iter->idx;
+    if (count > iter->page_size) {
+        count = iter->page_size;
+    }
+    if ((err_info = sr_vals_ly2sr_arena(iter->set->set.d + iter->idx, count, values))) {
+        return sr_api_ret(session, err_info);
+    }
+    *value_cnt = count;
+
+    /* remember the position */
+    iter->idx += count;
+
+    return sr_api_ret(session, NULL);
+}
+
+API void
+sr_free_get_items_iter(sr_get_items_iter_t *iter)
+{
+    if (!iter) {
+        return;
+    }
+
+    ly_set_free(iter->set);
+    if (iter->mod_info) {
+        sr_modinfo_free(iter->mod_info);
+        free(iter->mod_info);
+    }
+    free(iter);
+}
+
 API int
 sr_get_subtree(sr_session_ctx_t *session, const char *path, uint32_t timeout_ms, struct lyd_node **subtree)
 {
@@ -1732,7 +1983,7 @@ sr_get_subtree(sr_session_ctx_t *session, const char *path, uint32_t timeout_ms,
     }
 
     /* collect all required modules */
-    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, path))) {
+    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, path, &session->ptr_lock, &session->xpath_cache))) {
         goto cleanup_shm_unlock;
     }
 
@@ -1818,7 +2069,7 @@ sr_get_data(sr_session_ctx_t *session, const char *xpath, uint32_t max_depth, ui
     }
 
     /* collect all required modules */
-    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, xpath))) {
+    if ((err_info = sr_shmmod_modinfo_collect_xpath(&mod_info, xpath, &session->ptr_lock, &session->xpath_cache))) {
         goto cleanup_shm_unlock;
     }
 
@@ -1959,6 +2210,13 @@ sr_free_values(sr_val_t *values, size_t count)
     free(values);
 }
 
+API void
+sr_free_values_arena(sr_val_t *values)
+{
+    /* the values and all their strings are in a single allocation */
+    free(values);
+}
+
 API int
 sr_set_item(sr_session_ctx_t *session, const char *path, const sr_val_t *value, const sr_edit_options_t opts)
 {
@@ -2215,7 +2473,7 @@ sr_changes_notify_store(struct sr_mod_info_s *mod_info, sr_session_ctx_t *sessio
     if (mod_info->diff && session->conn->diff_check_cb) {
         /* create temporary session */
         tmp_sess.conn = session->conn;
-        tmp_sess.ds = session->ds;
+        tmp_sess.ds = mod_info->ds;
         tmp_sess.ev = SR_SUB_EV_CHANGE;
         tmp_sess.sid = session->sid;
 
@@ -2232,7 +2490,7 @@ sr_changes_notify_store(struct sr_mod_info_s *mod_info, sr_session_ctx_t *sessio
     }
 
     /* validate new data trees */
-    switch (session->ds) {
+    switch (mod_info->ds) {
     case SR_DS_STARTUP:
     case SR_DS_RUNNING:
         if ((err_info = sr_modinfo_validate(mod_info, 1, NULL, NULL))) {
@@ -2280,7 +2538,7 @@ sr_changes_notify_store(struct sr_mod_info_s *mod_info, sr_session_ctx_t *sessio
         }
 
         /* validate updated data trees and finish new diff */
-        switch (session->ds) {
+        switch (mod_info->ds) {
         case SR_DS_STARTUP:
         case SR_DS_RUNNING:
             if ((err_info = sr_modinfo_validate(mod_info, 1, NULL, NULL))) {
@@ -2459,19 +2717,191 @@ sr_discard_changes(sr_session_ctx_t *session)
     return sr_api_ret(session, NULL);
 }
 
+/**
+ * @brief Store all batched operational data updates of a session and notify the subscribers the same way
+ * ::sr_apply_changes() does. The session datastore does not matter.
+ *
+ * @param[in] session Session to use.
+ * @return err_info, NULL on success.
+ */
+static sr_error_info_t *
+sr_oper_push_store(sr_session_ctx_t *session)
+{
+    sr_error_info_t *err_info = NULL, *cb_err_info = NULL;
+    struct sr_mod_info_s mod_info;
+    struct lyd_node *root;
+
+    SR_MODINFO_INIT(mod_info, session->conn, SR_DS_OPERATIONAL, SR_DS_RUNNING);
+
+    /* all the updates are merged */
+    LY_TREE_FOR(session->oper_push.edit, root) {
+        if (!sr_edit_find_oper(root, 0, NULL) && (err_info = sr_edit_set_oper(root, "merge"))) {
+            return err_info;
+        }
+    }
+
+    /* SHM LOCK (reading subscriptions) */
+    if ((err_info = sr_shmmain_lock_remap(session->conn, SR_LOCK_READ, 0, __func__))) {
+        return err_info;
+    }
+
+    /* collect all required modules */
+    if ((err_info = sr_shmmod_modinfo_collect_edit(&mod_info, session->oper_push.edit))) {
+        goto cleanup_shm_unlock;
+    }
+
+    /* MODULES READ LOCK (but setting flag for guaranteed later upgrade success) */
+    if ((err_info = sr_shmmod_modinfo_rdlock(&mod_info, 1, session->sid))) {
+        goto cleanup_mods_unlock;
+    }
+
+    /* load all modules data, stored oper data are not validated so no data from oper subscribers are needed */
+    if ((err_info = sr_modinfo_data_load(&mod_info, MOD_INFO_TYPE_MASK, 0, NULL, NULL, 0, SR_OPER_NO_SUBS, NULL))) {
+        goto cleanup_mods_unlock;
+    }
+
+    /* create diff */
+    if ((err_info = sr_modinfo_edit_apply(&mod_info, session->oper_push.edit, 1))) {
+        goto cleanup_mods_unlock;
+    }
+
+    /* notify all the subscribers about the whole batch and store it */
+    err_info = sr_changes_notify_store(&mod_info, session, SR_CHANGE_CB_TIMEOUT, 0, &cb_err_info);
+
+cleanup_mods_unlock:
+    /* MODULES UNLOCK */
+    sr_shmmod_modinfo_unlock(&mod_info, 1);
+
+cleanup_shm_unlock:
+    /* SHM UNLOCK */
+    sr_shmmain_unlock(session->conn, SR_LOCK_READ, 0, __func__);
+
+    if (!err_info && !cb_err_info) {
+        /* free stored updates */
+        lyd_free_withsiblings(session->oper_push.edit);
+        session->oper_push.edit = NULL;
+        session->oper_push.count = 0;
+        session->oper_push.store_failed = 0;
+    }
+
+    sr_modinfo_free(&mod_info);
+    if (cb_err_info) {
+        /* return callback error if some was generated */
+        sr_errinfo_merge(&err_info, cb_err_info);
+        err_info->err_code = SR_ERR_CALLBACK_FAILED;
+    }
+    return err_info;
+}
+
+API int
+sr_oper_push_batch(sr_session_ctx_t *session, const char *path, const char *value, const char *origin)
+{
+    sr_error_info_t *err_info = NULL;
+    struct lyd_node *node, *parent;
+    const char *def_origin;
+    struct timespec cur_ts;
+    int64_t delay_ms;
+
+    SR_CHECK_ARG_APIRET(!session || (session->ds != SR_DS_OPERATIONAL) || !path, session, err_info);
+
+    /* add the update into the batch, previous value of the node is replaced */
+    ly_errno = 0;
+    node = lyd_new_path(session->oper_push.edit, session->conn->ly_ctx, path, (void *)value, 0,
+            LYD_PATH_OPT_UPDATE | LYD_PATH_OPT_NOPARENTRET);
+    if (!node && ly_errno) {
+        sr_errinfo_new_ly(&err_info, session->conn->ly_ctx);
+        sr_errinfo_new(&err_info, SR_ERR_INVAL_ARG, NULL, "Invalid operational data update.");
+        return sr_api_ret(session, err_info);
+    }
+    if (node) {
+        if (!session->oper_push.edit) {
+            for (parent = node; parent->parent; parent = parent->parent);
+            session->oper_push.edit = parent;
+        }
+
+        /* add parent origin, if not set */
+        for (parent = node->parent; parent; parent = parent->parent) {
+            def_origin = (parent->schema->flags & LYS_CONFIG_R) ? SR_OPER_ORIGIN : SR_CONFIG_ORIGIN;
+            if ((err_info = sr_edit_diff_set_origin(parent, def_origin, 0))) {
+                return sr_api_ret(session, err_info);
+            }
+        }
+
+        /* add node origin */
+        if ((err_info = sr_edit_diff_set_origin(node, origin, 1))) {
+            return sr_api_ret(session, err_info);
+        }
+    } /* else the node already has this value */
+
+    if (!session->oper_push.count) {
+        sr_time_get(&session->oper_push.first_ts, 0);
+    }
+    ++session->oper_push.count;
+
+    /* store the batch once a limit is reached */
+    if (session->oper_push.store_failed) {
+        /* the limit remains reached, do not retry on every push but wait for an explicit flush */
+    } else if (session->oper_push.max_count && (session->oper_push.count >= session->oper_push.max_count)) {
+        err_info = sr_oper_push_store(session);
+    } else if (session->oper_push.max_delay_ms) {
+        sr_time_get(&cur_ts, 0);
+        delay_ms = (cur_ts.tv_sec - session->oper_push.first_ts.tv_sec) * 1000
+                + (cur_ts.tv_nsec - session->oper_push.first_ts.tv_nsec) / 1000000;
+        if (delay_ms >= session->oper_push.max_delay_ms) {
+            err_info = sr_oper_push_store(session);
+        }
+    }
+    if (err_info) {
+        /* the batch is kept */
+        session->oper_push.store_failed = 1;
+    }
+
+    return sr_api_ret(session, err_info);
+}
+
+API int
+sr_oper_push_flush(sr_session_ctx_t *session)
+{
+    sr_error_info_t *err_info = NULL;
+
+    SR_CHECK_ARG_APIRET(!session, session, err_info);
+
+    if (!session->oper_push.edit) {
+        session->oper_push.count = 0;
+        session->oper_push.store_failed = 0;
+        return sr_api_ret(session, NULL);
+    }
+
+    err_info = sr_oper_push_store(session);
+    return sr_api_ret(session, err_info);
+}
+
+API int
+sr_oper_push_limits(sr_session_ctx_t *session, uint32_t max_count, uint32_t max_delay_ms)
+{
+    sr_error_info_t *err_info = NULL;
+
+    SR_CHECK_ARG_APIRET(!session, session, err_info);
+
+    session->oper_push.max_count = max_count;
+    session->oper_push.max_delay_ms = max_delay_ms;
+    return sr_api_ret(session, NULL);
+}
+
 /**
  * @brief Replace config data of all or some modules.
  *
  * @param[in] session Session to use.
  * @param[in] ly_mod Optional specific module.
  * @param[in] src_config Source data for the replace, they are spent.
+ * @param[in] cand_diff Whether @p src_config is a stored candidate diff to apply instead.
  * @param[in] timeout_ms Change callback timeout in milliseconds.
  * @param[in] wait Whether to wait for DONE/ABORT events as well.
  * @return err_info, NULL on success.
  */
 static sr_error_info_t *
 _sr_replace_config(sr_session_ctx_t *session, const struct lys_module *ly_mod, struct lyd_node **src_config,
-        uint32_t timeout_ms, int wait)
+        int cand_diff, uint32_t timeout_ms, int wait)
 {
     sr_error_info_t *err_info = NULL, *cb_err_info = NULL;
     struct sr_mod_info_s mod_info;
@@ -2500,8 +2930,14 @@ _sr_replace_config(sr_session_ctx_t *session, const struct lys_module *ly_mod, s
         goto cleanup_mods_unlock;
     }
 
-    /* update affected data and create corresponding diff, src_config is spent */
-    if ((err_info = sr_modinfo_replace(&mod_info, src_config))) {
+    if (cand_diff) {
+        /* apply the candidate changes directly, they are the diff */
+        err_info = sr_modinfo_candidate_apply(&mod_info, src_config);
+    } else {
+        /* update affected data and create corresponding diff, src_config is spent */
+        err_info = sr_modinfo_replace(&mod_info, src_config);
+    }
+    if (err_info) {
         goto cleanup_mods_unlock;
     }
 
@@ -2556,7 +2992,7 @@ sr_replace_config(sr_session_ctx_t *session, const char *module_name, struct lyd
     }
 
     /* replace the data */
-    if ((err_info = _sr_replace_config(session, ly_mod, &src_config, timeout_ms, wait))) {
+    if ((err_info = _sr_replace_config(session, ly_mod, &src_config, 0, timeout_ms, wait))) {
         goto cleanup_shm_unlock;
     }
 
@@ -2577,6 +3013,7 @@ sr_copy_config(sr_session_ctx_t *session, const char *module_name, sr_datastore_
     sr_error_info_t *err_info = NULL;
     struct sr_mod_info_s mod_info;
     const struct lys_module *ly_mod = NULL;
+    struct lyd_node *cand_diff = NULL;
 
     SR_CHECK_ARG_APIRET(!session || !SR_IS_CONVENTIONAL_DS(src_datastore) || !SR_IS_CONVENTIONAL_DS(session->ds),
             session, err_info);
@@ -2624,8 +3061,13 @@ sr_copy_config(sr_session_ctx_t *session, const char *module_name, sr_datastore_
         goto cleanup_shm_unlock;
     }
 
-    /* get their data */
-    err_info = sr_modinfo_data_load(&mod_info, MOD_INFO_REQ, 0, NULL, NULL, 0, 0, NULL);
+    if ((src_datastore == SR_DS_CANDIDATE) && (session->ds == SR_DS_RUNNING) && SR_CANDIDATE_DIFF) {
+        /* get only the candidate changes, they are applied on running data directly */
+        err_info = sr_modinfo_candidate_diff_load(&mod_info, &cand_diff);
+    } else {
+        /* get their data */
+        err_info = sr_modinfo_data_load(&mod_info, MOD_INFO_REQ, 0, NULL, NULL, 0, 0, NULL);
+    }
 
     /* MODULES UNLOCK */
     sr_shmmod_modinfo_unlock(&mod_info, 0);
@@ -2634,9 +3076,16 @@ sr_copy_config(sr_session_ctx_t *session, const char *module_name, sr_datastore_
         goto cleanup_shm_unlock;
     }
 
-    /* replace the data */
-    if ((err_info = _sr_replace_config(session, ly_mod, &mod_info.data, timeout_ms, wait))) {
-        goto cleanup_shm_unlock;
+    if ((src_datastore == SR_DS_CANDIDATE) && (session->ds == SR_DS_RUNNING) && SR_CANDIDATE_DIFF) {
+        /* apply the changes, if any */
+        if (cand_diff && (err_info = _sr_replace_config(session, ly_mod, &cand_diff, 1, timeout_ms, wait))) {
+            goto cleanup_shm_unlock;
+        }
+    } else {
+        /* replace the data */
+        if ((err_info = _sr_replace_config(session, ly_mod, &mod_info.data, 0, timeout_ms, wait))) {
+            goto cleanup_shm_unlock;
+        }
     }
 
     if ((src_datastore == SR_DS_CANDIDATE) && (session->ds == SR_DS_RUNNING)) {
@@ -2652,6 +3101,7 @@ cleanup_shm_unlock:
     /* SHM UNLOCK */
     sr_shmmain_unlock(session->conn, SR_LOCK_READ, 0, __func__);
 
+    lyd_free_withsiblings(cand_diff);
     sr_modinfo_free(&mod_info);
     return sr_api_ret(session, err_info);
 }
@@ -3055,6 +3505,25 @@ cleanup_unlock:
     return sr_api_ret(session, err_info);
 }
 
+API int
+sr_set_subscription_thread_limit(sr_conn_ctx_t *conn, uint32_t max_threads)
+{
+    sr_error_info_t *err_info = NULL;
+
+    SR_CHECK_ARG_APIRET(!conn, NULL, err_info);
+
+#ifdef SR_HAVE_EPOLL
+    sr_shmsub_disp_set_worker_max(conn, max_threads);
+#else
+    (void)max_threads;
+
+    /* there is a thread per subscription */
+    sr_errinfo_new(&err_info, SR_ERR_UNSUPPORTED, NULL, "Subscription events are not dispatched by connection threads.");
+#endif
+
+    return sr_api_ret(NULL, err_info);
+}
+
 /**
  * @brief Unlocked unsubscribe (free) a subscription.
  *
@@ -3074,8 +3543,12 @@ _sr_unsubscribe(sr_subscription_ctx_t *subscription)
         /* signal the thread to quit */
         ATOMIC_STORE_RELAXED(subscription->thread_running, 0);
 
+#ifdef SR_HAVE_EPOLL
+        /* stop dispatching its events */
+        err_info = sr_shmsub_disp_del(subscription);
+#else
         /* generate a new event for the thread to wake up */
-        err_info = sr_shmsub_notify_evpipe(subscription->evpipe_num);
+        err_info = sr_shmsub_notify_evpipe(subscription->conn, subscription->evpipe_num);
 
         if (!err_info) {
             /* join the thread */
@@ -3084,6 +3557,7 @@ _sr_unsubscribe(sr_subscription_ctx_t *subscription)
                 sr_errinfo_new(&err_info, SR_ERR_SYS, NULL, "Joining the subscriber thread failed (%s).", strerror(ret));
             }
         }
+#endif
     }
 
     /* delete all subscriptions (also removes this subscription from all the sessions) */
@@ -3313,12 +3787,19 @@ sr_subs_new(sr_conn_ctx_t *conn, sr_subscr_options_t opts, sr_subscription_ctx_t
         /* set thread_running to non-zero so that thread does not immediately quit */
         ATOMIC_STORE_RELAXED((*subs_p)->thread_running, 1);
 
+#ifdef SR_HAVE_EPOLL
+        /* let the connection dispatcher handle its events */
+        if ((err_info = sr_shmsub_disp_add(*subs_p))) {
+            goto error;
+        }
+#else
         /* start the listen thread */
         ret = pthread_create(&(*subs_p)->tid, NULL, sr_shmsub_listen_thread, *subs_p);
         if (ret) {
             sr_errinfo_new(&err_info, SR_ERR_INTERNAL, NULL, "Creating a new thread failed (%s).", strerror(ret));
             goto error;
         }
+#endif
     }
 
     free(path);
@@ -4416,7 +4897,7 @@ _sr_event_notif_subscribe(sr_session_ctx_t *session, const char *mod_name, const
 
     if (start_time) {
         /* notify subscription there are already some events (replay needs to be performed) */
-        if ((err_info = sr_shmsub_notify_evpipe((*subscription)->evpipe_num))) {
+        if ((err_info = sr_shmsub_notify_evpipe(conn, (*subscription)->evpipe_num))) {
             goto error_unlock_unsub;
         }
     }
@@ -4606,7 +5087,8 @@ sr_event_notif_send_tree(sr_session_ctx_t *session, struct lyd_node *notif)
 
     if (notif_sub_count) {
         /* publish notif in an event, do not wait for subscribers */
-        if ((tmp_err_info = sr_shmsub_notif_notify(notif, notif_ts, session->sid, (uint32_t *)notif_subs, notif_sub_count))) {
+        if ((tmp_err_info = sr_shmsub_notif_notify(session->conn, notif, notif_ts, session->sid, (uint32_t *)notif_subs,
+                notif_sub_count))) {
             goto cleanup_shm_unlock;
         }
     } else {
@@ -177,12 +177,20 @@ typedef struct sr_session_ctx_s sr_session_ctx_t;
  */
 typedef enum sr_conn_flag_e {
     SR_CONN_DEFAULT = 0,            /**< No special behaviour. */
-    SR_CONN_CACHE_RUNNING = 1,      /**< Always cache running datastore data which makes mainly repeated retrieval of data
-                                         much faster. Affects all sessions created on this connection. */
+    SR_CONN_CACHE_RUNNING = 1,      /**< Always cache running datastore data and enabled running data merged with stored
+                                         operational data which makes mainly repeated retrieval of data much faster.
+                                         Affects all sessions created on this connection. */
     SR_CONN_NO_SCHED_CHANGES = 2,   /**< Do not parse internal modules data and apply any scheduled changes. Makes
                                          creating the connection faster but, obviously, scheduled changes are not applied. */
     SR_CONN_ERR_ON_SCHED_FAIL = 4,  /**< If applying any of the scheduled changes fails, do not create a connection
                                          and return an error. */
+    SR_CONN_CONCURRENT_CHANGE_EVENTS = 8, /**< Publish "update", "change", and "done" events for all the changed modules
+                                         at once and wait for their subscribers together instead of one module after
+                                         another. Priorities of subscribers of a single module are still respected and
+                                         if any callback fails, all the notified subscribers get the "abort" event. */
+    SR_CONN_FULL_VALIDATION = 16,   /**< Validate all the changed modules and all the modules depending on them in full.
+                                         By default, only modules with changed data and modules referencing changed
+                                         modules are validated for ::SR_DS_RUNNING and ::SR_DS_STARTUP. */
 } sr_conn_flag_t;
 
 /**
@@ -746,6 +754,74 @@ int sr_get_item(sr_session_ctx_t *session, const char *path, uint32_t timeout_ms
 int sr_get_items(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms, const sr_get_oper_options_t opts,
         sr_val_t **values, size_t *value_cnt);
 
+/**
+ * @brief Retrieve an array of data elements selected by the provided XPath, same as ::sr_get_items.
+ *
+ * The returned array and all the xpaths and strings of its values are stored in a single allocation
+ * so that retrieving many elements (such as large lists) requires only this one allocation.
+ * The values must not be modified in a way requiring to free or reallocate any of their strings.
+ *
+ * @param[in] session Session ([DS](@ref sr_datastore_t)-specific) to use.
+ * @param[in] xpath [XPath](@ref paths) of the data elements to be retrieved.
+ * @param[in] timeout_ms Operational callback timeout in milliseconds. If 0, default is used.
+ * @param[in] opts Options overriding default get behaviour.
+ * @param[out] values Array of requested nodes, allocated dynamically (free using ::sr_free_values_arena).
+ * @param[out] value_cnt Number of returned elements in the values array.
+ * @return Error code (::SR_ERR_OK on success).
+ */
+int sr_get_items_arena(sr_session_ctx_t *session, const char *xpath, uint32_t timeout_ms,
+        const sr_get_oper_options_t opts, sr_val_t **values, size_t *value_cnt);
+
+/**
+ * @brief Iterator used for retrieval of data elements in pages using ::sr_get_items_iter_start call.
+ */
+typedef struct sr_get_items_iter_s sr_get_items_iter_t;
+
+/**
+ * @brief Create an iterator for retrieving data elements selected by the provided XPath in pages
+ * of at most \p page_size elements.
+ *
+ * The data are loaded and the elements selected once, by this function, holding the module locks only
+ * while doing so. The iterator then keeps this data snapshot (if the running data are cached, the cached
+ * data are referenced and not copied) and every page is created from it by ::sr_get_items_iter_next
+ * so that only a single page of ::sr_val_t structures is allocated at any time. Any changes made to
+ * the data after this call are not reflected in the pages.
+ *
+ * Required READ access, but if the access check fails, the module data are simply ignored without an error.
+ *
+ * @see ::sr_get_items_iter_next for retrieving the pages using this iterator.
+ *
+ * @param[in] session Session ([DS](@ref sr_datastore_t)-specific) to use.
+ * @param[in] xpath [XPath](@ref paths) of the data elements to be retrieved.
+ * @param[in] page_size Maximum number of elements in a page, must be non-zero.
+ * @param[in] timeout_ms Operational callback timeout in milliseconds. If 0, default is used.
+ * @param[in] opts Options overriding default get behaviour.
+ * @param[out] iter Iterator context that can be used to retrieve the pages using ::sr_get_items_iter_next calls.
+ * Allocated by the function, should be freed with ::sr_free_get_items_iter.
+ * @return Error code (::SR_ERR_OK on success).
+ */
+int sr_get_items_iter_start(sr_session_ctx_t *session, const char *xpath, uint32_t page_size, uint32_t timeout_ms,
+        const sr_get_oper_options_t opts, sr_get_items_iter_t **iter);
+
+/**
+ * @brief Retrieve the next page of data elements from the provided iterator created
+ * by ::sr_get_items_iter_start call. Data are represented as ::sr_val_t structures.
+ *
+ * @param[in] session Session ([DS](@ref sr_datastore_t)-specific) to use.
+ * @param[in,out] iter Iterator acquired with ::sr_get_items_iter_start call.
+ * @param[out] values Array of the next requested nodes in a single allocation (free using ::sr_free_values_arena).
+ * @param[out] value_cnt Number of returned elements in the values array.
+ * @return Error code (::SR_ERR_OK on success, ::SR_ERR_NOT_FOUND on no more elements).
+ */
+int sr_get_items_iter_next(sr_session_ctx_t *session, sr_get_items_iter_t *iter, sr_val_t **values, size_t *value_cnt);
+
+/**
+ * @brief Frees ::sr_get_items_iter_t iterator and all memory allocated within it.
+ *
+ * @param[in] iter Iterator to be freed.
+ */
+void sr_free_get_items_iter(sr_get_items_iter_t *iter);
+
 /**
  * @brief Retrieve a single subtree whose root node is selected by the provided path.
  * Data are represented as _libyang_ subtrees.
@@ -808,6 +884,13 @@ void sr_free_val(sr_val_t *value);
  */
 void sr_free_values(sr_val_t *values, size_t count);
 
+/**
+ * @brief Free array of ::sr_val_t structures returned by ::sr_get_items_arena.
+ *
+ * @param[in] values Array of values to be freed.
+ */
+void sr_free_values_arena(sr_val_t *values);
+
 /** @} getdata */
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1023,6 +1106,8 @@ int sr_replace_config(sr_session_ctx_t *session, const char *module_name, struct
  *
  * @note Note that copying from _candidate_ to _running_ or vice versa causes
  * the _candidate_ datastore to revert to original behavior of mirroring _running_ datastore (@ref datastores).
+ * If built with the `CANDIDATE_DIFF` option, copying from _candidate_ to _running_ applies only the _candidate_ changes
+ * on the current _running_ data and fails if any of them conflict with it.
  *
  * Required WRITE access.
  *
@@ -1038,6 +1123,51 @@ int sr_replace_config(sr_session_ctx_t *session, const char *module_name, struct
 int sr_copy_config(sr_session_ctx_t *session, const char *module_name, sr_datastore_t src_datastore, uint32_t timeout_ms,
         int wait);
 
+/**
+ * @brief Push a value of an operational leaf, leaf-list, list, or presence container in a batch.
+ * Repeated updates of the same node before the batch is stored keep only the last value.
+ *
+ * The batch is stored once the limits set by ::sr_oper_push_limits() are reached, checked on every push,
+ * on calling ::sr_oper_push_flush(), or on stopping the session. Storing it is equivalent to setting all the values
+ * using ::sr_set_item_str() and applying them with ::sr_apply_changes() without waiting for ::SR_EV_DONE,
+ * so the subscribers are notified about all the batched changes at once.
+ *
+ * If the batch could not be stored once a limit was reached, the error is returned and the batch, including
+ * this update, is kept. No more attempts to store it are then made by further pushes, it is stored only
+ * by ::sr_oper_push_flush().
+ *
+ * Required WRITE access.
+ *
+ * @param[in] session Session (::SR_DS_OPERATIONAL) to use.
+ * @param[in] path [Path](@ref paths) identifier of the data element to be set.
+ * @param[in] value String representation of the value to be set.
+ * @param[in] origin Optional origin of the value.
+ * @return Error code (::SR_ERR_OK on success).
+ */
+int sr_oper_push_batch(sr_session_ctx_t *session, const char *path, const char *value, const char *origin);
+
+/**
+ * @brief Store all the operational data updates batched by ::sr_oper_push_batch(). In case they could not be stored
+ * for any reason, they remain batched in the session. The session datastore may have been switched since.
+ *
+ * Required WRITE access.
+ *
+ * @param[in] session Session to use.
+ * @return Error code (::SR_ERR_OK on success).
+ */
+int sr_oper_push_flush(sr_session_ctx_t *session);
+
+/**
+ * @brief Set the limits of batching operational data updates by ::sr_oper_push_batch(). By default, updates
+ * are stored after 1000 pushes or once the first batched update is 100 ms old.
+ *
+ * @param[in] session Session to use.
+ * @param[in] max_count Maximum number of pushed updates before they are stored, 0 for no limit.
+ * @param[in] max_delay_ms Maximum delay of storing the first pushed update in milliseconds, 0 for no limit.
+ * @return Error code (::SR_ERR_OK on success).
+ */
+int sr_oper_push_limits(sr_session_ctx_t *session, uint32_t max_count, uint32_t max_delay_ms);
+
 /** @} editdata */
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -1114,8 +1244,9 @@ typedef enum sr_subscr_flag_e {
     /**
      * @brief Default behavior of the subscription. In case of ::sr_module_change_subscribe call it means that:
      *
-     * - for every new subscription (flag ::SR_SUBSCR_CTX_REUSE not used) a thread is created that listens for
-     *   new events (can be changed with ::SR_SUBSCR_NO_THREAD flag),
+     * - for every new subscription (flag ::SR_SUBSCR_CTX_REUSE not used) new events are listened for and processed
+     *   by threads of the connection, at most one thread processing events of a subscription at a time
+     *   (can be changed with ::SR_SUBSCR_NO_THREAD flag),
      * - the subscriber is the "owner" of the subscribed data tree and it will appear in the operational
      *   datastore while this subscription is alive (if not already, can be changed using ::SR_SUBSCR_PASSIVE flag),
      * - the callback will be called twice, once with ::SR_EV_CHANGE event and once with ::SR_EV_DONE / ::SR_EV_ABORT
@@ -1223,6 +1354,20 @@ int sr_get_event_pipe(sr_subscription_ctx_t *subscription, int *event_pipe);
  */
 int sr_process_events(sr_subscription_ctx_t *subscription, sr_session_ctx_t *session, time_t *stop_time_in);
 
+/**
+ * @brief Limit the number of threads processing events of the subscriptions of a connection, which are created
+ * only when all the existing threads are busy. By default, there are at most 16 threads.
+ *
+ * @note A callback waiting for another subscription of the same connection (for example, a change callback
+ * reading operational data provided by the same process) may time out when all the threads are busy.
+ * Increase the limit or remove it completely in such a case.
+ *
+ * @param[in] conn Connection to use.
+ * @param[in] max_threads Maximum number of subscription threads, 0 for no limit.
+ * @return Error code (::SR_ERR_OK on success, ::SR_ERR_UNSUPPORTED if events are not dispatched by connection threads).
+ */
+int sr_set_subscription_thread_limit(sr_conn_ctx_t *conn, uint32_t max_threads);
+
 /**
  * @brief Unsubscribes from a subscription acquired by any of sr_*_subscribe
  * calls and releases all subscription-related data.
@@ -30,6 +30,7 @@
 #include <setjmp.h>
 #include <cmocka.h>
 #include <stdbool.h>
+#include <pthread.h>
 #include <libyang/libyang.h>
 
 #include "tests/config.h"
@@ -46,6 +47,15 @@
 /**@brief constant for commit operation */
 #define OP_COUNT_COMMIT 1000
 
+/**@brief constant for loading a large data file */
+#define OP_COUNT_LOAD 20
+
+/**@brief number of list instances in a large data file */
+#define LOAD_LIST_COUNT 100000
+
+/**@brief number of threads used for concurrent operations */
+#define THREAD_COUNT 8
+
 #define TEST_SCHEMA_SEARCH_DIR "/home/vasko/Documents/sysrepo/build/repository/yang/"
 #define TEST_DATA_PREFIX "/dev/shm/sr_"
 #define SR_RUNNING_FILE_EXT ".running"
@@ -80,6 +90,50 @@ timeval_subtract (struct timeval *result, struct timeval *x, struct timeval *y)
     return x->tv_sec < y->tv_sec;
 }
 
+/* Per-operation latencies of the measured test, recorded only by some tests */
+double *op_latencies;
+int op_latency_count;
+
+/* Records latency of a single operation that started at the given time */
+void
+record_latency(const struct timeval *start)
+{
+    struct timeval begin = *start, end = {0, }, diff = {0, };
+
+    gettimeofday(&end, NULL);
+    timeval_subtract(&diff, &end, &begin);
+
+    op_latencies = realloc(op_latencies, (op_latency_count + 1) * sizeof *op_latencies);
+    assert_non_null(op_latencies);
+    op_latencies[op_latency_count++] = diff.tv_sec * 1000.0 + diff.tv_usec / 1000.0;
+}
+
+static int
+latency_cmp(const void *ptr1, const void *ptr2)
+{
+    double l1 = *(const double *)ptr1, l2 = *(const double *)ptr2;
+
+    return (l1 > l2) - (l1 < l2);
+}
+
+/* Prints percentiles of the recorded latencies, if any, and discards them */
+void
+print_latencies(void)
+{
+    if (!op_latency_count) {
+        return;
+    }
+
+    qsort(op_latencies, op_latency_count, sizeof *op_latencies, latency_cmp);
+    printf("%-32s| p50 %8.3f ms | p90 %8.3f ms | p99 %8.3f ms | max %8.3f ms\n", "  latency",
+            op_latencies[op_latency_count * 50 / 100], op_latencies[op_latency_count * 90 / 100],
+            op_latencies[op_latency_count * 99 / 100], op_latencies[op_latency_count - 1]);
+
+    free(op_latencies);
+    op_latencies = NULL;
+    op_latency_count = 0;
+}
+
 typedef struct test_s{
     void ( *function)(void **, int, int *);
     char *op_name;
@@ -135,6 +189,7 @@ measure(void (*func)(void **, int, int *), const char *name, int op_count, void
     seconds = diff.tv_sec + 0.000001*diff.tv_usec;
     printf("%-32s| %10.0f | %10d | %13d | %10.0f | %10.2f\n",
             name, items ? ((double) op_count)/ seconds : 0, items, op_count, items ? ((double) op_count * items)/ seconds : 0, seconds);
+    print_latencies();
 }
 
 void
@@ -156,6 +211,23 @@ sysrepo_setup(void **state)
 
 }
 
+void
+sysrepo_nocache_setup(void **state)
+{
+    sr_conn_ctx_t *conn = NULL;
+    int rc = SR_ERR_OK;
+
+    /* turn off all logging */
+    sr_log_stderr(SR_LL_WRN);
+    sr_log_syslog("perf_test", SR_LL_NONE);
+
+    /* connect to sysrepo, data are always loaded from the data files */
+    rc = sr_connect(SR_CONN_DEFAULT, &conn);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    *state = (void*)conn;
+}
+
 void
 sysrepo_teardown(void **state)
 {
@@ -327,6 +399,76 @@ perf_get_item_test(void **state, int op_num, int *items)
     *items = 1;
 }
 
+struct concurrent_arg {
+    sr_conn_ctx_t *conn;
+    int op_num;
+};
+
+static void *
+get_item_thread(void *arg)
+{
+    struct concurrent_arg *carg = arg;
+    sr_session_ctx_t *session = NULL;
+    sr_val_t *value = NULL;
+    int rc;
+
+    rc = sr_session_start(carg->conn, SR_DS_RUNNING, &session);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    for (int i = 0; i < carg->op_num; i++) {
+        rc = sr_get_item(session, "/example-module:container/list[key1='key1'][key2='key2']/leaf", 0, &value);
+        assert_int_equal(rc, SR_ERR_OK);
+        sr_free_val(value);
+    }
+
+    sr_session_stop(session);
+    return NULL;
+}
+
+static void *
+commit_thread(void *arg)
+{
+    struct concurrent_arg *carg = arg;
+    sr_session_ctx_t *session = NULL;
+    int rc;
+
+    rc = sr_session_start(carg->conn, SR_DS_RUNNING, &session);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    for (int i = 0; i < carg->op_num; i++) {
+        rc = sr_set_item_str(session, "/example-module:container/list[key1='key1'][key2='key2']/leaf",
+                (i % 2) ? "Leaf value" : "Leaf value changed", NULL, 0);
+        assert_int_equal(rc, SR_ERR_OK);
+        rc = sr_apply_changes(session, 0, 0);
+        assert_int_equal(rc, SR_ERR_OK);
+    }
+
+    sr_session_stop(session);
+    return NULL;
+}
+
+/* measures lock contention, get-item requests are split between concurrent threads while one more thread commits */
+static void
+perf_get_item_concurrent_test(void **state, int op_num, int *items)
+{
+    sr_conn_ctx_t *conn = *state;
+    assert_non_null(conn);
+
+    pthread_t tids[THREAD_COUNT + 1];
+    struct concurrent_arg get_arg = {conn, op_num / THREAD_COUNT}, commit_arg = {conn, op_num / 1000};
+    int i;
+
+    for (i = 0; i < THREAD_COUNT; i++) {
+        pthread_create(&tids[i], NULL, get_item_thread, &get_arg);
+    }
+    pthread_create(&tids[i], NULL, commit_thread, &commit_arg);
+
+    for (i = 0; i < THREAD_COUNT + 1; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    *items = 1;
+}
+
 static void
 perf_get_item_first_test(void **state, int op_num, int *items)
 {
@@ -395,6 +537,64 @@ perf_get_item_with_data_load_test(void **state, int op_num, int *items)
     *items = 1;
 }
 
+static void
+perf_data_load_test(void **state, int op_num, int *items)
+{
+    sr_conn_ctx_t *conn = *state;
+    assert_non_null(conn);
+    sr_session_ctx_t *session = NULL;
+    sr_val_t *value = NULL;
+    struct timeval start;
+    int rc = 0;
+
+    /* start a session */
+    rc = sr_session_start(conn, SR_DS_RUNNING, &session);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    /* every get-item loads the whole data file, the instance is not selected by all its keys */
+    for (int i = 0; i<op_num; i++){
+        gettimeofday(&start, NULL);
+        rc = sr_get_item(session, "/example-module:container/list[key1='key1']/leaf", 0, &value);
+        assert_int_equal(rc, SR_ERR_OK);
+        record_latency(&start);
+        sr_free_val(value);
+    }
+
+    /* stop the session */
+    rc = sr_session_stop(session);
+    assert_int_equal(rc, SR_ERR_OK);
+    *items = instance_cnt;
+}
+
+static void
+perf_data_load_inst_test(void **state, int op_num, int *items)
+{
+    sr_conn_ctx_t *conn = *state;
+    assert_non_null(conn);
+    sr_session_ctx_t *session = NULL;
+    sr_val_t *value = NULL;
+    struct timeval start;
+    int rc = 0;
+
+    /* start a session */
+    rc = sr_session_start(conn, SR_DS_RUNNING, &session);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    /* every get-item loads only the selected list instance */
+    for (int i = 0; i<op_num; i++){
+        gettimeofday(&start, NULL);
+        rc = sr_get_item(session, "/example-module:container/list[key1='key1'][key2='key2']/leaf", 0, &value);
+        assert_int_equal(rc, SR_ERR_OK);
+        record_latency(&start);
+        sr_free_val(value);
+    }
+
+    /* stop the session */
+    rc = sr_session_stop(session);
+    assert_int_equal(rc, SR_ERR_OK);
+    *items = 1;
+}
+
 static void
 perf_get_items_test(void **state, int op_num, int *items)
 {
@@ -691,15 +891,16 @@ perf_set_delete_100_test(void **state, int op_num, int *items)
 }
 
 static void
-perf_commit_test(void **state, int op_num, int *items)
+perf_commit_ds_test(void **state, int op_num, int *items, sr_datastore_t ds)
 {
     sr_conn_ctx_t *conn = *state;
     assert_non_null(conn);
     sr_session_ctx_t *session = NULL;
+    struct timeval start;
     int rc = 0;
 
     /* start a session */
-    rc = sr_session_start(conn, SR_DS_RUNNING, &session);
+    rc = sr_session_start(conn, ds, &session);
     assert_int_equal(rc, SR_ERR_OK);
 
     /* perform edit, commit request */
@@ -715,8 +916,10 @@ perf_commit_test(void **state, int op_num, int *items)
             rc = sr_set_item(session, "/example-module:container/list[key1='key1'][key2='key2']/leaf", &value, SR_EDIT_DEFAULT);
         }
         assert_int_equal(rc, SR_ERR_OK);
+        gettimeofday(&start, NULL);
         rc = sr_apply_changes(session, 0, 0);
         assert_int_equal(rc, SR_ERR_OK);
+        record_latency(&start);
         even = !even;
     }
 
@@ -726,6 +929,56 @@ perf_commit_test(void **state, int op_num, int *items)
     *items = 1;
 }
 
+static void
+perf_commit_test(void **state, int op_num, int *items)
+{
+    perf_commit_ds_test(state, op_num, items, SR_DS_RUNNING);
+}
+
+static void
+perf_commit_startup_test(void **state, int op_num, int *items)
+{
+    perf_commit_ds_test(state, op_num, items, SR_DS_STARTUP);
+}
+
+static void
+perf_oper_push_test(void **state, int op_num, int *items)
+{
+    sr_conn_ctx_t *conn = *state;
+    assert_non_null(conn);
+    sr_session_ctx_t *session = NULL;
+    struct timeval start;
+    char str[16];
+    int rc = 0;
+
+    /* start a session */
+    rc = sr_session_start(conn, SR_DS_OPERATIONAL, &session);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    /* push counter updates, they are stored in batches */
+    for (int i = 0; i<op_num; i++){
+        sprintf(str, "%d", i);
+        gettimeofday(&start, NULL);
+        rc = sr_oper_push_batch(session, "/ietf-interfaces:interfaces-state/interface[name='eth0']/statistics/in-octets",
+                str, NULL);
+        assert_int_equal(rc, SR_ERR_OK);
+        record_latency(&start);
+    }
+    rc = sr_oper_push_flush(session);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    /* remove the pushed data */
+    rc = sr_delete_item(session, "/ietf-interfaces:interfaces-state", SR_EDIT_DEFAULT);
+    assert_int_equal(rc, SR_ERR_OK);
+    rc = sr_apply_changes(session, 0, 0);
+    assert_int_equal(rc, SR_ERR_OK);
+
+    /* stop the session */
+    rc = sr_session_stop(session);
+    assert_int_equal(rc, SR_ERR_OK);
+    *items = 1;
+}
+
 static int
 test_rpc_cb(sr_session_ctx_t *session, const char *op_path, const sr_val_t *input, const size_t input_cnt,
         sr_event_t event, uint32_t request_id, sr_val_t **output, size_t *output_cnt, void *private_data)
@@ -1065,6 +1318,7 @@ main(int argc, char **argv)
     test_t tests[] = {
         {perf_get_item_test, "Get item one leaf", OP_COUNT, sysrepo_setup, sysrepo_teardown},
         {perf_get_item_first_test, "Get item first leaf", OP_COUNT, sysrepo_setup, sysrepo_teardown},
+        {perf_get_item_concurrent_test, "Get item concurrent w/ commits", OP_COUNT, sysrepo_setup, sysrepo_teardown},
         {perf_get_item_with_data_load_test, "Get item incl session start", OP_COUNT, sysrepo_setup, sysrepo_teardown},
         {perf_get_items_test, "Get items all lists", OP_COUNT, sysrepo_setup, sysrepo_teardown},
         {perf_get_items_iter_test, "Get items iter all lists", OP_COUNT, sysrepo_setup, sysrepo_teardown},
@@ -1076,6 +1330,8 @@ main(int argc, char **argv)
         {perf_set_delete_test, "Set & delete one list", OP_COUNT, sysrepo_setup, sysrepo_teardown},
         {perf_set_delete_100_test, "Set & delete 100 lists", OP_COUNT_COMMIT, sysrepo_setup, sysrepo_teardown},
         {perf_commit_test, "Commit one leaf change", OP_COUNT_COMMIT, sysrepo_setup, sysrepo_teardown},
+        {perf_commit_startup_test, "Commit one startup leaf change", OP_COUNT_COMMIT, sysrepo_setup, sysrepo_teardown},
+        {perf_oper_push_test, "Operational push batch", OP_COUNT, sysrepo_setup, sysrepo_teardown},
         {perf_data_provide_test, "Operational data provide", OP_COUNT_COMMIT, data_provide_setup, data_provide_teardown},
         {perf_rpc_test, "RPC", OP_COUNT_COMMIT, sysrepo_setup, sysrepo_teardown},
         {perf_ev_notification_ephemeral_test, "Event notification - ephemeral", OP_COUNT_COMMIT, sysrepo_setup, sysrepo_teardown},
@@ -1084,6 +1340,11 @@ main(int argc, char **argv)
         {perf_libyang_get_all_list, "Libyang get all list", OP_COUNT, libyang_setup, libyang_teardown},
     };
 
+    test_t load_tests[] = {
+        {perf_data_load_test, "Load data file", OP_COUNT_LOAD, sysrepo_nocache_setup, sysrepo_teardown},
+        {perf_data_load_inst_test, "Load one list instance", OP_COUNT_LOAD, sysrepo_nocache_setup, sysrepo_teardown},
+    };
+
     size_t test_count = sizeof(tests)/sizeof(*tests);
     sr_conn_ctx_t *conn = NULL;
     sr_session_ctx_t *sess;
@@ -1154,6 +1415,13 @@ main(int argc, char **argv)
     createDataTreeLargeIETFinterfacesModule(sess, 100);
     instance_cnt = 100;
     test_perf(tests, test_count, "Data file with 100 list instances", selection);
+
+    if (selection == -1) {
+        /* 100k list instances, measure only loading the data file */
+        createDataTreeLargeExampleModule(sess, LOAD_LIST_COUNT);
+        instance_cnt = LOAD_LIST_COUNT;
+        test_perf(load_tests, sizeof load_tests / sizeof *load_tests, "Data file with 100000 list instances", -1);
+    }
     puts("\n\n");
     ret = 0;
 
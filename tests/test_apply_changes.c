@@ -23,6 +23,7 @@
 
 #include <sys/types.h>
 #include <unistd.h>
+#include <poll.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <setjmp.h>
@@ -37,7 +38,7 @@
 
 struct state {
     sr_conn_ctx_t *conn;
-    volatile int cb_called, cb_called2;
+    volatile int cb_called, cb_called2, cb_called3;
     pthread_barrier_t barrier, barrier2;
 };
 
@@ -116,6 +117,7 @@ setup_f(void **state)
 
     st->cb_called = 0;
     st->cb_called2 = 0;
+    st->cb_called3 = 0;
     pthread_barrier_init(&st->barrier, NULL, 2);
     pthread_barrier_init(&st->barrier2, NULL, 2);
     return 0;
@@ -4247,6 +4249,77 @@ test_change_done_xpath(void **state)
     pthread_join(tid[1], NULL);
 }
 
+/* TEST */
+static int
+module_change_filter_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
+
+    (void)session;
+    (void)event;
+    (void)request_id;
+
+    assert_string_equal(module_name, "test");
+    if (!strcmp(xpath, "/test:cont")) {
+        /* never any changes for this subscription */
+        ++st->cb_called2;
+    } else {
+        assert_string_equal(xpath, "/test:test-leaf");
+        ++st->cb_called;
+    }
+
+    return SR_ERR_OK;
+}
+
+static void
+test_change_filter(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr, *subscr2;
+    struct pollfd pfd;
+    int ret;
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* subscriber whose events are never processed */
+    ret = sr_module_change_subscribe(sess, "test", "/test:cont", module_change_filter_cb, st, 0, SR_SUBSCR_NO_THREAD,
+            &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_module_change_subscribe(sess, "test", "/test:test-leaf", module_change_filter_cb, st, 0, 0, &subscr2);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* the other subscriber is not interested in the changes so it is not waited for (there would be a timeout) */
+    ret = sr_set_item_str(sess, "/test:test-leaf", "10", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 500, 1);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(st->cb_called, 2);
+
+    /* and it was not even notified */
+    ret = sr_get_event_pipe(subscr, &pfd.fd);
+    assert_int_equal(ret, SR_ERR_OK);
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ret = poll(&pfd, 1, 0);
+    assert_int_equal(ret, 0);
+    ret = sr_process_events(subscr, NULL, NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(st->cb_called2, 0);
+
+    /* cleanup */
+    sr_unsubscribe(subscr2);
+    sr_unsubscribe(subscr);
+    ret = sr_delete_item(sess, "/test:test-leaf", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    sr_session_stop(sess);
+}
+
 /* TEST */
 static int
 module_change_unlocked_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
@@ -4362,219 +4435,610 @@ test_change_unlocked(void **state)
 
 /* TEST */
 static int
-module_change_timeout_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+module_change_evpipe_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
         uint32_t request_id, void *private_data)
 {
     struct state *st = (struct state *)private_data;
 
     (void)session;
-    (void)xpath;
     (void)request_id;
 
     assert_string_equal(module_name, "test");
+    assert_string_equal(xpath, "/test:test-leaf");
 
-    switch (st->cb_called) {
-    case 0:
-        assert_int_equal(event, SR_EV_CHANGE);
-
-        /* time out, twice */
-        pthread_barrier_wait(&st->barrier2);
-        pthread_barrier_wait(&st->barrier2);
-        break;
-    case 1:
-        /* we timeouted before, but returned success so now we get abort */
-        assert_int_equal(event, SR_EV_ABORT);
-
-        pthread_barrier_wait(&st->barrier2);
-        break;
-    case 2:
-        assert_int_equal(event, SR_EV_CHANGE);
-        break;
-    case 3:
+    if (st->cb_called % 2) {
         assert_int_equal(event, SR_EV_DONE);
-        break;
-    default:
-        fail();
+    } else {
+        assert_int_equal(event, SR_EV_CHANGE);
     }
 
     ++st->cb_called;
     return SR_ERR_OK;
 }
 
-static void *
-apply_change_timeout_thread(void *arg)
+static void
+test_change_evpipe(void **state)
 {
-    struct state *st = (struct state *)arg;
+    struct state *st = (struct state *)*state;
     sr_session_ctx_t *sess;
-    int ret;
+    sr_subscription_ctx_t *subscr;
+    char val[8];
+    int count, ret, i, j;
 
     ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
     assert_int_equal(ret, SR_ERR_OK);
 
-    ret = sr_set_item_str(sess, "/test:l1[k='subscr']/v", "30", NULL, 0);
-    assert_int_equal(ret, SR_ERR_OK);
-
-    /* wait for subscription before applying changes */
-    pthread_barrier_wait(&st->barrier);
-
-    /* perform the change, time out but give it some time so that the callback is at least called) */
-    ret = sr_apply_changes(sess, 10, 0);
-    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
-    pthread_barrier_wait(&st->barrier2);
+    for (i = 0; i < 3; ++i) {
+        /* new subscription with a new event pipe, the previous one was removed but may still be cached */
+        ret = sr_module_change_subscribe(sess, "test", "/test:test-leaf", module_change_evpipe_cb, st, 0, 0, &subscr);
+        assert_int_equal(ret, SR_ERR_OK);
 
-    /* try again while the first callback is still executing (waiting) */
-    ret = sr_apply_changes(sess, 10, 0);
-    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
-    pthread_barrier_wait(&st->barrier2);
+        /* notify the same event pipe repeatedly */
+        for (j = 0; j < 2; ++j) {
+            sprintf(val, "%d", i * 2 + j);
+            ret = sr_set_item_str(sess, "/test:test-leaf", val, NULL, 0);
+            assert_int_equal(ret, SR_ERR_OK);
+            ret = sr_apply_changes(sess, 0, 0);
+            assert_int_equal(ret, SR_ERR_OK);
 
-    /* process abort */
-    pthread_barrier_wait(&st->barrier2);
+            /* wait for the done event */
+            count = 0;
+            while ((st->cb_called < (i * 2 + j + 1) * 2) && (count < 1500)) {
+                usleep(10000);
+                ++count;
+            }
+            assert_int_equal(st->cb_called, (i * 2 + j + 1) * 2);
+        }
 
-    /* signal that the commit is finished (by timeout) */
-    pthread_barrier_wait(&st->barrier);
+        sr_unsubscribe(subscr);
+    }
 
-    /* finally apply changes successfully */
+    /* no subscribers, no events */
+    ret = sr_delete_item(sess, "/test:test-leaf", 0);
+    assert_int_equal(ret, SR_ERR_OK);
     ret = sr_apply_changes(sess, 0, 0);
     assert_int_equal(ret, SR_ERR_OK);
-
-    /* signal that we have finished applying the changes */
-    pthread_barrier_wait(&st->barrier);
+    assert_int_equal(st->cb_called, 12);
 
     sr_session_stop(sess);
-    return NULL;
 }
 
-static void *
-subscribe_change_timeout_thread(void *arg)
+/* TEST */
+static int
+module_change_mod_diff_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
 {
-    struct state *st = (struct state *)arg;
-    sr_session_ctx_t *sess;
-    sr_subscription_ctx_t *subscr;
-    int count, ret;
-
-    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
-    assert_int_equal(ret, SR_ERR_OK);
-
-    ret = sr_module_change_subscribe(sess, "test", "/test:l1[k='subscr']", module_change_timeout_cb, st, 0, 0, &subscr);
-    assert_int_equal(ret, SR_ERR_OK);
+    struct state *st = (struct state *)private_data;
+    sr_change_iter_t *iter;
+    sr_change_oper_t op;
+    sr_val_t *old_val, *new_val;
+    char prefix[64];
+    int ret, count;
 
-    /* signal that subscription was created */
-    pthread_barrier_wait(&st->barrier);
+    (void)xpath;
+    (void)request_id;
 
-    count = 0;
-    while ((st->cb_called < 2) && (count < 1500)) {
-        usleep(10000);
-        ++count;
+    if (event != SR_EV_CHANGE) {
+        return SR_ERR_OK;
     }
-    assert_int_equal(st->cb_called, 2);
 
-    /* wait for the other thread to report timeout */
-    pthread_barrier_wait(&st->barrier);
+    /* all the changes must belong to the subscribed module */
+    sprintf(prefix, "/%s:", module_name);
+    ret = sr_get_changes_iter(session, "//.", &iter);
+    assert_int_equal(ret, SR_ERR_OK);
 
     count = 0;
-    while ((st->cb_called < 4) && (count < 1500)) {
-        usleep(10000);
+    while ((ret = sr_get_change_next(session, iter, &op, &old_val, &new_val)) == SR_ERR_OK) {
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_int_equal(strncmp(new_val->xpath, prefix, strlen(prefix)), 0);
+        sr_free_val(new_val);
         ++count;
     }
-    assert_int_equal(st->cb_called, 4);
+    assert_int_equal(ret, SR_ERR_NOT_FOUND);
+    sr_free_change_iter(iter);
 
-    /* wait for the other thread to finish */
-    pthread_barrier_wait(&st->barrier);
+    if (!strcmp(module_name, "test")) {
+        /* test-leaf */
+        assert_int_equal(count, 1);
+        ++st->cb_called;
+    } else {
+        /* interfaces, interface, name, type, and defaults */
+        assert_string_equal(module_name, "ietf-interfaces");
+        assert_true(count >= 4);
+        ++st->cb_called2;
+    }
 
-    sr_unsubscribe(subscr);
-    sr_session_stop(sess);
-    return NULL;
+    return SR_ERR_OK;
 }
 
 static void
-test_change_timeout(void **state)
+test_change_mod_diff(void **state)
 {
-    pthread_t tid[2];
+    struct state *st = (struct state *)*state;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr;
+    int ret;
 
-    pthread_create(&tid[0], NULL, apply_change_timeout_thread, *state);
-    pthread_create(&tid[1], NULL, subscribe_change_timeout_thread, *state);
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
 
-    pthread_join(tid[0], NULL);
-    pthread_join(tid[1], NULL);
+    ret = sr_module_change_subscribe(sess, "test", NULL, module_change_mod_diff_cb, st, 0, 0, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_module_change_subscribe(sess, "ietf-interfaces", NULL, module_change_mod_diff_cb, st, 0,
+            SR_SUBSCR_CTX_REUSE, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* change both modules at once */
+    ret = sr_set_item_str(sess, "/test:test-leaf", "30", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/ietf-interfaces:interfaces/interface[name='eth52']/type",
+            "iana-if-type:ethernetCsmacd", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* each subscriber got only the changes of its module */
+    assert_int_equal(st->cb_called, 1);
+    assert_int_equal(st->cb_called2, 1);
+
+    sr_unsubscribe(subscr);
+
+    /* cleanup */
+    ret = sr_delete_item(sess, "/test:test-leaf", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(sess, "/ietf-interfaces:interfaces", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    sr_session_stop(sess);
 }
 
 /* TEST */
+static pthread_mutex_t thread_limit_lock = PTHREAD_MUTEX_INITIALIZER;
+static int thread_limit_active;
+
 static int
-module_change_order_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+module_change_thread_limit_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
         uint32_t request_id, void *private_data)
 {
     struct state *st = (struct state *)private_data;
 
     (void)session;
     (void)xpath;
+    (void)event;
     (void)request_id;
 
-    switch (st->cb_called) {
-    case 0:
-    case 5:
-    case 9:
-        assert_string_equal(module_name, "test");
-        assert_int_equal(event, SR_EV_CHANGE);
-        break;
-    case 1:
-    case 4:
-    case 8:
-        assert_string_equal(module_name, "ietf-interfaces");
-        assert_int_equal(event, SR_EV_CHANGE);
-        break;
-    case 2:
-    case 3:
-    case 6:
-    case 7:
-    case 10:
-    case 11:
-        /* we cannot rely on any order for DONE event */
-        assert_int_equal(event, SR_EV_DONE);
-        break;
-    default:
-        fail();
-    }
+    assert_string_equal(module_name, "test");
+
+    /* only one callback can be running at a time */
+    pthread_mutex_lock(&thread_limit_lock);
+    ++thread_limit_active;
+    assert_int_equal(thread_limit_active, 1);
+    pthread_mutex_unlock(&thread_limit_lock);
 
+    usleep(50000);
+
+    pthread_mutex_lock(&thread_limit_lock);
+    --thread_limit_active;
     ++st->cb_called;
+    pthread_mutex_unlock(&thread_limit_lock);
     return SR_ERR_OK;
 }
 
-static void *
-apply_change_order_thread(void *arg)
+static void
+test_change_thread_limit(void **state)
 {
-    struct state *st = (struct state *)arg;
-    sr_session_ctx_t *sess;
-    int ret;
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess, *sess2;
+    sr_subscription_ctx_t *subscr[3];
+    int count, ret, i;
 
-    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
-    assert_int_equal(ret, SR_ERR_OK);
+#ifndef SR_HAVE_EPOLL
+    /* there is a thread per subscription */
+    skip();
+#endif
 
-    /* edit will be created in this order */
-    ret = sr_set_item_str(sess, "/test:l1[k='one']/v", "30", NULL, 0);
+    /* separate connection for the subscriptions */
+    ret = sr_connect(0, &conn);
     assert_int_equal(ret, SR_ERR_OK);
-    ret = sr_set_item_str(sess, "/ietf-interfaces:interfaces/interface[name='eth0']/type", "iana-if-type:ethernetCsmacd", NULL, 0);
+    ret = sr_set_subscription_thread_limit(conn, 1);
     assert_int_equal(ret, SR_ERR_OK);
-
-    /* wait for subscription before applying changes */
-    pthread_barrier_wait(&st->barrier);
-
-    /* perform the change */
-    ret = sr_apply_changes(sess, 0, 0);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
     assert_int_equal(ret, SR_ERR_OK);
 
-    pthread_barrier_wait(&st->barrier);
+    /* subscriptions with the same priority are notified at once, but there is only one thread to process them */
+    for (i = 0; i < 3; ++i) {
+        ret = sr_module_change_subscribe(sess, "test", NULL, module_change_thread_limit_cb, st, 0, 0, &subscr[i]);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
 
-    /* create edit in different order */
-    ret = sr_set_item_str(sess, "/ietf-interfaces:interfaces/interface[name='eth1']/type", "iana-if-type:ethernetCsmacd", NULL, 0);
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess2);
     assert_int_equal(ret, SR_ERR_OK);
-    ret = sr_set_item_str(sess, "/test:l1[k='two']/v", "30", NULL, 0);
+    ret = sr_set_item_str(sess2, "/test:test-leaf", "20", NULL, 0);
     assert_int_equal(ret, SR_ERR_OK);
-
-    /* perform the second change */
-    ret = sr_apply_changes(sess, 0, 0);
+    ret = sr_apply_changes(sess2, 0, 0);
     assert_int_equal(ret, SR_ERR_OK);
 
-    pthread_barrier_wait(&st->barrier);
+    /* all the change events were processed, wait for the done events */
+    assert_true(st->cb_called >= 3);
+    count = 0;
+    while ((st->cb_called < 6) && (count < 1500)) {
+        usleep(10000);
+        ++count;
+    }
+    assert_int_equal(st->cb_called, 6);
+
+    for (i = 0; i < 3; ++i) {
+        sr_unsubscribe(subscr[i]);
+    }
+
+    /* cleanup */
+    ret = sr_delete_item(sess2, "/test:test-leaf", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess2, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    sr_session_stop(sess2);
+    sr_disconnect(conn);
+}
+
+/* TEST */
+static sr_subscription_ctx_t *unlocked_subs_subscr;
+
+static int
+module_change_unlocked_subs_fail_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath,
+        sr_event_t event, uint32_t request_id, void *private_data)
+{
+    (void)session;
+    (void)module_name;
+    (void)xpath;
+    (void)event;
+    (void)request_id;
+    (void)private_data;
+
+    /* the subscriptions have no changes in their subtree */
+    fail();
+    return SR_ERR_OK;
+}
+
+static int
+module_change_unlocked_subs_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
+    sr_session_ctx_t *sess;
+    char path[64];
+    int ret, i;
+
+    (void)session;
+    (void)request_id;
+
+    assert_string_equal(module_name, "test");
+    assert_string_equal(xpath, "/test:l1[k='subscr']");
+
+    switch (st->cb_called) {
+    case 0:
+        assert_int_equal(event, SR_EV_CHANGE);
+
+        /* add enough subscriptions for the same module and datastore so that they are moved in ext SHM */
+        ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+        assert_int_equal(ret, SR_ERR_OK);
+        for (i = 0; i < 10; ++i) {
+            sprintf(path, "/test:cont/l2[k='unlocked-%d']", i);
+            ret = sr_module_change_subscribe(sess, "test", path, module_change_unlocked_subs_fail_cb, NULL, 5,
+                    i ? SR_SUBSCR_CTX_REUSE : 0, &unlocked_subs_subscr);
+            assert_int_equal(ret, SR_ERR_OK);
+        }
+        sr_session_stop(sess);
+        break;
+    case 1:
+        assert_int_equal(event, SR_EV_DONE);
+
+        /* remove them again */
+        sr_unsubscribe(unlocked_subs_subscr);
+        unlocked_subs_subscr = NULL;
+        break;
+    default:
+        fail();
+    }
+
+    ++st->cb_called;
+    return SR_ERR_OK;
+}
+
+static int
+module_change_unlocked_subs2_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
+
+    (void)session;
+    (void)request_id;
+
+    assert_string_equal(module_name, "test");
+    assert_string_equal(xpath, "/test:l1[k='subscr']");
+
+    /* the subscription with the lower priority must be notified normally */
+    switch (st->cb_called2) {
+    case 0:
+        assert_int_equal(st->cb_called, 1);
+        assert_int_equal(event, SR_EV_CHANGE);
+        break;
+    case 1:
+        assert_int_equal(event, SR_EV_DONE);
+        break;
+    default:
+        fail();
+    }
+
+    ++st->cb_called2;
+    return SR_ERR_OK;
+}
+
+static void
+test_change_unlocked_subs(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr;
+    int count, ret;
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* the unlocked subscription changes subscriptions of its own module while the event is being notified */
+    ret = sr_module_change_subscribe(sess, "test", "/test:l1[k='subscr']", module_change_unlocked_subs_cb, st, 10,
+            SR_SUBSCR_UNLOCKED, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_module_change_subscribe(sess, "test", "/test:l1[k='subscr']", module_change_unlocked_subs2_cb, st, 1,
+            SR_SUBSCR_CTX_REUSE, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_set_item_str(sess, "/test:l1[k='subscr']/v", "30", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* wait for the done events, they are processed asynchronously */
+    count = 0;
+    while (((st->cb_called < 2) || (st->cb_called2 < 2)) && (count < 1500)) {
+        usleep(10000);
+        ++count;
+    }
+    assert_int_equal(st->cb_called, 2);
+    assert_int_equal(st->cb_called2, 2);
+    assert_null(unlocked_subs_subscr);
+
+    sr_unsubscribe(subscr);
+
+    /* cleanup */
+    ret = sr_delete_item(sess, "/test:l1[k='subscr']", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    sr_session_stop(sess);
+}
+
+/* TEST */
+static int
+module_change_timeout_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
+
+    (void)session;
+    (void)xpath;
+    (void)request_id;
+
+    assert_string_equal(module_name, "test");
+
+    switch (st->cb_called) {
+    case 0:
+        assert_int_equal(event, SR_EV_CHANGE);
+
+        /* time out, twice */
+        pthread_barrier_wait(&st->barrier2);
+        pthread_barrier_wait(&st->barrier2);
+        break;
+    case 1:
+        /* we timeouted before, but returned success so now we get abort */
+        assert_int_equal(event, SR_EV_ABORT);
+
+        pthread_barrier_wait(&st->barrier2);
+        break;
+    case 2:
+        assert_int_equal(event, SR_EV_CHANGE);
+        break;
+    case 3:
+        assert_int_equal(event, SR_EV_DONE);
+        break;
+    default:
+        fail();
+    }
+
+    ++st->cb_called;
+    return SR_ERR_OK;
+}
+
+static void *
+apply_change_timeout_thread(void *arg)
+{
+    struct state *st = (struct state *)arg;
+    sr_session_ctx_t *sess;
+    int ret;
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_set_item_str(sess, "/test:l1[k='subscr']/v", "30", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* wait for subscription before applying changes */
+    pthread_barrier_wait(&st->barrier);
+
+    /* perform the change, time out but give it some time so that the callback is at least called) */
+    ret = sr_apply_changes(sess, 10, 0);
+    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
+    pthread_barrier_wait(&st->barrier2);
+
+    /* try again while the first callback is still executing (waiting) */
+    ret = sr_apply_changes(sess, 10, 0);
+    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
+    pthread_barrier_wait(&st->barrier2);
+
+    /* process abort */
+    pthread_barrier_wait(&st->barrier2);
+
+    /* signal that the commit is finished (by timeout) */
+    pthread_barrier_wait(&st->barrier);
+
+    /* finally apply changes successfully */
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* signal that we have finished applying the changes */
+    pthread_barrier_wait(&st->barrier);
+
+    sr_session_stop(sess);
+    return NULL;
+}
+
+static void *
+subscribe_change_timeout_thread(void *arg)
+{
+    struct state *st = (struct state *)arg;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr;
+    int count, ret;
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_module_change_subscribe(sess, "test", "/test:l1[k='subscr']", module_change_timeout_cb, st, 0, 0, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* signal that subscription was created */
+    pthread_barrier_wait(&st->barrier);
+
+    count = 0;
+    while ((st->cb_called < 2) && (count < 1500)) {
+        usleep(10000);
+        ++count;
+    }
+    assert_int_equal(st->cb_called, 2);
+
+    /* wait for the other thread to report timeout */
+    pthread_barrier_wait(&st->barrier);
+
+    count = 0;
+    while ((st->cb_called < 4) && (count < 1500)) {
+        usleep(10000);
+        ++count;
+    }
+    assert_int_equal(st->cb_called, 4);
+
+    /* wait for the other thread to finish */
+    pthread_barrier_wait(&st->barrier);
+
+    sr_unsubscribe(subscr);
+    sr_session_stop(sess);
+    return NULL;
+}
+
+static void
+test_change_timeout(void **state)
+{
+    pthread_t tid[2];
+
+    pthread_create(&tid[0], NULL, apply_change_timeout_thread, *state);
+    pthread_create(&tid[1], NULL, subscribe_change_timeout_thread, *state);
+
+    pthread_join(tid[0], NULL);
+    pthread_join(tid[1], NULL);
+}
+
+/* TEST */
+static int
+module_change_order_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
+
+    (void)session;
+    (void)xpath;
+    (void)request_id;
+
+    switch (st->cb_called) {
+    case 0:
+    case 5:
+    case 9:
+        assert_string_equal(module_name, "test");
+        assert_int_equal(event, SR_EV_CHANGE);
+        break;
+    case 1:
+    case 4:
+    case 8:
+        assert_string_equal(module_name, "ietf-interfaces");
+        assert_int_equal(event, SR_EV_CHANGE);
+        break;
+    case 2:
+    case 3:
+    case 6:
+    case 7:
+    case 10:
+    case 11:
+        /* we cannot rely on any order for DONE event */
+        assert_int_equal(event, SR_EV_DONE);
+        break;
+    default:
+        fail();
+    }
+
+    ++st->cb_called;
+    return SR_ERR_OK;
+}
+
+static void *
+apply_change_order_thread(void *arg)
+{
+    struct state *st = (struct state *)arg;
+    sr_session_ctx_t *sess;
+    int ret;
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* edit will be created in this order */
+    ret = sr_set_item_str(sess, "/test:l1[k='one']/v", "30", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/ietf-interfaces:interfaces/interface[name='eth0']/type", "iana-if-type:ethernetCsmacd", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* wait for subscription before applying changes */
+    pthread_barrier_wait(&st->barrier);
+
+    /* perform the change */
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    pthread_barrier_wait(&st->barrier);
+
+    /* create edit in different order */
+    ret = sr_set_item_str(sess, "/ietf-interfaces:interfaces/interface[name='eth1']/type", "iana-if-type:ethernetCsmacd", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/test:l1[k='two']/v", "30", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* perform the second change */
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    pthread_barrier_wait(&st->barrier);
 
     /* cleanup edit */
     ret = sr_delete_item(sess, "/ietf-interfaces:interfaces", 0);
@@ -4714,200 +5178,528 @@ module_change_userord_cb(sr_session_ctx_t *session, const char *module_name, con
         ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
         assert_int_equal(ret, SR_ERR_OK);
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_null(old_val);
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k1']/v");
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k1']/v");
+
+        sr_free_val(new_val);
+
+        /* 4th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k1']/ll12");
+
+        sr_free_val(new_val);
+
+        /* 5th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_non_null(old_val);
+        assert_string_equal(old_val->xpath, "/test:l1[k='k1']");
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k2']");
+
+        sr_free_val(old_val);
+        sr_free_val(new_val);
+
+        /* 6th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k2']/k");
+
+        sr_free_val(new_val);
+
+        /* 7th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k2']/v");
+
+        sr_free_val(new_val);
+
+        /* 8th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k2']/ll12");
+
+        sr_free_val(new_val);
+
+        /* 9th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_non_null(old_val);
+        assert_string_equal(old_val->xpath, "/test:l1[k='k2']");
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k3']");
+
+        sr_free_val(old_val);
+        sr_free_val(new_val);
+
+        /* 10th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k3']/k");
+
+        sr_free_val(new_val);
+
+        /* 11th change */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        assert_int_equal(op, SR_OP_CREATED);
+        assert_null(old_val);
+        assert_non_null(new_val);
+        assert_string_equal(new_val->xpath, "/test:l1[k='k3']/v");
+
+        sr_free_val(new_val);
+
+        /* no more changes */
+        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
+        assert_int_equal(ret, SR_ERR_NOT_FOUND);
+
+        sr_free_change_iter(iter);
+
+        /* check data */
+        ret = sr_get_items(session, "/test:l1//.", 0, 0, &new_val, &val_count);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(val_count, 11);
+
+        sr_free_values(new_val, val_count);
+        break;
+    default:
+        fail();
+    }
+
+    ++st->cb_called;
+    return SR_ERR_OK;
+}
+
+static void *
+apply_change_userord_thread(void *arg)
+{
+    struct state *st = (struct state *)arg;
+    sr_session_ctx_t *sess;
+    int ret;
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_set_item_str(sess, "/test:l1[k='k1']/v", "25", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/test:l1[k='k1']/ll12", "ahoy", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/test:l1[k='k2']/v", "52", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/test:l1[k='k2']/ll12", "mate", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/test:l1[k='k3']/v", "52", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* wait for subscription before applying changes */
+    pthread_barrier_wait(&st->barrier);
+
+    /* perform 1st change */
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* signal that we have finished applying changes */
+    pthread_barrier_wait(&st->barrier);
+
+    sr_session_stop(sess);
+    return NULL;
+}
+
+static void *
+subscribe_change_userord_thread(void *arg)
+{
+    struct state *st = (struct state *)arg;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr;
+    int count, ret;
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_module_change_subscribe(sess, "test", NULL, module_change_userord_cb, st, 0, 0, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* signal that subscription was created */
+    pthread_barrier_wait(&st->barrier);
+
+    count = 0;
+    while ((st->cb_called < 2) && (count < 1500)) {
+        usleep(10000);
+        ++count;
+    }
+    assert_int_equal(st->cb_called, 2);
+
+    /* wait for the other thread to finish */
+    pthread_barrier_wait(&st->barrier);
+
+    sr_unsubscribe(subscr);
+    sr_session_stop(sess);
+    return NULL;
+}
+
+static void
+test_change_userord(void **state)
+{
+    pthread_t tid[2];
+
+    pthread_create(&tid[0], NULL, apply_change_userord_thread, *state);
+    pthread_create(&tid[1], NULL, subscribe_change_userord_thread, *state);
+
+    pthread_join(tid[0], NULL);
+    pthread_join(tid[1], NULL);
+}
+
+/* TEST */
+static int
+module_change_concurrent_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
+
+    (void)session;
+    (void)xpath;
+    (void)request_id;
+
+    if (!strcmp(module_name, "test")) {
+        switch (st->cb_called) {
+        case 0:
+        case 2:
+            assert_int_equal(event, SR_EV_CHANGE);
+            break;
+        case 1:
+            /* the other module failed */
+            assert_int_equal(event, SR_EV_ABORT);
+            break;
+        case 3:
+            assert_int_equal(event, SR_EV_DONE);
+            break;
+        default:
+            fail();
+        }
+        ++st->cb_called;
+    } else {
+        assert_string_equal(module_name, "defaults");
+        switch (st->cb_called2) {
+        case 0:
+            assert_int_equal(event, SR_EV_CHANGE);
+
+            /* fail the first change, this subscriber must not get "abort" */
+            ++st->cb_called2;
+            return SR_ERR_UNSUPPORTED;
+        case 1:
+            assert_int_equal(event, SR_EV_CHANGE);
+            break;
+        case 2:
+            assert_int_equal(event, SR_EV_DONE);
+            break;
+        default:
+            fail();
+        }
+        ++st->cb_called2;
+    }
 
-        sr_free_val(new_val);
+    return SR_ERR_OK;
+}
 
-        /* 4th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+static void *
+apply_change_concurrent_thread(void *arg)
+{
+    struct state *st = (struct state *)arg;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    int ret;
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_null(old_val);
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k1']/ll12");
+    /* separate connection with concurrent change events */
+    ret = sr_connect(SR_CONN_CONCURRENT_CHANGE_EVENTS, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
 
-        sr_free_val(new_val);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
 
-        /* 5th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/test:test-leaf", "5", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/defaults:cont/interval", "40", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_non_null(old_val);
-        assert_string_equal(old_val->xpath, "/test:l1[k='k1']");
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k2']");
+    /* wait for subscription before applying changes */
+    pthread_barrier_wait(&st->barrier);
 
-        sr_free_val(old_val);
-        sr_free_val(new_val);
+    /* both modules are notified at once, one fails */
+    ret = sr_apply_changes(sess, 0, 1);
+    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
+    assert_int_equal(st->cb_called, 2);
+    assert_int_equal(st->cb_called2, 1);
 
-        /* 6th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+    /* now it succeeds */
+    ret = sr_apply_changes(sess, 0, 1);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(st->cb_called, 4);
+    assert_int_equal(st->cb_called2, 3);
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_null(old_val);
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k2']/k");
+    /* signal that we have finished applying the changes */
+    pthread_barrier_wait(&st->barrier);
 
-        sr_free_val(new_val);
+    sr_session_stop(sess);
+    sr_disconnect(conn);
+    return NULL;
+}
 
-        /* 7th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+static void *
+subscribe_change_concurrent_thread(void *arg)
+{
+    struct state *st = (struct state *)arg;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr;
+    int ret;
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_null(old_val);
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k2']/v");
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
 
-        sr_free_val(new_val);
+    ret = sr_module_change_subscribe(sess, "test", NULL, module_change_concurrent_cb, st, 0, 0, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_module_change_subscribe(sess, "defaults", NULL, module_change_concurrent_cb, st, 0, SR_SUBSCR_CTX_REUSE,
+            &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
 
-        /* 8th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+    /* signal that subscription was created */
+    pthread_barrier_wait(&st->barrier);
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_null(old_val);
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k2']/ll12");
+    /* wait for the other thread to finish */
+    pthread_barrier_wait(&st->barrier);
 
-        sr_free_val(new_val);
+    sr_unsubscribe(subscr);
 
-        /* 9th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+    /* cleanup */
+    ret = sr_delete_item(sess, "/test:test-leaf", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(sess, "/defaults:cont/interval", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_non_null(old_val);
-        assert_string_equal(old_val->xpath, "/test:l1[k='k2']");
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k3']");
+    sr_session_stop(sess);
+    return NULL;
+}
 
-        sr_free_val(old_val);
-        sr_free_val(new_val);
+static void
+test_change_concurrent(void **state)
+{
+    pthread_t tid[2];
 
-        /* 10th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+    pthread_create(&tid[0], NULL, apply_change_concurrent_thread, *state);
+    pthread_create(&tid[1], NULL, subscribe_change_concurrent_thread, *state);
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_null(old_val);
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k3']/k");
+    pthread_join(tid[0], NULL);
+    pthread_join(tid[1], NULL);
+}
 
-        sr_free_val(new_val);
+/* TEST */
+static int
+module_change_concurrent_update_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath,
+        sr_event_t event, uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
 
-        /* 11th change */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_OK);
+    (void)session;
+    (void)xpath;
+    (void)request_id;
 
-        assert_int_equal(op, SR_OP_CREATED);
-        assert_null(old_val);
-        assert_non_null(new_val);
-        assert_string_equal(new_val->xpath, "/test:l1[k='k3']/v");
+    if (!strcmp(module_name, "test")) {
+        switch (st->cb_called) {
+        case 0:
+            assert_int_equal(event, SR_EV_CHANGE);
 
-        sr_free_val(new_val);
+            /* fail the first change */
+            ++st->cb_called;
+            return SR_ERR_UNSUPPORTED;
+        case 1:
+            assert_int_equal(event, SR_EV_CHANGE);
+            break;
+        case 2:
+            assert_int_equal(event, SR_EV_DONE);
+            break;
+        default:
+            fail();
+        }
+        ++st->cb_called;
+    } else {
+        assert_string_equal(module_name, "defaults");
+        switch (st->cb_called2) {
+        case 0:
+        case 2:
+            assert_int_equal(event, SR_EV_CHANGE);
+            break;
+        case 1:
+            /* the other module failed */
+            assert_int_equal(event, SR_EV_ABORT);
+            break;
+        case 3:
+            assert_int_equal(event, SR_EV_DONE);
+            break;
+        default:
+            fail();
+        }
+        ++st->cb_called2;
+    }
 
-        /* no more changes */
-        ret = sr_get_change_next(session, iter, &op, &old_val, &new_val);
-        assert_int_equal(ret, SR_ERR_NOT_FOUND);
+    return SR_ERR_OK;
+}
 
-        sr_free_change_iter(iter);
+static int
+module_update_concurrent_update_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath,
+        sr_event_t event, uint32_t request_id, void *private_data)
+{
+    struct state *st = (struct state *)private_data;
 
-        /* check data */
-        ret = sr_get_items(session, "/test:l1//.", 0, 0, &new_val, &val_count);
-        assert_int_equal(ret, SR_ERR_OK);
-        assert_int_equal(val_count, 11);
+    (void)session;
+    (void)xpath;
+    (void)request_id;
 
-        sr_free_values(new_val, val_count);
+    assert_string_equal(module_name, "defaults");
+    switch (st->cb_called3) {
+    case 0:
+        assert_int_equal(event, SR_EV_UPDATE);
+        break;
+    case 1:
+        /* the first commit failed before "change" reached this priority so there must be no "abort" */
+        assert_int_equal(event, SR_EV_UPDATE);
+        break;
+    case 2:
+        assert_int_equal(event, SR_EV_CHANGE);
+        break;
+    case 3:
+        assert_int_equal(event, SR_EV_DONE);
         break;
     default:
         fail();
     }
+    ++st->cb_called3;
 
-    ++st->cb_called;
     return SR_ERR_OK;
 }
 
 static void *
-apply_change_userord_thread(void *arg)
+apply_change_concurrent_update_thread(void *arg)
 {
     struct state *st = (struct state *)arg;
+    sr_conn_ctx_t *conn;
     sr_session_ctx_t *sess;
     int ret;
 
-    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    /* separate connection with concurrent change events */
+    ret = sr_connect(SR_CONN_CONCURRENT_CHANGE_EVENTS, &conn);
     assert_int_equal(ret, SR_ERR_OK);
 
-    ret = sr_set_item_str(sess, "/test:l1[k='k1']/v", "25", NULL, 0);
-    assert_int_equal(ret, SR_ERR_OK);
-    ret = sr_set_item_str(sess, "/test:l1[k='k1']/ll12", "ahoy", NULL, 0);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
     assert_int_equal(ret, SR_ERR_OK);
-    ret = sr_set_item_str(sess, "/test:l1[k='k2']/v", "52", NULL, 0);
-    assert_int_equal(ret, SR_ERR_OK);
-    ret = sr_set_item_str(sess, "/test:l1[k='k2']/ll12", "mate", NULL, 0);
+
+    ret = sr_set_item_str(sess, "/test:test-leaf", "5", NULL, 0);
     assert_int_equal(ret, SR_ERR_OK);
-    ret = sr_set_item_str(sess, "/test:l1[k='k3']/v", "52", NULL, 0);
+    ret = sr_set_item_str(sess, "/defaults:cont/interval", "40", NULL, 0);
     assert_int_equal(ret, SR_ERR_OK);
 
     /* wait for subscription before applying changes */
     pthread_barrier_wait(&st->barrier);
 
-    /* perform 1st change */
-    ret = sr_apply_changes(sess, 0, 0);
+    /* "update" is delivered, then "change" fails in the other module */
+    ret = sr_apply_changes(sess, 0, 1);
+    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
+    assert_int_equal(st->cb_called, 1);
+    assert_int_equal(st->cb_called2, 2);
+    assert_int_equal(st->cb_called3, 1);
+
+    /* now it succeeds */
+    ret = sr_apply_changes(sess, 0, 1);
     assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(st->cb_called, 3);
+    assert_int_equal(st->cb_called2, 4);
+    assert_int_equal(st->cb_called3, 4);
 
-    /* signal that we have finished applying changes */
+    /* signal that we have finished applying the changes */
     pthread_barrier_wait(&st->barrier);
 
     sr_session_stop(sess);
+    sr_disconnect(conn);
     return NULL;
 }
 
 static void *
-subscribe_change_userord_thread(void *arg)
+subscribe_change_concurrent_update_thread(void *arg)
 {
     struct state *st = (struct state *)arg;
     sr_session_ctx_t *sess;
     sr_subscription_ctx_t *subscr;
-    int count, ret;
+    int ret;
 
     ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
     assert_int_equal(ret, SR_ERR_OK);
 
-    ret = sr_module_change_subscribe(sess, "test", NULL, module_change_userord_cb, st, 0, 0, &subscr);
+    ret = sr_module_change_subscribe(sess, "test", NULL, module_change_concurrent_update_cb, st, 0, 0, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_module_change_subscribe(sess, "defaults", NULL, module_change_concurrent_update_cb, st, 10,
+            SR_SUBSCR_CTX_REUSE, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* lower priority, it would get "change" only after the other subscriber */
+    ret = sr_module_change_subscribe(sess, "defaults", NULL, module_update_concurrent_update_cb, st, 0,
+            SR_SUBSCR_CTX_REUSE | SR_SUBSCR_UPDATE, &subscr);
     assert_int_equal(ret, SR_ERR_OK);
 
     /* signal that subscription was created */
     pthread_barrier_wait(&st->barrier);
 
-    count = 0;
-    while ((st->cb_called < 2) && (count < 1500)) {
-        usleep(10000);
-        ++count;
-    }
-    assert_int_equal(st->cb_called, 2);
-
     /* wait for the other thread to finish */
     pthread_barrier_wait(&st->barrier);
 
     sr_unsubscribe(subscr);
+
+    /* cleanup */
+    ret = sr_delete_item(sess, "/test:test-leaf", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(sess, "/defaults:cont/interval", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
     sr_session_stop(sess);
     return NULL;
 }
 
 static void
-test_change_userord(void **state)
+test_change_concurrent_update(void **state)
 {
     pthread_t tid[2];
 
-    pthread_create(&tid[0], NULL, apply_change_userord_thread, *state);
-    pthread_create(&tid[1], NULL, subscribe_change_userord_thread, *state);
+    pthread_create(&tid[0], NULL, apply_change_concurrent_update_thread, *state);
+    pthread_create(&tid[1], NULL, subscribe_change_concurrent_update_thread, *state);
 
     pthread_join(tid[0], NULL);
     pthread_join(tid[1], NULL);
@@ -4928,10 +5720,17 @@ main(void)
         cmocka_unit_test_setup_teardown(test_change_done_dflt, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_change_done_when, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_change_done_xpath, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_change_filter, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_change_unlocked, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_change_unlocked_subs, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_change_evpipe, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_change_mod_diff, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_change_thread_limit, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_change_timeout, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_change_order, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_change_userord, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_change_concurrent, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_change_concurrent_update, setup_f, teardown_f),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);
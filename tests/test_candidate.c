@@ -348,6 +348,150 @@ test_when(void **state)
     assert_int_equal(ret, SR_ERR_OK);
 }
 
+static void
+test_rebase(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct lyd_node *data;
+    sr_val_t *val;
+    char *str;
+    const char *str2;
+    int ret;
+
+    if (!SR_CANDIDATE_DIFF) {
+        /* candidate is a full copy of the data */
+        skip();
+    }
+
+    /* modify running */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* modify candidate */
+    ret = sr_session_switch_ds(st->sess, SR_DS_CANDIDATE);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth32']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* modify running again, candidate changes are kept on top */
+    ret = sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth128']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_session_switch_ds(st->sess, SR_DS_CANDIDATE);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_data(st->sess, "/ietf-interfaces:*", 0, 0, 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_free_withsiblings(data);
+    str2 =
+    "<interfaces xmlns=\"urn:ietf:params:xml:ns:yang:ietf-interfaces\">"
+        "<interface>"
+            "<name>eth128</name>"
+            "<type xmlns:ianaift=\"urn:ietf:params:xml:ns:yang:iana-if-type\">ianaift:ethernetCsmacd</type>"
+        "</interface>"
+        "<interface>"
+            "<name>eth32</name>"
+            "<type xmlns:ianaift=\"urn:ietf:params:xml:ns:yang:iana-if-type\">ianaift:ethernetCsmacd</type>"
+        "</interface>"
+    "</interfaces>";
+    assert_string_equal(str, str2);
+    free(str);
+
+    /* the same running change is no conflict */
+    ret = sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth32']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* commit, only the remaining candidate changes are applied */
+    ret = sr_copy_config(st->sess, NULL, SR_DS_CANDIDATE, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_data(st->sess, "/ietf-interfaces:*", 0, 0, 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    lyd_print_mem(&str, data, LYD_XML, LYP_WITHSIBLINGS);
+    lyd_free_withsiblings(data);
+    assert_string_equal(str, str2);
+    free(str);
+
+    /* candidate mirrors running again */
+    ret = sr_session_switch_ds(st->sess, SR_DS_CANDIDATE);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_lock(st->sess, NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_unlock(st->sess, NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* modify candidate and then the same node in running differently */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth32']/description",
+            "candidate", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth32']/description",
+            "running", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* the conflicting candidate change is only skipped when reading, the running value is returned */
+    ret = sr_session_switch_ds(st->sess, SR_DS_CANDIDATE);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces/interface[name='eth32']/description", 0, &val);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_string_equal(val->data.string_val, "running");
+    sr_free_val(val);
+
+    /* but it is not lost by storing other changes */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth32']/enabled", "false", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OPERATION_FAILED);
+    ret = sr_discard_changes(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* nor by a commit */
+    ret = sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_copy_config(st->sess, NULL, SR_DS_CANDIDATE, 0, 0);
+    assert_int_equal(ret, SR_ERR_OPERATION_FAILED);
+    ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces/interface[name='eth32']/description", 0, &val);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_string_equal(val->data.string_val, "running");
+    sr_free_val(val);
+
+    /* resolve the conflict by resetting candidate */
+    ret = sr_session_switch_ds(st->sess, SR_DS_CANDIDATE);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_copy_config(st->sess, NULL, SR_DS_RUNNING, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_lock(st->sess, NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_unlock(st->sess, NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
 int
 main(void)
 {
@@ -355,6 +499,7 @@ main(void)
         cmocka_unit_test_teardown(test_basic, clear_interfaces),
         cmocka_unit_test_teardown(test_invalid, clear_interfaces),
         cmocka_unit_test(test_when),
+        cmocka_unit_test_teardown(test_rebase, clear_interfaces),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);
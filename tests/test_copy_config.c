@@ -22,8 +22,10 @@
 #define _GNU_SOURCE
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <setjmp.h>
 #include <string.h>
@@ -2232,6 +2234,110 @@ test_replace_when(void **state)
     pthread_join(tid[1], NULL);
 }
 
+/* TEST */
+static void
+startup_file_path(const char *mod_name, const char *suffix, char *path, size_t size)
+{
+    if (SR_STARTUP_PATH[0]) {
+        snprintf(path, size, "%s/%s.startup%s", SR_STARTUP_PATH, mod_name, suffix);
+    } else {
+        snprintf(path, size, "%s/data/%s.startup%s", sr_get_repo_path(), mod_name, suffix);
+    }
+}
+
+static void
+test_startup_fail(void **state)
+{
+    struct state *st = (struct state *)*state;
+    const char *mod_names[] = {"test", "ietf-interfaces", "when1"};
+    sr_session_ctx_t *sess;
+    struct lyd_node *data;
+    char path[1024];
+    uint32_t i;
+    int ret;
+
+    if (!SR_STARTUP_DURABILITY) {
+        /* startup files are rewritten in place */
+        skip();
+    }
+
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* prepare some startup data */
+    ret = sr_set_item_str(sess, "/test:test-leaf", "1", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/when1:l1", "a", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    sr_session_switch_ds(sess, SR_DS_STARTUP);
+    ret = sr_copy_config(sess, NULL, SR_DS_RUNNING, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* change running data */
+    sr_session_switch_ds(sess, SR_DS_RUNNING);
+    ret = sr_set_item_str(sess, "/test:test-leaf", "2", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/when1:l1", "b", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/ietf-interfaces:interfaces/interface[name='eth1']/type",
+            "iana-if-type:ethernetCsmacd", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* make replacing one of the startup files fail */
+    startup_file_path("ietf-interfaces", ".bak", path, sizeof path);
+    assert_int_equal(mkdir(path, 00700), 0);
+
+    /* the whole copy fails and no startup data are changed */
+    sr_session_switch_ds(sess, SR_DS_STARTUP);
+    ret = sr_copy_config(sess, NULL, SR_DS_RUNNING, 0, 0);
+    assert_int_equal(ret, SR_ERR_SYS);
+    assert_int_equal(rmdir(path), 0);
+
+    ret = sr_get_subtree(sess, "/test:test-leaf", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, "1");
+    lyd_free(data);
+    ret = sr_get_subtree(sess, "/when1:l1", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, "a");
+    lyd_free(data);
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth1']", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_null(data);
+
+    /* no temporary or backup files are left */
+    for (i = 0; i < 3; ++i) {
+        startup_file_path(mod_names[i], ".tmp", path, sizeof path);
+        assert_int_equal(access(path, F_OK), -1);
+        startup_file_path(mod_names[i], ".bak", path, sizeof path);
+        assert_int_equal(access(path, F_OK), -1);
+    }
+
+    /* now it succeeds */
+    ret = sr_copy_config(sess, NULL, SR_DS_RUNNING, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_subtree(sess, "/when1:l1", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, "b");
+    lyd_free(data);
+
+    /* cleanup */
+    sr_delete_item(sess, "/when1:l1", 0);
+    sr_apply_changes(sess, 0, 0);
+    sr_session_switch_ds(sess, SR_DS_RUNNING);
+    sr_delete_item(sess, "/when1:l1", 0);
+    sr_apply_changes(sess, 0, 0);
+
+    sr_session_stop(sess);
+}
+
 /* MAIN */
 int
 main(void)
@@ -2245,6 +2351,7 @@ main(void)
         cmocka_unit_test_setup_teardown(test_replace_dflt, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_replace_case, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_replace_when, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_startup_fail, setup_f, teardown_f),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);
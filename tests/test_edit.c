@@ -21,7 +21,9 @@
  */
 #define _GNU_SOURCE
 
+#include <sys/stat.h>
 #include <string.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <setjmp.h>
 #include <stdarg.h>
@@ -33,6 +35,8 @@
 #include "tests/config.h"
 #include "sysrepo.h"
 
+#define IF_JOURNAL_FILE "/dev/shm/sr_ietf-interfaces.running.journal"
+
 struct state {
     sr_conn_ctx_t *conn;
     sr_session_ctx_t *sess;
@@ -694,6 +698,288 @@ test_union(void **state)
     free(str);
 }
 
+static void
+test_journal(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    struct lyd_node *data;
+    char desc[1025];
+    int ret, i, compacted = 0;
+
+    /* only the changes are appended into the journal */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(access(IF_JOURNAL_FILE, F_OK), 0);
+
+    /* a new connection loads the data file and replays the journal */
+    ret = sr_connect(0, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, "iana-if-type:ethernetCsmacd");
+    lyd_free(data);
+
+    /* keep changing a large value until the journal is compacted into the data file */
+    memset(desc, 'a', 1024);
+    desc[1024] = '\0';
+    for (i = 0; (i < 500) && !compacted; ++i) {
+        desc[0] = 'a' + (i % 26);
+        desc[1] = 'a' + (i / 26);
+        ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", desc, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+        ret = sr_apply_changes(st->sess, 0, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        compacted = (access(IF_JOURNAL_FILE, F_OK) == -1);
+    }
+    assert_true(compacted);
+
+    /* all the changes are in the new data file */
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, desc);
+    lyd_free(data);
+
+    /* a new journal is started for the compacted data */
+    ret = sr_delete_item(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(access(IF_JOURNAL_FILE, F_OK), 0);
+
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_null(data);
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, "iana-if-type:ethernetCsmacd");
+    lyd_free(data);
+
+    sr_disconnect(conn);
+}
+
+static void
+test_journal_cache(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    struct lyd_node *data;
+    char desc[1025];
+    int ret, i, compacted = 0;
+
+    /* cache the data with some journal applied */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_connect(SR_CONN_CACHE_RUNNING, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    lyd_free(data);
+
+    /* compact the journal by another connection */
+    memset(desc, 'a', 1024);
+    desc[1024] = '\0';
+    for (i = 0; (i < 500) && !compacted; ++i) {
+        desc[0] = 'a' + (i % 26);
+        desc[1] = 'a' + (i / 26);
+        ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", desc, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+        ret = sr_apply_changes(st->sess, 0, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        compacted = (access(IF_JOURNAL_FILE, F_OK) == -1);
+    }
+    assert_true(compacted);
+
+    /* start a new journal longer than the part of the previous one in the cache */
+    for (i = 0; i < 4; ++i) {
+        desc[0] = 'A' + i;
+        ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", desc, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+        ret = sr_apply_changes(st->sess, 0, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+
+    /* the cache must notice the compaction and not continue from its previous journal offset */
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, desc);
+    lyd_free(data);
+
+    /* and keep applying only the new journal records */
+    desc[0] = 'Z';
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", desc, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, desc);
+    lyd_free(data);
+
+    sr_disconnect(conn);
+}
+
+static void
+test_journal_torn(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    struct lyd_node *data;
+    struct stat stat_buf;
+    int ret;
+
+    /* create some journal records */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", "torn", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* cut the last record as if its writer was terminated */
+    ret = stat(IF_JOURNAL_FILE, &stat_buf);
+    assert_int_equal(ret, 0);
+    ret = truncate(IF_JOURNAL_FILE, stat_buf.st_size - 4);
+    assert_int_equal(ret, 0);
+
+    /* commit again, the incomplete record must be dropped */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces/interface[name='eth64']/enabled", "false", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* a new connection replays all the complete records */
+    ret = sr_connect(0, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/type", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, "iana-if-type:ethernetCsmacd");
+    lyd_free(data);
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/enabled", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_string_equal(((struct lyd_node_leaf_list *)data)->value_str, "false");
+    lyd_free(data);
+
+    /* the torn change was lost */
+    ret = sr_get_subtree(sess, "/ietf-interfaces:interfaces/interface[name='eth64']/description", 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_null(data);
+
+    sr_disconnect(conn);
+}
+
+struct snap_reader {
+    sr_conn_ctx_t *conn;
+    volatile int done;
+};
+
+static void *
+snap_reader_thread(void *arg)
+{
+    struct snap_reader *rd = arg;
+    sr_session_ctx_t *sess;
+    sr_val_t *values;
+    size_t count;
+    int ret;
+
+    ret = sr_session_start(rd->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* keep reading the cached data of one module while the other one is being changed */
+    while (!rd->done) {
+        ret = sr_get_items(sess, "/ietf-interfaces:interfaces/interface/type", 0, 0, &values, &count);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(count, 50);
+        sr_free_values(values, count);
+    }
+
+    sr_session_stop(sess);
+    return NULL;
+}
+
+static void
+test_cache_snapshot(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct snap_reader rd;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    sr_val_t *val;
+    pthread_t tid;
+    char xpath[128], str[8];
+    int ret, i;
+
+    for (i = 0; i < 50; ++i) {
+        sprintf(xpath, "/ietf-interfaces:interfaces/interface[name='eth%d']/type", i);
+        ret = sr_set_item_str(st->sess, xpath, "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_connect(SR_CONN_CACHE_RUNNING, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* readers hold the cache snapshot while the writes bump the version of another module */
+    rd.conn = conn;
+    rd.done = 0;
+    pthread_create(&tid, NULL, snap_reader_thread, &rd);
+    for (i = 0; i < 100; ++i) {
+        sprintf(str, "%d", i);
+        ret = sr_set_item_str(sess, "/test:test-leaf", str, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+        ret = sr_apply_changes(sess, 0, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        /* the new version is visible right away */
+        ret = sr_get_item(sess, "/test:test-leaf", 0, &val);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(val->data.uint8_val, i);
+        sr_free_val(val);
+    }
+    rd.done = 1;
+    pthread_join(tid, NULL);
+
+    ret = sr_delete_item(sess, "/test:test-leaf", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    sr_disconnect(conn);
+}
+
 static void
 test_decimal64(void **state)
 {
@@ -794,6 +1080,248 @@ test_decimal64(void **state)
     assert_int_equal(ret, SR_ERR_OK);
 }
 
+static int
+dummy_change_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    (void)session;
+    (void)module_name;
+    (void)xpath;
+    (void)event;
+    (void)request_id;
+    (void)private_data;
+
+    return SR_ERR_OK;
+}
+
+static void
+test_many_list(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr;
+    sr_val_t *values, *val;
+    size_t count;
+    char xpath[128], str[16];
+    int ret, i;
+
+    /* enough instances for the siblings to be indexed */
+    for (i = 0; i < 20; ++i) {
+        sprintf(xpath, "/ietf-interfaces:interfaces/interface[name='eth%d']/type", i);
+        ret = sr_set_item_str(st->sess, xpath, "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* delete odd, replace even, and create new instances in one edit */
+    for (i = 0; i < 30; ++i) {
+        sprintf(xpath, "/ietf-interfaces:interfaces/interface[name='eth%d']", i);
+        if ((i < 20) && (i % 2)) {
+            ret = sr_delete_item(st->sess, xpath, SR_EDIT_STRICT);
+        } else {
+            strcat(xpath, "/type");
+            ret = sr_set_item_str(st->sess, xpath, "iana-if-type:softwareLoopback", NULL, 0);
+        }
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items(st->sess, "/ietf-interfaces:interfaces/interface/name", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 20);
+    sr_free_values(values, count);
+    for (i = 0; i < 30; i += 2) {
+        sprintf(xpath, "/ietf-interfaces:interfaces/interface[name='eth%d']/type", i);
+        ret = sr_get_item(st->sess, xpath, 0, &val);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_string_equal(val->data.identityref_val, "iana-if-type:softwareLoopback");
+        sr_free_val(val);
+    }
+
+    /* store operational descriptions of all the instances, the config is enabled by a subscription */
+    ret = sr_module_change_subscribe(st->sess, "ietf-interfaces", NULL, dummy_change_cb, NULL, 0, 0, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_connect(0, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_OPERATIONAL, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    for (i = 0; i < 30; ++i) {
+        if ((i < 20) && (i % 2)) {
+            continue;
+        }
+        sprintf(xpath, "/ietf-interfaces:interfaces/interface[name='eth%d']/description", i);
+        sprintf(str, "oper%d", i);
+        ret = sr_set_item_str(sess, xpath, str, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* merged into the stored diff, deleted created nodes are redundant and replaced ones stay created */
+    for (i = 0; i < 30; ++i) {
+        if ((i < 20) && (i % 2)) {
+            continue;
+        }
+        sprintf(xpath, "/ietf-interfaces:interfaces/interface[name='eth%d']/description", i);
+        if (i < 20) {
+            ret = sr_delete_item(sess, xpath, 0);
+        } else {
+            sprintf(str, "new%d", i);
+            ret = sr_set_item_str(sess, xpath, str, NULL, 0);
+        }
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items(sess, "/ietf-interfaces:interfaces/interface/description", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 10);
+    for (i = 0; i < 10; ++i) {
+        sprintf(str, "new%d", 20 + i);
+        assert_string_equal(values[i].data.string_val, str);
+    }
+    sr_free_values(values, count);
+
+    sr_disconnect(conn);
+    sr_unsubscribe(subscr);
+}
+
+static void
+test_many_userord(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_val_t *values, *val;
+    size_t count;
+    char xpath[64];
+    const char *keys[] = {"key11", "key12", "key1", "key2", "key4", "key6", "key7", "key5", "key8", "key9", "key10", "key0"};
+    int ret, i;
+
+    /* enough instances for the siblings to be indexed */
+    for (i = 0; i < 12; ++i) {
+        sprintf(xpath, "/test:cont/l2[k='key%d']/v", i);
+        ret = sr_set_item_str(st->sess, xpath, "1", NULL, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* move, delete, create, and replace instances in one edit */
+    ret = sr_move_item(st->sess, "/test:cont/l2[k='key11']", SR_MOVE_FIRST, NULL, NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_move_item(st->sess, "/test:cont/l2[k='key0']", SR_MOVE_LAST, NULL, NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_move_item(st->sess, "/test:cont/l2[k='key5']", SR_MOVE_AFTER, "[k='key7']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(st->sess, "/test:cont/l2[k='key3']", SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_move_item(st->sess, "/test:cont/l2[k='key12']", SR_MOVE_BEFORE, "[k='key1']", NULL, NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/test:cont/l2[k='key12']/v", "12", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/test:cont/l2[k='key8']/v", "8", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items(st->sess, "/test:cont/l2/k", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 12);
+    for (i = 0; i < 12; ++i) {
+        assert_string_equal(values[i].data.string_val, keys[i]);
+    }
+    sr_free_values(values, count);
+
+    ret = sr_get_item(st->sess, "/test:cont/l2[k='key8']/v", 0, &val);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(val->data.uint8_val, 8);
+    sr_free_val(val);
+    ret = sr_get_item(st->sess, "/test:cont/l2[k='key12']/v", 0, &val);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(val->data.uint8_val, 12);
+    sr_free_val(val);
+}
+
+static void
+test_many_leaflist(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_val_t *values;
+    size_t count;
+    char xpath[64], str[16];
+    int ret, i;
+
+    /* enough instances for the siblings to be indexed */
+    for (i = 0; i < 30; ++i) {
+        sprintf(str, "%d", i);
+        ret = sr_set_item_str(st->sess, "/test:ll1", str, NULL, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* delete instances from the index and create new ones in one edit */
+    for (i = 0; i < 30; i += 2) {
+        sprintf(xpath, "/test:ll1[.='%d']", i);
+        ret = sr_delete_item(st->sess, xpath, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    for (i = 30; i < 40; ++i) {
+        sprintf(str, "%d", i);
+        ret = sr_set_item_str(st->sess, "/test:ll1", str, NULL, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items(st->sess, "/test:ll1", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 25);
+    for (i = 0; i < 15; ++i) {
+        assert_int_equal(values[i].data.int16_val, i * 2 + 1);
+    }
+    for (i = 15; i < 25; ++i) {
+        assert_int_equal(values[i].data.int16_val, i + 15);
+    }
+    sr_free_values(values, count);
+
+    /* an existing instance is found after the index is built */
+    for (i = 1; i < 20; i += 2) {
+        sprintf(xpath, "/test:ll1[.='%d']", i);
+        ret = sr_delete_item(st->sess, xpath, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_set_item_str(st->sess, "/test:ll1", "21", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_EXISTS);
+    ret = sr_discard_changes(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* and a deleted one is not */
+    for (i = 1; i < 20; i += 2) {
+        sprintf(xpath, "/test:ll1[.='%d']", i);
+        ret = sr_delete_item(st->sess, xpath, SR_EDIT_STRICT);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_delete_item(st->sess, "/test:ll1[.='0']", SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_NOT_FOUND);
+    ret = sr_discard_changes(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* nothing was changed by the failed edits */
+    ret = sr_get_items(st->sess, "/test:ll1", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 25);
+    sr_free_values(values, count);
+}
+
 int
 main(void)
 {
@@ -809,6 +1337,13 @@ main(void)
         cmocka_unit_test(test_top_op),
         cmocka_unit_test_teardown(test_union, clear_test),
         cmocka_unit_test(test_decimal64),
+        cmocka_unit_test_teardown(test_journal, clear_interfaces),
+        cmocka_unit_test_teardown(test_journal_cache, clear_interfaces),
+        cmocka_unit_test_teardown(test_journal_torn, clear_interfaces),
+        cmocka_unit_test_teardown(test_cache_snapshot, clear_interfaces),
+        cmocka_unit_test_teardown(test_many_list, clear_interfaces),
+        cmocka_unit_test_teardown(test_many_userord, clear_test),
+        cmocka_unit_test_teardown(test_many_leaflist, clear_test),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);
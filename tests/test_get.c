@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <sys/types.h>
 
 #include <cmocka.h>
@@ -35,6 +36,8 @@
 #include "tests/config.h"
 #include "sysrepo.h"
 
+#define SIMPLE_INDEX_FILE "/dev/shm/sr_simple.running.index"
+
 struct state {
     sr_conn_ctx_t *conn;
     sr_session_ctx_t *sess;
@@ -232,6 +235,382 @@ test_explicit_default(void **state)
     sr_apply_changes(st->sess, 0, 0);
 }
 
+static void
+test_cached_changes(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    sr_val_t *values;
+    size_t count;
+    char xpath[64];
+    int ret, i;
+
+    /* changes are made by another connection */
+    ret = sr_connect(0, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* load the module into the cache */
+    ret = sr_get_items(st->sess, "/simple:ac1/acl1", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 0);
+
+    for (i = 0; i < 10; ++i) {
+        /* create a list instance, remove every third one */
+        sprintf(xpath, "/simple:ac1/acl1[acs1='k%d']", i);
+        ret = sr_set_item_str(sess, xpath, NULL, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+        if (i && !(i % 3)) {
+            sprintf(xpath, "/simple:ac1/acl1[acs1='k%d']", i - 1);
+            ret = sr_delete_item(sess, xpath, 0);
+            assert_int_equal(ret, SR_ERR_OK);
+        }
+        ret = sr_apply_changes(sess, 0, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        if (i % 2) {
+            /* let the cache lag behind by several changes */
+            continue;
+        }
+
+        /* cached data must be up-to-date */
+        ret = sr_get_items(st->sess, "/simple:ac1/acl1", 0, 0, &values, &count);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(count, i + 1 - i / 3);
+        sr_free_values(values, count);
+    }
+
+    /* final state */
+    ret = sr_get_items(st->sess, "/simple:ac1/acl1", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 7);
+    sr_free_values(values, count);
+
+    /* cleanup */
+    ret = sr_delete_item(sess, "/simple:ac1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    sr_disconnect(conn);
+}
+
+static int index_loads;
+
+static void
+test_list_instance_log_cb(sr_log_level_t level, const char *message)
+{
+    (void)level;
+
+    if (strstr(message, "loaded from the running data index")) {
+        ++index_loads;
+    }
+}
+
+static void
+test_list_instance(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_val_t *values;
+    size_t count;
+    char xpath[160];
+    int ret, i, j;
+
+    /* create enough instances for the data file to be indexed */
+    for (i = 0; i < 2000; ++i) {
+        sprintf(xpath, "/simple:ac1/acl1[acs1='%0100d']", i);
+        ret = sr_set_item_str(st->sess, xpath, NULL, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* the changes were too large to be journaled, the index is created with the data file */
+    assert_int_equal(access(SIMPLE_INDEX_FILE, F_OK), 0);
+
+    /* the instances stored separately are all loaded with the rest of the data */
+    ret = sr_get_items(st->sess, "/simple:ac1/acl1", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 2000);
+    sr_free_values(values, count);
+
+    index_loads = 0;
+    for (i = 0; i < 3; ++i) {
+        /* read single instances */
+        sr_log_set_cb(test_list_instance_log_cb);
+        for (j = 0; j < 2; ++j) {
+            sprintf(xpath, "/simple:ac1/acl1[acs1='%0100d']/acs1", 5);
+            ret = sr_get_items(st->sess, xpath, 0, 0, &values, &count);
+            assert_int_equal(ret, SR_ERR_OK);
+            assert_int_equal(count, i ? 0 : 1);
+            sr_free_values(values, count);
+
+            sprintf(xpath, "/simple:ac1/acl1[acs1='%0100d']", 6);
+            ret = sr_get_items(st->sess, xpath, 0, 0, &values, &count);
+            assert_int_equal(ret, SR_ERR_OK);
+            assert_int_equal(count, 1);
+            sr_free_values(values, count);
+
+            sprintf(xpath, "/simple:ac1/acl1[acs1='%0100d']", 2000);
+            ret = sr_get_items(st->sess, xpath, 0, 0, &values, &count);
+            assert_int_equal(ret, SR_ERR_OK);
+            assert_int_equal(count, (i == 2) ? 1 : 0);
+            sr_free_values(values, count);
+        }
+        sr_log_set_cb(NULL);
+
+        if (!i) {
+            /* journaled changes must be applied on the indexed instances */
+            sprintf(xpath, "/simple:ac1/acl1[acs1='%0100d']", 5);
+            ret = sr_delete_item(st->sess, xpath, 0);
+            assert_int_equal(ret, SR_ERR_OK);
+        } else if (i == 1) {
+            sprintf(xpath, "/simple:ac1/acl1[acs1='%0100d']", 2000);
+            ret = sr_set_item_str(st->sess, xpath, NULL, NULL, 0);
+            assert_int_equal(ret, SR_ERR_OK);
+        } else {
+            break;
+        }
+        ret = sr_apply_changes(st->sess, 0, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+
+    /* all the indexed instances were loaded from the index, the new one is only journaled */
+    assert_int_equal(index_loads, 12);
+
+    /* cleanup */
+    ret = sr_delete_item(st->sess, "/simple:ac1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
+static void
+test_arena(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_val_t *values, *arena_values;
+    size_t count, arena_count, i;
+    char xpath[64];
+    int ret;
+
+    /* create some list instances, also with a quote in the key */
+    for (i = 0; i < 50; ++i) {
+        sprintf(xpath, "/simple:ac1/acl1[acs1='key%d']", (int)i);
+        ret = sr_set_item_str(st->sess, xpath, NULL, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_set_item_str(st->sess, "/simple:ac1/acl1[acs1=\"it's\"]", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/simple-aug:bc1/bcl1[bcs1='b']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* the arena values must be the same as the standard ones */
+    ret = sr_get_items(st->sess, "/simple:*//. | /simple-aug:*//.", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_items_arena(st->sess, "/simple:*//. | /simple-aug:*//.", 0, 0, &arena_values, &arena_count);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    assert_int_equal(count, arena_count);
+    for (i = 0; i < count; ++i) {
+        assert_string_equal(values[i].xpath, arena_values[i].xpath);
+        assert_int_equal(values[i].type, arena_values[i].type);
+        assert_int_equal(values[i].dflt, arena_values[i].dflt);
+        switch (values[i].type) {
+        case SR_STRING_T:
+            assert_string_equal(values[i].data.string_val, arena_values[i].data.string_val);
+            break;
+        case SR_BOOL_T:
+            assert_int_equal(values[i].data.bool_val, arena_values[i].data.bool_val);
+            break;
+        default:
+            break;
+        }
+    }
+
+    sr_free_values(values, count);
+    sr_free_values_arena(arena_values);
+
+    /* no values */
+    ret = sr_get_items_arena(st->sess, "/simple:ac1/acl1[acs1='none']", 0, 0, &arena_values, &arena_count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(arena_count, 0);
+    assert_null(arena_values);
+
+    /* cleanup */
+    ret = sr_delete_item(st->sess, "/simple:ac1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(st->sess, "/simple-aug:bc1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
+static void
+test_items_iter(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_get_items_iter_t *iter;
+    sr_val_t *values;
+    size_t count;
+    char xpath[64];
+    int ret, i;
+
+    for (i = 0; i < 25; ++i) {
+        sprintf(xpath, "/simple:ac1/acl1[acs1='key%02d']", i);
+        ret = sr_set_item_str(st->sess, xpath, NULL, NULL, 0);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* iterate over all the instances */
+    ret = sr_get_items_iter_start(st->sess, "/simple:ac1/acl1", 10, 0, 0, &iter);
+    assert_int_equal(ret, SR_ERR_OK);
+    for (i = 0; i < 3; ++i) {
+        ret = sr_get_items_iter_next(st->sess, iter, &values, &count);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(count, (i == 2) ? 5 : 10);
+        assert_string_equal(values[0].xpath, (i == 0) ? "/simple:ac1/acl1[acs1='key00']" :
+                (i == 1) ? "/simple:ac1/acl1[acs1='key10']" : "/simple:ac1/acl1[acs1='key20']");
+        sr_free_values_arena(values);
+    }
+    ret = sr_get_items_iter_next(st->sess, iter, &values, &count);
+    assert_int_equal(ret, SR_ERR_NOT_FOUND);
+    assert_int_equal(count, 0);
+    sr_free_get_items_iter(iter);
+
+    /* data changes between pages are not reflected */
+    ret = sr_get_items_iter_start(st->sess, "/simple:ac1/acl1", 10, 0, 0, &iter);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_items_iter_next(st->sess, iter, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 10);
+    assert_string_equal(values[2].xpath, "/simple:ac1/acl1[acs1='key02']");
+    sr_free_values_arena(values);
+
+    ret = sr_delete_item(st->sess, "/simple:ac1/acl1[acs1='key02']", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(st->sess, "/simple:ac1/acl1[acs1='key10']", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/simple:ac1/acl1[acs1='key25']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items_iter_next(st->sess, iter, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 10);
+    assert_string_equal(values[0].xpath, "/simple:ac1/acl1[acs1='key10']");
+    sr_free_values_arena(values);
+
+    /* the whole subtree is removed (cleanup) */
+    ret = sr_delete_item(st->sess, "/simple:ac1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items_iter_next(st->sess, iter, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 5);
+    assert_string_equal(values[4].xpath, "/simple:ac1/acl1[acs1='key24']");
+    sr_free_values_arena(values);
+
+    ret = sr_get_items_iter_next(st->sess, iter, &values, &count);
+    assert_int_equal(ret, SR_ERR_NOT_FOUND);
+    sr_free_get_items_iter(iter);
+
+    /* a new iterator sees the current data */
+    ret = sr_get_items_iter_start(st->sess, "/simple:ac1/acl1", 10, 0, 0, &iter);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_items_iter_next(st->sess, iter, &values, &count);
+    assert_int_equal(ret, SR_ERR_NOT_FOUND);
+    sr_free_get_items_iter(iter);
+}
+
+static void *
+xpath_cache_thread(void *arg)
+{
+    sr_session_ctx_t *sess = arg;
+    sr_val_t *values;
+    size_t count;
+    char xpath[64];
+    int ret, i;
+
+    for (i = 0; i < 300; ++i) {
+        /* more distinct XPaths than fit into the cache, with a repeated one */
+        sprintf(xpath, "/simple:ac1/acl1[acs1='x%d']", i);
+        ret = sr_get_items(sess, (i % 3) ? xpath : "/simple:ac1/acl1", 0, 0, &values, &count);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(count, (i % 3) ? 0 : 1);
+        sr_free_values(values, count);
+    }
+
+    return NULL;
+}
+
+static void
+test_xpath_cache(void **state)
+{
+    struct state *st = (struct state *)*state;
+    pthread_t tid;
+    sr_val_t *values;
+    size_t count;
+    int ret, i;
+
+    ret = sr_set_item_str(st->sess, "/simple:ac1/acl1[acs1='a']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* repeated queries use the collected modules */
+    for (i = 0; i < 3; ++i) {
+        ret = sr_get_items(st->sess, "/simple:ac1/acl1 | /simple-aug:bc1", 0, 0, &values, &count);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(count, 1);
+        sr_free_values(values, count);
+    }
+
+    /* different datastores */
+    ret = sr_session_switch_ds(st->sess, SR_DS_STARTUP);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_items(st->sess, "/simple:ac1/acl1 | /simple-aug:bc1", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 0);
+    sr_free_values(values, count);
+
+    ret = sr_session_switch_ds(st->sess, SR_DS_OPERATIONAL);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_items(st->sess, "/simple:ac1/acl1 | /simple-aug:bc1", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 1);
+    sr_free_values(values, count);
+
+    /* an invalid XPath is never cached */
+    for (i = 0; i < 2; ++i) {
+        ret = sr_get_items(st->sess, "/simple:ac1/acl1[", 0, 0, &values, &count);
+        assert_int_not_equal(ret, SR_ERR_OK);
+    }
+
+    /* a session shared by several threads, cache entries are replaced */
+    ret = sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+    assert_int_equal(ret, SR_ERR_OK);
+    pthread_create(&tid, NULL, xpath_cache_thread, st->sess);
+    xpath_cache_thread(st->sess);
+    pthread_join(tid, NULL);
+
+    /* cleanup */
+    ret = sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(st->sess, "/simple:ac1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
 int
 main(void)
 {
@@ -240,6 +619,12 @@ main(void)
         cmocka_unit_test_setup_teardown(test_no_read_access, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_no_read_access, setup_cached_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_explicit_default, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_cached_changes, setup_cached_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_list_instance, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_arena, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_items_iter, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_items_iter, setup_cached_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_xpath_cache, setup_f, teardown_f),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);
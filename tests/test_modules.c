@@ -1458,6 +1458,123 @@ test_get_module_info(void **state)
     assert_int_equal(ret, SR_ERR_OK);
 }
 
+static void
+module_hash_reconnect(struct state *st)
+{
+    uint32_t conn_count;
+    int ret;
+
+    sr_disconnect(st->conn);
+    st->conn = NULL;
+    ret = sr_connection_count(&conn_count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(conn_count, 0);
+    ret = sr_connect(0, &st->conn);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
+static void
+module_hash_check(sr_conn_ctx_t *conn, const char *module_name, int exp_ret)
+{
+    char *owner, *group;
+    mode_t perm;
+    int ret;
+
+    ret = sr_get_module_access(conn, module_name, &owner, &group, &perm);
+    assert_int_equal(ret, exp_ret);
+    if (ret == SR_ERR_OK) {
+        free(owner);
+        free(group);
+    }
+}
+
+static void
+test_module_hash(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_session_ctx_t *sess;
+    sr_val_t *val;
+    int ret;
+
+    /* install several modules */
+    ret = sr_install_module(st->conn, TESTS_DIR "/files/test.yang", TESTS_DIR "/files", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_install_module(st->conn, TESTS_DIR "/files/simple.yang", TESTS_DIR "/files", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_install_module(st->conn, TESTS_DIR "/files/rev.yang", TESTS_DIR "/files", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_install_module(st->conn, TESTS_DIR "/files/decimal.yang", TESTS_DIR "/files", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    module_hash_reconnect(st);
+
+    module_hash_check(st->conn, "test", SR_ERR_OK);
+    module_hash_check(st->conn, "simple", SR_ERR_OK);
+    module_hash_check(st->conn, "rev", SR_ERR_OK);
+    module_hash_check(st->conn, "decimal", SR_ERR_OK);
+    module_hash_check(st->conn, "no-module", SR_ERR_NOT_FOUND);
+
+    /* remove a module, all the following modules are moved in main SHM */
+    ret = sr_remove_module(st->conn, "simple");
+    assert_int_equal(ret, SR_ERR_OK);
+    module_hash_reconnect(st);
+
+    module_hash_check(st->conn, "test", SR_ERR_OK);
+    module_hash_check(st->conn, "simple", SR_ERR_NOT_FOUND);
+    module_hash_check(st->conn, "rev", SR_ERR_OK);
+    module_hash_check(st->conn, "decimal", SR_ERR_OK);
+
+    /* data of a moved module must still be accessible */
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(sess, "/decimal:d1", "1.1", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_item(sess, "/decimal:d1", 0, &val);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(val->type, SR_DECIMAL64_T);
+    sr_free_val(val);
+    sr_session_stop(sess);
+
+    /* update a module */
+    ret = sr_update_module(st->conn, TESTS_DIR "/files/rev@1970-01-01.yang", NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    module_hash_reconnect(st);
+
+    module_hash_check(st->conn, "test", SR_ERR_OK);
+    module_hash_check(st->conn, "simple", SR_ERR_NOT_FOUND);
+    module_hash_check(st->conn, "rev", SR_ERR_OK);
+    module_hash_check(st->conn, "decimal", SR_ERR_OK);
+
+    /* install the removed module again */
+    ret = sr_install_module(st->conn, TESTS_DIR "/files/simple.yang", TESTS_DIR "/files", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    module_hash_reconnect(st);
+
+    module_hash_check(st->conn, "test", SR_ERR_OK);
+    module_hash_check(st->conn, "simple", SR_ERR_OK);
+    module_hash_check(st->conn, "rev", SR_ERR_OK);
+    module_hash_check(st->conn, "decimal", SR_ERR_OK);
+
+    /* the data survived all the changes */
+    ret = sr_session_start(st->conn, SR_DS_RUNNING, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_item(sess, "/decimal:d1", 0, &val);
+    assert_int_equal(ret, SR_ERR_OK);
+    sr_free_val(val);
+    sr_session_stop(sess);
+
+    /* cleanup */
+    ret = sr_remove_module(st->conn, "decimal");
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_remove_module(st->conn, "rev");
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_remove_module(st->conn, "simple");
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_remove_module(st->conn, "test");
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
 int
 main(void)
 {
@@ -1477,6 +1594,7 @@ main(void)
         cmocka_unit_test_setup_teardown(test_set_module_access, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_get_module_access, setup_f, teardown_f),
         cmocka_unit_test_setup_teardown(test_get_module_info, setup_f, teardown_f),
+        cmocka_unit_test_setup_teardown(test_module_hash, setup_f, teardown_f),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);
@@ -312,6 +312,19 @@ dummy_rpc_cb(sr_session_ctx_t *session, const char *op_path, const sr_val_t *inp
     return SR_ERR_OK;
 }
 
+static void
+free_ext_shm_stats(struct lyd_node *data)
+{
+    struct ly_set *set;
+
+    /* ext SHM statistics depend on all the previous SHM allocations, they are tested separately */
+    set = lyd_find_path(data, "/sysrepo-monitoring:sysrepo-state/ext-shm");
+    assert_non_null(set);
+    assert_int_equal(set->number, 1);
+    lyd_free(set->set.d[0]);
+    ly_set_free(set);
+}
+
 static void
 test_sr_mon(void **state)
 {
@@ -326,6 +339,7 @@ test_sr_mon(void **state)
     assert_int_equal(ret, SR_ERR_OK);
     ret = sr_get_data(st->sess, "/sysrepo-monitoring:*", 0, 0, 0, &data);
     assert_int_equal(ret, SR_ERR_OK);
+    free_ext_shm_stats(data);
 
     /* check their content */
     ret = lyd_print_mem(&str1, data, LYD_XML, 0);
@@ -393,7 +407,6 @@ test_sr_mon(void **state)
         "</module>"
         "<connection>"
             "<pid>%ld</pid>"
-            "<main-lock>read</main-lock>"
             "<module-lock>"
                 "<name>sysrepo-monitoring</name>"
                 "<datastore xmlns:ds=\"urn:ietf:params:xml:ns:yang:ietf-datastores\">ds:running</datastore>"
@@ -450,6 +463,7 @@ test_sr_mon(void **state)
     assert_int_equal(ret, SR_ERR_OK);
     ret = sr_get_data(st->sess, "/sysrepo-monitoring:*", 0, 0, 0, &data);
     assert_int_equal(ret, SR_ERR_OK);
+    free_ext_shm_stats(data);
 
     /* check their content */
     ret = lyd_print_mem(&str1, data, LYD_XML, 0);
@@ -567,7 +581,6 @@ test_sr_mon(void **state)
         "</rpc>"
         "<connection>"
             "<pid>%ld</pid>"
-            "<main-lock>read</main-lock>"
             "<module-lock>"
                 "<name>sysrepo-monitoring</name>"
                 "<datastore xmlns:ds=\"urn:ietf:params:xml:ns:yang:ietf-datastores\">ds:running</datastore>"
@@ -591,6 +604,126 @@ test_sr_mon(void **state)
     sr_session_switch_ds(st->sess, SR_DS_RUNNING);
 }
 
+/* TEST */
+static uint64_t
+get_ext_shm_stat(sr_session_ctx_t *sess, const char *name)
+{
+    sr_val_t *val;
+    char xpath[128];
+    uint64_t stat;
+    int ret;
+
+    sprintf(xpath, "/sysrepo-monitoring:sysrepo-state/ext-shm/%s", name);
+    ret = sr_get_item(sess, xpath, 0, &val);
+    assert_int_equal(ret, SR_ERR_OK);
+    stat = (val->type == SR_UINT64_T) ? val->data.uint64_val : val->data.uint32_val;
+    sr_free_val(val);
+
+    return stat;
+}
+
+static void
+test_ext_shm_remap(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    sr_subscription_ctx_t *subscr = NULL;
+    sr_val_t *values;
+    size_t count;
+    char xpath[128];
+    uint64_t size;
+    int ret, i;
+
+    ret = sr_session_switch_ds(st->sess, SR_DS_OPERATIONAL);
+    assert_int_equal(ret, SR_ERR_OK);
+    size = get_ext_shm_stat(st->sess, "size");
+
+    /* enlarge ext SHM from another connection */
+    ret = sr_connect(0, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_OPERATIONAL, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    for (i = 0; i < 50; ++i) {
+        sprintf(xpath, "/test:cont/l2[k='subscription-with-a-long-enough-key-%d']", i);
+        ret = sr_module_change_subscribe(sess, "test", xpath, dummy_change_cb, NULL, 0, i ? SR_SUBSCR_CTX_REUSE : 0,
+                &subscr);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+
+    /* the first connection must remap ext SHM to see all the subscriptions */
+    assert_true(get_ext_shm_stat(st->sess, "size") > size);
+    assert_int_equal(get_ext_shm_stat(st->sess, "size"), get_ext_shm_stat(sess, "size"));
+    ret = sr_get_items(st->sess, "/sysrepo-monitoring:sysrepo-state/module[name='test']/subscriptions/change-sub/xpath",
+            0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 50);
+    for (i = 0; i < 50; ++i) {
+        sprintf(xpath, "/test:cont/l2[k='subscription-with-a-long-enough-key-%d']", i);
+        assert_string_equal(values[i].data.string_val, xpath);
+    }
+    sr_free_values(values, count);
+
+    /* and it must see them removed */
+    sr_unsubscribe(subscr);
+    ret = sr_get_items(st->sess, "/sysrepo-monitoring:sysrepo-state/module[name='test']/subscriptions/change-sub",
+            0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 0);
+    sr_free_values(values, count);
+
+    sr_disconnect(conn);
+    sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+}
+
+static void
+test_ext_shm_alloc(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_subscription_ctx_t *subscr;
+    char xpath[128];
+    uint64_t size, wasted, allocs, reused;
+    int ret, i, j;
+
+    ret = sr_session_switch_ds(st->sess, SR_DS_OPERATIONAL);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    for (j = 0; j < 5; ++j) {
+        /* allocate some ext SHM memory */
+        subscr = NULL;
+        for (i = 0; i < 10; ++i) {
+            sprintf(xpath, "/test:cont/l2[k='allocation-%d']", i);
+            ret = sr_module_change_subscribe(st->sess, "test", xpath, dummy_change_cb, NULL, 0,
+                    i ? SR_SUBSCR_CTX_REUSE : 0, &subscr);
+            assert_int_equal(ret, SR_ERR_OK);
+        }
+
+        /* free it */
+        sr_unsubscribe(subscr);
+
+        if (!j) {
+            /* first cycle, remember the stats */
+            size = get_ext_shm_stat(st->sess, "size");
+            wasted = get_ext_shm_stat(st->sess, "wasted");
+            allocs = get_ext_shm_stat(st->sess, "allocations");
+            reused = get_ext_shm_stat(st->sess, "reused");
+            continue;
+        }
+
+        /* the freed memory is being reused so ext SHM does not grow */
+        assert_true(get_ext_shm_stat(st->sess, "size") <= size);
+        assert_true(get_ext_shm_stat(st->sess, "allocations") > allocs);
+        assert_true(get_ext_shm_stat(st->sess, "reused") > reused);
+        allocs = get_ext_shm_stat(st->sess, "allocations");
+        reused = get_ext_shm_stat(st->sess, "reused");
+
+        /* and is not getting fragmented, the same chunks are free after every cycle */
+        assert_true(get_ext_shm_stat(st->sess, "wasted") <= wasted);
+    }
+
+    sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+}
+
 /* TEST */
 static int
 enabled_change_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
@@ -2137,6 +2270,279 @@ test_stored_state_list(void **state)
     free(str1);
 }
 
+/* TEST */
+static void
+test_stored_cached(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *conn;
+    sr_session_ctx_t *sess;
+    struct lyd_node *data;
+    sr_val_t *values;
+    size_t count;
+    int ret, i;
+
+    /* the data are read using a caching connection */
+    ret = sr_connect(SR_CONN_CACHE_RUNNING, &conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(conn, SR_DS_OPERATIONAL, &sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* switch to operational DS */
+    ret = sr_session_switch_ds(st->sess, SR_DS_OPERATIONAL);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* set some operational data */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* read the data repeatedly */
+    for (i = 0; i < 2; ++i) {
+        ret = sr_get_items(sess, "/ietf-interfaces:interfaces-state/interface", 0, 0, &values, &count);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(count, 1);
+        sr_free_values(values, count);
+    }
+
+    /* the data with origin are merged separately */
+    ret = sr_get_data(sess, "/ietf-interfaces:interfaces-state", 0, 0, SR_OPER_WITH_ORIGIN, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_non_null(data->attr);
+    lyd_free_withsiblings(data);
+    ret = sr_get_data(sess, "/ietf-interfaces:interfaces-state", 0, 0, 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_non_null(data);
+    assert_null(data->attr);
+    lyd_free_withsiblings(data);
+
+    /* change the data, the cached data must not be used */
+    ret = sr_set_item_str(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth2']/type",
+            "iana-if-type:ethernetCsmacd", NULL, SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items(sess, "/ietf-interfaces:interfaces-state/interface", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 2);
+    sr_free_values(values, count);
+
+    ret = sr_delete_item(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']", SR_EDIT_STRICT);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_get_items(sess, "/ietf-interfaces:interfaces-state/interface/name", 0, 0, &values, &count);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(count, 1);
+    assert_string_equal(values[0].data.string_val, "eth2");
+    sr_free_values(values, count);
+
+    sr_disconnect(conn);
+}
+
+/* TEST */
+static int
+push_batch_change_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    int *change_count = (int *)private_data;
+
+    (void)session;
+    (void)module_name;
+    (void)xpath;
+    (void)request_id;
+
+    /* every stored batch is a single change */
+    if (event == SR_EV_CHANGE) {
+        ++(*change_count);
+    }
+    return SR_ERR_OK;
+}
+
+static void
+test_push_batch(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_subscription_ctx_t *subscr;
+    sr_val_t *value;
+    char str[16];
+    int ret, i, change_count = 0;
+
+    /* switch to operational DS */
+    ret = sr_session_switch_ds(st->sess, SR_DS_OPERATIONAL);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* the subscribers must learn about the batched changes */
+    ret = sr_module_change_subscribe(st->sess, "ietf-interfaces", NULL, push_batch_change_cb, &change_count, 0, 0,
+            &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* push repeated updates of the same node without any limits */
+    ret = sr_oper_push_limits(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/type",
+            "iana-if-type:ethernetCsmacd", NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    for (i = 0; i < 10; ++i) {
+        sprintf(str, "%d", i);
+        ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets",
+                str, NULL);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+
+    /* nothing stored yet */
+    ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets", 0, &value);
+    assert_int_equal(ret, SR_ERR_NOT_FOUND);
+    assert_int_equal(change_count, 0);
+
+    /* only the last value is stored */
+    ret = sr_oper_push_flush(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(change_count, 1);
+    ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets", 0, &value);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(value->data.uint64_val, 9);
+    sr_free_val(value);
+
+    /* the batch is stored once it is large enough */
+    ret = sr_oper_push_limits(st->sess, 3, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    for (i = 10; i < 13; ++i) {
+        sprintf(str, "%d", i);
+        ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets",
+                str, NULL);
+        assert_int_equal(ret, SR_ERR_OK);
+
+        ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets", 0,
+                &value);
+        assert_int_equal(ret, SR_ERR_OK);
+        assert_int_equal(value->data.uint64_val, (i == 12) ? 12 : 9);
+        sr_free_val(value);
+    }
+    assert_int_equal(change_count, 2);
+
+    /* the batch is flushed even after switching the session to another DS */
+    ret = sr_oper_push_limits(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets",
+            "13", NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_switch_ds(st->sess, SR_DS_RUNNING);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_oper_push_flush(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(change_count, 3);
+    ret = sr_session_switch_ds(st->sess, SR_DS_OPERATIONAL);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets", 0, &value);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(value->data.uint64_val, 13);
+    sr_free_val(value);
+
+    sr_unsubscribe(subscr);
+
+    /* restore the defaults */
+    ret = sr_oper_push_limits(st->sess, 1000, 100);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
+/* TEST */
+static int
+push_batch_fail_change_cb(sr_session_ctx_t *session, const char *module_name, const char *xpath, sr_event_t event,
+        uint32_t request_id, void *private_data)
+{
+    int *fail = (int *)private_data;
+
+    (void)session;
+    (void)module_name;
+    (void)xpath;
+    (void)request_id;
+
+    if ((event == SR_EV_CHANGE) && *fail) {
+        ++(*fail);
+        return SR_ERR_OPERATION_FAILED;
+    }
+    return SR_ERR_OK;
+}
+
+static void
+test_push_batch_fail(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_subscription_ctx_t *subscr;
+    sr_val_t *value;
+    char str[16];
+    int ret, i, fail = 1;
+
+    ret = sr_session_switch_ds(st->sess, SR_DS_OPERATIONAL);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    ret = sr_module_change_subscribe(st->sess, "ietf-interfaces", NULL, push_batch_fail_change_cb, &fail, 0, 0, &subscr);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* storing the batch fails once it is large enough */
+    ret = sr_oper_push_limits(st->sess, 2, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/type",
+            "iana-if-type:ethernetCsmacd", NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets",
+            "0", NULL);
+    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
+    assert_int_equal(fail, 2);
+
+    /* further updates are batched without trying to store them again */
+    for (i = 1; i < 5; ++i) {
+        sprintf(str, "%d", i);
+        ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets",
+                str, NULL);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+    assert_int_equal(fail, 2);
+    ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets", 0, &value);
+    assert_int_equal(ret, SR_ERR_NOT_FOUND);
+
+    /* failing flush keeps the batch */
+    ret = sr_oper_push_flush(st->sess);
+    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
+    assert_int_equal(fail, 3);
+
+    /* the whole batch is stored by a successful flush */
+    fail = 0;
+    ret = sr_oper_push_flush(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_get_item(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets", 0, &value);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(value->data.uint64_val, 4);
+    sr_free_val(value);
+
+    /* and the limits apply again */
+    fail = 1;
+    ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets",
+            "5", NULL);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_oper_push_batch(st->sess, "/ietf-interfaces:interfaces-state/interface[name='eth1']/statistics/in-octets",
+            "6", NULL);
+    assert_int_equal(ret, SR_ERR_CALLBACK_FAILED);
+    assert_int_equal(fail, 2);
+
+    /* store the batch */
+    fail = 0;
+    ret = sr_oper_push_flush(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    sr_unsubscribe(subscr);
+
+    /* restore the defaults */
+    ret = sr_oper_push_limits(st->sess, 1000, 100);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
 /* TEST */
 static void
 test_stored_config(void **state)
@@ -2987,6 +3393,8 @@ main(void)
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_yang_lib),
         cmocka_unit_test(test_sr_mon),
+        cmocka_unit_test(test_ext_shm_remap),
+        cmocka_unit_test(test_ext_shm_alloc),
         cmocka_unit_test_teardown(test_enabled_partial, clear_up),
         cmocka_unit_test_teardown(test_simple, clear_up),
         cmocka_unit_test_teardown(test_fail, clear_up),
@@ -3002,6 +3410,9 @@ main(void)
         cmocka_unit_test_teardown(test_conn_owner2, clear_up),
         cmocka_unit_test_teardown(test_stored_state, clear_up),
         cmocka_unit_test_teardown(test_stored_state_list, clear_up),
+        cmocka_unit_test_teardown(test_stored_cached, clear_up),
+        cmocka_unit_test_teardown(test_push_batch, clear_up),
+        cmocka_unit_test_teardown(test_push_batch_fail, clear_up),
         cmocka_unit_test_teardown(test_stored_config, clear_up),
         cmocka_unit_test_teardown(test_stored_np_cont1, clear_up),
         cmocka_unit_test_teardown(test_stored_np_cont2, clear_up),
@@ -1394,6 +1394,101 @@ test_rpc_shelve(void **state)
     pthread_join(tid[1], NULL);
 }
 
+/* TEST */
+static int
+rpc_count_cb(sr_session_ctx_t *session, const char *xpath, const struct lyd_node *input, sr_event_t event,
+        uint32_t request_id, struct lyd_node *output, void *private_data)
+{
+    int *called = (int *)private_data;
+
+    (void)session;
+    (void)event;
+    (void)request_id;
+    (void)output;
+
+    /* the callback must be called only for its own RPC */
+    assert_string_equal(xpath + strlen("/ops:"), input->schema->name);
+    ++(*called);
+    return SR_ERR_OK;
+}
+
+static void
+rpc_hash_send(sr_session_ctx_t *sess, const char *op_path, int exp_ret)
+{
+    struct lyd_node *input, *output;
+    int ret;
+
+    input = lyd_new_path(NULL, sr_get_context(sr_session_get_connection(sess)), op_path, NULL, 0, 0);
+    assert_non_null(input);
+
+    ret = sr_rpc_send_tree(sess, input, 0, &output);
+    lyd_free_withsiblings(input);
+    assert_int_equal(ret, exp_ret);
+    lyd_free_withsiblings(output);
+}
+
+static void
+test_rpc_hash(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_subscription_ctx_t *subscr[3];
+    const char *op_paths[3] = {"/ops:rpc1", "/ops:rpc2", "/ops:rpc3"};
+    int called[3] = {0}, i, ret;
+
+    /* subscribe to every RPC separately */
+    for (i = 0; i < 3; ++i) {
+        ret = sr_rpc_subscribe_tree(st->sess, op_paths[i], rpc_count_cb, &called[i], 0, 0, &subscr[i]);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+
+    for (i = 0; i < 3; ++i) {
+        rpc_hash_send(st->sess, op_paths[i], SR_ERR_OK);
+    }
+    assert_int_equal(called[0], 1);
+    assert_int_equal(called[1], 1);
+    assert_int_equal(called[2], 1);
+
+    /* remove the first RPC, the others are moved in SHM and must still be found */
+    sr_unsubscribe(subscr[0]);
+    subscr[0] = NULL;
+
+    rpc_hash_send(st->sess, op_paths[0], SR_ERR_UNSUPPORTED);
+    rpc_hash_send(st->sess, op_paths[1], SR_ERR_OK);
+    rpc_hash_send(st->sess, op_paths[2], SR_ERR_OK);
+    assert_int_equal(called[0], 1);
+    assert_int_equal(called[1], 2);
+    assert_int_equal(called[2], 2);
+
+    /* remove the middle one as well */
+    sr_unsubscribe(subscr[1]);
+    subscr[1] = NULL;
+
+    rpc_hash_send(st->sess, op_paths[0], SR_ERR_UNSUPPORTED);
+    rpc_hash_send(st->sess, op_paths[1], SR_ERR_UNSUPPORTED);
+    rpc_hash_send(st->sess, op_paths[2], SR_ERR_OK);
+    assert_int_equal(called[2], 3);
+
+    /* subscribe them again */
+    for (i = 0; i < 2; ++i) {
+        ret = sr_rpc_subscribe_tree(st->sess, op_paths[i], rpc_count_cb, &called[i], 0, 0, &subscr[i]);
+        assert_int_equal(ret, SR_ERR_OK);
+    }
+
+    for (i = 0; i < 3; ++i) {
+        rpc_hash_send(st->sess, op_paths[i], SR_ERR_OK);
+    }
+    assert_int_equal(called[0], 2);
+    assert_int_equal(called[1], 3);
+    assert_int_equal(called[2], 4);
+
+    for (i = 0; i < 3; ++i) {
+        sr_unsubscribe(subscr[i]);
+    }
+
+    /* no RPCs left */
+    rpc_hash_send(st->sess, op_paths[2], SR_ERR_UNSUPPORTED);
+}
+
 /* MAIN */
 int
 main(void)
@@ -1409,6 +1504,7 @@ main(void)
         cmocka_unit_test(test_action_deps),
         cmocka_unit_test_teardown(test_action_change_config, clear_ops),
         cmocka_unit_test(test_rpc_shelve),
+        cmocka_unit_test(test_rpc_hash),
     };
 
     setenv("CMOCKA_TEST_ABORT", "1", 1);
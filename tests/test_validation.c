@@ -63,6 +63,15 @@ setup_f(void **state)
     if (sr_install_module(st->conn, TESTS_DIR "/files/refs.yang", TESTS_DIR "/files", NULL, 0) != SR_ERR_OK) {
         return 1;
     }
+    if (sr_install_module(st->conn, TESTS_DIR "/files/simple.yang", TESTS_DIR "/files", NULL, 0) != SR_ERR_OK) {
+        return 1;
+    }
+    if (sr_install_module(st->conn, TESTS_DIR "/files/decimal.yang", TESTS_DIR "/files", NULL, 0) != SR_ERR_OK) {
+        return 1;
+    }
+    if (sr_install_module(st->conn, TESTS_DIR "/files/list-case.yang", TESTS_DIR "/files", NULL, 0) != SR_ERR_OK) {
+        return 1;
+    }
     sr_disconnect(st->conn);
 
     if (sr_connect(0, &(st->conn)) != SR_ERR_OK) {
@@ -81,8 +90,11 @@ teardown_f(void **state)
 {
     struct state *st = (struct state *)*state;
 
-    sr_remove_module(st->conn, "test");
+    sr_remove_module(st->conn, "list-case");
+    sr_remove_module(st->conn, "decimal");
+    sr_remove_module(st->conn, "simple");
     sr_remove_module(st->conn, "refs");
+    sr_remove_module(st->conn, "test");
 
     sr_disconnect(st->conn);
     free(st);
@@ -217,6 +229,230 @@ test_instid(void **state)
     assert_int_equal(ret, SR_ERR_OK);
 }
 
+static void
+test_incremental(void **state)
+{
+    struct state *st = (struct state *)*state;
+    sr_conn_ctx_t *full_conn;
+    sr_session_ctx_t *sess[2];
+    struct {
+        const char *xpath1;
+        const char *value1;
+        const char *xpath2;
+        const char *value2;
+        int del;
+        int ret;
+    } changes[] = {
+        {"/refs:l", NULL, NULL, NULL, 0, SR_ERR_OK},
+        {"/refs:lref", "8", NULL, NULL, 0, SR_ERR_VALIDATION_FAILED},
+        {"/test:test-leaf", "8", NULL, NULL, 0, SR_ERR_VALIDATION_FAILED},
+        {"/test:test-leaf", "8", "/refs:lref", "8", 0, SR_ERR_OK},
+        {"/test:test-leaf", NULL, NULL, NULL, 1, SR_ERR_VALIDATION_FAILED},
+        {"/test:cont/server", "localhost", NULL, NULL, 0, SR_ERR_OK},
+        {"/refs:cont", NULL, NULL, NULL, 0, SR_ERR_VALIDATION_FAILED},
+        {"/refs:cont", NULL, "/test:ll1", "-3000", 0, SR_ERR_OK},
+        {"/refs:inst-id", "/test:test-leaf", NULL, NULL, 0, SR_ERR_OK},
+        {"/refs:inst-id", "/test:ll1[.='5']", NULL, NULL, 0, SR_ERR_VALIDATION_FAILED},
+    };
+    uint32_t i, j;
+    int ret;
+
+    /* create valid data */
+    ret = sr_set_item_str(st->sess, "/test:test-leaf", "10", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/refs:lref", "10", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* connection validating everything */
+    ret = sr_connect(SR_CONN_FULL_VALIDATION, &full_conn);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_session_start(full_conn, SR_DS_RUNNING, &sess[1]);
+    assert_int_equal(ret, SR_ERR_OK);
+    sess[0] = st->sess;
+
+    /* both validations must always reach the same verdict */
+    for (i = 0; i < sizeof changes / sizeof *changes; ++i) {
+        for (j = 0; j < 2; ++j) {
+            if (changes[i].del) {
+                ret = sr_delete_item(sess[j], changes[i].xpath1, 0);
+            } else {
+                ret = sr_set_item_str(sess[j], changes[i].xpath1, changes[i].value1, NULL, 0);
+            }
+            assert_int_equal(ret, SR_ERR_OK);
+            if (changes[i].xpath2) {
+                ret = sr_set_item_str(sess[j], changes[i].xpath2, changes[i].value2, NULL, 0);
+                assert_int_equal(ret, SR_ERR_OK);
+            }
+
+            ret = sr_validate(sess[j], NULL, 0);
+            assert_int_equal(ret, changes[i].ret);
+            if (ret) {
+                /* applying the changes must fail the same way */
+                ret = sr_apply_changes(sess[j], 0, 0);
+                assert_int_equal(ret, changes[i].ret);
+            }
+
+            ret = sr_discard_changes(sess[j]);
+            assert_int_equal(ret, SR_ERR_OK);
+        }
+    }
+
+    /* unchanged module with an inst-id referencing data of a module without any other dependencies */
+    ret = sr_set_item_str(st->sess, "/simple:ac1/acl1[acs1='a']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/refs:inst-id", "/simple:ac1/simple:acl1[simple:acs1='a']", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* removing the target must fail */
+    for (j = 0; j < 2; ++j) {
+        ret = sr_replace_config(sess[j], "simple", NULL, 0, 0);
+        assert_int_equal(ret, SR_ERR_VALIDATION_FAILED);
+    }
+
+    ret = sr_delete_item(st->sess, "/refs:inst-id", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_delete_item(st->sess, "/simple:ac1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    sr_disconnect(full_conn);
+}
+
+static int
+clear_independent(void **state)
+{
+    struct state *st = (struct state *)*state;
+
+    sr_delete_item(st->sess, "/simple:ac1", 0);
+    sr_delete_item(st->sess, "/decimal:d1", 0);
+    sr_delete_item(st->sess, "/list-case:ac1", 0);
+    sr_apply_changes(st->sess, 0, 0);
+
+    return clear_test_refs(state);
+}
+
+static void
+test_independent(void **state)
+{
+    struct state *st = (struct state *)*state;
+    struct lyd_node *data;
+    struct ly_set *set;
+    const char *paths[] = {"/simple:ac1/acd1", "/decimal:d1", "/list-case:ac1/acl1[acs1='b']", "/refs:lref"};
+    uint32_t i;
+    int ret;
+
+    /* change several independent modules at once, one of them invalid */
+    ret = sr_set_item_str(st->sess, "/test:test-leaf", "10", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/refs:lref", "8", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/simple:ac1/acl1[acs1='a']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/decimal:d1", "1.5", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/list-case:ac1/acl1[acs1='b']/acl1ch1cs1lf1", "x", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_validate(st->sess, NULL, 0);
+    assert_int_equal(ret, SR_ERR_VALIDATION_FAILED);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_VALIDATION_FAILED);
+
+    /* fix it */
+    ret = sr_set_item_str(st->sess, "/refs:lref", "10", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_validate(st->sess, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* all the data were stored, with defaults */
+    ret = sr_get_data(st->sess, "/simple:ac1/acd1 | /decimal:d1 | /list-case:ac1 | /refs:lref", 0, 0, 0, &data);
+    assert_int_equal(ret, SR_ERR_OK);
+    for (i = 0; i < sizeof paths / sizeof *paths; ++i) {
+        set = lyd_find_path(data, paths[i]);
+        assert_non_null(set);
+        assert_int_equal(set->number, 1);
+        ly_set_free(set);
+    }
+    lyd_free_withsiblings(data);
+}
+
+static int instid_adds;
+
+static void
+test_instid_unrelated_log_cb(sr_log_level_t level, const char *message)
+{
+    (void)level;
+
+    if (strstr(message, "Module \"refs\" with instance-identifiers referencing")) {
+        ++instid_adds;
+    }
+}
+
+static void
+test_instid_unrelated(void **state)
+{
+    struct state *st = (struct state *)*state;
+    int ret;
+
+    /* inst-id referencing simple data */
+    ret = sr_set_item_str(st->sess, "/simple:ac1/acl1[acs1='a']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/decimal:d1", "1.5", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_set_item_str(st->sess, "/refs:inst-id", "/simple:ac1/simple:acl1[simple:acs1='a']", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    instid_adds = 0;
+    sr_log_set_cb(test_instid_unrelated_log_cb);
+
+    /* unrelated module change, refs is neither locked nor loaded */
+    ret = sr_set_item_str(st->sess, "/decimal:d1", "2.5", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(instid_adds, 0);
+
+    /* referenced module change, refs is revalidated */
+    ret = sr_set_item_str(st->sess, "/simple:ac1/acl1[acs1='b']", NULL, NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(instid_adds, 1);
+
+    /* point it to decimal data */
+    ret = sr_set_item_str(st->sess, "/refs:inst-id", "/decimal:d1", NULL, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+
+    /* simple is not referenced anymore */
+    instid_adds = 0;
+    ret = sr_delete_item(st->sess, "/simple:ac1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    assert_int_equal(instid_adds, 0);
+
+    /* but removing the new target must fail */
+    ret = sr_delete_item(st->sess, "/decimal:d1", 0);
+    assert_int_equal(ret, SR_ERR_OK);
+    ret = sr_apply_changes(st->sess, 0, 0);
+    assert_int_equal(ret, SR_ERR_VALIDATION_FAILED);
+    assert_int_equal(instid_adds, 1);
+    sr_log_set_cb(NULL);
+
+    ret = sr_discard_changes(st->sess);
+    assert_int_equal(ret, SR_ERR_OK);
+}
+
 static void
 test_operational(void **state)
 {
@@ -276,6 +512,9 @@ main(void)
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_teardown(test_leafref, clear_test_refs),
         cmocka_unit_test_teardown(test_instid, clear_test_refs),
+        cmocka_unit_test_teardown(test_incremental, clear_test_refs),
+        cmocka_unit_test_teardown(test_independent, clear_independent),
+        cmocka_unit_test_teardown(test_instid_unrelated, clear_independent),
         cmocka_unit_test(test_operational),
     };
 